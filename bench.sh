@@ -0,0 +1,36 @@
+#!/bin/sh
+set -eu
+
+# Build and run the micro-benchmarks under bench/.
+#   ./bench.sh              run all
+#   ./bench.sh NAME [ARGS]  run one benchmark with its own arguments
+
+ROOT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BENCH_DIR="$ROOT_DIR/build/bench"
+mkdir -p "$BENCH_DIR"
+
+CC=${CC:-cc}
+CFLAGS="-O2 -std=c11 -Wall -Wextra -Wpedantic -pthread -D_POSIX_C_SOURCE=200809L -D_DEFAULT_SOURCE"
+SYNC="$ROOT_DIR/plugins/sync"
+
+build_bench() {
+  name="$1"; shift
+  echo "Building $name..."
+  $CC $CFLAGS -I"$ROOT_DIR/plugins" \
+    "$ROOT_DIR/bench/$name.c" "$@" \
+    -o "$BENCH_DIR/$name" -pthread
+}
+
+build_bench queue_bench "$SYNC/monitor.c" "$SYNC/consumer_producer.c" "$SYNC/spsc_ring.c" "$SYNC/byte_ring.c" "$SYNC/byte_budget.c" "$SYNC/spill_file.c" "$SYNC/slab.c" "$SYNC/executor.c"
+build_bench monitor_bench "$SYNC/monitor.c"
+build_bench placement_bench -I"$ROOT_DIR/src" "$ROOT_DIR/src/placement.c" "$SYNC/monitor.c" "$SYNC/consumer_producer.c" "$SYNC/spsc_ring.c" "$SYNC/byte_ring.c" "$SYNC/byte_budget.c" "$SYNC/spill_file.c" "$SYNC/slab.c" "$SYNC/executor.c"
+build_bench text_bench "$ROOT_DIR/plugins/text/cpu.c" "$ROOT_DIR/plugins/text/upper.c" "$ROOT_DIR/plugins/text/reverse.c" "$ROOT_DIR/plugins/text/expand.c"
+
+BENCHES="queue_bench monitor_bench placement_bench text_bench"
+if [ $# -gt 0 ]; then
+  BENCHES="$1"; shift
+fi
+for b in $BENCHES; do
+  echo "== $b =="
+  "$BENCH_DIR/$b" "$@"
+done
@@ -0,0 +1,185 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sync/monitor.h"
+
+/*
+ * Contention benchmark for monitor_t against the previous
+ * mutex + condvar + flag design (kept here as "legacy" for reference).
+ *
+ *   usage: monitor_bench [iterations] [signalling_threads]
+ */
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    int signaled;
+} legacy_monitor_t;
+
+static int legacy_init(void* m) {
+    legacy_monitor_t* l = (legacy_monitor_t*)m;
+    pthread_mutex_init(&l->mutex, NULL);
+    pthread_cond_init(&l->condition, NULL);
+    l->signaled = 0;
+    return 0;
+}
+
+static void legacy_destroy(void* m) {
+    legacy_monitor_t* l = (legacy_monitor_t*)m;
+    pthread_cond_destroy(&l->condition);
+    pthread_mutex_destroy(&l->mutex);
+}
+
+static void legacy_signal(void* m) {
+    legacy_monitor_t* l = (legacy_monitor_t*)m;
+    pthread_mutex_lock(&l->mutex);
+    l->signaled = 1;
+    pthread_cond_broadcast(&l->condition);
+    pthread_mutex_unlock(&l->mutex);
+}
+
+static int legacy_wait(void* m) {
+    legacy_monitor_t* l = (legacy_monitor_t*)m;
+    pthread_mutex_lock(&l->mutex);
+    while (!l->signaled) pthread_cond_wait(&l->condition, &l->mutex);
+    l->signaled = 0;
+    pthread_mutex_unlock(&l->mutex);
+    return 0;
+}
+
+static int current_init(void* m) { return monitor_init((monitor_t*)m); }
+static void current_destroy(void* m) { monitor_destroy((monitor_t*)m); }
+static void current_signal(void* m) { monitor_signal((monitor_t*)m); }
+static int current_wait(void* m) { return monitor_wait((monitor_t*)m); }
+
+typedef struct {
+    const char* name;
+    int (*init)(void*);
+    void (*destroy)(void*);
+    void (*signal)(void*);
+    int (*wait)(void*);
+} impl_t;
+
+static const impl_t IMPLS[] = {
+    { "legacy", legacy_init, legacy_destroy, legacy_signal, legacy_wait },
+    { "monitor", current_init, current_destroy, current_signal, current_wait },
+};
+
+typedef union {
+    legacy_monitor_t legacy;
+    monitor_t current;
+} any_monitor_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* 1) signal with nobody waiting: the common case on a busy queue */
+static void bench_uncontended(const impl_t* impl, long iters) {
+    any_monitor_t m;
+    impl->init(&m);
+    double start = now_sec();
+    for (long i = 0; i < iters; ++i) impl->signal(&m);
+    double elapsed = now_sec() - start;
+    impl->destroy(&m);
+    printf("%-8s signal-no-waiter  %8.1f ns/op\n", impl->name, elapsed * 1e9 / (double)iters);
+}
+
+/* 2) ping-pong handoff between two threads */
+typedef struct {
+    const impl_t* impl;
+    any_monitor_t* ping;
+    any_monitor_t* pong;
+    long iters;
+} pingpong_arg_t;
+
+static void* pong_thread(void* p) {
+    pingpong_arg_t* a = (pingpong_arg_t*)p;
+    for (long i = 0; i < a->iters; ++i) {
+        a->impl->wait(a->ping);
+        a->impl->signal(a->pong);
+    }
+    return NULL;
+}
+
+static void bench_pingpong(const impl_t* impl, long iters) {
+    any_monitor_t ping, pong;
+    impl->init(&ping);
+    impl->init(&pong);
+    pingpong_arg_t a = { impl, &ping, &pong, iters };
+    pthread_t t;
+    double start = now_sec();
+    pthread_create(&t, NULL, pong_thread, &a);
+    for (long i = 0; i < iters; ++i) {
+        impl->signal(&ping);
+        impl->wait(&pong);
+    }
+    pthread_join(t, NULL);
+    double elapsed = now_sec() - start;
+    impl->destroy(&ping);
+    impl->destroy(&pong);
+    printf("%-8s ping-pong         %8.1f ns/round-trip\n", impl->name, elapsed * 1e9 / (double)iters);
+}
+
+/* 3) many signalling threads, one waiter */
+typedef struct {
+    const impl_t* impl;
+    any_monitor_t* m;
+    long iters;
+    atomic_int* stop;
+} storm_arg_t;
+
+static void* storm_signaller(void* p) {
+    storm_arg_t* a = (storm_arg_t*)p;
+    for (long i = 0; i < a->iters; ++i) a->impl->signal(a->m);
+    return NULL;
+}
+
+static void* storm_waiter(void* p) {
+    storm_arg_t* a = (storm_arg_t*)p;
+    while (!atomic_load(a->stop)) a->impl->wait(a->m);
+    return NULL;
+}
+
+static void bench_storm(const impl_t* impl, long iters, int threads) {
+    any_monitor_t m;
+    impl->init(&m);
+    atomic_int stop;
+    atomic_init(&stop, 0);
+    storm_arg_t a = { impl, &m, iters, &stop };
+    pthread_t waiter;
+    pthread_t* sig = (pthread_t*)calloc((size_t)threads, sizeof(pthread_t));
+    pthread_create(&waiter, NULL, storm_waiter, &a);
+    double start = now_sec();
+    for (int i = 0; i < threads; ++i) pthread_create(&sig[i], NULL, storm_signaller, &a);
+    for (int i = 0; i < threads; ++i) pthread_join(sig[i], NULL);
+    double elapsed = now_sec() - start;
+    atomic_store(&stop, 1);
+    impl->signal(&m);
+    pthread_join(waiter, NULL);
+    impl->destroy(&m);
+    free(sig);
+    printf("%-8s %d signallers/1 waiter %8.1f ns/signal\n", impl->name, threads,
+           elapsed * 1e9 / ((double)iters * threads));
+}
+
+int main(int argc, char** argv) {
+    long iters = argc > 1 ? strtol(argv[1], NULL, 10) : 200000;
+    int threads = argc > 2 ? (int)strtol(argv[2], NULL, 10) : 4;
+    if (iters <= 0 || threads <= 0) {
+        fprintf(stderr, "usage: %s [iterations] [signalling_threads]\n", argv[0]);
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(IMPLS) / sizeof(IMPLS[0]); ++i) {
+        bench_uncontended(&IMPLS[i], iters * 10);
+        bench_pingpong(&IMPLS[i], iters / 4);
+        bench_storm(&IMPLS[i], iters, threads);
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "placement.h"
+#include "sync/consumer_producer.h"
+
+/*
+ * Items/sec through a long chain of locked queues, one thread per stage,
+ * with the stage threads floating, packed onto sibling cores of one node
+ * (compact), or dealt across nodes so that every hop crosses the
+ * interconnect (spread). Each queue is set up while pinned to its
+ * consumer's CPU, as the hosts do, so its buffers come from that node.
+ *
+ *   usage: placement_bench [items] [stages]
+ *
+ * On a machine with a single node, compact and spread differ only in
+ * whether neighbours share a core's caches.
+ */
+
+#define MAX_STAGES 64
+
+typedef struct {
+    consumer_producer_t* in;
+    consumer_producer_t* out; /* NULL for the last stage */
+    slab_t* slab;
+    long received;
+} stage_arg_t;
+
+static void* stage_thread(void* p) {
+    stage_arg_t* a = (stage_arg_t*)p;
+    char* items[CP_BATCH_MAX];
+    int done = 0;
+    while (!done) {
+        int n = consumer_producer_acquire_batch(a->in, items, CP_BATCH_MAX);
+        if (n == 0) break;
+        for (int i = 0; i < n; ++i) {
+            if (strcmp(items[i], "<END>") == 0) done = 1;
+            else a->received++;
+        }
+        /* copies each line: the next stage reads it from this one's cache */
+        if (a->out) consumer_producer_put_batch(a->out, (const char* const*)items, n);
+        for (int i = 0; i < n; ++i) {
+            if (strcmp(items[i], "<END>") != 0) slab_free(a->slab, items[i]);
+        }
+        consumer_producer_release(a->in);
+    }
+    return NULL;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int run_chain(const char* policy, long items, int stages, slab_t* slab) {
+    placement where;
+    const char* err = placement_init(&where, policy);
+    if (err) {
+        fprintf(stderr, "%s: %s\n", policy, err);
+        placement_free(&where);
+        return 1;
+    }
+    consumer_producer_t queues[MAX_STAGES];
+    stage_arg_t args[MAX_STAGES];
+    pthread_t threads[MAX_STAGES];
+    char cpus[128];
+
+    for (int i = 0; i < stages; ++i) {
+        /* the queue and the thread started here inherit the stage's CPU */
+        if (placement_pin(&where, (size_t)i, 1, cpus, sizeof(cpus)) != 0) {
+            fprintf(stderr, "%s: cannot pin to CPU %s\n", policy, cpus);
+            return 1;
+        }
+        err = consumer_producer_init(&queues[i], 128);
+        if (err) {
+            fprintf(stderr, "%s: %s\n", policy, err);
+            return 1;
+        }
+        consumer_producer_set_allocator(&queues[i], slab);
+        args[i].in = &queues[i];
+        args[i].out = NULL;
+        args[i].slab = slab;
+        args[i].received = 0;
+        if (i > 0) args[i - 1].out = &queues[i];
+    }
+    for (int i = 0; i < stages; ++i) {
+        placement_pin(&where, (size_t)i, 1, cpus, sizeof(cpus));
+        pthread_create(&threads[i], NULL, stage_thread, &args[i]);
+    }
+    /* the feeder shares the first stage's CPU */
+    placement_pin(&where, 0, 1, cpus, sizeof(cpus));
+
+    const char* line = "2025-01-01T00:00:00Z host app[123]: short log line";
+    const char* feed[CP_BATCH_MAX];
+    for (int i = 0; i < CP_BATCH_MAX; ++i) feed[i] = line;
+    double start = now_sec();
+    for (long n = 0; n < items; n += CP_BATCH_MAX) {
+        long left = items - n;
+        consumer_producer_put_batch(&queues[0], feed, left < CP_BATCH_MAX ? (int)left : CP_BATCH_MAX);
+    }
+    consumer_producer_put(&queues[0], "<END>");
+    for (int i = 0; i < stages; ++i) pthread_join(threads[i], NULL);
+    double elapsed = now_sec() - start;
+
+    for (int i = 0; i < stages; ++i) consumer_producer_destroy(&queues[i]);
+    placement_free(&where);
+
+    if (args[stages - 1].received != items) {
+        fprintf(stderr, "%s: expected %ld items, got %ld\n", policy, items, args[stages - 1].received);
+        return 1;
+    }
+    printf("%-8s %d stages  %ld items  %.3f s  %.0f items/sec\n",
+           policy, stages, items, elapsed, (double)items / elapsed);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    long items = argc > 1 ? strtol(argv[1], NULL, 10) : 200000;
+    int stages = argc > 2 ? (int)strtol(argv[2], NULL, 10) : 16;
+    if (items <= 0 || stages <= 0 || stages > MAX_STAGES) {
+        fprintf(stderr, "usage: %s [items] [stages]\n", argv[0]);
+        return 1;
+    }
+    slab_t slab;
+    if (slab_init(&slab) != 0) return 1;
+    /* pins stick to this thread, so the floating run goes first */
+    int rc = run_chain("none", items, stages, &slab) != 0 ||
+             run_chain("compact", items, stages, &slab) != 0 ||
+             run_chain("spread", items, stages, &slab) != 0;
+    slab_destroy(&slab);
+    return rc;
+}
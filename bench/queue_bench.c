@@ -0,0 +1,151 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sync/consumer_producer.h"
+
+/*
+ * Items/sec through a chain of STAGES queues, one thread per stage,
+ * mirroring how plugin_consumer_thread forwards into the next plugin.
+ *
+ *   usage: queue_bench [items] [capacity]
+ *
+ * capacity counts items; the byte-ring runs use capacity * 64 bytes.
+ * The /slab runs copy lines into slab blocks instead of malloc'd ones; each
+ * block is freed by the stage after the one that allocated it.
+ */
+
+#define STAGES 6
+
+typedef struct {
+    consumer_producer_t* in;
+    consumer_producer_t* out; /* NULL for the last stage */
+    slab_t* slab;             /* allocator of the items, NULL for malloc */
+    long received;
+    int batched;
+} stage_arg_t;
+
+/* Drain-many variant: one acquire_batch/put_batch pair per wakeup. For the
+ * byte ring the items are borrowed views and nothing is allocated. */
+static void stage_batched(stage_arg_t* a) {
+    char* items[CP_BATCH_MAX];
+    int borrowed = consumer_producer_borrows(a->in);
+    int done = 0;
+    while (!done) {
+        int n = consumer_producer_acquire_batch(a->in, items, CP_BATCH_MAX);
+        if (n == 0) break;
+        for (int i = 0; i < n; ++i) {
+            if (strcmp(items[i], "<END>") == 0) done = 1;
+            else a->received++;
+        }
+        if (a->out) consumer_producer_put_batch(a->out, (const char* const*)items, n);
+        for (int i = 0; i < n && !borrowed; ++i) {
+            if (strcmp(items[i], "<END>") != 0) slab_free(a->slab, items[i]);
+        }
+        consumer_producer_release(a->in);
+    }
+}
+
+static void* stage_thread(void* p) {
+    stage_arg_t* a = (stage_arg_t*)p;
+    if (a->batched) {
+        stage_batched(a);
+        return NULL;
+    }
+    for (;;) {
+        char* item = consumer_producer_get(a->in);
+        if (!item) break;
+        if (strcmp(item, "<END>") == 0) {
+            if (a->out) consumer_producer_put(a->out, item);
+            break;
+        }
+        a->received++;
+        if (a->out) consumer_producer_put(a->out, item);
+        slab_free(a->slab, item);
+    }
+    return NULL;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int run_chain(consumer_producer_kind_t kind, const char* label, long items, int capacity,
+                     int batched, slab_t* slab) {
+    consumer_producer_t queues[STAGES];
+    stage_arg_t args[STAGES];
+    pthread_t threads[STAGES];
+
+    for (int i = 0; i < STAGES; ++i) {
+        const char* err = consumer_producer_init_kind(&queues[i], capacity, kind);
+        if (err) {
+            fprintf(stderr, "%s: %s\n", label, err);
+            return 1;
+        }
+        consumer_producer_set_allocator(&queues[i], slab);
+    }
+    for (int i = 0; i < STAGES; ++i) {
+        args[i].in = &queues[i];
+        args[i].out = i + 1 < STAGES ? &queues[i + 1] : NULL;
+        args[i].slab = slab;
+        args[i].received = 0;
+        args[i].batched = batched;
+        pthread_create(&threads[i], NULL, stage_thread, &args[i]);
+    }
+
+    const char* line = "2025-01-01T00:00:00Z host app[123]: short log line";
+    double start = now_sec();
+    if (batched) {
+        const char* feed[CP_BATCH_MAX];
+        for (int i = 0; i < CP_BATCH_MAX; ++i) feed[i] = line;
+        for (long n = 0; n < items; n += CP_BATCH_MAX) {
+            long left = items - n;
+            consumer_producer_put_batch(&queues[0], feed, left < CP_BATCH_MAX ? (int)left : CP_BATCH_MAX);
+        }
+    } else {
+        for (long n = 0; n < items; ++n) {
+            consumer_producer_put(&queues[0], line);
+        }
+    }
+    consumer_producer_put(&queues[0], "<END>");
+    for (int i = 0; i < STAGES; ++i) pthread_join(threads[i], NULL);
+    double elapsed = now_sec() - start;
+
+    for (int i = 0; i < STAGES; ++i) consumer_producer_destroy(&queues[i]);
+
+    if (args[STAGES - 1].received != items) {
+        fprintf(stderr, "%s: expected %ld items, got %ld\n", label, items, args[STAGES - 1].received);
+        return 1;
+    }
+    printf("%-14s %d stages  %ld items  %.3f s  %.0f items/sec\n",
+           label, STAGES, items, elapsed, (double)items / elapsed);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    long items = argc > 1 ? strtol(argv[1], NULL, 10) : 200000;
+    int capacity = argc > 2 ? (int)strtol(argv[2], NULL, 10) : 128;
+    if (items <= 0 || capacity <= 0) {
+        fprintf(stderr, "usage: %s [items] [capacity]\n", argv[0]);
+        return 1;
+    }
+    if (run_chain(CP_QUEUE_LOCKED, "locked", items, capacity, 0, NULL) != 0) return 1;
+    if (run_chain(CP_QUEUE_SPSC, "spsc", items, capacity, 0, NULL) != 0) return 1;
+    if (run_chain(CP_QUEUE_LOCKED, "locked/batch", items, capacity, 1, NULL) != 0) return 1;
+    if (run_chain(CP_QUEUE_SPSC, "spsc/batch", items, capacity, 1, NULL) != 0) return 1;
+    /* byte ring sized to hold about the same number of these lines */
+    if (run_chain(CP_QUEUE_BYTES, "bytes", items, capacity * 64, 0, NULL) != 0) return 1;
+    if (run_chain(CP_QUEUE_BYTES, "bytes/view", items, capacity * 64, 1, NULL) != 0) return 1;
+
+    slab_t slab;
+    if (slab_init(&slab) != 0) return 1;
+    int rc = run_chain(CP_QUEUE_LOCKED, "locked/slab", items, capacity, 1, &slab) != 0 ||
+             run_chain(CP_QUEUE_SPSC, "spsc/slab", items, capacity, 1, &slab) != 0;
+    slab_destroy(&slab);
+    return rc;
+}
@@ -0,0 +1,151 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "text/expand.h"
+#include "text/reverse.h"
+#include "text/upper.h"
+
+/*
+ * Throughput of each text kernel this CPU can run, in GB/s of line bytes,
+ * for a few line lengths. Lines sit back to back in a buffer larger than
+ * the L2 cache, so long lines measure the memory-bound case.
+ *
+ * The expander rows time a whole line transform, allocation included:
+ * the previous byte-by-byte expander against exact-size allocation plus
+ * each interleave kernel.
+ *
+ *   usage: text_bench [megabytes_per_run]
+ */
+
+#define BUF_BYTES (8u << 20)
+
+static const size_t LINE_LENS[] = { 16, 64, 1024, 65536, 1u << 20 };
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static const char ASCII_TEXT[] = "The quick brown fox jumps over the lazy dog, 0123456789! ";
+static const char MIXED_TEXT[] = "Stra\xc3\x9f" "e, caf\xc3\xa9, \xe2\x82\xac" "5, \xe4\xb8\xad\xe6\x96\x87, \xf0\x9f\x98\x80 ok. ";
+
+typedef void (*kernel_fn)(char* data, size_t len);
+
+static void fill_text(char* buf, size_t len, const char* sample, size_t sample_len) {
+    for (size_t i = 0; i < len; ++i) {
+        buf[i] = sample[i % sample_len];
+    }
+}
+
+#define BENCH(label, isa, fn, sample, buf, total) \
+    bench_kernel(label, isa, fn, sample, sizeof(sample) - 1, buf, total)
+
+static void bench_kernel(const char* label, text_isa_t isa, kernel_fn fn,
+                         const char* sample, size_t sample_len, char* buf, size_t total) {
+    if (!fn) {
+        return;
+    }
+    printf("%-12s %-7s", label, text_isa_name(isa));
+    for (size_t k = 0; k < sizeof(LINE_LENS) / sizeof(LINE_LENS[0]); ++k) {
+        size_t line = LINE_LENS[k];
+        size_t lines = BUF_BYTES / line;
+        size_t done = 0;
+        double elapsed = 0;
+        while (done < total) {
+            fill_text(buf, lines * line, sample, sample_len);   /* fresh input, untimed */
+            double start = now_sec();
+            for (size_t i = 0; i < lines; ++i) {
+                fn(buf + i * line, line);
+            }
+            elapsed += now_sec() - start;
+            done += lines * line;
+        }
+        printf("  %7zuB %6.2f GB/s", line, (double)done / elapsed / 1e9);
+    }
+    printf("\n");
+}
+
+static const size_t EXPAND_LENS[] = { 16, 1024, 1u << 20 };
+
+/* The expander before the interleave kernels, for reference. */
+static char* expand_legacy(const char* input, size_t len) {
+    char* out = (char*)malloc(len * 2);
+    if (!out) {
+        return NULL;
+    }
+    size_t j = 0;
+    for (size_t i = 0; i < len; ++i) {
+        out[j++] = input[i];
+        if (i + 1 < len) {
+            out[j++] = ' ';
+        }
+    }
+    out[j] = '\0';
+    return out;
+}
+
+static text_interleave_fn g_interleave;
+
+static char* expand_kernel(const char* input, size_t len) {
+    char* out = (char*)malloc(2 * len);
+    if (!out) {
+        return NULL;
+    }
+    g_interleave(out, input, len, ' ');
+    out[2 * len - 1] = '\0';
+    return out;
+}
+
+static void bench_expand(const char* label, char* (*expand)(const char*, size_t),
+                         const char* buf, size_t total) {
+    printf("%-12s %-7s", "expand", label);
+    for (size_t k = 0; k < sizeof(EXPAND_LENS) / sizeof(EXPAND_LENS[0]); ++k) {
+        size_t line = EXPAND_LENS[k];
+        size_t lines = BUF_BYTES / line;
+        size_t done = 0;
+        double start = now_sec();
+        while (done < total) {
+            for (size_t i = 0; i < lines; ++i) {
+                free(expand(buf + i * line, line));
+            }
+            done += lines * line;
+        }
+        double elapsed = now_sec() - start;
+        printf("  %7zuB %6.2f GB/s", line, (double)done / elapsed / 1e9);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    long mb = argc > 1 ? strtol(argv[1], NULL, 10) : 512;
+    if (mb <= 0) {
+        fprintf(stderr, "usage: %s [megabytes_per_run]\n", argv[0]);
+        return 1;
+    }
+    char* buf = (char*)malloc(BUF_BYTES);
+    if (!buf) {
+        return 1;
+    }
+    size_t total = (size_t)mb << 20;
+    for (int i = 0; i < TEXT_ISA_COUNT; ++i) {
+        text_isa_t isa = (text_isa_t)i;
+        BENCH("upper", isa, text_upper_kernel(isa), ASCII_TEXT, buf, total);
+        BENCH("reverse", isa, text_reverse_kernel(isa), ASCII_TEXT, buf, total);
+        BENCH("utf8 ascii", isa, text_reverse_utf8_kernel(isa), ASCII_TEXT, buf, total);
+        BENCH("utf8 mixed", isa, text_reverse_utf8_kernel(isa), MIXED_TEXT, buf, total);
+    }
+    fill_text(buf, BUF_BYTES, ASCII_TEXT, sizeof(ASCII_TEXT) - 1);
+    bench_expand("legacy", expand_legacy, buf, total);
+    for (int i = 0; i < TEXT_ISA_COUNT; ++i) {
+        g_interleave = text_interleave_kernel((text_isa_t)i);
+        if (g_interleave) {
+            bench_expand(text_isa_name((text_isa_t)i), expand_kernel, buf, total);
+        }
+    }
+    free(buf);
+    return 0;
+}
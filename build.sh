@@ -30,33 +30,42 @@ fi
 
 echo "Building core pipeline..."
 $CC $CFLAGS -Isrc -Iplugins \
-  "$SRC_DIR/bq.c" "$SRC_DIR/pipeline.c" \
+  "$SRC_DIR/bq.c" "$SRC_DIR/options.c" "$SRC_DIR/plan.c" "$SRC_DIR/placement.c" "$ROOT_DIR/plugins/sync/byte_budget.c" "$ROOT_DIR/plugins/sync/slab.c" "$ROOT_DIR/plugins/sync/executor.c" "$SRC_DIR/pipeline.c" \
   -o "$BUILD_DIR/pipeline" $LDFLAGS $dlflag $rpath ${EXPORT_MAIN:-}
 
 echo "Building analyzer (spec main)..."
 $CC $CFLAGS -Isrc -Iplugins \
-  "$SRC_DIR/bq.c" "$SRC_DIR/main.c" \
+  "$SRC_DIR/bq.c" "$SRC_DIR/options.c" "$SRC_DIR/plan.c" "$SRC_DIR/placement.c" "$ROOT_DIR/plugins/sync/byte_budget.c" "$ROOT_DIR/plugins/sync/slab.c" "$ROOT_DIR/plugins/sync/executor.c" "$SRC_DIR/main.c" \
   -o "$OUT_DIR/analyzer" $LDFLAGS $dlflag $rpath ${EXPORT_MAIN:-}
 
+# build_plugin NAME [EXTRA_SOURCES...]
 build_plugin() {
-  name="$1"
-  src="$ROOT_DIR/plugins/$1.c"
-  out="$PLUG_DIR/$1.$ext"
+  name="$1"; shift
+  src="$ROOT_DIR/plugins/$name.c"
+  out="$PLUG_DIR/$name.$ext"
   echo "Building plugin $name -> $out"
   $CC $CFLAGS -Isrc -Iplugins $PLUGIN_LDFLAGS \
     "$src" \
     "$ROOT_DIR/plugins/plugin_common.c" \
     "$ROOT_DIR/plugins/sync/monitor.c" \
     "$ROOT_DIR/plugins/sync/consumer_producer.c" \
+    "$ROOT_DIR/plugins/sync/spsc_ring.c" \
+    "$ROOT_DIR/plugins/sync/byte_ring.c" \
+    "$ROOT_DIR/plugins/sync/byte_budget.c" \
+    "$ROOT_DIR/plugins/sync/spill_file.c" \
+    "$ROOT_DIR/plugins/sync/slab.c" \
+    "$ROOT_DIR/plugins/sync/executor.c" \
+    "$@" \
     -o "$out" $LDFLAGS ${dlflag:-}
 }
 
-build_plugin logger
+build_plugin logger "$ROOT_DIR/plugins/io/async_writer.c" "$ROOT_DIR/plugins/io/mmap_log.c" \
+  "$ROOT_DIR/plugins/io/uring_writer.c"
 build_plugin typewriter
-build_plugin uppercaser
-build_plugin rotator
-build_plugin flipper
-build_plugin expander
-build_plugin sink_stdout
+build_plugin uppercaser "$ROOT_DIR/plugins/text/cpu.c" "$ROOT_DIR/plugins/text/upper.c"
+build_plugin rotator "$ROOT_DIR/plugins/text/cpu.c" "$ROOT_DIR/plugins/text/reverse.c"
+build_plugin flipper "$ROOT_DIR/plugins/text/cpu.c" "$ROOT_DIR/plugins/text/reverse.c"
+build_plugin expander "$ROOT_DIR/plugins/text/cpu.c" "$ROOT_DIR/plugins/text/expand.c"
+build_plugin sink_stdout "$ROOT_DIR/plugins/io/uring_writer.c" "$ROOT_DIR/plugins/io/line_batch.c"
 
 echo "Done. Run: $OUT_DIR/analyzer <queue_size> <plugins...>"
@@ -1,49 +1,175 @@
+#include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "plugin_common.h"
 #include "plugin_sdk.h"
+#include "text/expand.h"
+
+#define EXPAND_SEP_MAX 256
 
 static plugin_context_t g_ctx;
+static char g_sep[EXPAND_SEP_MAX];  /* EXPANDER_SEPARATOR, EXPANDER_REPEAT times */
+static size_t g_sep_len;
+static text_interleave_fn g_interleave;
+
+/* Separators longer than a byte: one copy per gap. */
+static void expand_with(char* out, const char* input, size_t len) {
+    for (size_t i = 0; i + 1 < len; ++i) {
+        *out++ = input[i];
+        memcpy(out, g_sep, g_sep_len);
+        out += g_sep_len;
+    }
+    *out = input[len - 1];
+}
 
-static char* expand_with_spaces(char* input) {
-    if (!input) {
-        return NULL;
+static int expand_with_separator(record_t* rec) {
+    size_t len = rec->len;
+    if (len <= 1 || g_sep_len == 0) {
+        return 1;
     }
-    size_t len = strlen(input);
-    if (len == 0) {
-        return input;
+    /* len chars, len - 1 separators, terminator */
+    if (len - 1 > (SIZE_MAX - len - 1) / g_sep_len) {
+        return 1;
     }
-    size_t out_len = len * 2;
-    char* out = (char*)malloc(out_len);
+    size_t out_len = len + (len - 1) * g_sep_len;
+    char* out = common_plugin_alloc(&g_ctx, out_len + 1);
     if (!out) {
-        return input; /* fall back to original */
+        return 1; /* fall back to original */
+    }
+    if (g_sep_len == 1) {
+        g_interleave(out, rec->data, len, g_sep[0]);
+    } else {
+        expand_with(out, rec->data, len);
     }
-    size_t j = 0;
-    for (size_t i = 0; i < len; ++i) {
-        out[j++] = input[i];
-        if (i + 1 < len) {
-            out[j++] = ' ';
+    out[out_len] = '\0';
+    rec->data = out;
+    rec->len = out_len;
+    rec->cap = out_len + 1;
+    return 1;
+}
+
+static const char* parse_config(void) {
+    const char* sep = getenv("EXPANDER_SEPARATOR");
+    if (!sep) {
+        sep = " ";
+    }
+    size_t repeat = 1;
+    const char* env = getenv("EXPANDER_REPEAT");
+    if (env && *env) {
+        char* end = NULL;
+        errno = 0;
+        unsigned long val = strtoul(env, &end, 10);
+        if (errno != 0 || end == env || *end != '\0' || env[0] == '-') {
+            return "expander: invalid EXPANDER_REPEAT value";
         }
+        repeat = (size_t)val;
+    }
+    size_t len = strlen(sep);
+    if (len > 0 && repeat > sizeof(g_sep) / len) {
+        return "expander: separator too long (EXPANDER_SEPARATOR x EXPANDER_REPEAT)";
     }
-    out[j] = '\0';
-    return out;
+    g_sep_len = 0;
+    for (size_t i = 0; i < repeat && len > 0; ++i) {
+        memcpy(g_sep + g_sep_len, sep, len);
+        g_sep_len += len;
+    }
+    return NULL;
 }
 
 const char* plugin_get_name(void) { return "expander"; }
 
+/* Everything plugin_init sets up besides the queue and the thread. */
+static const char* configure(void) {
+    text_isa_t isa;
+    const char* err = parse_config();
+    if (!err) {
+        err = text_isa_limit(&isa);
+    }
+    if (err) {
+        return err;
+    }
+    g_interleave = text_interleave_select(isa);
+    return NULL;
+}
+
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(&g_ctx, expand_with_spaces, "expander", queue_size);
+    const char* err = configure();
+    return err ? err : common_plugin_init(&g_ctx, expand_with_separator, "expander", queue_size);
+}
+
+const char* plugin_init_inline(int (**process)(struct record* rec)) {
+    const char* err = configure();
+    return err ? err : common_plugin_init_inline(&g_ctx, expand_with_separator, "expander", process);
 }
 
 void plugin_attach(const char* (*next_place_work)(const char*)) {
     common_plugin_attach(&g_ctx, next_place_work);
 }
 
+void plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int)) {
+    common_plugin_attach_batch(&g_ctx, next_place_work_batch);
+}
+
+void plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+                         const char* (*next_place_work_owned_batch)(char* const*, int)) {
+    common_plugin_attach_owned(&g_ctx, next_place_work_owned, next_place_work_owned_batch);
+}
+
 const char* plugin_place_work(const char* str) {
     return common_plugin_place_work(&g_ctx, str);
 }
 
+const char* plugin_place_work_batch(const char* const* strs, int count) {
+    return common_plugin_place_work_batch(&g_ctx, strs, count);
+}
+
+const char* plugin_place_work_owned(char* str) {
+    return common_plugin_place_work_owned(&g_ctx, str);
+}
+
+const char* plugin_place_work_owned_batch(char* const* strs, int count) {
+    return common_plugin_place_work_owned_batch(&g_ctx, strs, count);
+}
+
+void plugin_attach_records(const char* (*next_place_work_records)(const struct record*, int),
+                           const char* (*next_place_work_records_owned)(const struct record*, int)) {
+    common_plugin_attach_records(&g_ctx, next_place_work_records, next_place_work_records_owned);
+}
+
+const char* plugin_place_work_records(const struct record* recs, int count) {
+    return common_plugin_place_work_records(&g_ctx, recs, count);
+}
+
+const char* plugin_place_work_records_owned(const struct record* recs, int count) {
+    return common_plugin_place_work_records_owned(&g_ctx, recs, count);
+}
+
+void plugin_set_memory_budget(struct byte_budget* budget) {
+    common_plugin_set_memory_budget(&g_ctx, budget);
+}
+
+void plugin_set_allocator(struct slab* slab) {
+    common_plugin_set_allocator(&g_ctx, slab);
+}
+
+void plugin_set_executor(struct executor* ex) {
+    common_plugin_set_executor(&g_ctx, ex, 1);
+}
+
+int plugin_process_record(struct record* rec) {
+    return expand_with_separator(rec);
+}
+
+const char* plugin_fuse(int (*process_record)(struct record* rec)) {
+    return common_plugin_fuse(&g_ctx, process_record);
+}
+
+const char* plugin_set_replicas(int replicas) {
+    return common_plugin_set_replicas(&g_ctx, replicas);
+}
+
 const char* plugin_wait_finished(void) {
     return common_plugin_wait_finished(&g_ctx);
 }
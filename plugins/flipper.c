@@ -3,36 +3,123 @@
 
 #include "plugin_common.h"
 #include "plugin_sdk.h"
+#include "text/reverse.h"
 
 static plugin_context_t g_ctx;
+static text_reverse_fn g_reverse;
 
-static char* flip_in_place(char* input) {
-    if (!input) {
+static int flip_in_place(record_t* rec) {
+    g_reverse(rec->data, rec->len);
+    return 1;
+}
+
+/* FLIPPER_UTF8=1 reverses code points instead of bytes. */
+static const char* parse_utf8_env(int* utf8) {
+    const char* env = getenv("FLIPPER_UTF8");
+    *utf8 = 0;
+    if (!env || !*env || strcmp(env, "0") == 0) {
         return NULL;
     }
-    size_t len = strlen(input);
-    for (size_t i = 0; i < len / 2; ++i) {
-        char tmp = input[i];
-        input[i] = input[len - 1 - i];
-        input[len - 1 - i] = tmp;
+    if (strcmp(env, "1") != 0) {
+        return "flipper: invalid FLIPPER_UTF8 value";
     }
-    return input;
+    *utf8 = 1;
+    return NULL;
 }
 
 const char* plugin_get_name(void) { return "flipper"; }
 
+/* Everything plugin_init sets up besides the queue and the thread. */
+static const char* configure(void) {
+    text_isa_t isa;
+    int utf8;
+    const char* err = text_isa_limit(&isa);
+    if (!err) {
+        err = parse_utf8_env(&utf8);
+    }
+    if (err) {
+        return err;
+    }
+    g_reverse = utf8 ? text_reverse_utf8_select(isa) : text_reverse_select(isa);
+    return NULL;
+}
+
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(&g_ctx, flip_in_place, "flipper", queue_size);
+    const char* err = configure();
+    return err ? err : common_plugin_init(&g_ctx, flip_in_place, "flipper", queue_size);
+}
+
+const char* plugin_init_inline(int (**process)(struct record* rec)) {
+    const char* err = configure();
+    return err ? err : common_plugin_init_inline(&g_ctx, flip_in_place, "flipper", process);
 }
 
 void plugin_attach(const char* (*next_place_work)(const char*)) {
     common_plugin_attach(&g_ctx, next_place_work);
 }
 
+void plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int)) {
+    common_plugin_attach_batch(&g_ctx, next_place_work_batch);
+}
+
+void plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+                         const char* (*next_place_work_owned_batch)(char* const*, int)) {
+    common_plugin_attach_owned(&g_ctx, next_place_work_owned, next_place_work_owned_batch);
+}
+
 const char* plugin_place_work(const char* str) {
     return common_plugin_place_work(&g_ctx, str);
 }
 
+const char* plugin_place_work_batch(const char* const* strs, int count) {
+    return common_plugin_place_work_batch(&g_ctx, strs, count);
+}
+
+const char* plugin_place_work_owned(char* str) {
+    return common_plugin_place_work_owned(&g_ctx, str);
+}
+
+const char* plugin_place_work_owned_batch(char* const* strs, int count) {
+    return common_plugin_place_work_owned_batch(&g_ctx, strs, count);
+}
+
+void plugin_attach_records(const char* (*next_place_work_records)(const struct record*, int),
+                           const char* (*next_place_work_records_owned)(const struct record*, int)) {
+    common_plugin_attach_records(&g_ctx, next_place_work_records, next_place_work_records_owned);
+}
+
+const char* plugin_place_work_records(const struct record* recs, int count) {
+    return common_plugin_place_work_records(&g_ctx, recs, count);
+}
+
+const char* plugin_place_work_records_owned(const struct record* recs, int count) {
+    return common_plugin_place_work_records_owned(&g_ctx, recs, count);
+}
+
+void plugin_set_memory_budget(struct byte_budget* budget) {
+    common_plugin_set_memory_budget(&g_ctx, budget);
+}
+
+void plugin_set_allocator(struct slab* slab) {
+    common_plugin_set_allocator(&g_ctx, slab);
+}
+
+void plugin_set_executor(struct executor* ex) {
+    common_plugin_set_executor(&g_ctx, ex, 1);
+}
+
+int plugin_process_record(struct record* rec) {
+    return flip_in_place(rec);
+}
+
+const char* plugin_fuse(int (*process_record)(struct record* rec)) {
+    return common_plugin_fuse(&g_ctx, process_record);
+}
+
+const char* plugin_set_replicas(int replicas) {
+    return common_plugin_set_replicas(&g_ctx, replicas);
+}
+
 const char* plugin_wait_finished(void) {
     return common_plugin_wait_finished(&g_ctx);
 }
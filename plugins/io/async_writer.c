@@ -0,0 +1,277 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, fdatasync */
+#endif
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "async_writer.h"
+
+static long long mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Condition variables wait on CLOCK_REALTIME (macOS cannot change that):
+ * turn a monotonic deadline into a realtime one. */
+static struct timespec realtime_deadline(long long mono_deadline) {
+    long long left = mono_deadline - mono_ns();
+    if (left < 0) {
+        left = 0;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long long ns = ts.tv_nsec + left;
+    ts.tv_sec += (time_t)(ns / 1000000000LL);
+    ts.tv_nsec = (long)(ns % 1000000000LL);
+    return ts;
+}
+
+static int write_all(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void sync_fd(int fd) {
+#ifdef __APPLE__
+    (void)fsync(fd);
+#else
+    (void)fdatasync(fd);
+#endif
+}
+
+static void sync_targets(const async_writer_t* w, const int* failed) {
+    for (int t = 0; t < w->ntargets; ++t) {
+        if (w->targets[t].sync && !failed[t]) {
+            sync_fd(w->targets[t].fd);
+        }
+    }
+}
+
+static int front_empty(const async_writer_t* w) {
+    for (int t = 0; t < w->ntargets; ++t) {
+        if (w->front_len[t] > 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static long long flush_deadline(const async_writer_t* w) {
+    return w->first_ns + (long long)w->config.flush_ms * 1000000LL;
+}
+
+static int should_swap(const async_writer_t* w) {
+    if (front_empty(w)) {
+        return 0;
+    }
+    return w->flush_now || w->stop || mono_ns() >= flush_deadline(w);
+}
+
+static void* writer_thread(void* arg) {
+    async_writer_t* w = (async_writer_t*)arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!should_swap(w)) {
+            if (w->stop && front_empty(w)) {
+                pthread_mutex_unlock(&w->lock);
+                return NULL;
+            }
+            if (w->first_ns >= 0) {
+                struct timespec deadline = realtime_deadline(flush_deadline(w));
+                pthread_cond_timedwait(&w->wake, &w->lock, &deadline);
+            } else {
+                pthread_cond_wait(&w->wake, &w->lock);
+            }
+        }
+
+        for (int t = 0; t < w->ntargets; ++t) {
+            char* tmp = w->back[t];
+            w->back[t] = w->front[t];
+            w->back_len[t] = w->front_len[t];
+            w->front[t] = tmp;
+            w->front_len[t] = 0;
+        }
+        w->swaps++;
+        w->flush_now = 0;
+        w->first_ns = -1;
+        pthread_cond_broadcast(&w->written);
+        pthread_mutex_unlock(&w->lock);
+
+        /* failed is only ever set by this thread, under the lock */
+        int failed[ASYNC_WRITER_MAX_TARGETS];
+        for (int t = 0; t < w->ntargets; ++t) {
+            failed[t] = w->failed[t];
+            if (w->back_len[t] > 0 && !failed[t] &&
+                write_all(w->targets[t].fd, w->back[t], w->back_len[t]) != 0) {
+                failed[t] = 1;
+            }
+        }
+        if (w->config.sync_ms > 0 &&
+            mono_ns() - w->synced_ns >= (long long)w->config.sync_ms * 1000000LL) {
+            sync_targets(w, failed);
+            w->synced_ns = mono_ns();
+        }
+
+        pthread_mutex_lock(&w->lock);
+        for (int t = 0; t < w->ntargets; ++t) {
+            if (failed[t] && !w->failed[t]) {
+                w->failed[t] = 1;
+                w->error = w->error ? w->error : "async_writer: write failed";
+            }
+            w->back_len[t] = 0;
+        }
+        w->done++;
+        pthread_cond_broadcast(&w->written);
+    }
+}
+
+static void free_blocks(async_writer_t* w) {
+    for (int t = 0; t < ASYNC_WRITER_MAX_TARGETS; ++t) {
+        free(w->front[t]);
+        free(w->back[t]);
+        w->front[t] = NULL;
+        w->back[t] = NULL;
+    }
+}
+
+const char* async_writer_open(async_writer_t* w, const async_target_t* targets, int ntargets,
+                              const async_writer_config_t* config) {
+    if (!w || !targets || ntargets <= 0 || ntargets > ASYNC_WRITER_MAX_TARGETS || !config ||
+        config->block_bytes == 0 || config->flush_ms < 0 || config->sync_ms < 0) {
+        return "async_writer_open: invalid arguments";
+    }
+    memset(w, 0, sizeof(*w));
+    w->config = *config;
+    w->ntargets = ntargets;
+    for (int t = 0; t < ntargets; ++t) {
+        w->targets[t] = targets[t];
+        w->front[t] = (char*)malloc(config->block_bytes);
+        w->back[t] = (char*)malloc(config->block_bytes);
+        if (!w->front[t] || !w->back[t]) {
+            free_blocks(w);
+            return "async_writer_open: out of memory";
+        }
+    }
+    w->first_ns = -1;
+    w->synced_ns = mono_ns();
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->wake, NULL);
+    pthread_cond_init(&w->written, NULL);
+    if (pthread_create(&w->thread, NULL, writer_thread, w) != 0) {
+        pthread_cond_destroy(&w->written);
+        pthread_cond_destroy(&w->wake);
+        pthread_mutex_destroy(&w->lock);
+        free_blocks(w);
+        return "async_writer_open: pthread_create failed";
+    }
+    return NULL;
+}
+
+/* Copy one piece into the front block of target, handing over full blocks. */
+static void append_locked(async_writer_t* w, int target, const char* data, size_t len) {
+    while (len > 0 && !w->failed[target]) {
+        size_t room = w->config.block_bytes - w->front_len[target];
+        if (room == 0) {
+            /* full: wait for the thread to take this block */
+            w->flush_now = 1;
+            pthread_cond_signal(&w->wake);
+            pthread_cond_wait(&w->written, &w->lock);
+            continue;
+        }
+        size_t n = len < room ? len : room;
+        memcpy(w->front[target] + w->front_len[target], data, n);
+        w->front_len[target] += n;
+        data += n;
+        len -= n;
+        if (w->first_ns < 0) {
+            w->first_ns = mono_ns();
+            pthread_cond_signal(&w->wake);
+        }
+        if (w->front_len[target] == w->config.block_bytes) {
+            w->flush_now = 1;
+            pthread_cond_signal(&w->wake);
+        }
+    }
+}
+
+const char* async_writer_appendv(async_writer_t* w, int target, const struct iovec* iov, int iovcnt) {
+    if (!w || target < 0 || target >= w->ntargets || iovcnt < 0 || (iovcnt > 0 && !iov)) {
+        return "async_writer_append: invalid arguments";
+    }
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        total += iov[i].iov_len;
+    }
+    pthread_mutex_lock(&w->lock);
+    /* keep the pieces in one write unless they cannot fit in any block */
+    while (!w->failed[target] && total <= w->config.block_bytes &&
+           total > w->config.block_bytes - w->front_len[target]) {
+        w->flush_now = 1;
+        pthread_cond_signal(&w->wake);
+        pthread_cond_wait(&w->written, &w->lock);
+    }
+    for (int i = 0; i < iovcnt; ++i) {
+        append_locked(w, target, (const char*)iov[i].iov_base, iov[i].iov_len);
+    }
+    const char* err = w->error;
+    pthread_mutex_unlock(&w->lock);
+    return err;
+}
+
+const char* async_writer_append(async_writer_t* w, int target, const char* data, size_t len) {
+    struct iovec iov = { (void*)data, len };
+    return async_writer_appendv(w, target, &iov, 1);
+}
+
+const char* async_writer_drain(async_writer_t* w) {
+    if (!w) {
+        return "async_writer_drain: invalid arguments";
+    }
+    pthread_mutex_lock(&w->lock);
+    unsigned long target = w->swaps;
+    if (!front_empty(w)) {
+        target++;
+        w->flush_now = 1;
+        pthread_cond_signal(&w->wake);
+    }
+    while (w->done < target) {
+        pthread_cond_wait(&w->written, &w->lock);
+    }
+    int failed[ASYNC_WRITER_MAX_TARGETS];
+    memcpy(failed, w->failed, sizeof(failed));
+    const char* err = w->error;
+    pthread_mutex_unlock(&w->lock);
+    if (w->config.sync_ms > 0) {
+        sync_targets(w, failed);
+    }
+    return err;
+}
+
+const char* async_writer_close(async_writer_t* w) {
+    if (!w) {
+        return "async_writer_close: invalid arguments";
+    }
+    const char* err = async_writer_drain(w);
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    pthread_cond_destroy(&w->written);
+    pthread_cond_destroy(&w->wake);
+    pthread_mutex_destroy(&w->lock);
+    free_blocks(w);
+    return err;
+}
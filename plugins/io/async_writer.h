@@ -0,0 +1,77 @@
+#ifndef IO_ASYNC_WRITER_H
+#define IO_ASYNC_WRITER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#define ASYNC_WRITER_MAX_TARGETS 2
+
+typedef struct {
+    int fd;
+    int sync;                 /* fdatasync this fd on the sync cadence */
+} async_target_t;
+
+typedef struct {
+    size_t block_bytes;       /* per-target block; a full block is handed over */
+    long flush_ms;            /* hand over a partial block this long after its first byte */
+    long sync_ms;             /* fdatasync at most this often, 0 for never */
+} async_writer_config_t;
+
+/*
+ * Group commit for line-oriented output.
+ *
+ * Producers append into the front block of each target; a dedicated thread
+ * writes the back blocks. When a front block fills up, or flush_ms after
+ * the oldest byte in them was appended, the two sets are swapped under the
+ * lock and the thread writes the old front with one write() per target
+ * while producers fill the other. A producer only waits when its pieces do not fit in the
+ * front block and the thread has not finished the previous one yet.
+ *
+ * Bytes reach each fd in the order they were appended, and the pieces of
+ * one appendv call go out in a single write() unless they are larger than
+ * a block, so lines do not tear against other writers of the fd. After a
+ * write error further output to that fd is dropped and the error is
+ * reported by async_writer_drain and async_writer_close.
+ */
+typedef struct {
+    async_writer_config_t config;
+    int ntargets;
+    async_target_t targets[ASYNC_WRITER_MAX_TARGETS];
+    char* front[ASYNC_WRITER_MAX_TARGETS];
+    size_t front_len[ASYNC_WRITER_MAX_TARGETS];
+    char* back[ASYNC_WRITER_MAX_TARGETS];
+    size_t back_len[ASYNC_WRITER_MAX_TARGETS];
+    int failed[ASYNC_WRITER_MAX_TARGETS];
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;      /* to the writer thread */
+    pthread_cond_t written;   /* to producers waiting for a block or a drain */
+    pthread_t thread;
+    unsigned long swaps;      /* front/back swaps so far */
+    unsigned long done;       /* swaps written out */
+    int flush_now;            /* hand over the front set regardless of size and age */
+    int stop;
+    long long first_ns;       /* monotonic time of the oldest unflushed byte, -1 if none */
+    long long synced_ns;      /* monotonic time of the last fdatasync */
+    const char* error;
+} async_writer_t;
+
+/* Returns NULL on success or an error message. */
+const char* async_writer_open(async_writer_t* w, const async_target_t* targets, int ntargets,
+                              const async_writer_config_t* config);
+
+/* Append len bytes for targets[target]. Returns NULL or the first error. */
+const char* async_writer_append(async_writer_t* w, int target, const char* data, size_t len);
+
+/* Same for several pieces, appended together under one lock. */
+const char* async_writer_appendv(async_writer_t* w, int target, const struct iovec* iov, int iovcnt);
+
+/* Write out everything appended so far, fdatasync the sync targets if
+ * sync_ms is set, and return NULL or the first error. */
+const char* async_writer_drain(async_writer_t* w);
+
+/* Drain, stop the thread and free the blocks. The fds stay open. */
+const char* async_writer_close(async_writer_t* w);
+
+#endif // IO_ASYNC_WRITER_H
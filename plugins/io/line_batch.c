@@ -0,0 +1,301 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* vmsplice, F_GETPIPE_SZ */
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "line_batch.h"
+
+#if defined(__linux__) && defined(F_GETPIPE_SZ)
+#define HAVE_VMSPLICE 1
+#else
+#define HAVE_VMSPLICE 0
+#endif
+
+/* iovecs per writev; well under IOV_MAX everywhere */
+#define IOV_BATCH 256
+
+static long long mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Condition variables wait on CLOCK_REALTIME (see async_writer.c). */
+static struct timespec realtime_deadline(long long mono_deadline) {
+    long long left = mono_deadline - mono_ns();
+    if (left < 0) {
+        left = 0;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long long ns = ts.tv_nsec + left;
+    ts.tv_sec += (time_t)(ns / 1000000000LL);
+    ts.tv_nsec = (long)(ns % 1000000000LL);
+    return ts;
+}
+
+static int writev_all(int fd, struct iovec* iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = writev(fd, iov, cnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+#if HAVE_VMSPLICE
+static int vmsplice_all(int fd, char* buf, size_t len) {
+    struct iovec iov = { buf, len };
+    while (iov.iov_len > 0) {
+        ssize_t n = vmsplice(fd, &iov, 1, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        iov.iov_base = (char*)iov.iov_base + n;
+        iov.iov_len -= (size_t)n;
+    }
+    return 0;
+}
+#endif
+
+/* ---- everything below runs under b->lock ---- */
+
+static void fail(line_batch_t* b) {
+    if (!b->error) {
+        b->error = "line_batch: write failed";
+    }
+}
+
+static void reset_stage(line_batch_t* b) {
+    b->stage_len = 0;
+    b->stage_lines = 0;
+    b->first_ns = -1;
+}
+
+/* Write the waiting bytes by themselves. */
+static void emit_stage(line_batch_t* b) {
+    if (b->stage_len == 0) {
+        return;
+    }
+    int rc = 0;
+#if HAVE_VMSPLICE
+    if (b->splice) {
+        int size = fcntl(b->fd, F_GETPIPE_SZ);
+        if (size < 0 || (size_t)size > b->pipe_bytes) {
+            b->splice = 0; /* the pipe may now hold pages of a buffer we reuse */
+        }
+    }
+    if (b->splice) {
+        rc = vmsplice_all(b->fd, b->stage, b->stage_len);
+        b->bufi = (b->bufi + 1) % b->nbufs;
+        b->stage = b->mem + (size_t)b->bufi * b->buf_bytes;
+    } else
+#endif
+    {
+        struct iovec iov = { b->stage, b->stage_len };
+        rc = writev_all(b->fd, &iov, 1);
+    }
+    b->stats.writes++;
+    if (rc != 0) {
+        fail(b);
+    }
+    reset_stage(b);
+}
+
+/* Copy into the waiting bytes, writing them out whenever the buffer fills. */
+static void stage_put(line_batch_t* b, const char* src, size_t len) {
+    while (len > 0 && !b->error) {
+        if (b->stage_len == b->buf_bytes) {
+            emit_stage(b);
+            continue;
+        }
+        size_t room = b->buf_bytes - b->stage_len;
+        size_t n = len < room ? len : room;
+        memcpy(b->stage + b->stage_len, src, n);
+        b->stage_len += n;
+        src += n;
+        len -= n;
+    }
+}
+
+/* The waiting bytes and then lines, in as few writev calls as fit. */
+static void emit_with(line_batch_t* b, const struct iovec* lines, int n) {
+    struct iovec iov[IOV_BATCH];
+    int cnt = 0;
+    if (b->stage_len > 0) {
+        iov[cnt].iov_base = b->stage;
+        iov[cnt++].iov_len = b->stage_len;
+    }
+    for (int i = 0; i < n && !b->error; ++i) {
+        if (cnt + 2 > IOV_BATCH) {
+            b->stats.writes++;
+            if (writev_all(b->fd, iov, cnt) != 0) {
+                fail(b);
+            }
+            cnt = 0;
+        }
+        iov[cnt++] = lines[i];
+        iov[cnt].iov_base = (void*)"\n";
+        iov[cnt++].iov_len = 1;
+    }
+    if (cnt > 0 && !b->error) {
+        b->stats.writes++;
+        if (writev_all(b->fd, iov, cnt) != 0) {
+            fail(b);
+        }
+    }
+    reset_stage(b);
+}
+
+static void* timer_thread(void* arg) {
+    line_batch_t* b = (line_batch_t*)arg;
+    pthread_mutex_lock(&b->lock);
+    while (!b->stop) {
+        if (b->stage_len == 0) {
+            pthread_cond_wait(&b->wake, &b->lock);
+            continue;
+        }
+        long long deadline = b->first_ns + b->config.max_delay_us * 1000LL;
+        long long idle = b->last_ns + b->config.idle_us * 1000LL;
+        if (idle < deadline) {
+            deadline = idle;
+        }
+        if (mono_ns() >= deadline) {
+            emit_stage(b);
+            continue;
+        }
+        struct timespec ts = realtime_deadline(deadline);
+        pthread_cond_timedwait(&b->wake, &b->lock, &ts);
+    }
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+const char* line_batch_open(line_batch_t* b, int fd, const line_batch_config_t* config) {
+    if (!b || fd < 0 || !config || config->max_lines < 1 || config->max_bytes == 0 ||
+        config->idle_us < 0 || config->max_delay_us < 0) {
+        return "line_batch_open: invalid arguments";
+    }
+    memset(b, 0, sizeof(*b));
+    b->config = *config;
+    b->fd = fd;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    b->buf_bytes = (config->max_bytes + page - 1) / page * page;
+    b->nbufs = 1;
+#if HAVE_VMSPLICE
+    struct stat st;
+    int size = config->vmsplice && fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode)
+                   ? fcntl(fd, F_GETPIPE_SZ) : -1;
+    if (size > 0) {
+        /* every splice takes at least one of the pipe's page slots */
+        b->splice = 1;
+        b->pipe_bytes = (size_t)size;
+        b->nbufs = (int)((size_t)size / page) + 1;
+    }
+#endif
+    void* mem = NULL;
+    if (posix_memalign(&mem, page, (size_t)b->nbufs * b->buf_bytes) != 0) {
+        return "line_batch_open: out of memory";
+    }
+    b->mem = (char*)mem;
+    b->stage = b->mem;
+    reset_stage(b);
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->wake, NULL);
+    if (pthread_create(&b->thread, NULL, timer_thread, b) != 0) {
+        pthread_cond_destroy(&b->wake);
+        pthread_mutex_destroy(&b->lock);
+        free(b->mem);
+        return "line_batch_open: pthread_create failed";
+    }
+    return NULL;
+}
+
+const char* line_batch_add(line_batch_t* b, const struct iovec* lines, int n, int end) {
+    if (!b || n < 0 || (n > 0 && !lines)) {
+        return "line_batch_add: invalid arguments";
+    }
+    size_t bytes = 0;
+    for (int i = 0; i < n; ++i) {
+        bytes += lines[i].iov_len + 1;
+    }
+    pthread_mutex_lock(&b->lock);
+    b->stats.lines += (unsigned long)n;
+    int flush = end || b->config.max_delay_us == 0 ||
+                b->stage_lines + n >= b->config.max_lines ||
+                b->stage_len + bytes >= b->config.max_bytes;
+    if (b->error) {
+        /* dropped */
+    } else if (!flush) {
+        /* fits: stage_len + bytes < max_bytes <= buf_bytes */
+        for (int i = 0; i < n; ++i) {
+            memcpy(b->stage + b->stage_len, lines[i].iov_base, lines[i].iov_len);
+            b->stage_len += lines[i].iov_len;
+            b->stage[b->stage_len++] = '\n';
+        }
+        b->stage_lines += n;
+        b->stats.held += (unsigned long)n;
+        long long now = mono_ns();
+        if (b->first_ns < 0) {
+            b->first_ns = now;
+        }
+        b->last_ns = now;
+        pthread_cond_signal(&b->wake);
+    } else if (b->splice) {
+        for (int i = 0; i < n; ++i) {
+            stage_put(b, (const char*)lines[i].iov_base, lines[i].iov_len);
+            stage_put(b, "\n", 1);
+        }
+        emit_stage(b);
+    } else {
+        emit_with(b, lines, n);
+    }
+    const char* err = b->error;
+    pthread_mutex_unlock(&b->lock);
+    return err;
+}
+
+const char* line_batch_close(line_batch_t* b) {
+    if (!b) {
+        return "line_batch_close: invalid arguments";
+    }
+    pthread_mutex_lock(&b->lock);
+    if (!b->error) {
+        emit_stage(b);
+    }
+    b->stop = 1;
+    pthread_cond_signal(&b->wake);
+    pthread_mutex_unlock(&b->lock);
+    pthread_join(b->thread, NULL);
+    pthread_cond_destroy(&b->wake);
+    pthread_mutex_destroy(&b->lock);
+    free(b->mem);
+    b->mem = NULL;
+    return b->error;
+}
+
+void line_batch_format_stats(const line_batch_t* b, char* buf, size_t size) {
+    const line_batch_stats_t* s = &b->stats;
+    double per = s->writes ? (double)s->lines / (double)s->writes : 0.0;
+    snprintf(buf, size, "%s: %lu lines in %lu writes (%.1f per write), %lu held for more input",
+             b->splice ? "vmsplice" : "writev", s->lines, s->writes, per, s->held);
+}
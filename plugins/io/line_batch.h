@@ -0,0 +1,74 @@
+#ifndef IO_LINE_BATCH_H
+#define IO_LINE_BATCH_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+typedef struct {
+    int max_lines;            /* write once this many lines are waiting */
+    size_t max_bytes;         /* or this many bytes */
+    long idle_us;             /* or no line came for this long */
+    long max_delay_us;        /* or the oldest waiting line is this old; 0 holds nothing */
+    int vmsplice;             /* into a pipe, hand the pages over instead of copying */
+} line_batch_config_t;
+
+typedef struct {
+    unsigned long writes;     /* writev or vmsplice calls */
+    unsigned long lines;
+    unsigned long held;       /* lines copied aside to wait for more */
+} line_batch_stats_t;
+
+/*
+ * Newline-terminated output in as few system calls as the flush rules
+ * allow.
+ *
+ * line_batch_add gets the lines of one input batch. When a rule says
+ * write, everything waiting and the new lines go out in one writev, the
+ * new lines straight from the caller's memory. Otherwise the lines are
+ * copied aside and a timer thread writes them when idle_us or
+ * max_delay_us runs out, whichever comes first.
+ *
+ * With vmsplice into a pipe every line is copied into page-aligned
+ * buffers whose pages are then lent to the pipe. A buffer is only filled
+ * again once enough pages have been spliced after it that the pipe cannot
+ * still hold any of its own; should the pipe grow beyond that, the
+ * writer goes back to writev.
+ */
+typedef struct {
+    line_batch_config_t config;
+    int fd;
+    int splice;               /* vmsplice in use */
+    size_t pipe_bytes;        /* pipe size the buffer count was planned for */
+    char* mem;                /* nbufs buffers of buf_bytes */
+    int nbufs;
+    int bufi;
+    size_t buf_bytes;
+    char* stage;              /* mem + bufi * buf_bytes */
+    size_t stage_len;
+    int stage_lines;
+    long long first_ns;       /* when the oldest waiting line came */
+    long long last_ns;        /* when the newest one came */
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    int stop;
+    const char* error;
+    line_batch_stats_t stats;
+} line_batch_t;
+
+/* Returns NULL on success or an error message. The fd stays the caller's. */
+const char* line_batch_open(line_batch_t* b, int fd, const line_batch_config_t* config);
+
+/* Lines without their newlines, only read during the call. end writes
+ * everything out before returning. Returns NULL or the first error. */
+const char* line_batch_add(line_batch_t* b, const struct iovec* lines, int n, int end);
+
+/* Write what is waiting, stop the timer thread and free the buffers. */
+const char* line_batch_close(line_batch_t* b);
+
+/* One line for a shutdown report. */
+void line_batch_format_stats(const line_batch_t* b, char* buf, size_t size);
+
+#endif // IO_LINE_BATCH_H
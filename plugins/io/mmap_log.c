@@ -0,0 +1,147 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L /* posix_fallocate, pread */
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mmap_log.h"
+
+/* Length of the file without the zeros a run that never trimmed left at
+ * its end. Records always end in a newline, so no real line ends in a
+ * zero byte. */
+static off_t data_length(int fd, off_t size) {
+    char buf[4096];
+    while (size > 0) {
+        size_t n = size < (off_t)sizeof(buf) ? (size_t)size : sizeof(buf);
+        if (pread(fd, buf, n, size - (off_t)n) != (ssize_t)n) {
+            return size;
+        }
+        size_t i = n;
+        while (i > 0 && buf[i - 1] == '\0') {
+            i--;
+        }
+        size -= (off_t)(n - i);
+        if (i > 0) {
+            break;
+        }
+    }
+    return size;
+}
+
+/* Grow the file to at least end bytes. */
+static int reserve(mmap_log_t* log, off_t end) {
+    if (end <= log->reserved) {
+        return 0;
+    }
+#ifdef __APPLE__
+    int rc = ftruncate(log->fd, end) == 0 ? 0 : errno;
+#else
+    int rc = posix_fallocate(log->fd, log->reserved, end - log->reserved);
+    if (rc == EINVAL || rc == EOPNOTSUPP) {
+        rc = ftruncate(log->fd, end) == 0 ? 0 : errno;
+    }
+#endif
+    if (rc != 0) {
+        return -1;
+    }
+    log->reserved = end;
+    return 0;
+}
+
+static void unmap(mmap_log_t* log) {
+    if (log->window) {
+        munmap(log->window, log->extent);
+        log->window = NULL;
+    }
+}
+
+/* Map the extent starting at the page that holds the end of the data. */
+static const char* map_tail(mmap_log_t* log) {
+    unmap(log);
+    off_t page = (off_t)sysconf(_SC_PAGESIZE);
+    off_t off = log->length - log->length % page;
+    if (reserve(log, off + (off_t)log->extent) != 0) {
+        return "mmap_log: cannot reserve space for the log";
+    }
+    void* p = mmap(NULL, log->extent, PROT_READ | PROT_WRITE, MAP_SHARED, log->fd, off);
+    if (p == MAP_FAILED) {
+        return "mmap_log: mmap failed";
+    }
+    log->window = (char*)p;
+    log->window_off = off;
+    return NULL;
+}
+
+const char* mmap_log_open(mmap_log_t* log, const char* path, size_t extent_bytes) {
+    if (!log || !path || extent_bytes == 0) {
+        return "mmap_log_open: invalid arguments";
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    memset(log, 0, sizeof(*log));
+    log->extent = (extent_bytes + page - 1) / page * page;
+    log->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (log->fd < 0) {
+        return "mmap_log_open: cannot open the log";
+    }
+    struct stat st;
+    if (fstat(log->fd, &st) != 0) {
+        close(log->fd);
+        return "mmap_log_open: cannot stat the log";
+    }
+    log->length = data_length(log->fd, st.st_size);
+    log->reserved = st.st_size;
+    return NULL;
+}
+
+const char* mmap_log_appendv(mmap_log_t* log, const struct iovec* iov, int iovcnt) {
+    if (!log || iovcnt < 0 || (iovcnt > 0 && !iov)) {
+        return "mmap_log_appendv: invalid arguments";
+    }
+    for (int i = 0; i < iovcnt; ++i) {
+        const char* src = (const char*)iov[i].iov_base;
+        size_t len = iov[i].iov_len;
+        while (len > 0) {
+            off_t end = log->window_off + (off_t)log->extent;
+            if (!log->window || log->length == end) {
+                const char* err = map_tail(log);
+                if (err) {
+                    return err;
+                }
+                end = log->window_off + (off_t)log->extent;
+            }
+            size_t room = (size_t)(end - log->length);
+            size_t n = len < room ? len : room;
+            memcpy(log->window + (log->length - log->window_off), src, n);
+            log->length += (off_t)n;
+            src += n;
+            len -= n;
+        }
+    }
+    return NULL;
+}
+
+const char* mmap_log_trim(mmap_log_t* log) {
+    if (!log) {
+        return "mmap_log_trim: invalid arguments";
+    }
+    unmap(log);
+    if (log->reserved != log->length) {
+        if (ftruncate(log->fd, log->length) != 0) {
+            return "mmap_log_trim: ftruncate failed";
+        }
+        log->reserved = log->length;
+    }
+    return NULL;
+}
+
+const char* mmap_log_close(mmap_log_t* log) {
+    const char* err = mmap_log_trim(log);
+    if (log && close(log->fd) != 0 && !err) {
+        err = "mmap_log_close: close failed";
+    }
+    return err;
+}
@@ -0,0 +1,45 @@
+#ifndef IO_MMAP_LOG_H
+#define IO_MMAP_LOG_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * Append-only file written through a shared mapping.
+ *
+ * The file is reserved ahead of the data in extents of extent_bytes
+ * (posix_fallocate, or ftruncate where that is missing) and one
+ * extent-sized window at the tail is mapped; appends are a memcpy into
+ * it. When the window is full it is unmapped and the next one mapped from
+ * the page holding the end of the data. mmap_log_trim cuts the file back
+ * to the bytes actually appended.
+ *
+ * Until then the file is longer than its data and ends in zeros. A run
+ * that dies before trimming leaves them behind; mmap_log_open drops
+ * trailing zero bytes from an existing file, so the next run appends
+ * right after the last real byte.
+ */
+typedef struct {
+    int fd;
+    size_t extent;            /* window and reservation size, whole pages */
+    off_t length;             /* bytes appended, including what was already there */
+    off_t reserved;           /* current file size */
+    char* window;             /* NULL when nothing is mapped */
+    off_t window_off;
+} mmap_log_t;
+
+/* Open or create path for appending. Returns NULL or an error message. */
+const char* mmap_log_open(mmap_log_t* log, const char* path, size_t extent_bytes);
+
+/* Append the pieces in order. Returns NULL or an error message. */
+const char* mmap_log_appendv(mmap_log_t* log, const struct iovec* iov, int iovcnt);
+
+/* Unmap the window and truncate the file to its data; appending again
+ * reserves and maps a new window. */
+const char* mmap_log_trim(mmap_log_t* log);
+
+/* Trim and close the file. */
+const char* mmap_log_close(mmap_log_t* log);
+
+#endif // IO_MMAP_LOG_H
@@ -0,0 +1,684 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* syscall */
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "uring_writer.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define HAVE_IO_URING 1
+#else
+#define HAVE_IO_URING 0
+#endif
+
+#define DEPTH_ENV "PIPELINE_IO_DEPTH"
+#define BLOCK_ENV "PIPELINE_IO_BLOCK"
+#define THREADS_ENV "PIPELINE_IO_THREADS"
+#define STATS_ENV "PIPELINE_IO_STATS"
+
+/* user_data of the NOP that stops the reaper */
+#define STOP_TAG UINT64_MAX
+
+static void finish(uring_writer_t* w, int slot, long res);
+
+/* ---- environment ---- */
+
+/* Non-negative number with an optional k/m/g suffix; def if unset, -1 if
+ * malformed. */
+static long env_size(const char* name, long def) {
+    const char* env = getenv(name);
+    if (!env || !*env) {
+        return def;
+    }
+    char* end = NULL;
+    errno = 0;
+    long val = strtol(env, &end, 10);
+    if (errno != 0 || end == env || val < 0) {
+        return -1;
+    }
+    int shift = 0;
+    switch (*end) {
+    case 'k': case 'K': shift = 10; end++; break;
+    case 'm': case 'M': shift = 20; end++; break;
+    case 'g': case 'G': shift = 30; end++; break;
+    default: break;
+    }
+    if (*end != '\0' || val > (LONG_MAX >> shift)) {
+        return -1;
+    }
+    return val << shift;
+}
+
+const char* uring_writer_config_from_env(uring_writer_config_t* config) {
+    long depth = env_size(DEPTH_ENV, 8);
+    long block = env_size(BLOCK_ENV, 64L << 10);
+    long threads = env_size(THREADS_ENV, 0);
+    long report = env_size(STATS_ENV, 0);
+    if (depth < 1 || depth > URING_WRITER_MAX_DEPTH) {
+        return "invalid " DEPTH_ENV " value (1..64)";
+    }
+    if (block < 1 || block > (1L << 30)) {
+        return "invalid " BLOCK_ENV " value";
+    }
+    if (threads != 0 && threads != 1) {
+        return "invalid " THREADS_ENV " value (0|1)";
+    }
+    if (report != 0 && report != 1) {
+        return "invalid " STATS_ENV " value (0|1)";
+    }
+    config->depth = (int)depth;
+    config->block_bytes = (size_t)block;
+    config->threads_only = (int)threads;
+    config->report = (int)report;
+    return NULL;
+}
+
+static char* buffer_of(const uring_writer_t* w, int slot) {
+    return w->mem + (size_t)slot * w->config.block_bytes;
+}
+
+/* ---- io_uring backend ---- */
+
+#if HAVE_IO_URING
+
+struct uring_ring {
+    int fd;
+    int fixed;                /* buffers registered */
+    unsigned sq_next;         /* tail including SQEs not yet published */
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    void* sq_map;
+    size_t sq_map_size;
+    void* cq_map;
+    size_t cq_map_size;
+    size_t sqes_size;
+    pthread_t reaper;
+};
+
+static int ring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void ring_unmap(struct uring_ring* r) {
+    if (r->sqes) {
+        munmap(r->sqes, r->sqes_size);
+    }
+    if (r->cq_map && r->cq_map != r->sq_map) {
+        munmap(r->cq_map, r->cq_map_size);
+    }
+    if (r->sq_map) {
+        munmap(r->sq_map, r->sq_map_size);
+    }
+    close(r->fd);
+}
+
+/* Set up a ring with room for every buffer plus the stop NOP and register
+ * the buffers. NULL if the kernel cannot do what the writer needs. */
+static struct uring_ring* ring_create(uring_writer_t* w) {
+    struct uring_ring* r = (struct uring_ring*)calloc(1, sizeof(*r));
+    if (!r) {
+        return NULL;
+    }
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    r->fd = (int)syscall(__NR_io_uring_setup, (unsigned)w->config.depth + 1, &p);
+    /* RW_CUR_POS (5.6) also brings IORING_OP_WRITE */
+    if (r->fd < 0 || !(p.features & IORING_FEAT_RW_CUR_POS)) {
+        if (r->fd >= 0) {
+            close(r->fd);
+        }
+        free(r);
+        return NULL;
+    }
+    r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_map_size > r->sq_map_size) {
+            r->sq_map_size = r->cq_map_size;
+        }
+        r->cq_map_size = r->sq_map_size;
+    }
+    r->sq_map = mmap(NULL, r->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_map == MAP_FAILED) {
+        r->sq_map = NULL;
+        goto fail;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_map = r->sq_map;
+    } else {
+        r->cq_map = mmap(NULL, r->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_map == MAP_FAILED) {
+            r->cq_map = NULL;
+            goto fail;
+        }
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe*)mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        goto fail;
+    }
+    char* sq = (char*)r->sq_map;
+    char* cq = (char*)r->cq_map;
+    r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    r->sq_next = *r->sq_tail;
+    r->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)(sq + p.sq_off.array);
+    r->cq_head = (unsigned*)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    /* registration fails under a small RLIMIT_MEMLOCK; plain writes still work */
+    struct iovec iov[URING_WRITER_MAX_DEPTH];
+    for (int i = 0; i < w->config.depth; ++i) {
+        iov[i].iov_base = buffer_of(w, i);
+        iov[i].iov_len = w->config.block_bytes;
+    }
+    r->fixed = syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_BUFFERS, iov,
+                       (unsigned)w->config.depth) == 0;
+    return r;
+
+fail:
+    ring_unmap(r);
+    free(r);
+    return NULL;
+}
+
+/* Next free SQE; the caller holds the lock, so there is one submitter. */
+static struct io_uring_sqe* ring_sqe(struct uring_ring* r) {
+    unsigned idx = r->sq_next++ & *r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    return sqe;
+}
+
+static void prep_write(uring_writer_t* w, int slot, int link) {
+    struct uring_ring* r = w->ring;
+    struct io_uring_sqe* sqe = ring_sqe(r);
+    sqe->opcode = r->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = w->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(buffer_of(w, slot) + w->done[slot]);
+    sqe->len = (unsigned)(w->len[slot] - w->done[slot]);
+    sqe->off = w->offsets ? (uint64_t)(w->off[slot] + (off_t)w->done[slot]) : (uint64_t)-1;
+    sqe->buf_index = r->fixed ? (uint16_t)slot : 0;
+    sqe->flags = link ? IOSQE_IO_LINK : 0;
+    sqe->user_data = (uint64_t)slot;
+}
+
+/* Hand n queued SQEs to the kernel. Returns how many it took. The CQ has
+ * room for twice the SQ, so EBUSY only means try again. */
+static int ring_submit_all(struct uring_ring* r, int n) {
+    __atomic_store_n(r->sq_tail, r->sq_next, __ATOMIC_RELEASE);
+    int submitted = 0;
+    while (submitted < n) {
+        int rc = ring_enter(r->fd, (unsigned)(n - submitted), 0, 0);
+        if (rc < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                sched_yield();
+                continue;
+            }
+            break;
+        }
+        submitted += rc;
+    }
+    return submitted;
+}
+
+/* Submit the writes just prepared; any the kernel refused fail here. */
+static void ring_submit(uring_writer_t* w, const int* slots, int n) {
+    for (int i = ring_submit_all(w->ring, n); i < n; ++i) {
+        finish(w, slots[i], -EIO);
+    }
+}
+
+static void* reaper_thread(void* arg) {
+    uring_writer_t* w = (uring_writer_t*)arg;
+    struct uring_ring* r = w->ring;
+    int stop = 0;
+    while (!stop) {
+        if (ring_enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            break;
+        }
+        unsigned head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        pthread_mutex_lock(&w->lock);
+        for (; head != tail; ++head) {
+            const struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+            if (cqe->user_data == STOP_TAG) {
+                stop = 1;
+            } else {
+                finish(w, (int)cqe->user_data, cqe->res);
+            }
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&w->lock);
+    }
+    return NULL;
+}
+
+static void ring_stop(uring_writer_t* w) {
+    struct uring_ring* r = w->ring;
+    pthread_mutex_lock(&w->lock);
+    struct io_uring_sqe* sqe = ring_sqe(r);
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = STOP_TAG;
+    int stopped = ring_submit_all(r, 1) == 1;
+    pthread_mutex_unlock(&w->lock);
+    w->ring = NULL;
+    if (!stopped) {
+        /* the reaper cannot be woken: leave it and the ring to the process */
+        pthread_detach(r->reaper);
+        return;
+    }
+    pthread_join(r->reaper, NULL);
+    ring_unmap(r);
+    free(r);
+}
+
+#else
+
+struct uring_ring {
+    int unused;
+};
+
+#endif
+
+/* ---- thread-pool backend ---- */
+
+static int write_all(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int pwrite_all(int fd, const char* buf, size_t len, off_t off) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        buf += n;
+        len -= (size_t)n;
+        off += n;
+    }
+    return 0;
+}
+
+static void* pool_thread(void* arg) {
+    uring_writer_t* w = (uring_writer_t*)arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (w->jlen == 0 && !w->stop) {
+            pthread_cond_wait(&w->work, &w->lock);
+        }
+        if (w->jlen == 0) {
+            break;
+        }
+        int slot = w->jobs[w->jhead];
+        w->jhead = (w->jhead + 1) % URING_WRITER_MAX_DEPTH;
+        w->jlen--;
+        pthread_mutex_unlock(&w->lock);
+
+        const char* buf = buffer_of(w, slot);
+        int rc = w->offsets ? pwrite_all(w->fd, buf, w->len[slot], w->off[slot])
+                            : write_all(w->fd, buf, w->len[slot]);
+
+        pthread_mutex_lock(&w->lock);
+        finish(w, slot, rc < 0 ? rc : (long)w->len[slot]);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/* ---- common front end; everything below runs under w->lock ---- */
+
+static void count_submit(uring_writer_t* w) {
+    w->inflight++;
+    w->stats.writes++;
+    w->stats.depth_sum += (unsigned long)w->inflight;
+    if (w->inflight > w->stats.max_depth) {
+        w->stats.max_depth = w->inflight;
+    }
+}
+
+static void release(uring_writer_t* w, int slot) {
+    w->free_slots[w->nfree++] = slot;
+    pthread_cond_broadcast(&w->changed);
+}
+
+static void push_queue(uring_writer_t* w, int slot) {
+    w->queue[(w->qhead + w->qlen) % URING_WRITER_MAX_DEPTH] = slot;
+    w->qlen++;
+}
+
+static int pop_queue(uring_writer_t* w) {
+    int slot = w->queue[w->qhead];
+    w->qhead = (w->qhead + 1) % URING_WRITER_MAX_DEPTH;
+    w->qlen--;
+    return slot;
+}
+
+/* A buffer is complete: fix its place in the output and queue it. */
+static void seal(uring_writer_t* w, int slot) {
+    w->done[slot] = 0;
+    if (w->offsets) {
+        w->off[slot] = w->next_off;
+        w->next_off += (off_t)w->len[slot];
+    }
+    push_queue(w, slot);
+}
+
+/* Submit what may go now: queued buffers, and the one being filled when
+ * nothing is in flight. Linked io_uring batches wait for the previous
+ * batch, so their order holds. */
+static void kick(uring_writer_t* w) {
+    if (w->error) {
+        while (w->qlen > 0) {
+            release(w, pop_queue(w));
+        }
+        return;
+    }
+    if (w->inflight == 0 && w->cur >= 0 && w->len[w->cur] > 0) {
+        seal(w, w->cur);
+        w->cur = -1;
+    }
+    if (w->qlen == 0) {
+        return;
+    }
+#if HAVE_IO_URING
+    if (w->ring) {
+        int slots[URING_WRITER_MAX_DEPTH];
+        int n = 0;
+        if (w->offsets) {
+            while (w->qlen > 0) {
+                slots[n] = pop_queue(w);
+                prep_write(w, slots[n], 0);
+                count_submit(w);
+                n++;
+            }
+        } else if (w->inflight == 0) {
+            w->chain_len = 0;
+            while (w->qlen > 0) {
+                int slot = pop_queue(w);
+                w->chain[w->chain_len++] = slot;
+                prep_write(w, slot, w->qlen > 0);
+                count_submit(w);
+            }
+            n = w->chain_len;
+            memcpy(slots, w->chain, (size_t)n * sizeof(int));
+        }
+        if (n > 0) {
+            ring_submit(w, slots, n);
+        }
+        return;
+    }
+#endif
+    while (w->qlen > 0) {
+        w->jobs[(w->jhead + w->jlen) % URING_WRITER_MAX_DEPTH] = pop_queue(w);
+        w->jlen++;
+        count_submit(w);
+    }
+    pthread_cond_broadcast(&w->work);
+}
+
+/* A write came back with res bytes or -errno. */
+static void finish(uring_writer_t* w, int slot, long res) {
+    w->inflight--;
+    int chained = w->ring && !w->offsets;
+    int retry = w->ring && (res == -EINTR || res == -EAGAIN);
+    if (res == -ECANCELED && chained) {
+        /* an earlier link in the batch fell short; rewritten below */
+    } else if (res <= 0 && !retry) {
+        if (!w->error) {
+            w->error = "uring_writer: write failed";
+        }
+    } else if (res > 0) {
+        w->done[slot] += (size_t)res;
+    }
+
+    if (!chained) {
+#if HAVE_IO_URING
+        if (w->ring && !w->error && w->done[slot] < w->len[slot]) {
+            /* short or interrupted: the rest goes out at its own offset */
+            prep_write(w, slot, 0);
+            count_submit(w);
+            ring_submit(w, &slot, 1);
+            return;
+        }
+#endif
+        release(w, slot);
+        kick(w);
+        return;
+    }
+
+    if (w->inflight > 0) {
+        return;
+    }
+    /* the batch is over: unwritten buffers go back in front, in order */
+    int redo[URING_WRITER_MAX_DEPTH];
+    int nredo = 0;
+    for (int i = 0; i < w->chain_len; ++i) {
+        int s = w->chain[i];
+        if (!w->error && w->done[s] < w->len[s]) {
+            redo[nredo++] = s;
+        } else {
+            release(w, s);
+        }
+    }
+    w->chain_len = 0;
+    for (int i = nredo - 1; i >= 0; --i) {
+        w->qhead = (w->qhead + URING_WRITER_MAX_DEPTH - 1) % URING_WRITER_MAX_DEPTH;
+        w->queue[w->qhead] = redo[i];
+        w->qlen++;
+    }
+    /* they keep done[], so the rewrite starts where the short one stopped */
+    kick(w);
+}
+
+/* ---- public API ---- */
+
+const char* uring_writer_open(uring_writer_t* w, int fd, const uring_writer_config_t* config) {
+    if (!w || fd < 0 || !config || config->depth < 1 || config->depth > URING_WRITER_MAX_DEPTH ||
+        config->block_bytes == 0) {
+        return "uring_writer_open: invalid arguments";
+    }
+    memset(w, 0, sizeof(*w));
+    w->config = *config;
+    w->fd = fd;
+    w->cur = -1;
+    struct stat st;
+    int flags = fcntl(fd, F_GETFL);
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    int regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    w->offsets = config->owns_fd && regular && flags >= 0 && !(flags & O_APPEND) && pos >= 0;
+    w->next_off = w->offsets ? pos : 0;
+
+    long page = sysconf(_SC_PAGESIZE);
+    void* mem = NULL;
+    if (posix_memalign(&mem, (size_t)page, (size_t)config->depth * config->block_bytes) != 0) {
+        return "uring_writer_open: out of memory";
+    }
+    w->mem = (char*)mem;
+    for (int i = config->depth - 1; i >= 0; --i) {
+        w->free_slots[w->nfree++] = i;
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->changed, NULL);
+    pthread_cond_init(&w->work, NULL);
+
+#if HAVE_IO_URING
+    /* io_uring writes at the file position without taking its lock, so
+     * another writer of the same open file could overwrite them */
+    if (!config->threads_only && !(regular && !w->offsets)) {
+        w->ring = ring_create(w);
+    }
+    if (w->ring) {
+        w->stats.backend = w->ring->fixed ? "io_uring" : "io_uring, unregistered buffers";
+        if (pthread_create(&w->ring->reaper, NULL, reaper_thread, w) == 0) {
+            return NULL;
+        }
+        ring_unmap(w->ring);
+        free(w->ring);
+        w->ring = NULL;
+    }
+#endif
+    w->stats.backend = "threads";
+    /* without offsets the order is the queue order: one thread */
+    int want = w->offsets ? (config->depth < URING_WRITER_MAX_THREADS ? config->depth
+                                                                       : URING_WRITER_MAX_THREADS)
+                          : 1;
+    for (; w->nthreads < want; ++w->nthreads) {
+        if (pthread_create(&w->threads[w->nthreads], NULL, pool_thread, w) != 0) {
+            break;
+        }
+    }
+    if (w->nthreads == 0) {
+        pthread_cond_destroy(&w->work);
+        pthread_cond_destroy(&w->changed);
+        pthread_mutex_destroy(&w->lock);
+        free(w->mem);
+        return "uring_writer_open: pthread_create failed";
+    }
+    return NULL;
+}
+
+/* A free buffer to fill, waiting for a write to come back if needed. */
+static int take_buffer(uring_writer_t* w) {
+    while (w->nfree == 0 && !w->error) {
+        kick(w);
+        pthread_cond_wait(&w->changed, &w->lock);
+    }
+    if (w->error) {
+        return -1;
+    }
+    int slot = w->free_slots[--w->nfree];
+    w->len[slot] = 0;
+    return slot;
+}
+
+const char* uring_writer_appendv(uring_writer_t* w, const struct iovec* iov, int iovcnt) {
+    if (!w || iovcnt < 0 || (iovcnt > 0 && !iov)) {
+        return "uring_writer_appendv: invalid arguments";
+    }
+    size_t block = w->config.block_bytes;
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        total += iov[i].iov_len;
+    }
+    pthread_mutex_lock(&w->lock);
+    /* keep the pieces in one buffer unless they cannot fit in any */
+    if (w->cur >= 0 && total <= block && total > block - w->len[w->cur]) {
+        seal(w, w->cur);
+        w->cur = -1;
+    }
+    for (int i = 0; i < iovcnt && !w->error; ++i) {
+        const char* src = (const char*)iov[i].iov_base;
+        size_t len = iov[i].iov_len;
+        while (len > 0) {
+            if (w->cur < 0 && (w->cur = take_buffer(w)) < 0) {
+                break;
+            }
+            size_t room = block - w->len[w->cur];
+            size_t n = len < room ? len : room;
+            memcpy(buffer_of(w, w->cur) + w->len[w->cur], src, n);
+            w->len[w->cur] += n;
+            src += n;
+            len -= n;
+            if (w->len[w->cur] == block) {
+                seal(w, w->cur);
+                w->cur = -1;
+            }
+        }
+    }
+    kick(w);
+    const char* err = w->error;
+    pthread_mutex_unlock(&w->lock);
+    return err;
+}
+
+const char* uring_writer_drain(uring_writer_t* w) {
+    if (!w) {
+        return "uring_writer_drain: invalid arguments";
+    }
+    pthread_mutex_lock(&w->lock);
+    if (w->cur >= 0 && w->len[w->cur] > 0) {
+        seal(w, w->cur);
+        w->cur = -1;
+    }
+    kick(w);
+    while (w->inflight > 0 || w->qlen > 0) {
+        pthread_cond_wait(&w->changed, &w->lock);
+    }
+    const char* err = w->error;
+    pthread_mutex_unlock(&w->lock);
+    return err;
+}
+
+const char* uring_writer_close(uring_writer_t* w) {
+    if (!w) {
+        return "uring_writer_close: invalid arguments";
+    }
+    const char* err = uring_writer_drain(w);
+#if HAVE_IO_URING
+    if (w->ring) {
+        ring_stop(w);
+    }
+#endif
+    if (w->nthreads > 0) {
+        pthread_mutex_lock(&w->lock);
+        w->stop = 1;
+        pthread_cond_broadcast(&w->work);
+        pthread_mutex_unlock(&w->lock);
+        for (int i = 0; i < w->nthreads; ++i) {
+            pthread_join(w->threads[i], NULL);
+        }
+        w->nthreads = 0;
+    }
+    if (w->offsets) {
+        (void)lseek(w->fd, w->next_off, SEEK_SET);
+    }
+    pthread_cond_destroy(&w->work);
+    pthread_cond_destroy(&w->changed);
+    pthread_mutex_destroy(&w->lock);
+    free(w->mem);
+    w->mem = NULL;
+    return err;
+}
+
+void uring_writer_format_stats(const uring_writer_t* w, char* buf, size_t size) {
+    const uring_writer_stats_t* s = &w->stats;
+    double avg = s->writes ? (double)s->depth_sum / (double)s->writes : 0.0;
+    snprintf(buf, size, "%s: %lu writes of up to %zu bytes, depth avg %.2f max %d of %d",
+             s->backend, s->writes, w->config.block_bytes, avg, s->max_depth, w->config.depth);
+}
@@ -0,0 +1,110 @@
+#ifndef IO_URING_WRITER_H
+#define IO_URING_WRITER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define URING_WRITER_MAX_DEPTH 64
+#define URING_WRITER_MAX_THREADS 4
+
+typedef struct {
+    size_t block_bytes;       /* size of each buffer */
+    int depth;                /* buffers, and so the most writes in flight */
+    int threads_only;         /* skip io_uring and use the thread-pool writer */
+    int owns_fd;              /* nothing else writes the fd (see below) */
+    int report;               /* the owner should log the stats on close */
+} uring_writer_config_t;
+
+typedef struct {
+    const char* backend;      /* "io_uring", "io_uring, unregistered buffers" or "threads" */
+    unsigned long writes;     /* writes submitted, retries of short ones included */
+    unsigned long depth_sum;  /* writes in flight at each submission, summed */
+    int max_depth;
+} uring_writer_stats_t;
+
+struct uring_ring;
+
+/*
+ * Buffered output to one fd with several writes in flight.
+ *
+ * The caller appends into one of depth buffers of block_bytes; a full
+ * buffer is submitted right away, a partial one as soon as nothing is in
+ * flight, so an idle writer adds no latency and a busy one batches.
+ * Appending only waits when every buffer is full or being written.
+ *
+ * With io_uring the buffers are registered once and written with
+ * WRITE_FIXED; a thread reaps completions. Where io_uring is missing or
+ * refused (old kernel, seccomp) a small pool of threads does the writes
+ * instead.
+ *
+ * A regular file the caller owns, opened without O_APPEND, gets explicit
+ * offsets, so its writes run in parallel and may complete in any order.
+ * Any other fd is written at its current position. For a pipe or a
+ * terminal io_uring links each batch of buffers so they run one after
+ * another. A regular file someone else may write too, such as stdout
+ * redirected to a file, always goes to the pool: io_uring does not lock
+ * the file position, so two writers could land on the same offset. The
+ * pool uses a single thread when there are no offsets. Either way the
+ * bytes land in append order.
+ * As with async_writer, the pieces of one appendv stay in one buffer, and
+ * so one write, unless they are larger than a block.
+ */
+typedef struct {
+    uring_writer_config_t config;
+    int fd;
+    int offsets;              /* explicit offsets, see above */
+    off_t next_off;
+    char* mem;                /* depth buffers of block_bytes, page aligned */
+    size_t len[URING_WRITER_MAX_DEPTH];
+    size_t done[URING_WRITER_MAX_DEPTH];   /* bytes of the buffer written so far */
+    off_t off[URING_WRITER_MAX_DEPTH];
+    int free_slots[URING_WRITER_MAX_DEPTH];
+    int nfree;
+    int queue[URING_WRITER_MAX_DEPTH];     /* full buffers waiting to be submitted, in order */
+    int qhead;
+    int qlen;
+    int chain[URING_WRITER_MAX_DEPTH];     /* io_uring, no offsets: the batch in flight */
+    int chain_len;
+    int cur;                  /* buffer being filled, -1 if none */
+    int inflight;             /* buffers handed to the backend */
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;   /* a buffer came back */
+    const char* error;        /* first write error; later output is dropped */
+
+    struct uring_ring* ring;  /* NULL with the thread pool */
+    pthread_cond_t work;      /* thread pool: a job was queued or stop was set */
+    int jobs[URING_WRITER_MAX_DEPTH];
+    int jhead;
+    int jlen;
+    int stop;
+    int nthreads;
+    pthread_t threads[URING_WRITER_MAX_THREADS];
+
+    uring_writer_stats_t stats;
+} uring_writer_t;
+
+/* Fill config from PIPELINE_IO_DEPTH, PIPELINE_IO_BLOCK,
+ * PIPELINE_IO_THREADS and PIPELINE_IO_STATS; owns_fd is left to the
+ * caller. Returns NULL or an error message. */
+const char* uring_writer_config_from_env(uring_writer_config_t* config);
+
+/* Returns NULL on success or an error message. The fd stays the caller's. */
+const char* uring_writer_open(uring_writer_t* w, int fd, const uring_writer_config_t* config);
+
+/* Append the pieces in order. Returns NULL or the first error. */
+const char* uring_writer_appendv(uring_writer_t* w, const struct iovec* iov, int iovcnt);
+
+/* Wait until everything appended so far is written. */
+const char* uring_writer_drain(uring_writer_t* w);
+
+/* Drain, stop the backend and free the buffers. With offsets the fd is
+ * left positioned after the data. */
+const char* uring_writer_close(uring_writer_t* w);
+
+/* One line for a shutdown report: backend, writes and queue depth. */
+void uring_writer_format_stats(const uring_writer_t* w, char* buf, size_t size);
+
+#endif // IO_URING_WRITER_H
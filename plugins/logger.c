@@ -1,65 +1,337 @@
 #define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include "io/async_writer.h"
+#include "io/mmap_log.h"
+#include "io/uring_writer.h"
 #include "plugin_common.h"
 #include "plugin_sdk.h"
 
+/* Targets of the async writer, and the io_uring writers. */
+enum { LOG_STDOUT, LOG_FILE };
+
 static plugin_context_t g_ctx;
 static FILE* g_fp = NULL;
+static enum { MODE_SYNC, MODE_ASYNC, MODE_MMAP, MODE_URING } g_mode;
+static async_writer_t g_writer;     /* MODE_ASYNC */
+static mmap_log_t g_map;            /* MODE_MMAP: output/pipeline.log */
+static uring_writer_t g_uring[2];   /* MODE_URING, by LOG_STDOUT / LOG_FILE */
+static int g_log_fd = -1;           /* MODE_URING: output/pipeline.log */
 
-static char* logger_process(char* input) {
-    if (!input) {
-        return NULL;
-    }
-    fprintf(stdout, "[logger] %s\n", input);
+static int logger_process(record_t* rec) {
+    fputs("[logger] ", stdout);
+    fwrite(rec->data, 1, rec->len, stdout);
+    fputc('\n', stdout);
     fflush(stdout);
     if (g_fp) {
-        fprintf(g_fp, "%s\n", input);
+        fwrite(rec->data, 1, rec->len, g_fp);
+        fputc('\n', g_fp);
         fflush(g_fp);
     }
-    return input;
+    return 1;
+}
+
+/* Same output, handed to the writer thread instead of two write(2)s. */
+static int logger_process_async(record_t* rec) {
+    struct iovec line[3] = {
+        { (void*)"[logger] ", 9 },
+        { rec->data, rec->len },
+        { (void*)"\n", 1 },
+    };
+    (void)async_writer_appendv(&g_writer, LOG_STDOUT, line, 3);
+    (void)async_writer_appendv(&g_writer, LOG_FILE, line + 1, 2);
+    return 1;
+}
+
+/* stdout as in sync mode; the log line is copied into the mapping. */
+static int logger_process_mmap(record_t* rec) {
+    struct iovec line[2] = {
+        { rec->data, rec->len },
+        { (void*)"\n", 1 },
+    };
+    fputs("[logger] ", stdout);
+    fwrite(rec->data, 1, rec->len, stdout);
+    fputc('\n', stdout);
+    fflush(stdout);
+    (void)mmap_log_appendv(&g_map, line, 2);
+    return 1;
+}
+
+static int logger_process_uring(record_t* rec) {
+    struct iovec line[3] = {
+        { (void*)"[logger] ", 9 },
+        { rec->data, rec->len },
+        { (void*)"\n", 1 },
+    };
+    (void)uring_writer_appendv(&g_uring[LOG_STDOUT], line, 3);
+    (void)uring_writer_appendv(&g_uring[LOG_FILE], line + 1, 2);
+    return 1;
+}
+
+/* Non-negative number from the environment with an optional k/m/g suffix
+ * when bytes is set; def if unset. Returns -1 if malformed. */
+static int env_number(const char* name, long def, int bytes, long* out) {
+    const char* env = getenv(name);
+    *out = def;
+    if (!env || !*env) {
+        return 0;
+    }
+    char* end = NULL;
+    errno = 0;
+    long val = strtol(env, &end, 10);
+    if (errno != 0 || end == env || val < 0) {
+        return -1;
+    }
+    int shift = 0;
+    if (bytes) {
+        switch (*end) {
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+        default: break;
+        }
+    }
+    if (*end != '\0' || val > (LONG_MAX >> shift)) {
+        return -1;
+    }
+    *out = val << shift;
+    return 0;
+}
+
+static const char* start_async(void) {
+    async_writer_config_t config;
+    long block;
+    if (env_number("LOGGER_FLUSH_BYTES", 1L << 20, 1, &block) != 0 || block <= 0) {
+        return "logger: invalid LOGGER_FLUSH_BYTES value";
+    }
+    if (env_number("LOGGER_FLUSH_MS", 100, 0, &config.flush_ms) != 0) {
+        return "logger: invalid LOGGER_FLUSH_MS value";
+    }
+    if (env_number("LOGGER_SYNC_MS", 0, 0, &config.sync_ms) != 0) {
+        return "logger: invalid LOGGER_SYNC_MS value";
+    }
+    config.block_bytes = (size_t)block;
+    async_target_t targets[2] = {
+        { STDOUT_FILENO, 0 },
+        { fileno(g_fp), 1 },
+    };
+    return async_writer_open(&g_writer, targets, 2, &config);
+}
+
+static const char* start_mmap(void) {
+    long extent;
+    if (env_number("LOGGER_EXTENT_BYTES", 16L << 20, 1, &extent) != 0 || extent <= 0) {
+        return "logger: invalid LOGGER_EXTENT_BYTES value";
+    }
+    return mmap_log_open(&g_map, "output/pipeline.log", (size_t)extent);
+}
+
+/* The log is opened without O_APPEND so its writes can carry offsets and
+ * overlap; stdout is shared with other stages and keeps its position. */
+static const char* start_uring(void) {
+    uring_writer_config_t config;
+    const char* err = uring_writer_config_from_env(&config);
+    if (err) {
+        return err;
+    }
+    g_log_fd = open("output/pipeline.log", O_WRONLY | O_CREAT, 0644);
+    if (g_log_fd < 0 || lseek(g_log_fd, 0, SEEK_END) < 0) {
+        err = "logger: failed to open output/pipeline.log";
+    } else {
+        config.owns_fd = 0;
+        err = uring_writer_open(&g_uring[LOG_STDOUT], STDOUT_FILENO, &config);
+        if (!err) {
+            config.owns_fd = 1;
+            err = uring_writer_open(&g_uring[LOG_FILE], g_log_fd, &config);
+            if (err) {
+                (void)uring_writer_close(&g_uring[LOG_STDOUT]);
+            }
+        }
+    }
+    if (err && g_log_fd >= 0) {
+        close(g_log_fd);
+        g_log_fd = -1;
+    }
+    return err;
+}
+
+static const char* stop_uring(void) {
+    const char* err = NULL;
+    static const char* const names[2] = { "stdout", "output/pipeline.log" };
+    for (int t = LOG_STDOUT; t <= LOG_FILE; ++t) {
+        const char* werr = uring_writer_close(&g_uring[t]);
+        err = err ? err : werr;
+        if (g_uring[t].config.report) {
+            char stats[160];
+            char msg[200];
+            uring_writer_format_stats(&g_uring[t], stats, sizeof(stats));
+            snprintf(msg, sizeof(msg), "%s via %s", names[t], stats);
+            log_info(&g_ctx, msg);
+        }
+    }
+    close(g_log_fd);
+    g_log_fd = -1;
+    return err;
+}
+
+static const char* stop_output(void) {
+    const char* err = NULL;
+    if (g_mode == MODE_ASYNC) {
+        err = async_writer_close(&g_writer);
+    } else if (g_mode == MODE_MMAP) {
+        err = mmap_log_close(&g_map);
+    } else if (g_mode == MODE_URING) {
+        err = stop_uring();
+    }
+    if (g_fp) {
+        fclose(g_fp);
+        g_fp = NULL;
+    }
+    g_mode = MODE_SYNC;
+    return err;
 }
 
 const char* plugin_get_name(void) { return "logger"; }
 
-const char* plugin_init(int queue_size) {
+/* plugin_init, or plugin_init_inline when inline_process is set: every
+ * mode works from the host's thread, the writers run on their own. */
+static const char* start(int queue_size, plugin_process_fn* inline_process) {
+    const char* mode = getenv("LOGGER_MODE");
+    int (*process)(record_t*) = logger_process;
+    if (!mode || !*mode || strcmp(mode, "sync") == 0) {
+        g_mode = MODE_SYNC;
+    } else if (strcmp(mode, "async") == 0) {
+        g_mode = MODE_ASYNC;
+        process = logger_process_async;
+    } else if (strcmp(mode, "mmap") == 0) {
+        g_mode = MODE_MMAP;
+        process = logger_process_mmap;
+    } else if (strcmp(mode, "uring") == 0) {
+        g_mode = MODE_URING;
+        process = logger_process_uring;
+    } else {
+        return "logger: invalid LOGGER_MODE value";
+    }
     struct stat st;
     if (stat("output", &st) != 0) {
         (void)mkdir("output", 0755);
     }
-    g_fp = fopen("output/pipeline.log", "a");
-    if (!g_fp) {
-        return "logger: failed to open output/pipeline.log";
+    const char* err = NULL;
+    if (g_mode == MODE_MMAP || g_mode == MODE_URING) {
+        err = g_mode == MODE_MMAP ? start_mmap() : start_uring();
+        if (err) {
+            g_mode = MODE_SYNC;
+            return err;
+        }
+    } else {
+        g_fp = fopen("output/pipeline.log", "a");
+        if (!g_fp) {
+            return "logger: failed to open output/pipeline.log";
+        }
+        if (g_mode == MODE_ASYNC && (err = start_async()) != NULL) {
+            g_mode = MODE_SYNC;
+            fclose(g_fp);
+            g_fp = NULL;
+            return err;
+        }
     }
-    const char* err = common_plugin_init(&g_ctx, logger_process, "logger", queue_size);
+    err = inline_process ? common_plugin_init_inline(&g_ctx, process, "logger", inline_process)
+                         : common_plugin_init(&g_ctx, process, "logger", queue_size);
     if (err) {
-        fclose(g_fp);
-        g_fp = NULL;
+        (void)stop_output();
     }
     return err;
 }
 
+const char* plugin_init(int queue_size) {
+    return start(queue_size, NULL);
+}
+
+const char* plugin_init_inline(int (**process)(struct record* rec)) {
+    return start(0, process);
+}
+
 void plugin_attach(const char* (*next_place_work)(const char*)) {
     common_plugin_attach(&g_ctx, next_place_work);
 }
 
+void plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int)) {
+    common_plugin_attach_batch(&g_ctx, next_place_work_batch);
+}
+
+void plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+                         const char* (*next_place_work_owned_batch)(char* const*, int)) {
+    common_plugin_attach_owned(&g_ctx, next_place_work_owned, next_place_work_owned_batch);
+}
+
 const char* plugin_place_work(const char* str) {
     return common_plugin_place_work(&g_ctx, str);
 }
 
+const char* plugin_place_work_batch(const char* const* strs, int count) {
+    return common_plugin_place_work_batch(&g_ctx, strs, count);
+}
+
+const char* plugin_place_work_owned(char* str) {
+    return common_plugin_place_work_owned(&g_ctx, str);
+}
+
+const char* plugin_place_work_owned_batch(char* const* strs, int count) {
+    return common_plugin_place_work_owned_batch(&g_ctx, strs, count);
+}
+
+void plugin_attach_records(const char* (*next_place_work_records)(const struct record*, int),
+                           const char* (*next_place_work_records_owned)(const struct record*, int)) {
+    common_plugin_attach_records(&g_ctx, next_place_work_records, next_place_work_records_owned);
+}
+
+const char* plugin_place_work_records(const struct record* recs, int count) {
+    return common_plugin_place_work_records(&g_ctx, recs, count);
+}
+
+const char* plugin_place_work_records_owned(const struct record* recs, int count) {
+    return common_plugin_place_work_records_owned(&g_ctx, recs, count);
+}
+
+void plugin_set_memory_budget(struct byte_budget* budget) {
+    common_plugin_set_memory_budget(&g_ctx, budget);
+}
+
+void plugin_set_allocator(struct slab* slab) {
+    common_plugin_set_allocator(&g_ctx, slab);
+}
+
+void plugin_set_executor(struct executor* ex) {
+    common_plugin_set_executor(&g_ctx, ex, 1);
+}
+
+/* Once the stage has seen <END>, everything it logged is written out
+ * before this returns. */
 const char* plugin_wait_finished(void) {
-    return common_plugin_wait_finished(&g_ctx);
+    const char* err = common_plugin_wait_finished(&g_ctx);
+    const char* werr = NULL;
+    if (g_mode == MODE_ASYNC) {
+        werr = async_writer_drain(&g_writer);
+    } else if (g_mode == MODE_MMAP) {
+        werr = mmap_log_trim(&g_map);
+    } else if (g_mode == MODE_URING) {
+        werr = uring_writer_drain(&g_uring[LOG_STDOUT]);
+        const char* ferr = uring_writer_drain(&g_uring[LOG_FILE]);
+        werr = werr ? werr : ferr;
+    }
+    return err ? err : werr;
 }
 
 const char* plugin_fini(void) {
     const char* err = common_plugin_fini(&g_ctx);
-    if (g_fp) {
-        fclose(g_fp);
-        g_fp = NULL;
-    }
-    return err;
+    const char* werr = stop_output();
+    return err ? err : werr;
 }
 
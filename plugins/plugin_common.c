@@ -1,4 +1,5 @@
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,11 +7,85 @@
 #include "plugin_common.h"
 
 #define END_TOKEN "<END>"
+#define QUEUE_KIND_ENV "PIPELINE_QUEUE"
+#define SPIN_ENV "PIPELINE_SPIN"
+#define YIELD_ENV "PIPELINE_YIELD"
+#define WAIT_STATS_ENV "PIPELINE_WAIT_STATS"
+#define RING_BYTES_ENV "PIPELINE_RING_BYTES"
+#define QUEUE_BYTES_ENV "PIPELINE_QUEUE_BYTES"
+#define SPILL_ENV "PIPELINE_SPILL"
+
+/* Default byte-ring size per queue slot when PIPELINE_RING_BYTES is unset. */
+#define RING_BYTES_PER_SLOT 256
 
 static int is_end_token(const char* str) {
     return str && strcmp(str, END_TOKEN) == 0;
 }
 
+/* Non-negative integer from the environment, or def_val if unset/invalid. */
+static long env_long(const char* name, long def_val) {
+    const char* env = getenv(name);
+    if (!env || !*env) {
+        return def_val;
+    }
+    char* end = NULL;
+    errno = 0;
+    long val = strtol(env, &end, 10);
+    if (errno != 0 || end == env || *end != '\0' || val < 0) {
+        return def_val;
+    }
+    return val;
+}
+
+/* Byte count from the environment: a number with an optional k/m/g suffix.
+ * 0 if unset; -1 if malformed. */
+static long env_bytes(const char* name) {
+    const char* env = getenv(name);
+    if (!env || !*env) {
+        return 0;
+    }
+    char* end = NULL;
+    errno = 0;
+    long val = strtol(env, &end, 10);
+    if (errno != 0 || end == env || val < 0) {
+        return -1;
+    }
+    int shift = 0;
+    switch (*end) {
+    case 'k': case 'K': shift = 10; end++; break;
+    case 'm': case 'M': shift = 20; end++; break;
+    case 'g': case 'G': shift = 30; end++; break;
+    default: break;
+    }
+    if (*end != '\0' || val > (LONG_MAX >> shift)) {
+        return -1;
+    }
+    return val << shift;
+}
+
+static void configure_wait_policy(plugin_context_t* ctx) {
+    wait_policy_t policy;
+    consumer_producer_get_wait_policy(&ctx->queue, &policy);
+    policy.spin_iters = (int)env_long(SPIN_ENV, policy.spin_iters);
+    policy.yield_iters = (int)env_long(YIELD_ENV, policy.yield_iters);
+    consumer_producer_set_wait_policy(&ctx->queue, &policy);
+}
+
+static void report_wait_stats(plugin_context_t* ctx) {
+    if (env_long(WAIT_STATS_ENV, 0) == 0) {
+        return;
+    }
+    unsigned long c[WAIT_PHASE_COUNT];
+    unsigned long p[WAIT_PHASE_COUNT];
+    consumer_producer_get_wait_stats(&ctx->queue, c, p);
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "waits: consumer spin=%lu yield=%lu park=%lu; producer spin=%lu yield=%lu park=%lu",
+             c[WAIT_PHASE_SPIN], c[WAIT_PHASE_YIELD], c[WAIT_PHASE_PARK],
+             p[WAIT_PHASE_SPIN], p[WAIT_PHASE_YIELD], p[WAIT_PHASE_PARK]);
+    log_info(ctx, msg);
+}
+
 void log_error(plugin_context_t* ctx, const char* message) {
     const char* name = ctx && ctx->name ? ctx->name : "plugin";
     fprintf(stderr, "[ERROR][%s] - %s\n", name, message ? message : "unknown error");
@@ -21,63 +96,262 @@ void log_info(plugin_context_t* ctx, const char* message) {
     fprintf(stderr, "[INFO][%s] - %s\n", name, message ? message : "info");
 }
 
-void* plugin_consumer_thread(void* arg) {
-    plugin_context_t* ctx = (plugin_context_t*)arg;
-    if (!ctx) {
-        return NULL;
+/* Records this stage owns: not the end marker, not a view into the queue. */
+static int owns(const record_t* rec) {
+    return !(rec->flags & (RECORD_END | RECORD_BORROWED));
+}
+
+/* Hand a processed batch to the next stage over the richest interface it
+ * offers. When the stage owns every record and the next one takes
+ * ownership, the buffers move on instead of being copied. */
+static void forward_batch(plugin_context_t* ctx, record_t* out, int n) {
+    if (n == 0) {
+        return;
+    }
+    int movable = 1;
+    for (int i = 0; i < n && movable; ++i) {
+        movable = owns(&out[i]) || record_is_end(&out[i]);
     }
 
-    for (;;) {
-        char* item = consumer_producer_get(&ctx->queue);
-        if (!item) {
-            break; /* queue drained and closed */
+    const char* err = NULL;
+    if (ctx->next_place_work_records) {
+        if (movable && ctx->next_place_work_records_owned) {
+            err = ctx->next_place_work_records_owned(out, n);
+            if (err) {
+                log_error(ctx, err);
+            }
+            return;
         }
-
-        if (is_end_token(item)) {
-            if (ctx->next_place_work) {
-                const char* err = ctx->next_place_work(END_TOKEN);
+        err = ctx->next_place_work_records(out, n);
+        if (err) {
+            log_error(ctx, err);
+        }
+    } else {
+        /* a pre-record next stage sees C strings, cut at the first NUL */
+        char* strs[CP_BATCH_MAX];
+        for (int i = 0; i < n; ++i) {
+            strs[i] = record_cstr(&out[i]);
+        }
+        if (movable && ctx->next_place_work_owned) {
+            if (ctx->next_place_work_owned_batch) {
+                err = ctx->next_place_work_owned_batch(strs, n);
+                if (err) {
+                    log_error(ctx, err);
+                }
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                err = ctx->next_place_work_owned(strs[i]);
+                if (err) {
+                    log_error(ctx, err);
+                }
+            }
+            return;
+        }
+        if (ctx->next_place_work_batch) {
+            err = ctx->next_place_work_batch((const char* const*)strs, n);
+            if (err) {
+                log_error(ctx, err);
+            }
+        } else if (ctx->next_place_work) {
+            for (int i = 0; i < n; ++i) {
+                err = ctx->next_place_work(strs[i]);
                 if (err) {
                     log_error(ctx, err);
                 }
             }
-            break;
         }
+    }
+    for (int i = 0; i < n; ++i) {
+        if (owns(&out[i])) {
+            slab_free(ctx->queue.slab, out[i].data);
+        }
+    }
+}
+
+/* Run the plugin transform on rec. Returns 0 if the record is dropped;
+ * a replacement buffer is left in rec for the caller to sort out. */
+static int process_record(plugin_context_t* ctx, record_t* rec) {
+    if (ctx->process_function) {
+        return ctx->process_function(rec);
+    }
+    if (!ctx->cstr_process) {
+        return 1;
+    }
+    /* pre-record plugins see the payload up to its first NUL */
+    char* out = ctx->cstr_process(rec->data);
+    if (!out) {
+        return 0;
+    }
+    rec->len = strlen(out);
+    if (out != rec->data) {
+        rec->data = out;
+        rec->cap = rec->len + 1;
+    }
+    return 1;
+}
 
-        char* processed = item;
-        if (ctx->process_function) {
-            processed = ctx->process_function(item);
+/* The stage's own transform and then the fused ones. Returns 0 once one
+ * drops the record; replaced and dropped buffers are freed here. */
+static int transform(plugin_context_t* ctx, record_t* rec) {
+    for (int k = -1; k < ctx->num_fused; ++k) {
+        char* input = rec->data;
+        int owned = owns(rec);
+        int keep = k < 0 ? process_record(ctx, rec) : ctx->fused[k](rec);
+        if (rec->data != input) {
+            /* replaced: the new buffer is ours, the input goes */
+            if (owned) {
+                slab_free(ctx->queue.slab, input);
+            }
+            rec->flags &= ~RECORD_BORROWED;
+        }
+        if (!keep) {
+            /* Drop the record if plugin chose to consume it */
+            if (owns(rec)) {
+                slab_free(ctx->queue.slab, rec->data);
+            }
+            return 0;
         }
+    }
+    return 1;
+}
+
+/* Replicas hold a processed batch here until every batch taken before it
+ * has been forwarded: at most one batch per replica waits. */
+static void wait_turn(plugin_context_t* ctx, unsigned long seq) {
+    pthread_mutex_lock(&ctx->order_lock);
+    while (ctx->next_turn != seq) {
+        pthread_cond_wait(&ctx->order_cond, &ctx->order_lock);
+    }
+    pthread_mutex_unlock(&ctx->order_lock);
+}
+
+static void pass_turn(plugin_context_t* ctx) {
+    pthread_mutex_lock(&ctx->order_lock);
+    ctx->next_turn++;
+    pthread_cond_broadcast(&ctx->order_cond);
+    pthread_mutex_unlock(&ctx->order_lock);
+}
 
-        if (!processed) {
-            /* Drop the string if plugin chose to consume it */
-            free(item);
+/* Transform a batch taken from the queue and pass it on. Returns 1 once
+ * <END> went through. */
+static int handle_batch(plugin_context_t* ctx, record_t* batch, int n, record_t* out,
+                        unsigned long seq) {
+    int done = 0;
+    int n_out = 0;
+    for (int i = 0; i < n; ++i) {
+        record_t rec = batch[i];
+        if (done) {
+            if (owns(&rec)) {
+                slab_free(ctx->queue.slab, rec.data); /* nothing follows <END>; defensive */
+            }
             continue;
         }
-
-        if (processed != item) {
-            free(item);
+        if (record_is_end(&rec)) {
+            out[n_out++] = rec;
+            done = 1;
+            continue;
+        }
+        if (!rec.data) {
+            continue; /* lost to a failed copy */
         }
 
-        if (ctx->next_place_work) {
-            const char* err = ctx->next_place_work(processed);
-            if (err) {
-                log_error(ctx, err);
-            }
+        if (transform(ctx, &rec)) {
+            out[n_out++] = rec;
         }
+    }
+
+    if (ctx->replicas > 1) {
+        wait_turn(ctx, seq);
+    }
+    if (ctx->batch_function && n_out > 0) {
+        ctx->batch_function(out, n_out);
+    }
+    forward_batch(ctx, out, n_out);
+    consumer_producer_release(&ctx->queue);
+    if (ctx->replicas > 1) {
+        pass_turn(ctx);
+    }
+    return done;
+}
+
+void* plugin_consumer_thread(void* arg) {
+    plugin_context_t* ctx = (plugin_context_t*)arg;
+    if (!ctx) {
+        return NULL;
+    }
 
-        free(processed);
+    /* With a borrowing queue the items live in the ring: in-place plugins
+     * transform them there and the next stage copies them out, so a line
+     * costs no allocation. Only replacement buffers are ours to free. */
+    record_t batch[CP_BATCH_MAX];
+    record_t out[CP_BATCH_MAX];
+    int done = 0;
+    int max = CP_BATCH_MAX;
+    while (!done) {
+        /* drain everything available per wakeup */
+        unsigned long seq = 0;
+        int n = ctx->queue.kind == CP_QUEUE_LOCKED
+                    ? consumer_producer_get_records_seq(&ctx->queue, batch, max, &seq)
+                    : consumer_producer_acquire_records(&ctx->queue, batch, max);
+        if (n == 0) {
+            break; /* queue drained and closed */
+        }
+        /* set before the first item was placed: a replicated stage takes
+         * less at a time so that the other replicas find work too */
+        max = ctx->batch_max;
+        done = handle_batch(ctx, batch, n, out, seq);
     }
 
+    if (ctx->replicas > 1) {
+        /* the last replica out reports the stage finished; wait_finished
+         * joins them all */
+        pthread_mutex_lock(&ctx->order_lock);
+        int last = --ctx->live == 0;
+        pthread_mutex_unlock(&ctx->order_lock);
+        if (last) {
+            consumer_producer_signal_finished(&ctx->queue);
+            ctx->finished = 1;
+        }
+        return NULL;
+    }
     consumer_producer_signal_finished(&ctx->queue);
     ctx->thread_running = 0;
     ctx->finished = 1;
     return NULL;
 }
 
-const char* common_plugin_init(plugin_context_t* ctx,
-                               plugin_process_fn process,
-                               const char* name,
-                               int queue_size) {
+/* The consumer thread's loop as an executor task: one batch per step, so
+ * the worker moves on to other stages in between. */
+static executor_status_t stage_step(void* arg) {
+    plugin_context_t* ctx = (plugin_context_t*)arg;
+    record_t batch[CP_BATCH_MAX];
+    record_t out[CP_BATCH_MAX];
+    int n = consumer_producer_try_get_records(&ctx->queue, batch, CP_BATCH_MAX);
+    if (n == 0) {
+        return EXECUTOR_IDLE;
+    }
+    if (!handle_batch(ctx, batch, n, out, 0)) {
+        /* a short batch emptied the queue; puts since then notify again */
+        return n == CP_BATCH_MAX ? EXECUTOR_MORE : EXECUTOR_IDLE;
+    }
+    consumer_producer_signal_finished(&ctx->queue);
+    ctx->finished = 1;
+    return EXECUTOR_DONE;
+}
+
+/* The kind QUEUE_KIND_ENV asks for. Returns 0, or -1 if it names none. */
+static int queue_kind(consumer_producer_kind_t* kind) {
+    const char* name = getenv(QUEUE_KIND_ENV);
+    *kind = CP_QUEUE_LOCKED;
+    return name && *name ? consumer_producer_kind_parse(name, kind) : 0;
+}
+
+static const char* init_context(plugin_context_t* ctx,
+                                plugin_process_fn process,
+                                plugin_cstr_process_fn cstr_process,
+                                const char* name,
+                                int queue_size) {
     if (!ctx || queue_size <= 0) {
         return "common_plugin_init: invalid arguments";
     }
@@ -85,16 +359,61 @@ const char* common_plugin_init(plugin_context_t* ctx,
         return "common_plugin_init: already initialized";
     }
 
+    consumer_producer_kind_t kind;
+    if (queue_kind(&kind) != 0) {
+        return "common_plugin_init: unknown " QUEUE_KIND_ENV " value";
+    }
+
+    /* set by common_plugin_set_executor before init */
+    executor_t* executor = ctx->executor;
+    int as_task = ctx->as_task;
     memset(ctx, 0, sizeof(*ctx));
+    ctx->executor = executor;
+    ctx->as_task = as_task;
     ctx->name = name ? name : "plugin";
     ctx->process_function = process;
+    ctx->cstr_process = cstr_process;
+
+    int capacity = queue_size;
+    if (kind == CP_QUEUE_BYTES) {
+        long bytes = env_long(RING_BYTES_ENV, (long)queue_size * RING_BYTES_PER_SLOT);
+        if (bytes <= 0 || bytes > INT_MAX) {
+            return "common_plugin_init: invalid " RING_BYTES_ENV " value";
+        }
+        capacity = (int)bytes;
+    }
 
-    const char* err = consumer_producer_init(&ctx->queue, queue_size);
+    const char* err = consumer_producer_init_kind(&ctx->queue, capacity, kind);
     if (err) {
         return err;
     }
+    configure_wait_policy(ctx);
+    long queue_bytes = env_bytes(QUEUE_BYTES_ENV);
+    err = queue_bytes < 0 ? "common_plugin_init: invalid " QUEUE_BYTES_ENV " value"
+                          : consumer_producer_set_byte_budget(&ctx->queue, (size_t)queue_bytes);
+    const char* spill_dir = getenv(SPILL_ENV);
+    if (!err && spill_dir && *spill_dir) {
+        err = consumer_producer_enable_spill(&ctx->queue, spill_dir);
+    }
+    if (err) {
+        consumer_producer_destroy(&ctx->queue);
+        return err;
+    }
 
+    ctx->replicas = 1;
+    ctx->batch_max = CP_BATCH_MAX;
     ctx->initialized = 1;
+    if (ctx->executor) {
+        int order = executor_next_order(ctx->executor);
+        if (ctx->as_task && kind == CP_QUEUE_LOCKED &&
+            executor_register(ctx->executor, &ctx->task, order, stage_step, ctx) == 0) {
+            consumer_producer_set_executor(&ctx->queue, ctx->executor, &ctx->task);
+            ctx->on_executor = 1;
+            return NULL;
+        }
+        /* a thread after all, but workers blocked on its queue still help */
+        consumer_producer_set_executor(&ctx->queue, ctx->executor, NULL);
+    }
     ctx->thread_running = 1;
     if (pthread_create(&ctx->consumer_thread, NULL, plugin_consumer_thread, ctx) != 0) {
         ctx->initialized = 0;
@@ -105,6 +424,46 @@ const char* common_plugin_init(plugin_context_t* ctx,
     return NULL;
 }
 
+const char* common_plugin_init(plugin_context_t* ctx,
+                               plugin_process_fn process,
+                               const char* name,
+                               int queue_size) {
+    return init_context(ctx, process, NULL, name, queue_size);
+}
+
+const char* common_plugin_init_cstr(plugin_context_t* ctx,
+                                    plugin_cstr_process_fn process,
+                                    const char* name,
+                                    int queue_size) {
+    return init_context(ctx, NULL, process, name, queue_size);
+}
+
+const char* common_plugin_init_inline(plugin_context_t* ctx,
+                                      plugin_process_fn process,
+                                      const char* name,
+                                      plugin_process_fn* out) {
+    if (!ctx || !process || !out) {
+        return "common_plugin_init_inline: invalid arguments";
+    }
+    if (ctx->initialized) {
+        return "common_plugin_init_inline: already initialized";
+    }
+    consumer_producer_kind_t kind;
+    if (queue_kind(&kind) != 0) {
+        /* unused here, but the option is wrong all the same */
+        return "common_plugin_init_inline: unknown " QUEUE_KIND_ENV " value";
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->name = name ? name : "plugin";
+    ctx->process_function = process;
+    ctx->replicas = 1;
+    ctx->runs_inline = 1;
+    ctx->finished = 1;
+    ctx->initialized = 1;
+    *out = process;
+    return NULL;
+}
+
 void common_plugin_attach(plugin_context_t* ctx, const char* (*next_place)(const char*)) {
     if (!ctx) {
         return;
@@ -112,6 +471,134 @@ void common_plugin_attach(plugin_context_t* ctx, const char* (*next_place)(const
     ctx->next_place_work = next_place;
 }
 
+void common_plugin_attach_batch(plugin_context_t* ctx,
+                                const char* (*next_place_batch)(const char* const*, int)) {
+    if (!ctx) {
+        return;
+    }
+    ctx->next_place_work_batch = next_place_batch;
+}
+
+void common_plugin_attach_owned(plugin_context_t* ctx,
+                                const char* (*next_place_owned)(char*),
+                                const char* (*next_place_owned_batch)(char* const*, int)) {
+    if (!ctx) {
+        return;
+    }
+    ctx->next_place_work_owned = next_place_owned;
+    ctx->next_place_work_owned_batch = next_place_owned ? next_place_owned_batch : NULL;
+}
+
+void common_plugin_attach_records(plugin_context_t* ctx,
+                                  const char* (*next_place_records)(const record_t*, int),
+                                  const char* (*next_place_records_owned)(const record_t*, int)) {
+    if (!ctx) {
+        return;
+    }
+    ctx->next_place_work_records = next_place_records;
+    ctx->next_place_work_records_owned = next_place_records ? next_place_records_owned : NULL;
+}
+
+void common_plugin_set_memory_budget(plugin_context_t* ctx, byte_budget_t* budget) {
+    if (!ctx || !ctx->initialized) {
+        return;
+    }
+    consumer_producer_set_shared_budget(&ctx->queue, budget);
+}
+
+void common_plugin_set_allocator(plugin_context_t* ctx, slab_t* slab) {
+    if (!ctx || !ctx->initialized) {
+        return;
+    }
+    consumer_producer_set_allocator(&ctx->queue, slab);
+}
+
+void common_plugin_set_batch_function(plugin_context_t* ctx, plugin_batch_fn fn) {
+    if (!ctx || !ctx->initialized) {
+        return;
+    }
+    ctx->batch_function = fn;
+}
+
+const char* common_plugin_fuse(plugin_context_t* ctx, plugin_process_fn fn) {
+    if (!ctx || !ctx->initialized || !fn) {
+        return "common_plugin_fuse: invalid arguments";
+    }
+    if (ctx->num_fused == PLUGIN_MAX_FUSED) {
+        return "common_plugin_fuse: too many fused stages";
+    }
+    ctx->fused[ctx->num_fused++] = fn;
+    return NULL;
+}
+
+const char* common_plugin_set_replicas(plugin_context_t* ctx, int replicas) {
+    if (!ctx || !ctx->initialized || replicas < 1 || replicas > PLUGIN_MAX_REPLICAS) {
+        return "common_plugin_set_replicas: invalid arguments";
+    }
+    if (ctx->replicas > 1) {
+        return "common_plugin_set_replicas: already replicated";
+    }
+    if (replicas == 1) {
+        return NULL;
+    }
+    if (ctx->queue.kind != CP_QUEUE_LOCKED) {
+        return "common_plugin_set_replicas: replicas need the locked queue";
+    }
+    if (ctx->on_executor) {
+        /* replicas are threads; the task is left idle for good */
+        consumer_producer_set_executor(&ctx->queue, ctx->executor, NULL);
+        ctx->on_executor = 0;
+        ctx->thread_running = 1;
+        if (pthread_create(&ctx->consumer_thread, NULL, plugin_consumer_thread, ctx) != 0) {
+            ctx->thread_running = 0;
+            return "common_plugin_set_replicas: pthread_create failed";
+        }
+    }
+    pthread_mutex_init(&ctx->order_lock, NULL);
+    pthread_cond_init(&ctx->order_cond, NULL);
+    ctx->next_turn = 0;
+    ctx->live = replicas;
+    /* a batch of at most half the queue per replica keeps them all busy */
+    int per = ctx->queue.capacity / (2 * replicas);
+    ctx->batch_max = per < 1 ? 1 : per > CP_BATCH_MAX ? CP_BATCH_MAX : per;
+    ctx->replicas = replicas;
+    for (int i = 1; i < replicas; ++i) {
+        if (pthread_create(&ctx->replica_threads[ctx->num_replica_threads], NULL,
+                           plugin_consumer_thread, ctx) != 0) {
+            pthread_mutex_lock(&ctx->order_lock);
+            ctx->live -= replicas - i;
+            pthread_mutex_unlock(&ctx->order_lock);
+            return "common_plugin_set_replicas: pthread_create failed";
+        }
+        ctx->num_replica_threads++;
+    }
+    return NULL;
+}
+
+void common_plugin_set_executor(plugin_context_t* ctx, executor_t* ex, int as_task) {
+    if (!ctx || ctx->initialized) {
+        return;
+    }
+    ctx->executor = ex;
+    ctx->as_task = ex && as_task;
+}
+
+char* common_plugin_alloc(plugin_context_t* ctx, size_t len) {
+    return (char*)slab_alloc(ctx ? ctx->queue.slab : NULL, len);
+}
+
+void common_plugin_forward(plugin_context_t* ctx, record_t* recs, int count) {
+    if (!ctx || !ctx->initialized || !recs) {
+        return;
+    }
+    while (count > 0) {
+        int n = count < CP_BATCH_MAX ? count : CP_BATCH_MAX;
+        forward_batch(ctx, recs, n);
+        recs += n;
+        count -= n;
+    }
+}
+
 const char* common_plugin_place_work(plugin_context_t* ctx, const char* str) {
     if (!ctx || !ctx->initialized) {
         return "common_plugin_place_work: plugin not initialized";
@@ -122,6 +609,57 @@ const char* common_plugin_place_work(plugin_context_t* ctx, const char* str) {
     return consumer_producer_put(&ctx->queue, str);
 }
 
+const char* common_plugin_place_work_batch(plugin_context_t* ctx, const char* const* strs, int count) {
+    if (!ctx || !ctx->initialized) {
+        return "common_plugin_place_work_batch: plugin not initialized";
+    }
+    return consumer_producer_put_batch(&ctx->queue, strs, count);
+}
+
+const char* common_plugin_place_work_owned(plugin_context_t* ctx, char* str) {
+    if (!ctx || !ctx->initialized) {
+        if (str && !is_end_token(str)) {
+            slab_free(ctx ? ctx->queue.slab : NULL, str);
+        }
+        return "common_plugin_place_work_owned: plugin not initialized";
+    }
+    if (!str) {
+        return common_plugin_place_work(ctx, "");
+    }
+    return consumer_producer_put_owned(&ctx->queue, str);
+}
+
+const char* common_plugin_place_work_owned_batch(plugin_context_t* ctx, char* const* strs, int count) {
+    if (!ctx || !ctx->initialized) {
+        for (int i = 0; strs && i < count; ++i) {
+            if (strs[i] && !is_end_token(strs[i])) {
+                slab_free(ctx ? ctx->queue.slab : NULL, strs[i]);
+            }
+        }
+        return "common_plugin_place_work_owned_batch: plugin not initialized";
+    }
+    return consumer_producer_put_owned_batch(&ctx->queue, strs, count);
+}
+
+const char* common_plugin_place_work_records(plugin_context_t* ctx, const record_t* recs, int count) {
+    if (!ctx || !ctx->initialized) {
+        return "common_plugin_place_work_records: plugin not initialized";
+    }
+    return consumer_producer_put_records(&ctx->queue, recs, count);
+}
+
+const char* common_plugin_place_work_records_owned(plugin_context_t* ctx, const record_t* recs, int count) {
+    if (!ctx || !ctx->initialized) {
+        for (int i = 0; recs && i < count; ++i) {
+            if (owns(&recs[i])) {
+                slab_free(ctx ? ctx->queue.slab : NULL, recs[i].data);
+            }
+        }
+        return "common_plugin_place_work_records_owned: plugin not initialized";
+    }
+    return consumer_producer_put_records_owned(&ctx->queue, recs, count);
+}
+
 const char* common_plugin_wait_finished(plugin_context_t* ctx) {
     if (!ctx || !ctx->initialized) {
         return NULL;
@@ -133,8 +671,12 @@ const char* common_plugin_wait_finished(plugin_context_t* ctx) {
         pthread_join(ctx->consumer_thread, NULL);
         ctx->thread_running = 0;
     }
+    for (int i = 0; i < ctx->num_replica_threads; ++i) {
+        pthread_join(ctx->replica_threads[i], NULL);
+    }
+    ctx->num_replica_threads = 0;
     ctx->finished = 1;
-    return NULL;
+    return ctx->runs_inline ? NULL : consumer_producer_error(&ctx->queue);
 }
 
 const char* common_plugin_fini(plugin_context_t* ctx) {
@@ -142,10 +684,39 @@ const char* common_plugin_fini(plugin_context_t* ctx) {
         return NULL;
     }
 
-    (void)common_plugin_wait_finished(ctx);
-    consumer_producer_destroy(&ctx->queue);
+    const char* lost = common_plugin_wait_finished(ctx);
+    if (lost) {
+        log_error(ctx, lost);
+    }
+    if (!ctx->runs_inline) {
+        report_wait_stats(ctx);
+        unsigned long spilled = consumer_producer_spilled(&ctx->queue);
+        if (spilled > 0) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "spilled %lu items to disk", spilled);
+            log_info(ctx, msg);
+        }
+        consumer_producer_destroy(&ctx->queue);
+    }
+    if (ctx->replicas > 1) {
+        pthread_cond_destroy(&ctx->order_cond);
+        pthread_mutex_destroy(&ctx->order_lock);
+    }
+    ctx->replicas = 1;
+    ctx->executor = NULL;
+    ctx->as_task = 0;
+    ctx->on_executor = 0;
+    ctx->runs_inline = 0;
     ctx->initialized = 0;
     ctx->next_place_work = NULL;
+    ctx->next_place_work_batch = NULL;
+    ctx->next_place_work_owned = NULL;
+    ctx->next_place_work_owned_batch = NULL;
+    ctx->next_place_work_records = NULL;
+    ctx->next_place_work_records_owned = NULL;
     ctx->process_function = NULL;
+    ctx->cstr_process = NULL;
+    ctx->batch_function = NULL;
+    ctx->num_fused = 0;
     return NULL;
 }
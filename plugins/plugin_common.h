@@ -5,14 +5,57 @@
 
 #include "sync/consumer_producer.h"
 
-typedef char* (*plugin_process_fn)(char* input);
+/*
+ * Transform rec in place (growing it up to rec->cap - 1 bytes), or point
+ * rec->data at a new buffer from common_plugin_alloc and set len and cap;
+ * the caller frees the old one. The payload is rec->len bytes and may
+ * contain NULs. Return 1 to forward rec, 0 to drop it.
+ */
+typedef int (*plugin_process_fn)(record_t* rec);
+
+/* Pre-record transform, for plugins written against it: takes a C string
+ * and returns it (changed in place), a replacement, or NULL to drop it. */
+typedef char* (*plugin_cstr_process_fn)(char* input);
+
+/* Sees each batch of records the stage keeps, after process and before
+ * they are forwarded or freed; an <END> record comes last. */
+typedef void (*plugin_batch_fn)(const record_t* recs, int count);
+
+/* Transforms of later stages run on this stage's thread (see plugin_fuse
+ * in plugin_sdk.h). */
+#define PLUGIN_MAX_FUSED 16
+
+/* Most consumer threads one stage may run (see plugin_set_replicas). */
+#define PLUGIN_MAX_REPLICAS 64
 
 typedef struct plugin_context_impl {
     const char* name;                                      /* plugin name */
     consumer_producer_t queue;                             /* inbound queue */
     pthread_t consumer_thread;                             /* worker thread */
     const char* (*next_place_work)(const char*);           /* next stage callback */
+    const char* (*next_place_work_batch)(const char* const*, int); /* optional batch callback */
+    const char* (*next_place_work_owned)(char*);           /* optional ownership-taking callback */
+    const char* (*next_place_work_owned_batch)(char* const*, int); /* optional, batch form */
+    const char* (*next_place_work_records)(const record_t*, int);  /* optional record callback */
+    const char* (*next_place_work_records_owned)(const record_t*, int); /* optional, ownership-taking */
     plugin_process_fn process_function;                    /* plugin-specific transform */
+    plugin_cstr_process_fn cstr_process;                   /* or a pre-record one */
+    plugin_batch_fn batch_function;                        /* optional, see plugin_batch_fn */
+    plugin_process_fn fused[PLUGIN_MAX_FUSED];             /* applied after process, in order */
+    int num_fused;
+    int replicas;                                          /* consumer threads, 1 unless replicated */
+    int batch_max;                                         /* records taken per batch */
+    pthread_t replica_threads[PLUGIN_MAX_REPLICAS - 1];    /* the ones besides consumer_thread */
+    int num_replica_threads;
+    pthread_mutex_t order_lock;                            /* replicated: batches leave in order */
+    pthread_cond_t order_cond;
+    unsigned long next_turn;                               /* sequence number of the next batch out */
+    int live;                                              /* replicas still running */
+    executor_t* executor;                                  /* shared workers, NULL if none */
+    int as_task;                                           /* may run as a task on them */
+    int on_executor;                                       /* does: no consumer_thread */
+    executor_task_t task;
+    int runs_inline;                                       /* no queue, no thread: the host calls process */
     int initialized;                                       /* initialization flag */
     int thread_running;                                    /* thread state */
     int finished;                                          /* worker completion flag */
@@ -26,8 +69,67 @@ const char* common_plugin_init(plugin_context_t* ctx,
                                plugin_process_fn process,
                                const char* name,
                                int queue_size);
+const char* common_plugin_init_cstr(plugin_context_t* ctx,
+                                    plugin_cstr_process_fn process,
+                                    const char* name,
+                                    int queue_size);
+/* Set ctx up for a host that runs process itself, on its own thread (see
+ * plugin_init_inline in plugin_sdk.h): no queue and no thread, and *out
+ * set to process. Of the other calls only set_allocator, alloc,
+ * wait_finished and fini apply to such a context. */
+const char* common_plugin_init_inline(plugin_context_t* ctx,
+                                      plugin_process_fn process,
+                                      const char* name,
+                                      plugin_process_fn* out);
 const char* common_plugin_place_work(plugin_context_t* ctx, const char* str);
+const char* common_plugin_place_work_batch(plugin_context_t* ctx, const char* const* strs, int count);
 void        common_plugin_attach(plugin_context_t* ctx, const char* (*next_place)(const char*));
+void        common_plugin_attach_batch(plugin_context_t* ctx,
+                                       const char* (*next_place_batch)(const char* const*, int));
+const char* common_plugin_place_work_owned(plugin_context_t* ctx, char* str);
+const char* common_plugin_place_work_owned_batch(plugin_context_t* ctx, char* const* strs, int count);
+void        common_plugin_attach_owned(plugin_context_t* ctx,
+                                       const char* (*next_place_owned)(char*),
+                                       const char* (*next_place_owned_batch)(char* const*, int));
+const char* common_plugin_place_work_records(plugin_context_t* ctx, const record_t* recs, int count);
+const char* common_plugin_place_work_records_owned(plugin_context_t* ctx, const record_t* recs, int count);
+void        common_plugin_attach_records(plugin_context_t* ctx,
+                                         const char* (*next_place_records)(const record_t*, int),
+                                         const char* (*next_place_records_owned)(const record_t*, int));
+void        common_plugin_set_memory_budget(plugin_context_t* ctx, byte_budget_t* budget);
+void        common_plugin_set_allocator(plugin_context_t* ctx, slab_t* slab);
+
+/* Install fn on an initialized context before any work is placed. */
+void        common_plugin_set_batch_function(plugin_context_t* ctx, plugin_batch_fn fn);
+
+/* Append a later stage's transform, applied after this stage's own.
+ * Call on an initialized context before any work is placed. */
+const char* common_plugin_fuse(plugin_context_t* ctx, plugin_process_fn fn);
+
+/* Run replicas consumer threads on the queue, for a stateless process
+ * function. Batches are numbered as they leave the queue and forwarded in
+ * that order. Needs the locked queue. Call on an initialized context
+ * before any work is placed. */
+const char* common_plugin_set_replicas(plugin_context_t* ctx, int replicas);
+
+/* Run the stage as a task on ex's workers instead of a thread of its own
+ * (see plugin_set_executor in plugin_sdk.h). as_task 0 keeps the thread,
+ * for a stage whose hooks wait on threads of its own, but still lets a
+ * worker stuck on its queue run later stages. Call before init; a stage
+ * whose queue is not the locked one keeps its thread either way. */
+void        common_plugin_set_executor(plugin_context_t* ctx, executor_t* ex, int as_task);
+
+/* Buffer for a replacement string returned by a process function. Plugins
+ * must use it rather than malloc: the buffer is freed by whichever stage
+ * ends up holding it, with the allocator the host shares between stages. */
+char*       common_plugin_alloc(plugin_context_t* ctx, size_t len);
+
+/* Forward records the stage produced outside its process function, for a
+ * plugin that emits from a thread of its own. The buffers come from
+ * common_plugin_alloc and move on or are freed here. Only one thread may
+ * forward at a time: the consumer thread forwards right after the batch
+ * function returns, so a plugin can keep it waiting there. */
+void        common_plugin_forward(plugin_context_t* ctx, record_t* recs, int count);
 const char* common_plugin_wait_finished(plugin_context_t* ctx);
 const char* common_plugin_fini(plugin_context_t* ctx);
 
@@ -9,6 +9,90 @@
  *   void        plugin_attach(const char* (*next_place_work)(const char*));
  *   const char* plugin_wait_finished(void);
  *
+ * Optional symbols; the host probes for them and falls back to the
+ * required ones when they are missing:
+ *   const char* plugin_place_work_batch(const char* const* strs, int count);
+ *   void        plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int));
+ * The host only calls plugin_attach_batch when the next plugin exports
+ * plugin_place_work_batch, so a stage can forward a drained batch in one call.
+ *
+ *   const char* plugin_place_work_owned(char* str);
+ *   const char* plugin_place_work_owned_batch(char* const* strs, int count);
+ *   void        plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+ *                                   const char* (*next_place_work_owned_batch)(char* const*, int));
+ * The owned entry points take heap strings and free them once done,
+ * including on error, so a buffer moves down the chain without a copy.
+ * "<END>" is never taken over. The host calls plugin_attach_owned only when
+ * the next plugin exports plugin_place_work_owned (the batch form may be
+ * NULL); plugins then still receive plugin_attach for strings they borrow.
+ *
+ *   const char* plugin_place_work_records(const struct record* recs, int count);
+ *   const char* plugin_place_work_records_owned(const struct record* recs, int count);
+ *   void        plugin_attach_records(const char* (*next_place_work_records)(const struct record*, int),
+ *                                     const char* (*next_place_work_records_owned)(const struct record*, int));
+ * Record entry points (see sync/record.h): each line carries its length,
+ * so stages never measure it again and payloads may contain NULs; the end
+ * of the stream is the RECORD_END flag. The owned form takes over the
+ * buffers like plugin_place_work_owned_batch. The host prefers these over
+ * every char* form when the next plugin exports plugin_place_work_records;
+ * a plugin without them still loads and is fed C strings.
+ *
+ *   void        plugin_set_memory_budget(struct byte_budget* budget);
+ * Called after plugin_init and before any work when the host enforces a
+ * pipeline-wide memory ceiling: the plugin charges the bytes waiting in its
+ * queue to the shared budget (see sync/byte_budget.h).
+ *
+ *   void        plugin_set_allocator(struct slab* slab);
+ * Called after plugin_init and before any work. The plugin allocates its
+ * queued copies and its replacement strings (common_plugin_alloc) from the
+ * slab the host shares between stages, and frees what it is handed with it
+ * (see sync/slab.h). The host only wires the owned entry points between two
+ * plugins that agree on the allocator, i.e. both or neither export this.
+ *
+ *   int         plugin_process_record(struct record* rec);
+ *   const char* plugin_fuse(int (*process_record)(struct record* rec));
+ * Exported by stages whose transform keeps no state between lines and
+ * touches nothing but the record. plugin_process_record runs it on the
+ * caller's thread, with the contract of a plugin_process_fn (see
+ * plugin_common.h). For a run of adjacent stages that all export both, the
+ * host hands the later stages' plugin_process_record to the first one's
+ * plugin_fuse, in order, after plugin_init and before any work: the first
+ * stage applies them after its own transform and forwards past the run, so
+ * the run costs one thread and one queue. The host closes the skipped
+ * stages at once and keeps them loaded until the end. Fused stages must
+ * agree on the allocator; --fuse=0 keeps a thread per stage.
+ *
+ *   const char* plugin_set_replicas(int replicas);
+ * Also for stateless stages only. Called after plugin_init and before any
+ * work when the chain names the stage as "name*N": the stage runs N
+ * consumer threads on its one queue. Batches are numbered as they are
+ * taken and each waits for the ones before it to be forwarded, so the next
+ * stage sees the lines in their original order. A stage that keeps state,
+ * or writes output itself, does not export it and the host refuses to
+ * replicate it. Needs the locked queue.
+ *
+ *   void        plugin_set_executor(struct executor* ex);
+ * Called before plugin_init, in chain order, when the host runs the stages
+ * on a shared pool of workers (--executor=pool, see sync/executor.h). The
+ * stage then starts no thread: its consumer loop runs on the workers one
+ * batch at a time whenever its queue has work. A plugin whose hooks wait on
+ * threads of its own keeps its thread but still takes the executor, so a
+ * worker blocked on its queue can run later stages meanwhile. Plugins
+ * without it, and stages on a queue other than the locked one, keep a
+ * thread each.
+ *
+ *   const char* plugin_init_inline(int (**process)(struct record* rec));
+ * Instead of plugin_init, for a host that runs the stage on its own thread
+ * (--executor=inline): the plugin reads its configuration as plugin_init
+ * would but starts no queue and no thread, and sets *process to its
+ * transform. The host's reader then pushes each line through every such
+ * stage by calling these in chain order, each with the contract of a
+ * plugin_process_fn (see plugin_common.h), and hands what is kept to the
+ * first threaded stage. plugin_set_allocator, plugin_wait_finished and
+ * plugin_fini still follow. A configuration that needs the stage thread
+ * returns an error, and the host calls plugin_init instead; so does every
+ * stage after one that runs threaded.
+ *
  * All returned const char* are NULL on success, or point to a static string
  * describing the error on failure. The strings must remain valid for the
  * duration of the call.
@@ -21,6 +105,11 @@
 extern "C" {
 #endif
 
+struct byte_budget;
+struct executor;
+struct record;
+struct slab;
+
 // Function prototypes required by the host application
 const char* plugin_get_name(void);
 const char* plugin_init(int queue_size);
@@ -29,6 +118,39 @@ const char* plugin_place_work(const char* str);
 void        plugin_attach(const char* (*next_place_work)(const char*));
 const char* plugin_wait_finished(void);
 
+// Optional batch entry points (see above)
+const char* plugin_place_work_batch(const char* const* strs, int count);
+void        plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int));
+
+// Optional ownership-transfer entry points (see above)
+const char* plugin_place_work_owned(char* str);
+const char* plugin_place_work_owned_batch(char* const* strs, int count);
+void        plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+                                const char* (*next_place_work_owned_batch)(char* const*, int));
+
+// Optional length-carrying record entry points (see above)
+const char* plugin_place_work_records(const struct record* recs, int count);
+const char* plugin_place_work_records_owned(const struct record* recs, int count);
+void        plugin_attach_records(const char* (*next_place_work_records)(const struct record*, int),
+                                  const char* (*next_place_work_records_owned)(const struct record*, int));
+
+// Optional pipeline-wide memory ceiling (see above)
+void        plugin_set_memory_budget(struct byte_budget* budget);
+
+// Optional shared record allocator (see above)
+void        plugin_set_allocator(struct slab* slab);
+
+// Optional stateless transform, stage fusion and replication (see above)
+int         plugin_process_record(struct record* rec);
+const char* plugin_fuse(int (*process_record)(struct record* rec));
+const char* plugin_set_replicas(int replicas);
+
+// Optional shared worker pool (see above)
+void        plugin_set_executor(struct executor* ex);
+
+// Optional run-to-completion setup (see above)
+const char* plugin_init_inline(int (**process)(struct record* rec));
+
 #ifdef __cplusplus
 }
 #endif
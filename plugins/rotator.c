@@ -1,39 +1,185 @@
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "plugin_common.h"
 #include "plugin_sdk.h"
+#include "text/reverse.h"
+
+/* Rotations whose short side fits here are done in place. */
+#define ROTATE_STACK_BYTES 256
 
 static plugin_context_t g_ctx;
+static size_t g_amount = 1;         /* ROTATOR_AMOUNT */
+static int g_left;                  /* ROTATOR_DIRECTION=left */
+static text_reverse_fn g_reverse;
 
-static char* rotate_right(char* input) {
-    if (!input) {
-        return NULL;
+/*
+ * Rotate right by k, 0 < k < len, touching each byte about once. With a
+ * short side of at most ROTATE_STACK_BYTES it is saved aside while the
+ * long side slides over, as the old rotate-by-one did with a single byte.
+ * Otherwise the two sides are copied into a new buffer in rotated order.
+ * Without memory for one, three reversals do it in place in two passes.
+ */
+static void rotate_by(record_t* rec, size_t k) {
+    char* s = rec->data;
+    size_t len = rec->len;
+    char saved[ROTATE_STACK_BYTES];
+    if (k <= sizeof(saved)) {
+        memcpy(saved, s + len - k, k);
+        memmove(s + k, s, len - k);
+        memcpy(s, saved, k);
+        return;
+    }
+    if (len - k <= sizeof(saved)) {
+        memcpy(saved, s, len - k);
+        memmove(s, s + len - k, k);
+        memcpy(s + k, saved, len - k);
+        return;
+    }
+    char* out = common_plugin_alloc(&g_ctx, len + 1);
+    if (out) {
+        memcpy(out, s + len - k, k);
+        memcpy(out + k, s, len - k);
+        out[len] = '\0';
+        rec->data = out;
+        rec->cap = len + 1;
+        return;
     }
-    size_t len = strlen(input);
+    g_reverse(s, len);
+    g_reverse(s, k);
+    g_reverse(s + k, len - k);
+}
+
+static int rotate_process(record_t* rec) {
+    size_t len = rec->len;
     if (len <= 1) {
-        return input;
+        return 1;
+    }
+    size_t k = g_amount % len;
+    if (k == 0) {
+        return 1;
     }
-    char last = input[len - 1];
-    memmove(input + 1, input, len - 1);
-    input[0] = last;
-    return input;
+    rotate_by(rec, g_left ? len - k : k);
+    return 1;
+}
+
+static const char* parse_config(void) {
+    const char* amount = getenv("ROTATOR_AMOUNT");
+    g_amount = 1;
+    if (amount && *amount) {
+        char* end = NULL;
+        errno = 0;
+        unsigned long long val = strtoull(amount, &end, 10);
+        if (errno != 0 || end == amount || *end != '\0' || amount[0] == '-') {
+            return "rotator: invalid ROTATOR_AMOUNT value";
+        }
+        g_amount = (size_t)val;
+    }
+    const char* dir = getenv("ROTATOR_DIRECTION");
+    g_left = 0;
+    if (dir && *dir) {
+        if (strcmp(dir, "left") == 0) {
+            g_left = 1;
+        } else if (strcmp(dir, "right") != 0) {
+            return "rotator: invalid ROTATOR_DIRECTION value";
+        }
+    }
+    return NULL;
 }
 
 const char* plugin_get_name(void) { return "rotator"; }
 
+/* Everything plugin_init sets up besides the queue and the thread. */
+static const char* configure(void) {
+    text_isa_t isa;
+    const char* err = parse_config();
+    if (!err) {
+        err = text_isa_limit(&isa);
+    }
+    if (err) {
+        return err;
+    }
+    g_reverse = text_reverse_select(isa);
+    return NULL;
+}
+
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(&g_ctx, rotate_right, "rotator", queue_size);
+    const char* err = configure();
+    return err ? err : common_plugin_init(&g_ctx, rotate_process, "rotator", queue_size);
+}
+
+const char* plugin_init_inline(int (**process)(struct record* rec)) {
+    const char* err = configure();
+    return err ? err : common_plugin_init_inline(&g_ctx, rotate_process, "rotator", process);
 }
 
 void plugin_attach(const char* (*next_place_work)(const char*)) {
     common_plugin_attach(&g_ctx, next_place_work);
 }
 
+void plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int)) {
+    common_plugin_attach_batch(&g_ctx, next_place_work_batch);
+}
+
+void plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+                         const char* (*next_place_work_owned_batch)(char* const*, int)) {
+    common_plugin_attach_owned(&g_ctx, next_place_work_owned, next_place_work_owned_batch);
+}
+
 const char* plugin_place_work(const char* str) {
     return common_plugin_place_work(&g_ctx, str);
 }
 
+const char* plugin_place_work_batch(const char* const* strs, int count) {
+    return common_plugin_place_work_batch(&g_ctx, strs, count);
+}
+
+const char* plugin_place_work_owned(char* str) {
+    return common_plugin_place_work_owned(&g_ctx, str);
+}
+
+const char* plugin_place_work_owned_batch(char* const* strs, int count) {
+    return common_plugin_place_work_owned_batch(&g_ctx, strs, count);
+}
+
+void plugin_attach_records(const char* (*next_place_work_records)(const struct record*, int),
+                           const char* (*next_place_work_records_owned)(const struct record*, int)) {
+    common_plugin_attach_records(&g_ctx, next_place_work_records, next_place_work_records_owned);
+}
+
+const char* plugin_place_work_records(const struct record* recs, int count) {
+    return common_plugin_place_work_records(&g_ctx, recs, count);
+}
+
+const char* plugin_place_work_records_owned(const struct record* recs, int count) {
+    return common_plugin_place_work_records_owned(&g_ctx, recs, count);
+}
+
+void plugin_set_memory_budget(struct byte_budget* budget) {
+    common_plugin_set_memory_budget(&g_ctx, budget);
+}
+
+void plugin_set_allocator(struct slab* slab) {
+    common_plugin_set_allocator(&g_ctx, slab);
+}
+
+void plugin_set_executor(struct executor* ex) {
+    common_plugin_set_executor(&g_ctx, ex, 1);
+}
+
+int plugin_process_record(struct record* rec) {
+    return rotate_process(rec);
+}
+
+const char* plugin_fuse(int (*process_record)(struct record* rec)) {
+    return common_plugin_fuse(&g_ctx, process_record);
+}
+
+const char* plugin_set_replicas(int replicas) {
+    return common_plugin_set_replicas(&g_ctx, replicas);
+}
+
 const char* plugin_wait_finished(void) {
     return common_plugin_wait_finished(&g_ctx);
 }
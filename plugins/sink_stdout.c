@@ -1,24 +1,202 @@
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "io/line_batch.h"
+#include "io/uring_writer.h"
 #include "plugin_common.h"
 #include "plugin_sdk.h"
 
 static plugin_context_t g_ctx;
+static enum { MODE_SYNC, MODE_URING, MODE_WRITEV } g_mode;
+static uring_writer_t g_out;        /* MODE_URING */
+static line_batch_t g_batch;        /* MODE_WRITEV */
+static int g_report;                /* PIPELINE_IO_STATS */
 
-static char* sink_process(char* input) {
-    if (!input) {
-        return NULL;
+static int sink_process(record_t* rec) {
+    fwrite(rec->data, 1, rec->len, stdout);
+    fputc('\n', stdout);
+    fflush(stdout);
+    return 0; /* consume the record, nothing to forward */
+}
+
+static int sink_process_uring(record_t* rec) {
+    struct iovec line[2] = {
+        { rec->data, rec->len },
+        { (void*)"\n", 1 },
+    };
+    (void)uring_writer_appendv(&g_out, line, 2);
+    return 0;
+}
+
+/* Keep the record: sink_write_batch needs it, the common code frees it. */
+static int sink_process_keep(record_t* rec) {
+    (void)rec;
+    return 1;
+}
+
+static void sink_write_batch(const record_t* recs, int count) {
+    struct iovec lines[CP_BATCH_MAX];
+    int n = 0;
+    int end = 0;
+    for (int i = 0; i < count; ++i) {
+        if (record_is_end(&recs[i])) {
+            end = 1;
+            break;
+        }
+        lines[n].iov_base = recs[i].data;
+        lines[n++].iov_len = recs[i].len;
+    }
+    const char* err = line_batch_add(&g_batch, lines, n, end);
+    if (err) {
+        log_error(&g_ctx, err);
+    }
+}
+
+/* Non-negative number from the environment with an optional k/m/g suffix
+ * when bytes is set; def if unset. Returns -1 if malformed. */
+static int env_number(const char* name, long def, int bytes, long* out) {
+    const char* env = getenv(name);
+    *out = def;
+    if (!env || !*env) {
+        return 0;
+    }
+    char* end = NULL;
+    errno = 0;
+    long val = strtol(env, &end, 10);
+    if (errno != 0 || end == env || val < 0) {
+        return -1;
+    }
+    int shift = 0;
+    if (bytes) {
+        switch (*end) {
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+        default: break;
+        }
+    }
+    if (*end != '\0' || val > (LONG_MAX >> shift)) {
+        return -1;
+    }
+    *out = val << shift;
+    return 0;
+}
+
+static const char* start_writev(void) {
+    line_batch_config_t config;
+    long lines, bytes, vmsplice, report;
+    if (env_number("SINK_BATCH_LINES", 1024, 0, &lines) != 0 || lines < 1 || lines > INT_MAX) {
+        return "sink_stdout: invalid SINK_BATCH_LINES value";
+    }
+    if (env_number("SINK_BATCH_BYTES", 64L << 10, 1, &bytes) != 0 || bytes < 1 || bytes > (1L << 30)) {
+        return "sink_stdout: invalid SINK_BATCH_BYTES value";
+    }
+    if (env_number("SINK_IDLE_US", 1000, 0, &config.idle_us) != 0) {
+        return "sink_stdout: invalid SINK_IDLE_US value";
     }
-    fprintf(stdout, "%s\n", input);
+    if (env_number("SINK_MAX_DELAY_US", 10000, 0, &config.max_delay_us) != 0) {
+        return "sink_stdout: invalid SINK_MAX_DELAY_US value";
+    }
+    if (env_number("SINK_VMSPLICE", 0, 0, &vmsplice) != 0 || vmsplice > 1) {
+        return "sink_stdout: invalid SINK_VMSPLICE value";
+    }
+    if (env_number("PIPELINE_IO_STATS", 0, 0, &report) != 0 || report > 1) {
+        return "sink_stdout: invalid PIPELINE_IO_STATS value";
+    }
+    config.max_lines = (int)lines;
+    config.max_bytes = (size_t)bytes;
+    config.vmsplice = (int)vmsplice;
+    g_report = (int)report;
     fflush(stdout);
-    return NULL; /* consume the string, nothing to forward */
+    return line_batch_open(&g_batch, STDOUT_FILENO, &config);
+}
+
+static const char* start_uring(void) {
+    uring_writer_config_t config;
+    const char* err = uring_writer_config_from_env(&config);
+    if (err) {
+        return err;
+    }
+    config.owns_fd = 0;
+    g_report = config.report;
+    fflush(stdout);
+    return uring_writer_open(&g_out, STDOUT_FILENO, &config);
+}
+
+static const char* stop_output(void) {
+    const char* err = NULL;
+    char msg[160];
+    msg[0] = '\0';
+    if (g_mode == MODE_URING) {
+        err = uring_writer_close(&g_out);
+        uring_writer_format_stats(&g_out, msg, sizeof(msg));
+    } else if (g_mode == MODE_WRITEV) {
+        err = line_batch_close(&g_batch);
+        line_batch_format_stats(&g_batch, msg, sizeof(msg));
+    }
+    if (g_report && msg[0]) {
+        log_info(&g_ctx, msg);
+    }
+    g_mode = MODE_SYNC;
+    return err;
 }
 
 const char* plugin_get_name(void) { return "sink_stdout"; }
 
+static const char* init_stage(plugin_process_fn process, int queue_size,
+                              plugin_process_fn* inline_process) {
+    return inline_process ? common_plugin_init_inline(&g_ctx, process, "sink_stdout", inline_process)
+                          : common_plugin_init(&g_ctx, process, "sink_stdout", queue_size);
+}
+
+/* plugin_init, or plugin_init_inline when inline_process is set: sync and
+ * uring lines are written from whichever thread calls the process
+ * function, writev batches need the stage thread. */
+static const char* start(int queue_size, plugin_process_fn* inline_process) {
+    const char* mode = getenv("SINK_MODE");
+    const char* err = NULL;
+    g_mode = MODE_SYNC;
+    g_report = 0;
+    if (!mode || !*mode || strcmp(mode, "sync") == 0) {
+        return init_stage(sink_process, queue_size, inline_process);
+    } else if (strcmp(mode, "uring") == 0) {
+        err = start_uring();
+        if (!err) {
+            g_mode = MODE_URING;
+            err = init_stage(sink_process_uring, queue_size, inline_process);
+        }
+    } else if (strcmp(mode, "writev") == 0) {
+        if (inline_process) {
+            return "sink_stdout: writev batches on the stage thread";
+        }
+        err = start_writev();
+        if (!err) {
+            g_mode = MODE_WRITEV;
+            err = common_plugin_init(&g_ctx, sink_process_keep, "sink_stdout", queue_size);
+            if (!err) {
+                common_plugin_set_batch_function(&g_ctx, sink_write_batch);
+            }
+        }
+    } else {
+        return "sink_stdout: invalid SINK_MODE value";
+    }
+    if (err) {
+        g_report = 0;
+        (void)stop_output();
+    }
+    return err;
+}
+
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(&g_ctx, sink_process, "sink_stdout", queue_size);
+    return start(queue_size, NULL);
+}
+
+const char* plugin_init_inline(int (**process)(struct record* rec)) {
+    return start(0, process);
 }
 
 void plugin_attach(const char* (*next_place_work)(const char*)) {
@@ -26,15 +204,70 @@ void plugin_attach(const char* (*next_place_work)(const char*)) {
     common_plugin_attach(&g_ctx, NULL);
 }
 
+void plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int)) {
+    (void)next_place_work_batch;
+    common_plugin_attach_batch(&g_ctx, NULL);
+}
+
+void plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+                         const char* (*next_place_work_owned_batch)(char* const*, int)) {
+    (void)next_place_work_owned;
+    (void)next_place_work_owned_batch;
+    common_plugin_attach_owned(&g_ctx, NULL, NULL);
+}
+
 const char* plugin_place_work(const char* str) {
     return common_plugin_place_work(&g_ctx, str);
 }
 
+const char* plugin_place_work_batch(const char* const* strs, int count) {
+    return common_plugin_place_work_batch(&g_ctx, strs, count);
+}
+
+const char* plugin_place_work_owned(char* str) {
+    return common_plugin_place_work_owned(&g_ctx, str);
+}
+
+const char* plugin_place_work_owned_batch(char* const* strs, int count) {
+    return common_plugin_place_work_owned_batch(&g_ctx, strs, count);
+}
+
+void plugin_attach_records(const char* (*next_place_work_records)(const struct record*, int),
+                           const char* (*next_place_work_records_owned)(const struct record*, int)) {
+    common_plugin_attach_records(&g_ctx, next_place_work_records, next_place_work_records_owned);
+}
+
+const char* plugin_place_work_records(const struct record* recs, int count) {
+    return common_plugin_place_work_records(&g_ctx, recs, count);
+}
+
+const char* plugin_place_work_records_owned(const struct record* recs, int count) {
+    return common_plugin_place_work_records_owned(&g_ctx, recs, count);
+}
+
+void plugin_set_memory_budget(struct byte_budget* budget) {
+    common_plugin_set_memory_budget(&g_ctx, budget);
+}
+
+void plugin_set_allocator(struct slab* slab) {
+    common_plugin_set_allocator(&g_ctx, slab);
+}
+
+void plugin_set_executor(struct executor* ex) {
+    common_plugin_set_executor(&g_ctx, ex, 1);
+}
+
+/* Everything before <END> is written once this returns: the writev mode
+ * writes it out on seeing <END>. */
 const char* plugin_wait_finished(void) {
-    return common_plugin_wait_finished(&g_ctx);
+    const char* err = common_plugin_wait_finished(&g_ctx);
+    const char* werr = g_mode == MODE_URING ? uring_writer_drain(&g_out) : NULL;
+    return err ? err : werr;
 }
 
 const char* plugin_fini(void) {
-    return common_plugin_fini(&g_ctx);
+    const char* err = common_plugin_fini(&g_ctx);
+    const char* werr = stop_output();
+    return err ? err : werr;
 }
 
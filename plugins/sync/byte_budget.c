@@ -0,0 +1,81 @@
+#include "byte_budget.h"
+
+int byte_budget_init(byte_budget_t* budget, size_t limit) {
+    if (!budget) return -1;
+
+    budget->limit = limit;
+    atomic_init(&budget->used, 0);
+    atomic_init(&budget->peak, 0);
+    atomic_init(&budget->waiters, 0);
+    if (pthread_mutex_init(&budget->mutex, NULL) != 0) {
+        return -1;
+    }
+    if (pthread_cond_init(&budget->released, NULL) != 0) {
+        pthread_mutex_destroy(&budget->mutex);
+        return -1;
+    }
+    return 0;
+}
+
+void byte_budget_destroy(byte_budget_t* budget) {
+    if (!budget) return;
+    pthread_cond_destroy(&budget->released);
+    pthread_mutex_destroy(&budget->mutex);
+}
+
+static void note_peak(byte_budget_t* budget, size_t used) {
+    size_t peak = atomic_load_explicit(&budget->peak, memory_order_relaxed);
+    while (used > peak &&
+           !atomic_compare_exchange_weak_explicit(&budget->peak, &peak, used,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+int byte_budget_try_acquire(byte_budget_t* budget, size_t len, int idle) {
+    size_t used = atomic_load(&budget->used);
+    for (;;) {
+        if (budget->limit && !idle && used + len > budget->limit) {
+            return 0;
+        }
+        if (atomic_compare_exchange_weak(&budget->used, &used, used + len)) {
+            note_peak(budget, used + len);
+            return 1;
+        }
+    }
+}
+
+void byte_budget_acquire(byte_budget_t* budget, size_t len,
+                         int (*idle)(void*), void* arg) {
+    if (byte_budget_try_acquire(budget, len, idle && idle(arg))) {
+        return;
+    }
+
+    pthread_mutex_lock(&budget->mutex);
+    atomic_fetch_add(&budget->waiters, 1);
+    /* Registered before the re-check: a release that lands after it sees
+     * the waiter and broadcasts under the mutex, so it cannot be lost. */
+    while (!byte_budget_try_acquire(budget, len, idle && idle(arg))) {
+        pthread_cond_wait(&budget->released, &budget->mutex);
+    }
+    atomic_fetch_sub(&budget->waiters, 1);
+    pthread_mutex_unlock(&budget->mutex);
+}
+
+void byte_budget_release(byte_budget_t* budget, size_t len) {
+    if (len == 0) return;
+    atomic_fetch_sub(&budget->used, len);
+    if (atomic_load(&budget->waiters) > 0) {
+        pthread_mutex_lock(&budget->mutex);
+        pthread_cond_broadcast(&budget->released);
+        pthread_mutex_unlock(&budget->mutex);
+    }
+}
+
+size_t byte_budget_used(byte_budget_t* budget) {
+    return atomic_load_explicit(&budget->used, memory_order_relaxed);
+}
+
+size_t byte_budget_peak(byte_budget_t* budget) {
+    return atomic_load_explicit(&budget->peak, memory_order_relaxed);
+}
@@ -0,0 +1,51 @@
+#ifndef SYNC_BYTE_BUDGET_H
+#define SYNC_BYTE_BUDGET_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * Counting semaphore over bytes. Producers charge the size of what they
+ * enqueue and consumers release it once dequeued, so `used` is the number
+ * of bytes sitting in the queues that share the budget.
+ *
+ * Charging is a CAS on `used`; only a charge that does not fit takes the
+ * mutex and sleeps. A release broadcasts, because waiters ask for different
+ * amounts and a budget may be shared by every stage of a pipeline.
+ *
+ * A charge is always admitted when the caller says its target is idle
+ * (holds nothing). That bounds each queue to one oversized item and keeps a
+ * pipeline-wide budget from deadlocking with every queue full and every
+ * stage blocked forwarding: the stage feeding an empty queue always moves.
+ */
+typedef struct byte_budget {
+    size_t limit;               /* bytes allowed in flight, 0 = unlimited */
+    atomic_size_t used;         /* bytes currently charged */
+    atomic_size_t peak;         /* high-water mark of used */
+    atomic_int waiters;         /* threads sleeping in byte_budget_acquire */
+    pthread_mutex_t mutex;      /* pairs with released */
+    pthread_cond_t released;    /* broadcast when bytes are released */
+} byte_budget_t;
+
+/* Returns 0 on success, -1 on failure. */
+int    byte_budget_init(byte_budget_t* budget, size_t limit);
+void   byte_budget_destroy(byte_budget_t* budget);
+
+/* Charge len bytes without blocking. Returns 1 if charged, 0 if not. */
+int    byte_budget_try_acquire(byte_budget_t* budget, size_t len, int idle);
+
+/*
+ * Charge len bytes, sleeping until they fit. idle(arg) is re-evaluated on
+ * every wakeup; when it returns nonzero the charge goes through regardless.
+ */
+void   byte_budget_acquire(byte_budget_t* budget, size_t len,
+                           int (*idle)(void*), void* arg);
+
+/* Return len bytes and wake any waiters. */
+void   byte_budget_release(byte_budget_t* budget, size_t len);
+
+size_t byte_budget_used(byte_budget_t* budget);
+size_t byte_budget_peak(byte_budget_t* budget);
+
+#endif // SYNC_BYTE_BUDGET_H
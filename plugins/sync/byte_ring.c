@@ -0,0 +1,276 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "byte_ring.h"
+
+#define BYTE_RING_ALIGN 8
+#define BYTE_RING_MIN   64
+
+static size_t align_up(size_t n) {
+    return (n + BYTE_RING_ALIGN - 1) & ~(size_t)(BYTE_RING_ALIGN - 1);
+}
+
+/* Bytes a record of payload length len takes in the ring. */
+static size_t record_size(const byte_ring_hdr_t* hdr) {
+    if (hdr->flags & BYTE_RING_HEAP) return align_up(sizeof(*hdr) + sizeof(char*) + sizeof(size_t));
+    if (hdr->flags & BYTE_RING_END) return sizeof(*hdr);
+    return align_up(sizeof(*hdr) + (size_t)hdr->len + 1);
+}
+
+static byte_ring_hdr_t* header_at(byte_ring_t* ring, size_t pos) {
+    return (byte_ring_hdr_t*)(ring->buf + pos % ring->capacity);
+}
+
+int byte_ring_init(byte_ring_t* ring, size_t capacity) {
+    if (!ring || capacity == 0) return -1;
+
+    capacity = align_up(capacity < BYTE_RING_MIN ? BYTE_RING_MIN : capacity);
+    ring->buf = (unsigned char*)aligned_alloc(SPSC_CACHE_LINE,
+                                              (capacity + SPSC_CACHE_LINE - 1) &
+                                                  ~(size_t)(SPSC_CACHE_LINE - 1));
+    if (!ring->buf) return -1;
+    ring->capacity = capacity;
+    ring->read_pos = 0;
+    ring->cached_tail = 0;
+    ring->cached_head = 0;
+    ring->need = 0;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->closed, 0);
+    atomic_init(&ring->consumer_parked, 0);
+    atomic_init(&ring->producer_parked, 0);
+    ring->policy.spin_iters = SPSC_DEFAULT_SPIN;
+    ring->policy.yield_iters = 0;
+    wait_stats_init(&ring->consumer_waits);
+    wait_stats_init(&ring->producer_waits);
+
+    if (monitor_init(&ring->not_empty) != 0) {
+        free(ring->buf);
+        ring->buf = NULL;
+        return -1;
+    }
+    if (monitor_init(&ring->not_full) != 0) {
+        monitor_destroy(&ring->not_empty);
+        free(ring->buf);
+        ring->buf = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void byte_ring_destroy(byte_ring_t* ring) {
+    if (!ring || !ring->buf) return;
+
+    /* Heap records still queued (acquired or not) own their copies. */
+    size_t pos = atomic_load(&ring->head);
+    size_t tail = atomic_load(&ring->tail);
+    while (pos != tail) {
+        byte_ring_hdr_t* hdr = header_at(ring, pos);
+        if (hdr->flags & BYTE_RING_WRAP) {
+            pos += ring->capacity - pos % ring->capacity;
+            continue;
+        }
+        if (hdr->flags & BYTE_RING_HEAP) {
+            char* copy;
+            memcpy(&copy, hdr + 1, sizeof(copy));
+            free(copy);
+        }
+        pos += record_size(hdr);
+    }
+
+    monitor_destroy(&ring->not_full);
+    monitor_destroy(&ring->not_empty);
+    free(ring->buf);
+    ring->buf = NULL;
+}
+
+static int producer_ready(void* arg) {
+    byte_ring_t* ring = (byte_ring_t*)arg;
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return ring->capacity - (tail - head) >= ring->need;
+}
+
+/* Producer: wait until ring->need bytes are free behind tail. */
+static void wait_for_room(byte_ring_t* ring, size_t tail) {
+    int waited = 0;
+    wait_phase_t phase = WAIT_PHASE_SPIN;
+
+    while (ring->capacity - (tail - ring->cached_head) < ring->need) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (ring->capacity - (tail - ring->cached_head) >= ring->need) break;
+        if (!waited) {
+            waited = 1;
+            phase = wait_policy_poll(&ring->policy, producer_ready, ring);
+            continue;
+        }
+        phase = WAIT_PHASE_PARK;
+        atomic_store(&ring->producer_parked, 1);
+        ring->cached_head = atomic_load(&ring->head);
+        if (ring->capacity - (tail - ring->cached_head) < ring->need) {
+            (void)monitor_wait(&ring->not_full);
+        }
+        atomic_store_explicit(&ring->producer_parked, 0, memory_order_relaxed);
+    }
+    if (waited) {
+        wait_stats_record(&ring->producer_waits, phase);
+    }
+}
+
+int byte_ring_push(byte_ring_t* ring, const char* data, size_t len, unsigned flags) {
+    byte_ring_hdr_t hdr;
+    char* copy = NULL;
+
+    hdr.flags = flags & BYTE_RING_END;
+    hdr.len = 0;
+    if (!hdr.flags) {
+        /* Inline only what is guaranteed to fit after a wrap. */
+        if (len > UINT32_MAX ||
+            align_up(sizeof(hdr) + len + 1) > ring->capacity / 2) {
+            copy = (char*)malloc(len + 1);
+            if (!copy) return -1;
+            memcpy(copy, data, len);
+            copy[len] = '\0';
+            hdr.flags = BYTE_RING_HEAP;
+        } else {
+            hdr.len = (uint32_t)len;
+        }
+    }
+
+    size_t size = record_size(&hdr);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t room_to_end = ring->capacity - tail % ring->capacity;
+    ring->need = size <= room_to_end ? size : room_to_end + size;
+    wait_for_room(ring, tail);
+
+    if (size > room_to_end) {
+        byte_ring_hdr_t* wrap = header_at(ring, tail);
+        wrap->len = 0;
+        wrap->flags = BYTE_RING_WRAP;
+        tail += room_to_end;
+    }
+
+    byte_ring_hdr_t* slot = header_at(ring, tail);
+    *slot = hdr;
+    if (hdr.flags & BYTE_RING_HEAP) {
+        /* the length too: the payload may contain NULs */
+        memcpy(slot + 1, &copy, sizeof(copy));
+        memcpy((char*)(slot + 1) + sizeof(copy), &len, sizeof(len));
+    } else if (!(hdr.flags & BYTE_RING_END)) {
+        char* payload = (char*)(slot + 1);
+        memcpy(payload, data, len);
+        payload[len] = '\0';
+    }
+
+    atomic_store(&ring->tail, tail + size);
+    if (atomic_load(&ring->consumer_parked)) {
+        monitor_signal(&ring->not_empty);
+    }
+    return 0;
+}
+
+void byte_ring_close(byte_ring_t* ring) {
+    atomic_store(&ring->closed, 1);
+    if (atomic_load(&ring->consumer_parked)) {
+        monitor_signal(&ring->not_empty);
+    }
+}
+
+int byte_ring_is_closed(byte_ring_t* ring) {
+    return atomic_load_explicit(&ring->closed, memory_order_acquire);
+}
+
+static int consumer_ready(void* arg) {
+    byte_ring_t* ring = (byte_ring_t*)arg;
+    return atomic_load_explicit(&ring->tail, memory_order_acquire) != ring->read_pos ||
+           atomic_load_explicit(&ring->closed, memory_order_acquire);
+}
+
+/* Consumer: wait until bytes past read_pos are published. Returns 0 once
+ * the ring is drained and closed. */
+static int wait_readable(byte_ring_t* ring) {
+    int waited = 0;
+    wait_phase_t phase = WAIT_PHASE_SPIN;
+    size_t pos = ring->read_pos;
+
+    while (pos == ring->cached_tail) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (pos != ring->cached_tail) break;
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+            ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            break;
+        }
+        if (!waited) {
+            waited = 1;
+            phase = wait_policy_poll(&ring->policy, consumer_ready, ring);
+            continue;
+        }
+        phase = WAIT_PHASE_PARK;
+        atomic_store(&ring->consumer_parked, 1);
+        ring->cached_tail = atomic_load(&ring->tail);
+        if (pos == ring->cached_tail && !atomic_load(&ring->closed)) {
+            (void)monitor_wait(&ring->not_empty);
+        }
+        atomic_store_explicit(&ring->consumer_parked, 0, memory_order_relaxed);
+    }
+    if (waited) {
+        wait_stats_record(&ring->consumer_waits, phase);
+    }
+    return pos != ring->cached_tail;
+}
+
+size_t byte_ring_acquire(byte_ring_t* ring, byte_ring_view_t* out, size_t max) {
+    size_t n = 0;
+    if (max == 0) return 0;
+
+    /* A trailing WRAP can be all that is readable; wait again after it. */
+    while (n == 0 && wait_readable(ring)) {
+        size_t pos = ring->read_pos;
+        while (n < max && pos != ring->cached_tail) {
+            byte_ring_hdr_t* hdr = header_at(ring, pos);
+            if (hdr->flags & BYTE_RING_WRAP) {
+                pos += ring->capacity - pos % ring->capacity;
+                continue;
+            }
+            out[n].flags = hdr->flags & BYTE_RING_END;
+            if (hdr->flags & BYTE_RING_END) {
+                out[n].data = NULL;
+                out[n].len = 0;
+            } else if (hdr->flags & BYTE_RING_HEAP) {
+                memcpy(&out[n].data, hdr + 1, sizeof(out[n].data));
+                memcpy(&out[n].len, (char*)(hdr + 1) + sizeof(out[n].data), sizeof(out[n].len));
+            } else {
+                out[n].data = (char*)(hdr + 1);
+                out[n].len = hdr->len;
+            }
+            pos += record_size(hdr);
+            if (out[n++].flags & BYTE_RING_END) break;
+        }
+        ring->read_pos = pos;
+        if (n > 0 && (out[n - 1].flags & BYTE_RING_END)) break;
+    }
+    return n;
+}
+
+void byte_ring_release(byte_ring_t* ring) {
+    size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    while (pos != ring->read_pos) {
+        byte_ring_hdr_t* hdr = header_at(ring, pos);
+        if (hdr->flags & BYTE_RING_WRAP) {
+            pos += ring->capacity - pos % ring->capacity;
+            continue;
+        }
+        if (hdr->flags & BYTE_RING_HEAP) {
+            char* copy;
+            memcpy(&copy, hdr + 1, sizeof(copy));
+            free(copy);
+        }
+        pos += record_size(hdr);
+    }
+
+    atomic_store(&ring->head, pos);
+    if (atomic_load(&ring->producer_parked)) {
+        monitor_signal(&ring->not_full);
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef SYNC_BYTE_RING_H
+#define SYNC_BYTE_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "monitor.h"
+#include "spsc_ring.h"
+#include "wait_policy.h"
+
+/*
+ * Single-producer/single-consumer ring of length-prefixed records stored
+ * inline in one contiguous buffer whose capacity is counted in bytes.
+ *
+ * Every record is an 8-byte header followed by its payload and a NUL, padded
+ * to 8 bytes, so a payload is always contiguous and usable as a C string.
+ * When a record does not fit before the end of the buffer the producer
+ * writes a WRAP header and continues at offset 0. Records larger than half
+ * the ring are kept on the heap and the ring stores the pointer and length.
+ *
+ * The consumer borrows records in place with byte_ring_acquire() (they may be
+ * modified) and hands the space back with byte_ring_release(). Indices and
+ * parking follow spsc_ring_t.
+ */
+
+#define BYTE_RING_WRAP 0x1u   /* skip to the start of the buffer */
+#define BYTE_RING_END  0x2u   /* end-of-stream record, no payload */
+#define BYTE_RING_HEAP 0x4u   /* payload is a char* to a heap copy, then its size_t length */
+
+typedef struct {
+    uint32_t len;             /* payload bytes, excluding the NUL */
+    uint32_t flags;           /* BYTE_RING_* */
+} byte_ring_hdr_t;
+
+typedef struct {
+    char* data;               /* NUL-terminated payload, NULL for END */
+    size_t len;
+    unsigned flags;           /* BYTE_RING_END or 0 */
+} byte_ring_view_t;
+
+typedef struct {
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t head;  /* released by the consumer */
+    size_t read_pos;                               /* end of acquired records */
+    size_t cached_tail;                            /* consumer's view of tail */
+    atomic_int consumer_parked;
+
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t tail;  /* published by the producer */
+    size_t cached_head;                            /* producer's view of head */
+    size_t need;                                   /* bytes the producer waits for */
+    atomic_int producer_parked;
+
+    _Alignas(SPSC_CACHE_LINE) unsigned char* buf;
+    size_t capacity;                               /* bytes, multiple of 8 */
+    atomic_int closed;
+    monitor_t not_empty;
+    monitor_t not_full;
+    wait_policy_t policy;
+    wait_stats_t consumer_waits;
+    wait_stats_t producer_waits;
+} byte_ring_t;
+
+/* capacity is rounded up to a multiple of 8 (minimum 64). 0 on success. */
+int    byte_ring_init(byte_ring_t* ring, size_t capacity);
+
+/* Frees the buffer and any heap records still queued. */
+void   byte_ring_destroy(byte_ring_t* ring);
+
+/*
+ * Producer side. Copy len bytes into the ring, blocking until there is room.
+ * flags may be BYTE_RING_END (data ignored). Returns 0, or -1 if a heap copy
+ * for an oversized record could not be allocated.
+ */
+int    byte_ring_push(byte_ring_t* ring, const char* data, size_t len, unsigned flags);
+
+/* Producer side. Marks the ring closed. */
+void   byte_ring_close(byte_ring_t* ring);
+int    byte_ring_is_closed(byte_ring_t* ring);
+
+/*
+ * Consumer side. Block until at least one record is readable, then borrow
+ * up to max of them (stopping after an END record). Views stay valid until
+ * byte_ring_release(). Returns the count, or 0 once empty and closed.
+ */
+size_t byte_ring_acquire(byte_ring_t* ring, byte_ring_view_t* out, size_t max);
+
+/* Consumer side. Return the space of every record acquired so far. */
+void   byte_ring_release(byte_ring_t* ring);
+
+#endif // SYNC_BYTE_RING_H
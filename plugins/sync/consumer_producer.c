@@ -1,36 +1,90 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L /* nanosleep */
+#endif
 #include <errno.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "consumer_producer.h"
 
-#define END_TOKEN "<END>"
+/* get_records on CP_QUEUE_BYTES retries a failed copy-out this often, and
+ * gives up on the rest of the batch after CP_ALLOC_RETRIES attempts. */
+#define CP_ALLOC_RETRY_NS (1000 * 1000)
+#define CP_ALLOC_RETRIES  1000
 
-static int is_end_token(const char* item) {
-    return item && strcmp(item, END_TOKEN) == 0;
+int consumer_producer_kind_parse(const char* name, consumer_producer_kind_t* kind) {
+    if (!name || !kind) {
+        return -1;
+    }
+    if (strcmp(name, "locked") == 0) {
+        *kind = CP_QUEUE_LOCKED;
+        return 0;
+    }
+    if (strcmp(name, "spsc") == 0) {
+        *kind = CP_QUEUE_SPSC;
+        return 0;
+    }
+    if (strcmp(name, "bytes") == 0) {
+        *kind = CP_QUEUE_BYTES;
+        return 0;
+    }
+    return -1;
 }
 
-static char* dup_if_needed(const char* item, int* is_end) {
-    *is_end = is_end_token(item);
-    if (*is_end) {
-        return (char*)END_TOKEN;
+static const char* init_spsc(consumer_producer_t* q, int capacity) {
+    q->capacity = capacity;
+    if (spsc_ring_init(&q->spsc, (size_t)capacity) != 0) {
+        return "consumer_producer_init: out of memory";
     }
-    size_t len = strlen(item);
-    char* copy = (char*)malloc(len + 1);
-    if (!copy) {
-        return NULL;
+    if (monitor_init(&q->finished_monitor) != 0) {
+        spsc_ring_destroy(&q->spsc);
+        return "consumer_producer_init: monitor init failed";
     }
-    memcpy(copy, item, len + 1);
-    return copy;
+    return NULL;
+}
+
+static const char* init_bytes(consumer_producer_t* q, int capacity) {
+    q->capacity = capacity;
+    if (byte_ring_init(&q->bytes, (size_t)capacity) != 0) {
+        return "consumer_producer_init: out of memory";
+    }
+    if (monitor_init(&q->finished_monitor) != 0) {
+        byte_ring_destroy(&q->bytes);
+        return "consumer_producer_init: monitor init failed";
+    }
+    return NULL;
 }
 
 const char* consumer_producer_init(consumer_producer_t* q, int capacity) {
+    return consumer_producer_init_kind(q, capacity, CP_QUEUE_LOCKED);
+}
+
+const char* consumer_producer_init_kind(consumer_producer_t* q, int capacity,
+                                        consumer_producer_kind_t kind) {
     if (!q || capacity <= 0) {
         return "consumer_producer_init: invalid arguments";
     }
 
-    q->items = (char**)calloc((size_t)capacity, sizeof(char*));
+    q->kind = kind;
+    q->items = NULL;
+    q->budget = NULL;
+    q->shared_budget = NULL;
+    q->spills = 0;
+    q->slab = NULL;
+    q->takes = 0;
+    q->error = NULL;
+    q->executor = NULL;
+    q->task = NULL;
+    if (kind == CP_QUEUE_SPSC) {
+        return init_spsc(q, capacity);
+    }
+    if (kind == CP_QUEUE_BYTES) {
+        return init_bytes(q, capacity);
+    }
+
+    q->items = (record_t*)calloc((size_t)capacity, sizeof(record_t));
     if (!q->items) {
         return "consumer_producer_init: out of memory";
     }
@@ -38,7 +92,14 @@ const char* consumer_producer_init(consumer_producer_t* q, int capacity) {
     q->count = 0;
     q->head = 0;
     q->tail = 0;
-    q->closed = 0;
+    atomic_init(&q->closed, 0);
+    atomic_init(&q->level, 0);
+    q->waiting_consumers = 0;
+    q->waiting_producers = 0;
+    q->wait_policy.spin_iters = 0;
+    q->wait_policy.yield_iters = 0;
+    wait_stats_init(&q->consumer_waits);
+    wait_stats_init(&q->producer_waits);
 
     if (pthread_mutex_init(&q->mutex, NULL) != 0) {
         free(q->items);
@@ -70,102 +131,823 @@ const char* consumer_producer_init(consumer_producer_t* q, int capacity) {
     return NULL;
 }
 
+static void uncharge_items(consumer_producer_t* q, const record_t* items, int n);
+
+/* Drop an item still queued at destroy time, returning its charge. */
+static void drop_pending(consumer_producer_t* q, const record_t* item) {
+    if (!record_is_end(item)) {
+        uncharge_items(q, item, 1);
+        slab_free(q->slab, item->data);
+    }
+}
+
 void consumer_producer_destroy(consumer_producer_t* q) {
     if (!q) {
         return;
     }
 
-    if (q->items) {
-        for (int i = 0; i < q->capacity; ++i) {
-            char* item = q->items[i];
-            if (item && !is_end_token(item)) {
-                free(item);
+    if (q->kind == CP_QUEUE_SPSC) {
+        record_t item;
+        while (spsc_ring_try_pop(&q->spsc, &item)) {
+            drop_pending(q, &item);
+        }
+        spsc_ring_destroy(&q->spsc);
+    } else if (q->kind == CP_QUEUE_BYTES) {
+        byte_ring_destroy(&q->bytes);
+    } else {
+        if (q->items) {
+            for (int i = 0; i < q->count; ++i) {
+                drop_pending(q, &q->items[(q->head + i) % q->capacity]);
             }
+            free(q->items);
+            q->items = NULL;
         }
-        free(q->items);
-        q->items = NULL;
+        if (q->spills) {
+            spill_close(&q->spill);
+            q->spills = 0;
+        }
+        monitor_destroy(&q->not_empty_monitor);
+        monitor_destroy(&q->not_full_monitor);
+        pthread_mutex_destroy(&q->mutex);
     }
 
     monitor_destroy(&q->finished_monitor);
-    monitor_destroy(&q->not_empty_monitor);
-    monitor_destroy(&q->not_full_monitor);
-    pthread_mutex_destroy(&q->mutex);
+    if (q->budget) {
+        byte_budget_destroy(q->budget);
+        q->budget = NULL;
+    }
+    q->shared_budget = NULL;
 }
 
-const char* consumer_producer_put(consumer_producer_t* q, const char* item) {
-    if (!q || !item) {
-        return "consumer_producer_put: invalid arguments";
+const char* consumer_producer_set_byte_budget(consumer_producer_t* q, size_t bytes) {
+    if (!q) {
+        return "consumer_producer_set_byte_budget: invalid arguments";
+    }
+    if (q->kind == CP_QUEUE_BYTES || q->budget || bytes == 0) {
+        return NULL; /* a byte ring is sized in bytes already */
     }
+    if (byte_budget_init(&q->own_budget, bytes) != 0) {
+        return "consumer_producer_set_byte_budget: init failed";
+    }
+    q->budget = &q->own_budget;
+    return NULL;
+}
 
-    int is_end = 0;
-    char* copy = dup_if_needed(item, &is_end);
-    if (!copy && !is_end) {
-        return "consumer_producer_put: out of memory";
+void consumer_producer_set_shared_budget(consumer_producer_t* q, byte_budget_t* budget) {
+    if (!q || q->kind == CP_QUEUE_BYTES) {
+        return;
     }
+    q->shared_budget = budget;
+}
 
+const char* consumer_producer_enable_spill(consumer_producer_t* q, const char* dir) {
+    if (!q || !dir || !*dir) {
+        return "consumer_producer_enable_spill: invalid arguments";
+    }
+    if (q->kind != CP_QUEUE_LOCKED) {
+        return "consumer_producer_enable_spill: spilling needs the locked queue";
+    }
+    if (q->spills) {
+        return NULL;
+    }
+    if (spill_open(&q->spill, dir) != 0) {
+        return "consumer_producer_enable_spill: cannot create spill file";
+    }
+    q->spills = 1;
+    return NULL;
+}
+
+void consumer_producer_set_allocator(consumer_producer_t* q, slab_t* slab) {
+    if (q) {
+        q->slab = slab;
+    }
+}
+
+void consumer_producer_set_executor(consumer_producer_t* q, executor_t* ex, executor_task_t* task) {
+    if (q) {
+        q->executor = ex;
+        q->task = task;
+    }
+}
+
+unsigned long consumer_producer_spilled(consumer_producer_t* q) {
+    if (!q || !q->spills) {
+        return 0;
+    }
     pthread_mutex_lock(&q->mutex);
+    unsigned long n = q->spill.spilled;
+    pthread_mutex_unlock(&q->mutex);
+    return n;
+}
 
-    if (q->closed && !is_end) {
-        pthread_mutex_unlock(&q->mutex);
-        if (!is_end && copy) {
-            free(copy);
-        }
-        return "consumer_producer_put: queue closed";
+const char* consumer_producer_error(consumer_producer_t* q) {
+    if (!q || q->kind == CP_QUEUE_SPSC) {
+        return NULL;
+    }
+    if (q->kind == CP_QUEUE_BYTES) {
+        return q->error; /* only its one consumer sets it */
     }
+    pthread_mutex_lock(&q->mutex);
+    const char* err = q->error;
+    pthread_mutex_unlock(&q->mutex);
+    return err;
+}
 
-    while (!q->closed && q->count == q->capacity) {
-        pthread_mutex_unlock(&q->mutex);
-        (void)monitor_wait(&q->not_full_monitor);
-        pthread_mutex_lock(&q->mutex);
+/* Items waiting in the ring and, in spill mode, on disk. Mutex held. */
+static int queued(const consumer_producer_t* q) {
+    return q->count + (q->spills ? (int)q->spill.records : 0);
+}
+
+/* Lock-free readiness checks used while spinning; re-checked under the mutex. */
+static int producer_ready(void* arg) {
+    consumer_producer_t* q = (consumer_producer_t*)arg;
+    return atomic_load_explicit(&q->level, memory_order_acquire) < q->capacity ||
+           atomic_load_explicit(&q->closed, memory_order_acquire);
+}
+
+static int consumer_ready(void* arg) {
+    consumer_producer_t* q = (consumer_producer_t*)arg;
+    return atomic_load_explicit(&q->level, memory_order_acquire) > 0 ||
+           atomic_load_explicit(&q->closed, memory_order_acquire);
+}
+
+/*
+ * Called with q->mutex held. Waits for a free slot and stores copy.
+ * Returns 1 if stored, 0 if a repeated <END> was dropped, -1 if closed.
+ */
+static int charged(const consumer_producer_t* q);
+static int charge(consumer_producer_t* q, size_t len, int wait);
+static void charge_anyway(consumer_producer_t* q, size_t len);
+
+/* Ring full, or spilled items still ahead of anything new. */
+static int ring_blocked(const consumer_producer_t* q) {
+    return q->count == q->capacity || (q->spills && q->spill.records > 0);
+}
+
+/*
+ * Spill mode, called with q->mutex held. Stores copy in the spill file
+ * unless it can go into the ring without waiting. Returns 1 if spilled.
+ * A ring item is charged here, as put_items leaves that to us.
+ */
+static int spill_locked(consumer_producer_t* q, const record_t* copy) {
+    int is_end = record_is_end(copy);
+    if (!ring_blocked(q) && (is_end || !charged(q) || charge(q, copy->len + 1, 0))) {
+        return 0;
     }
+    if (spill_append(&q->spill, copy->data, copy->len, is_end) != 0) {
+        /* cannot spill: wait for the ring instead, over budget if need be */
+        if (!is_end) {
+            charge_anyway(q, copy->len + 1);
+        }
+        return 0;
+    }
+    if (is_end) {
+        q->closed = 1;
+    } else {
+        slab_free(q->slab, copy->data);
+    }
+    atomic_store_explicit(&q->level, queued(q), memory_order_release);
+    return 1;
+}
 
-    if (q->closed && !is_end) {
-        pthread_mutex_unlock(&q->mutex);
-        if (!is_end && copy) {
-            free(copy);
+static int store_locked(consumer_producer_t* q, const record_t* copy) {
+    int is_end = record_is_end(copy);
+    if (q->spills && !q->closed && spill_locked(q, copy)) {
+        return 1;
+    }
+    if (!q->closed && ring_blocked(q)) {
+        wait_phase_t phase = WAIT_PHASE_PARK;
+        if (wait_policy_polls(&q->wait_policy)) {
+            pthread_mutex_unlock(&q->mutex);
+            phase = wait_policy_poll(&q->wait_policy, producer_ready, q);
+            pthread_mutex_lock(&q->mutex);
+        }
+        while (!q->closed && ring_blocked(q)) {
+            phase = WAIT_PHASE_PARK;
+            if (executor_in_worker(q->executor)) {
+                /* the consumer may need this very thread to make room */
+                pthread_mutex_unlock(&q->mutex);
+                executor_help(q->executor);
+                pthread_mutex_lock(&q->mutex);
+                continue;
+            }
+            q->waiting_producers++;
+            pthread_mutex_unlock(&q->mutex);
+            (void)monitor_wait(&q->not_full_monitor);
+            pthread_mutex_lock(&q->mutex);
+            q->waiting_producers--;
         }
-        return "consumer_producer_put: queue closed";
+        wait_stats_record(&q->producer_waits, phase);
+    }
+    if (q->closed) {
+        return is_end ? 0 : -1;
     }
 
-    q->items[q->tail] = copy;
+    q->items[q->tail] = *copy;
     q->tail = (q->tail + 1) % q->capacity;
     q->count++;
+    atomic_store_explicit(&q->level, queued(q), memory_order_release);
     if (is_end) {
         q->closed = 1;
     }
+    return 1;
+}
+
+static void free_copies(consumer_producer_t* q, const record_t* copies, int n) {
+    for (int i = 0; i < n; ++i) {
+        if (!record_is_end(&copies[i])) {
+            slab_free(q->slab, copies[i].data);
+        }
+    }
+}
 
+static int charged(const consumer_producer_t* q) {
+    return q->budget || q->shared_budget;
+}
+
+/* Nothing queued: a charge for this queue is admitted over budget. */
+static int queue_idle(void* arg) {
+    consumer_producer_t* q = (consumer_producer_t*)arg;
+    if (q->kind == CP_QUEUE_SPSC) {
+        return atomic_load(&q->spsc.tail) == atomic_load(&q->spsc.head);
+    }
+    return atomic_load(&q->level) == 0;
+}
+
+/* Charge len bytes to the queue and pipeline budgets. Without wait, gives
+ * up and returns 0 where it would block. */
+static int charge(consumer_producer_t* q, size_t len, int wait) {
+    if (wait && executor_in_worker(q->executor)) {
+        /* as in store_locked: run the stages that release the bytes */
+        while (!charge(q, len, 0)) {
+            if (queue_idle(q)) {
+                charge_anyway(q, len);
+                break;
+            }
+            executor_help(q->executor);
+        }
+        return 1;
+    }
+    if (q->budget) {
+        if (wait) {
+            byte_budget_acquire(q->budget, len, queue_idle, q);
+        } else if (!byte_budget_try_acquire(q->budget, len, 0)) {
+            return 0;
+        }
+    }
+    if (q->shared_budget) {
+        if (wait) {
+            byte_budget_acquire(q->shared_budget, len, queue_idle, q);
+        } else if (!byte_budget_try_acquire(q->shared_budget, len, 0)) {
+            if (q->budget) {
+                byte_budget_release(q->budget, len);
+            }
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Charge even if over budget (the item is stored regardless). */
+static void charge_anyway(consumer_producer_t* q, size_t len) {
+    if (q->budget) {
+        (void)byte_budget_try_acquire(q->budget, len, 1);
+    }
+    if (q->shared_budget) {
+        (void)byte_budget_try_acquire(q->shared_budget, len, 1);
+    }
+}
+
+static void uncharge(consumer_producer_t* q, size_t len) {
+    if (q->budget) {
+        byte_budget_release(q->budget, len);
+    }
+    if (q->shared_budget) {
+        byte_budget_release(q->shared_budget, len);
+    }
+}
+
+/* Release the charge for items that left the queue. */
+static void uncharge_items(consumer_producer_t* q, const record_t* items, int n) {
+    if (!charged(q)) {
+        return;
+    }
+    size_t total = 0;
+    for (int i = 0; i < n; ++i) {
+        if (!record_is_end(&items[i])) {
+            total += items[i].len + 1;
+        }
+    }
+    uncharge(q, total);
+}
+
+/* Drop charged copies that never made it into the queue. */
+static void discard_copies(consumer_producer_t* q, const record_t* copies, int n) {
+    uncharge_items(q, copies, n);
+    free_copies(q, copies, n);
+}
+
+/* After storing into a locked queue: wake a parked consumer or schedule
+ * the consumer task. */
+static void announce(consumer_producer_t* q, int wake, int stored) {
+    if (wake) {
+        monitor_signal(&q->not_empty_monitor);
+    }
+    if (stored > 0 && q->task) {
+        executor_notify(q->task);
+    }
+}
+
+/* Enqueue n owned copies; only the last one may be <END>. */
+static const char* enqueue_copies(consumer_producer_t* q, const record_t* copies, int n, int ends) {
+    if (q->kind == CP_QUEUE_SPSC) {
+        if (spsc_ring_is_closed(&q->spsc)) {
+            discard_copies(q, copies, n);
+            /* a repeated <END> on its own is harmless */
+            return n == 1 && ends ? NULL : "consumer_producer_put: queue closed";
+        }
+        spsc_ring_push_batch(&q->spsc, copies, (size_t)n);
+        if (ends) {
+            spsc_ring_close(&q->spsc);
+        }
+        return NULL;
+    }
+
+    /* Consumers register in waiting_consumers under the mutex before they
+     * park, so a producer only pays for a wakeup when someone sleeps. */
+    int stored = 0;
+    int wake = 0;
+    pthread_mutex_lock(&q->mutex);
+    for (int i = 0; i < n; ++i) {
+        if (stored > 0 && !q->spills && q->count == q->capacity) {
+            /* let the consumer drain what we added before we block */
+            wake = q->waiting_consumers > 0;
+            pthread_mutex_unlock(&q->mutex);
+            announce(q, wake, stored);
+            stored = 0;
+            pthread_mutex_lock(&q->mutex);
+        }
+        int rc = store_locked(q, &copies[i]);
+        if (rc < 0) {
+            wake = stored > 0 && q->waiting_consumers > 0;
+            pthread_mutex_unlock(&q->mutex);
+            discard_copies(q, copies + i, n - i);
+            announce(q, wake, stored);
+            return "consumer_producer_put: queue closed";
+        }
+        stored += rc;
+    }
+    wake = stored > 0 && q->waiting_consumers > 0;
     pthread_mutex_unlock(&q->mutex);
-    monitor_signal(&q->not_empty_monitor);
+    announce(q, wake, stored);
     return NULL;
 }
 
-char* consumer_producer_get(consumer_producer_t* q) {
-    if (!q) {
-        return NULL;
+/* CP_QUEUE_BYTES: copy straight into the ring, no per-item allocation. */
+static const char* push_bytes(consumer_producer_t* q, const record_t* items, int count) {
+    for (int i = 0; i < count; ++i) {
+        int is_end = record_is_end(&items[i]);
+        if (!is_end && !items[i].data) {
+            return "consumer_producer_put: invalid arguments";
+        }
+        if (byte_ring_is_closed(&q->bytes)) {
+            /* a repeated <END> on its own is harmless */
+            return count == 1 && is_end ? NULL : "consumer_producer_put: queue closed";
+        }
+        if (is_end) {
+            (void)byte_ring_push(&q->bytes, NULL, 0, BYTE_RING_END);
+            byte_ring_close(&q->bytes);
+        } else if (byte_ring_push(&q->bytes, items[i].data, items[i].len, 0) != 0) {
+            return "consumer_producer_put: out of memory";
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Enqueue for the item kinds, CP_BATCH_MAX at a time. With owned set the
+ * items are buffers from q->slab that are queued as-is (and freed on
+ * failure); otherwise each is copied. Under a byte budget a run is flushed
+ * as soon as the next item does not fit, and the producer then waits for room.
+ */
+static const char* put_items(consumer_producer_t* q, const record_t* items, int count, int owned) {
+    record_t batch[CP_BATCH_MAX];
+    int done = 0;
+    while (done < count) {
+        int n = 0;
+        int ends = 0;
+        const char* err = NULL;
+        while (n < CP_BATCH_MAX && done + n < count && !ends) {
+            const record_t* item = &items[done + n];
+            ends = record_is_end(item);
+            if (ends) {
+                batch[n++] = record_end();
+                break;
+            }
+            if (!item->data) {
+                err = "consumer_producer_put: invalid arguments";
+                break;
+            }
+            size_t len = item->len + 1;
+            /* spill mode charges in store_locked, where it picks ring or disk */
+            if (charged(q) && !q->spills && !charge(q, len, n == 0)) {
+                break;
+            }
+            record_t copy = *item;
+            copy.flags = 0;
+            if (!owned) {
+                copy.data = (char*)slab_alloc(q->slab, len);
+                if (!copy.data) {
+                    uncharge(q, len);
+                    err = "consumer_producer_put: out of memory";
+                    break;
+                }
+                memcpy(copy.data, item->data, item->len);
+                copy.data[item->len] = '\0';
+                copy.cap = len;
+            }
+            batch[n++] = copy;
+        }
+        if (err) {
+            discard_copies(q, batch, n);
+            if (owned) {
+                free_copies(q, items + done + n, count - done - n);
+            }
+            return err;
+        }
+
+        /* enqueue_copies discards what it rejects */
+        err = enqueue_copies(q, batch, n, ends);
+        done += n;
+        if (!err && ends && done < count) {
+            err = "consumer_producer_put: queue closed";
+        }
+        if (err) {
+            if (owned) {
+                free_copies(q, items + done, count - done);
+            }
+            return err;
+        }
+    }
+    return NULL;
+}
+
+const char* consumer_producer_put_records(consumer_producer_t* q, const record_t* items, int count) {
+    if (!q || count < 0 || (count > 0 && !items)) {
+        return "consumer_producer_put: invalid arguments";
+    }
+    if (q->kind == CP_QUEUE_BYTES) {
+        return push_bytes(q, items, count);
+    }
+    return put_items(q, items, count, 0);
+}
+
+const char* consumer_producer_put_records_owned(consumer_producer_t* q, const record_t* items, int count) {
+    if (!q || count < 0 || (count > 0 && !items)) {
+        if (q && items && count > 0) {
+            free_copies(q, items, count);
+        }
+        return "consumer_producer_put: invalid arguments";
+    }
+    if (q->kind == CP_QUEUE_BYTES) {
+        /* the ring stores bytes inline; copy in, then drop the buffers */
+        const char* err = push_bytes(q, items, count);
+        free_copies(q, items, count);
+        return err;
     }
+    return put_items(q, items, count, 1);
+}
+
+/* Free owned char* items the queue will not take, <END> excepted. */
+static void free_cstrs(consumer_producer_t* q, const char* const* items, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (items[i] && strcmp(items[i], RECORD_END_TOKEN) != 0) {
+            slab_free(q->slab, (char*)items[i]);
+        }
+    }
+}
+
+/* The char* calls: wrap each string in a record, CP_BATCH_MAX at a time. */
+static const char* put_cstrs(consumer_producer_t* q, const char* const* items, int count, int owned) {
+    record_t recs[CP_BATCH_MAX];
+    int done = 0;
+    while (done < count) {
+        int n = count - done < CP_BATCH_MAX ? count - done : CP_BATCH_MAX;
+        const char* err = NULL;
+        for (int i = 0; i < n && !err; ++i) {
+            if (!items[done + i]) {
+                err = "consumer_producer_put: invalid arguments";
+                n = i;
+            } else {
+                recs[i] = record_from_cstr(items[done + i]);
+            }
+        }
+        const char* put_err = owned ? consumer_producer_put_records_owned(q, recs, n)
+                                    : consumer_producer_put_records(q, recs, n);
+        done += n;
+        err = put_err ? put_err : err;
+        if (err) {
+            if (owned) {
+                free_cstrs(q, items + done, count - done);
+            }
+            return err;
+        }
+    }
+    return NULL;
+}
 
+const char* consumer_producer_put(consumer_producer_t* q, const char* item) {
+    if (!q || !item) {
+        return "consumer_producer_put: invalid arguments";
+    }
+    record_t rec = record_from_cstr(item);
+    return consumer_producer_put_records(q, &rec, 1);
+}
+
+const char* consumer_producer_put_batch(consumer_producer_t* q, const char* const* items, int count) {
+    if (!q || count < 0 || (count > 0 && !items)) {
+        return "consumer_producer_put_batch: invalid arguments";
+    }
+    return put_cstrs(q, items, count, 0);
+}
+
+const char* consumer_producer_put_owned(consumer_producer_t* q, char* item) {
+    return consumer_producer_put_owned_batch(q, &item, 1);
+}
+
+const char* consumer_producer_put_owned_batch(consumer_producer_t* q, char* const* items, int count) {
+    if (!q || count < 0 || (count > 0 && !items)) {
+        if (q && items && count > 0) {
+            free_cstrs(q, (const char* const*)items, count);
+        }
+        return "consumer_producer_put: invalid arguments";
+    }
+    return put_cstrs(q, (const char* const*)items, count, 1);
+}
+
+static int take_locked(consumer_producer_t* q, record_t* out, int max, unsigned long* seq, int wait);
+
+int consumer_producer_get_records(consumer_producer_t* q, record_t* out, int max) {
+    if (!q || !out || max <= 0) {
+        return 0;
+    }
+
+    if (q->kind == CP_QUEUE_SPSC) {
+        int n = (int)spsc_ring_pop_batch(&q->spsc, out, (size_t)max);
+        uncharge_items(q, out, n);
+        return n;
+    }
+    if (q->kind == CP_QUEUE_BYTES) {
+        /* owned items: copy out of the ring */
+        int n = consumer_producer_acquire_records(q, out, max);
+        for (int i = 0; i < n; ++i) {
+            if (record_is_end(&out[i])) {
+                continue;
+            }
+            /* the view stays put until the release: wait a while for
+             * memory rather than hand on a different line */
+            char* copy = (char*)slab_alloc(q->slab, out[i].len + 1);
+            for (int tries = 1; !copy && tries < CP_ALLOC_RETRIES; ++tries) {
+                struct timespec ts = { .tv_sec = 0, .tv_nsec = CP_ALLOC_RETRY_NS };
+                nanosleep(&ts, NULL);
+                copy = (char*)slab_alloc(q->slab, out[i].len + 1);
+            }
+            if (!copy) {
+                /* the rest of the batch is lost, but not the end marker,
+                 * which acquire only ever returns last */
+                q->error = "consumer_producer_get: out of memory, queued items lost";
+                if (record_is_end(&out[n - 1])) {
+                    out[i++] = record_end();
+                }
+                consumer_producer_release(q);
+                return i;
+            }
+            memcpy(copy, out[i].data, out[i].len + 1);
+            out[i].data = copy;
+            out[i].cap = out[i].len + 1;
+            out[i].flags = 0;
+        }
+        consumer_producer_release(q);
+        return n;
+    }
+    return take_locked(q, out, max, NULL, 1);
+}
+
+int consumer_producer_get_records_seq(consumer_producer_t* q, record_t* out, int max,
+                                      unsigned long* seq) {
+    if (!q || !out || max <= 0 || !seq || q->kind != CP_QUEUE_LOCKED) {
+        return 0;
+    }
+    return take_locked(q, out, max, seq, 1);
+}
+
+int consumer_producer_try_get_records(consumer_producer_t* q, record_t* out, int max) {
+    if (!q || !out || max <= 0 || q->kind != CP_QUEUE_LOCKED) {
+        return 0;
+    }
+    return take_locked(q, out, max, NULL, 0);
+}
+
+static int take_locked(consumer_producer_t* q, record_t* out, int max, unsigned long* seq, int wait) {
     pthread_mutex_lock(&q->mutex);
-    while (q->count == 0 && !q->closed) {
+    if (!wait && queued(q) == 0) {
         pthread_mutex_unlock(&q->mutex);
-        (void)monitor_wait(&q->not_empty_monitor);
-        pthread_mutex_lock(&q->mutex);
+        return 0;
+    }
+    if (queued(q) == 0 && !q->closed) {
+        wait_phase_t phase = WAIT_PHASE_PARK;
+        if (wait_policy_polls(&q->wait_policy)) {
+            pthread_mutex_unlock(&q->mutex);
+            phase = wait_policy_poll(&q->wait_policy, consumer_ready, q);
+            pthread_mutex_lock(&q->mutex);
+        }
+        while (queued(q) == 0 && !q->closed) {
+            phase = WAIT_PHASE_PARK;
+            q->waiting_consumers++;
+            pthread_mutex_unlock(&q->mutex);
+            (void)monitor_wait(&q->not_empty_monitor);
+            pthread_mutex_lock(&q->mutex);
+            q->waiting_consumers--;
+        }
+        wait_stats_record(&q->consumer_waits, phase);
     }
 
-    if (q->count == 0 && q->closed) {
+    if (queued(q) == 0 && q->closed) {
+        /* replicas: the wakeup for <END> reached one of them, pass it on */
+        int wake_consumer = q->waiting_consumers > 0;
         pthread_mutex_unlock(&q->mutex);
-        return NULL;
+        if (wake_consumer) {
+            monitor_signal(&q->not_empty_monitor);
+        }
+        return 0;
     }
 
-    char* item = q->items[q->head];
-    q->items[q->head] = NULL;
-    q->head = (q->head + 1) % q->capacity;
-    q->count--;
+    int n = q->count < max ? q->count : max;
+    for (int i = 0; i < n; ++i) {
+        out[i] = q->items[q->head];
+        q->head = (q->head + 1) % q->capacity;
+    }
+    q->count -= n;
+    int from_ring = n;
+    /* the ring is always older than the spill file */
+    while (q->spills && q->count == 0 && n < max && q->spill.records > 0) {
+        if (spill_take(&q->spill, q->slab, &out[n]) != 0) {
+            /* unreadable: the rest of the spill is lost, and with it the
+             * end marker if it was already put */
+            q->error = "consumer_producer: spill file unreadable, queued items lost";
+            if (q->closed) {
+                out[n++] = record_end();
+            }
+            break;
+        }
+        n++;
+    }
+    atomic_store_explicit(&q->level, queued(q), memory_order_release);
+    if (n == 0) {
+        /* lost the spill with nothing to show for it: wait again */
+        pthread_mutex_unlock(&q->mutex);
+        return take_locked(q, out, max, seq, wait);
+    }
+    if (seq) {
+        *seq = q->takes;
+    }
+    q->takes++;
 
+    int wake_producer = q->waiting_producers > 0;
+    /* pass leftovers, or the close, on to the next sleeping consumer */
+    int wake_consumer = (queued(q) > 0 || q->closed) && q->waiting_consumers > 0;
     pthread_mutex_unlock(&q->mutex);
-    monitor_signal(&q->not_full_monitor);
+    uncharge_items(q, out, from_ring);
+    if (wake_producer) {
+        monitor_signal(&q->not_full_monitor);
+    }
+    if (wake_consumer) {
+        monitor_signal(&q->not_empty_monitor);
+    }
+    return n;
+}
+
+int consumer_producer_acquire_records(consumer_producer_t* q, record_t* out, int max) {
+    if (!q || !out || max <= 0) {
+        return 0;
+    }
+    if (q->kind != CP_QUEUE_BYTES) {
+        return consumer_producer_get_records(q, out, max);
+    }
+
+    byte_ring_view_t views[CP_BATCH_MAX];
+    size_t n = byte_ring_acquire(&q->bytes, views, max < CP_BATCH_MAX ? (size_t)max : CP_BATCH_MAX);
+    for (size_t i = 0; i < n; ++i) {
+        if (views[i].flags & BYTE_RING_END) {
+            out[i] = record_end();
+            continue;
+        }
+        out[i].data = views[i].data;
+        out[i].len = views[i].len;
+        out[i].cap = views[i].len + 1;
+        out[i].flags = RECORD_BORROWED;
+    }
+    return (int)n;
+}
+
+char* consumer_producer_get(consumer_producer_t* q) {
+    char* item = NULL;
+    (void)consumer_producer_get_batch(q, &item, 1);
     return item;
 }
 
+int consumer_producer_get_batch(consumer_producer_t* q, char** out, int max) {
+    if (!out) {
+        return 0;
+    }
+    record_t recs[CP_BATCH_MAX];
+    int n = consumer_producer_get_records(q, recs, max < CP_BATCH_MAX ? max : CP_BATCH_MAX);
+    for (int i = 0; i < n; ++i) {
+        out[i] = record_cstr(&recs[i]);
+    }
+    return n;
+}
+
+int consumer_producer_acquire_batch(consumer_producer_t* q, char** out, int max) {
+    if (!out) {
+        return 0;
+    }
+    record_t recs[CP_BATCH_MAX];
+    int n = consumer_producer_acquire_records(q, recs, max < CP_BATCH_MAX ? max : CP_BATCH_MAX);
+    for (int i = 0; i < n; ++i) {
+        out[i] = record_cstr(&recs[i]);
+    }
+    return n;
+}
+
+void consumer_producer_release(consumer_producer_t* q) {
+    if (q && q->kind == CP_QUEUE_BYTES) {
+        byte_ring_release(&q->bytes);
+    }
+}
+
+int consumer_producer_borrows(const consumer_producer_t* q) {
+    return q && q->kind == CP_QUEUE_BYTES;
+}
+
+void consumer_producer_get_wait_policy(consumer_producer_t* q, wait_policy_t* policy) {
+    if (!q || !policy) {
+        return;
+    }
+    if (q->kind == CP_QUEUE_SPSC) {
+        *policy = q->spsc.policy;
+    } else if (q->kind == CP_QUEUE_BYTES) {
+        *policy = q->bytes.policy;
+    } else {
+        *policy = q->wait_policy;
+    }
+}
+
+void consumer_producer_set_wait_policy(consumer_producer_t* q, const wait_policy_t* policy) {
+    if (!q || !policy) {
+        return;
+    }
+    wait_policy_t p = *policy;
+    if (p.spin_iters < 0) {
+        p.spin_iters = 0;
+    }
+    if (p.yield_iters < 0) {
+        p.yield_iters = 0;
+    }
+    if (q->kind == CP_QUEUE_SPSC) {
+        q->spsc.policy = p;
+    } else if (q->kind == CP_QUEUE_BYTES) {
+        q->bytes.policy = p;
+    } else {
+        q->wait_policy = p;
+    }
+}
+
+void consumer_producer_get_wait_stats(consumer_producer_t* q,
+                                      unsigned long consumer[WAIT_PHASE_COUNT],
+                                      unsigned long producer[WAIT_PHASE_COUNT]) {
+    if (!q) {
+        return;
+    }
+    wait_stats_t* c = &q->consumer_waits;
+    wait_stats_t* p = &q->producer_waits;
+    if (q->kind == CP_QUEUE_SPSC) {
+        c = &q->spsc.consumer_waits;
+        p = &q->spsc.producer_waits;
+    } else if (q->kind == CP_QUEUE_BYTES) {
+        c = &q->bytes.consumer_waits;
+        p = &q->bytes.producer_waits;
+    }
+    for (int i = 0; i < WAIT_PHASE_COUNT; ++i) {
+        if (consumer) {
+            consumer[i] = wait_stats_get(c, (wait_phase_t)i);
+        }
+        if (producer) {
+            producer[i] = wait_stats_get(p, (wait_phase_t)i);
+        }
+    }
+}
+
 void consumer_producer_signal_finished(consumer_producer_t* q) {
     if (!q) {
         return;
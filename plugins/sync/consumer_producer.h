@@ -1,26 +1,216 @@
 #ifndef SYNC_CONSUMER_PRODUCER_H
 #define SYNC_CONSUMER_PRODUCER_H
 
+#include "byte_budget.h"
+#include "byte_ring.h"
+#include "executor.h"
 #include "monitor.h"
+#include "record.h"
+#include "slab.h"
+#include "spill_file.h"
+#include "spsc_ring.h"
+#include "wait_policy.h"
+
+/* Upper bound on items moved per lock acquisition by the batch calls. */
+#define CP_BATCH_MAX 64
+
+/* Queue implementation backing a consumer_producer_t. */
+typedef enum {
+    CP_QUEUE_LOCKED = 0,          /* mutex + monitors, any number of threads */
+    CP_QUEUE_SPSC,                /* lock-free ring, one producer, one consumer */
+    CP_QUEUE_BYTES,               /* inline byte ring, one producer, one consumer */
+} consumer_producer_kind_t;
 
 typedef struct {
-    char **items;                 /* circular buffer storage */
+    consumer_producer_kind_t kind;/* selected implementation */
+    record_t* items;              /* circular buffer storage */
     int capacity;                 /* maximum number of items */
     int count;                    /* current number of items */
     int head;                     /* index of next item to consume */
     int tail;                     /* index of next slot to produce */
-    int closed;                   /* set once <END> is queued */
+    atomic_int closed;            /* set once <END> is queued */
+    atomic_int level;             /* mirror of count for lock-free polling */
+    int waiting_consumers;        /* consumers parked on not_empty_monitor */
+    int waiting_producers;        /* producers parked on not_full_monitor */
     monitor_t not_full_monitor;   /* signaled when producers may enqueue */
     monitor_t not_empty_monitor;  /* signaled when consumers may dequeue */
     monitor_t finished_monitor;   /* signaled when processing fully done */
     pthread_mutex_t mutex;        /* protects buffer state */
+    wait_policy_t wait_policy;    /* spin/yield budget before parking */
+    wait_stats_t consumer_waits;  /* how empty-queue waits ended */
+    wait_stats_t producer_waits;  /* how full-queue waits ended */
+    spsc_ring_t spsc;             /* storage for CP_QUEUE_SPSC */
+    byte_ring_t bytes;            /* storage for CP_QUEUE_BYTES */
+    byte_budget_t own_budget;     /* storage for budget */
+    byte_budget_t* budget;        /* per-queue byte budget, NULL if none */
+    byte_budget_t* shared_budget; /* pipeline-wide budget, owned elsewhere */
+    int spills;                   /* overflow goes to spill instead of blocking */
+    spill_file_t spill;           /* overflow records, oldest after the ring */
+    slab_t* slab;                 /* record allocator, NULL for malloc */
+    unsigned long takes;          /* batches handed out by CP_QUEUE_LOCKED */
+    const char* error;            /* sticky: queued items were lost, NULL if none */
+    executor_t* executor;         /* workers of this pipeline, NULL if none */
+    executor_task_t* task;        /* consumer run by executor, NULL if a thread */
 } consumer_producer_t;
 
+/* capacity counts items, except for CP_QUEUE_BYTES where it counts bytes. */
 const char* consumer_producer_init(consumer_producer_t* queue, int capacity);
+const char* consumer_producer_init_kind(consumer_producer_t* queue, int capacity,
+                                        consumer_producer_kind_t kind);
 void        consumer_producer_destroy(consumer_producer_t* queue);
 const char* consumer_producer_put(consumer_producer_t* queue, const char* item);
 char*       consumer_producer_get(consumer_producer_t* queue);
+
+/*
+ * Copy and enqueue count items, taking the lock once per CP_BATCH_MAX run
+ * (once per free run for SPSC). Blocks while full like consumer_producer_put.
+ * Items after an <END> are rejected with "queue closed".
+ */
+const char* consumer_producer_put_batch(consumer_producer_t* queue,
+                                        const char* const* items, int count);
+
+/*
+ * Enqueue heap strings without copying. They must come from the queue's
+ * allocator (see consumer_producer_set_allocator). The queue takes ownership
+ * of every item, including ones it rejects, which it frees. An item equal
+ * to <END> is never freed and stays with the caller.
+ */
+const char* consumer_producer_put_owned(consumer_producer_t* queue, char* item);
+const char* consumer_producer_put_owned_batch(consumer_producer_t* queue,
+                                              char* const* items, int count);
+
+/*
+ * Block until at least one item is available, then dequeue up to max of
+ * them in one step (at most CP_BATCH_MAX). Ownership of the returned items
+ * passes to the caller. Returns the number stored in out, or 0 once the
+ * queue is drained and closed.
+ */
+int         consumer_producer_get_batch(consumer_producer_t* queue, char** out, int max);
+
+/*
+ * Zero-copy variant of consumer_producer_get_batch. For CP_QUEUE_BYTES the
+ * items point into the ring: they may be modified in place (not grown or
+ * freed) and stay valid until consumer_producer_release(). For the other
+ * kinds this is consumer_producer_get_batch and the caller owns the items.
+ */
+int         consumer_producer_acquire_batch(consumer_producer_t* queue, char** out, int max);
+
+/*
+ * Record forms of the calls above, which wrap them. A record carries its
+ * length, so nothing is measured again and payloads may contain NULs; the
+ * end of the stream is RECORD_END rather than the string "<END>". The char*
+ * calls turn "<END>" into the flag on the way in and back on the way out.
+ *
+ * put_records copies; put_records_owned takes over NUL-terminated buffers
+ * from the queue's allocator, as consumer_producer_put_owned_batch does.
+ * acquire_records marks items that point into a byte ring RECORD_BORROWED;
+ * get_records copies them out. If a copy still cannot be allocated after
+ * about a second of retries, get_records sets consumer_producer_error and
+ * returns only the items copied so far (possibly none, though the end
+ * marker is kept); the rest of that batch is lost.
+ */
+const char* consumer_producer_put_records(consumer_producer_t* queue,
+                                          const record_t* items, int count);
+const char* consumer_producer_put_records_owned(consumer_producer_t* queue,
+                                                const record_t* items, int count);
+int         consumer_producer_get_records(consumer_producer_t* queue, record_t* out, int max);
+int         consumer_producer_acquire_records(consumer_producer_t* queue, record_t* out, int max);
+
+/*
+ * consumer_producer_get_records for several consumers of a CP_QUEUE_LOCKED
+ * queue: *seq numbers the batches, from 0, in the order they left the
+ * queue, so the consumers can put their results back in that order.
+ * Returns 0 for any other kind.
+ */
+int         consumer_producer_get_records_seq(consumer_producer_t* queue, record_t* out, int max,
+                                              unsigned long* seq);
+
+/*
+ * consumer_producer_get_records for a CP_QUEUE_LOCKED queue that never
+ * waits: returns 0 when nothing is queued, closed or not.
+ */
+int         consumer_producer_try_get_records(consumer_producer_t* queue, record_t* out, int max);
+
+/* Give back everything acquired so far. No-op unless the queue borrows. */
+void        consumer_producer_release(consumer_producer_t* queue);
+
+/* 1 if consumer_producer_acquire_batch lends items instead of handing them over. */
+int         consumer_producer_borrows(const consumer_producer_t* queue);
+
 void        consumer_producer_signal_finished(consumer_producer_t* queue);
 int         consumer_producer_wait_finished(consumer_producer_t* queue);
 
+/*
+ * Bound the bytes (string length + 1) queued at once, on top of the item
+ * capacity. Producers block while a put would go over, except into an empty
+ * queue, so one oversized line still passes. 0 leaves the queue unbounded.
+ * Call before the queue is used. CP_QUEUE_BYTES ignores it: the ring size
+ * is its byte budget.
+ */
+const char* consumer_producer_set_byte_budget(consumer_producer_t* queue, size_t bytes);
+
+/*
+ * Charge queued bytes to a budget shared with other queues as well, for a
+ * pipeline-wide ceiling. The budget must outlive the queue. CP_QUEUE_BYTES
+ * ignores it.
+ */
+void        consumer_producer_set_shared_budget(consumer_producer_t* queue, byte_budget_t* budget);
+
+/*
+ * Allocate the items the queue copies, and free the ones it drops, from
+ * slab rather than malloc. Items handed out by the get calls must then be
+ * released with slab_free on the same slab, and owned puts must come from
+ * it too. slab must outlive the queue; NULL restores malloc. Call before
+ * the queue is used.
+ */
+void        consumer_producer_set_allocator(consumer_producer_t* queue, slab_t* slab);
+
+/*
+ * Pipeline run on ex's workers. task, if any, is the queue's consumer: it is
+ * notified after every put instead of a consumer thread being woken. A put
+ * from one of ex's workers that finds the queue full runs the stages after
+ * the blocked one meanwhile (see executor_help), whether or not the queue's
+ * own consumer is a task. Call before the queue is used.
+ */
+void        consumer_producer_set_executor(consumer_producer_t* queue, executor_t* ex,
+                                           executor_task_t* task);
+
+/*
+ * Opt-in overflow to disk, CP_QUEUE_LOCKED only. When the ring is full, or
+ * a put would go over a byte budget, items are appended to an unlinked temp
+ * file in dir instead of blocking the producer; once anything is spilled,
+ * later items follow it there so the consumer still sees them in order.
+ * Spilled items are not charged to the byte budgets. If the file cannot be
+ * written the producer blocks as usual. Call before the queue is used.
+ */
+const char* consumer_producer_enable_spill(consumer_producer_t* queue, const char* dir);
+
+/* Number of items that went through the spill file so far. */
+unsigned long consumer_producer_spilled(consumer_producer_t* queue);
+
+/*
+ * NULL, or why queued items were lost: a spill file that could not be read
+ * back drops everything still in it, and get_records on CP_QUEUE_BYTES
+ * drops the rest of a batch it cannot copy out. If that included the end
+ * marker, the consumer gets RECORD_END in its place so the stream still
+ * terminates. For CP_QUEUE_BYTES, call it from the consumer, or once the
+ * consumer has finished.
+ */
+const char* consumer_producer_error(consumer_producer_t* queue);
+
+/*
+ * Wait policy for blocked producers and consumers. Defaults: LOCKED parks
+ * immediately, SPSC and BYTES spin SPSC_DEFAULT_SPIN times first.
+ */
+void        consumer_producer_get_wait_policy(consumer_producer_t* queue, wait_policy_t* policy);
+void        consumer_producer_set_wait_policy(consumer_producer_t* queue, const wait_policy_t* policy);
+
+/* Snapshot how many consumer and producer waits ended in each phase. */
+void        consumer_producer_get_wait_stats(consumer_producer_t* queue,
+                                             unsigned long consumer[WAIT_PHASE_COUNT],
+                                             unsigned long producer[WAIT_PHASE_COUNT]);
+
+/* Map "locked"/"spsc"/"bytes" to a queue kind. Returns 0 on success, -1 if unknown. */
+int         consumer_producer_kind_parse(const char* name, consumer_producer_kind_t* kind);
+
 #endif // SYNC_CONSUMER_PRODUCER_H
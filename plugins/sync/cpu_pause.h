@@ -0,0 +1,15 @@
+#ifndef SYNC_CPU_PAUSE_H
+#define SYNC_CPU_PAUSE_H
+
+/* Hint to the CPU that we are inside a busy-wait loop. */
+static inline void cpu_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+#endif // SYNC_CPU_PAUSE_H
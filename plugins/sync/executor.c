@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "executor.h"
+
+/* executor_help backs off this long when nothing downstream is queued. */
+#define EXECUTOR_BACKOFF_NS (50 * 1000)
+
+enum {
+    TASK_IDLE = 0,
+    TASK_QUEUED,        /* in exactly one deque */
+    TASK_RUNNING,
+    TASK_NOTIFIED,      /* running, and notified since it took its input */
+    TASK_DONE,
+};
+
+/* ---- deques; everything takes the worker's lock ---- */
+
+static void push_bottom(executor_worker_t* w, executor_task_t* t) {
+    pthread_mutex_lock(&w->lock);
+    w->slots[(w->top + w->count) % EXECUTOR_MAX_TASKS] = t;
+    w->count++;
+    pthread_mutex_unlock(&w->lock);
+}
+
+static void push_top(executor_worker_t* w, executor_task_t* t) {
+    pthread_mutex_lock(&w->lock);
+    w->top = (w->top + EXECUTOR_MAX_TASKS - 1) % EXECUTOR_MAX_TASKS;
+    w->slots[w->top] = t;
+    w->count++;
+    pthread_mutex_unlock(&w->lock);
+}
+
+static executor_task_t* pop_bottom(executor_worker_t* w) {
+    executor_task_t* t = NULL;
+    pthread_mutex_lock(&w->lock);
+    if (w->count > 0) {
+        w->count--;
+        t = w->slots[(w->top + w->count) % EXECUTOR_MAX_TASKS];
+    }
+    pthread_mutex_unlock(&w->lock);
+    return t;
+}
+
+static executor_task_t* pop_top(executor_worker_t* w) {
+    executor_task_t* t = NULL;
+    pthread_mutex_lock(&w->lock);
+    if (w->count > 0) {
+        t = w->slots[w->top];
+        w->top = (w->top + 1) % EXECUTOR_MAX_TASKS;
+        w->count--;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return t;
+}
+
+/* The newest task ordered after `after`, taken out of the middle if need be. */
+static executor_task_t* take_after(executor_worker_t* w, int after) {
+    executor_task_t* t = NULL;
+    pthread_mutex_lock(&w->lock);
+    for (int i = w->count - 1; i >= 0; --i) {
+        int at = (w->top + i) % EXECUTOR_MAX_TASKS;
+        if (w->slots[at]->order > after) {
+            t = w->slots[at];
+            for (int j = i; j < w->count - 1; ++j) {
+                w->slots[(w->top + j) % EXECUTOR_MAX_TASKS] =
+                    w->slots[(w->top + j + 1) % EXECUTOR_MAX_TASKS];
+            }
+            w->count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    return t;
+}
+
+/* ---- scheduling ---- */
+
+static void enqueue(executor_t* ex, executor_task_t* t, int yield) {
+    executor_worker_t* self = (executor_worker_t*)pthread_getspecific(ex->key);
+    executor_worker_t* w = self;
+    if (!w || w->ex != ex) {
+        unsigned n = atomic_fetch_add_explicit(&ex->deal, 1, memory_order_relaxed);
+        w = &ex->workers[n % (unsigned)ex->num_workers];
+    }
+    if (yield) {
+        push_top(w, t);
+    } else {
+        push_bottom(w, t);
+    }
+    /* pairs with the sleepers/pending check in worker_main */
+    atomic_fetch_add(&ex->pending, 1);
+    if (atomic_load(&ex->sleepers) > 0) {
+        pthread_mutex_lock(&ex->lock);
+        pthread_cond_signal(&ex->wake);
+        pthread_mutex_unlock(&ex->lock);
+    }
+}
+
+static void run(executor_worker_t* w, executor_task_t* t) {
+    executor_t* ex = w->ex;
+    atomic_store(&t->state, TASK_RUNNING);
+    int outer = w->current;
+    w->current = t->order;
+    executor_status_t status = t->step(t->arg);
+    w->current = outer;
+    atomic_fetch_add_explicit(&ex->steps, 1, memory_order_relaxed);
+
+    if (status == EXECUTOR_DONE) {
+        atomic_store(&t->state, TASK_DONE);
+        return;
+    }
+    if (status == EXECUTOR_IDLE) {
+        int expected = TASK_RUNNING;
+        if (atomic_compare_exchange_strong(&t->state, &expected, TASK_IDLE)) {
+            return;
+        }
+        /* notified while running: the input it saw may be stale */
+    }
+    atomic_store(&t->state, TASK_QUEUED);
+    enqueue(ex, t, status == EXECUTOR_MORE);
+}
+
+/* Own deque first, then the oldest task of the others. */
+static executor_task_t* find_task(executor_worker_t* w) {
+    executor_t* ex = w->ex;
+    executor_task_t* t = pop_bottom(w);
+    for (int i = 1; !t && i < ex->num_workers; ++i) {
+        t = pop_top(&ex->workers[(w->id + i) % ex->num_workers]);
+        if (t) {
+            atomic_fetch_add_explicit(&ex->steals, 1, memory_order_relaxed);
+        }
+    }
+    if (t) {
+        atomic_fetch_sub(&ex->pending, 1);
+    }
+    return t;
+}
+
+static void* worker_main(void* arg) {
+    executor_worker_t* w = (executor_worker_t*)arg;
+    executor_t* ex = w->ex;
+    pthread_setspecific(ex->key, w);
+    for (;;) {
+        executor_task_t* t = find_task(w);
+        if (t) {
+            run(w, t);
+            continue;
+        }
+        pthread_mutex_lock(&ex->lock);
+        atomic_fetch_add(&ex->sleepers, 1);
+        while (atomic_load(&ex->pending) == 0 && !atomic_load(&ex->stop)) {
+            pthread_cond_wait(&ex->wake, &ex->lock);
+        }
+        atomic_fetch_sub(&ex->sleepers, 1);
+        int stop = atomic_load(&ex->stop) && atomic_load(&ex->pending) == 0;
+        pthread_mutex_unlock(&ex->lock);
+        if (stop) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+int executor_init(executor_t* ex, int workers) {
+    if (!ex) {
+        return -1;
+    }
+    if (workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (workers > EXECUTOR_MAX_WORKERS) {
+        workers = EXECUTOR_MAX_WORKERS;
+    }
+    memset(ex, 0, sizeof(*ex));
+    if (pthread_key_create(&ex->key, NULL) != 0) {
+        return -1;
+    }
+    pthread_mutex_init(&ex->lock, NULL);
+    pthread_cond_init(&ex->wake, NULL);
+    for (int i = 0; i < workers; ++i) {
+        executor_worker_t* w = &ex->workers[i];
+        pthread_mutex_init(&w->lock, NULL);
+        w->ex = ex;
+        w->id = i;
+        w->current = -1;
+    }
+    ex->num_workers = workers;
+    for (int i = 0; i < workers; ++i) {
+        if (pthread_create(&ex->threads[i], NULL, worker_main, &ex->workers[i]) != 0) {
+            ex->num_workers = i;
+            executor_destroy(ex);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void executor_destroy(executor_t* ex) {
+    if (!ex) {
+        return;
+    }
+    pthread_mutex_lock(&ex->lock);
+    atomic_store(&ex->stop, 1);
+    pthread_cond_broadcast(&ex->wake);
+    pthread_mutex_unlock(&ex->lock);
+    for (int i = 0; i < ex->num_workers; ++i) {
+        pthread_join(ex->threads[i], NULL);
+    }
+    for (int i = 0; i < EXECUTOR_MAX_WORKERS; ++i) {
+        if (ex->workers[i].ex) {
+            pthread_mutex_destroy(&ex->workers[i].lock);
+        }
+    }
+    pthread_cond_destroy(&ex->wake);
+    pthread_mutex_destroy(&ex->lock);
+    pthread_key_delete(ex->key);
+    ex->num_workers = 0;
+}
+
+int executor_next_order(executor_t* ex) {
+    return atomic_fetch_add(&ex->next_order, 1);
+}
+
+int executor_register(executor_t* ex, executor_task_t* task, int order,
+                      executor_step_fn step, void* arg) {
+    if (!ex || !task || !step) {
+        return -1;
+    }
+    if (atomic_fetch_add(&ex->tasks, 1) >= EXECUTOR_MAX_TASKS) {
+        atomic_fetch_sub(&ex->tasks, 1);
+        return -1;
+    }
+    task->ex = ex;
+    task->step = step;
+    task->arg = arg;
+    task->order = order;
+    atomic_init(&task->state, TASK_IDLE);
+    return 0;
+}
+
+void executor_notify(executor_task_t* t) {
+    int s = atomic_load(&t->state);
+    for (;;) {
+        if (s == TASK_IDLE) {
+            if (atomic_compare_exchange_weak(&t->state, &s, TASK_QUEUED)) {
+                enqueue(t->ex, t, 0);
+                return;
+            }
+        } else if (s == TASK_RUNNING) {
+            if (atomic_compare_exchange_weak(&t->state, &s, TASK_NOTIFIED)) {
+                return;
+            }
+        } else {
+            return; /* already queued, already notified, or done */
+        }
+    }
+}
+
+int executor_in_worker(executor_t* ex) {
+    executor_worker_t* w = ex ? (executor_worker_t*)pthread_getspecific(ex->key) : NULL;
+    return w && w->ex == ex;
+}
+
+void executor_help(executor_t* ex) {
+    executor_worker_t* w = (executor_worker_t*)pthread_getspecific(ex->key);
+    executor_task_t* t = NULL;
+    if (w && w->ex == ex) {
+        for (int i = 0; !t && i < ex->num_workers; ++i) {
+            t = take_after(&ex->workers[(w->id + i) % ex->num_workers], w->current);
+        }
+    }
+    if (t) {
+        atomic_fetch_sub(&ex->pending, 1);
+        atomic_fetch_add_explicit(&ex->helps, 1, memory_order_relaxed);
+        run(w, t);
+        return;
+    }
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = EXECUTOR_BACKOFF_NS };
+    nanosleep(&ts, NULL);
+}
+
+void executor_format_stats(executor_t* ex, char* buf, size_t size) {
+    snprintf(buf, size, "executor: %d workers ran %lu steps, %lu stolen, %lu while blocked",
+             ex->num_workers, atomic_load(&ex->steps), atomic_load(&ex->steals),
+             atomic_load(&ex->helps));
+}
@@ -0,0 +1,110 @@
+#ifndef SYNC_EXECUTOR_H
+#define SYNC_EXECUTOR_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "spsc_ring.h"
+
+/* Most worker threads, and most tasks one executor schedules. */
+#define EXECUTOR_MAX_WORKERS 64
+#define EXECUTOR_MAX_TASKS   256
+
+/* What a step reports back. */
+typedef enum {
+    EXECUTOR_IDLE = 0,  /* nothing left to do until notified again */
+    EXECUTOR_MORE,      /* did a batch and there may be more: yield */
+    EXECUTOR_DONE,      /* finished for good; never run again */
+} executor_status_t;
+
+typedef executor_status_t (*executor_step_fn)(void* arg);
+
+struct executor;
+
+/* A unit of work the executor runs when notified, one step at a time and
+ * never on two workers at once. Owned by the caller. */
+typedef struct executor_task {
+    struct executor* ex;
+    executor_step_fn step;
+    void* arg;
+    int order;                          /* position in the chain, upstream first */
+    atomic_int state;
+} executor_task_t;
+
+/* Tasks queued on one worker: the owner works the bottom, thieves and
+ * yielded tasks use the top. Never holds more than EXECUTOR_MAX_TASKS. */
+typedef struct {
+    _Alignas(SPSC_CACHE_LINE) pthread_mutex_t lock;
+    executor_task_t* slots[EXECUTOR_MAX_TASKS];
+    int top;                            /* index of the oldest task */
+    int count;
+    struct executor* ex;
+    int id;
+    int current;                        /* order of the task running here, -1 if none */
+} executor_worker_t;
+
+/*
+ * Fixed pool of worker threads running tasks, for pipelines whose stages
+ * should not each need a thread of their own. Shared by the host and every
+ * plugin of a pipeline, like the slab.
+ *
+ * Notifying a task queues it on the notifying worker's own deque, bottom
+ * end, so the stage that was just fed usually runs next on the same core
+ * while its input is still in cache; from other threads tasks are dealt
+ * round-robin. A task that yields goes to the top, behind everything else
+ * queued there. Idle workers steal from the top of the others' deques and
+ * sleep only when no task is queued anywhere.
+ *
+ * A step may block, typically putting into the next stage's full queue.
+ * Such a worker calls executor_help, which runs tasks further down the
+ * chain than the one that is blocked: they are what drains the queue, and
+ * never need the blocked one, so a single worker runs any chain.
+ */
+typedef struct executor {
+    int num_workers;
+    executor_worker_t workers[EXECUTOR_MAX_WORKERS];
+    pthread_t threads[EXECUTOR_MAX_WORKERS];
+    pthread_key_t key;                  /* the calling thread's executor_worker_t */
+    atomic_int next_order;
+    atomic_int tasks;
+    atomic_uint deal;                   /* round-robin for notifies from outside */
+    _Alignas(SPSC_CACHE_LINE) atomic_int pending; /* tasks sitting in deques */
+    atomic_int sleepers;
+    atomic_int stop;
+    pthread_mutex_t lock;               /* pairs with wake */
+    pthread_cond_t wake;
+    atomic_ulong steps;
+    atomic_ulong steals;
+    atomic_ulong helps;
+} executor_t;
+
+/* workers <= 0 means one per online CPU. Returns 0 on success, -1 on
+ * failure. */
+int  executor_init(executor_t* ex, int workers);
+
+/* Stop and join the workers. Every task must be done or idle. */
+void executor_destroy(executor_t* ex);
+
+/* Next position in the chain; call once per stage, in chain order. */
+int  executor_next_order(executor_t* ex);
+
+/* Set up task to run step(arg), idle until notified. Returns 0, or -1 if
+ * the executor has no room for another task. */
+int  executor_register(executor_t* ex, executor_task_t* task, int order,
+                       executor_step_fn step, void* arg);
+
+/* Work arrived for task: make sure it runs a step after this call. */
+void executor_notify(executor_task_t* task);
+
+/* Nonzero if the calling thread is one of ex's workers. */
+int  executor_in_worker(executor_t* ex);
+
+/* From a blocked step: run one queued task further down the chain, or,
+ * if there is none, back off briefly. */
+void executor_help(executor_t* ex);
+
+/* One line for a shutdown report. */
+void executor_format_stats(executor_t* ex, char* buf, size_t size);
+
+#endif // SYNC_EXECUTOR_H
@@ -1,5 +1,73 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE /* syscall() */
+#endif
 #include "monitor.h"
 
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define MONITOR_SIGNALED 1u
+#define MONITOR_WAITER   2u
+
+static void futex_wait(atomic_uint* addr, unsigned expected) {
+    /* Returns early on EAGAIN (value changed) or EINTR; callers re-check. */
+    (void)syscall(SYS_futex, (unsigned*)addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_uint* addr, int count) {
+    (void)syscall(SYS_futex, (unsigned*)addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+int monitor_init(monitor_t* monitor) {
+    if (!monitor) return -1;
+    atomic_init(&monitor->state, 0);
+    return 0;
+}
+
+void monitor_destroy(monitor_t* monitor) {
+    (void)monitor;
+}
+
+void monitor_signal(monitor_t* monitor) {
+    if (!monitor) return;
+    unsigned prev = atomic_fetch_or(&monitor->state, MONITOR_SIGNALED);
+    /* Only one waiter can consume the signal, so wake just one; if the flag
+     * was already set that wakeup has been issued and is still pending. */
+    if (!(prev & MONITOR_SIGNALED) && prev >= MONITOR_WAITER) {
+        futex_wake(&monitor->state, 1);
+    }
+}
+
+void monitor_reset(monitor_t* monitor) {
+    if (!monitor) return;
+    (void)atomic_fetch_and(&monitor->state, ~MONITOR_SIGNALED);
+}
+
+int monitor_wait(monitor_t* monitor) {
+    if (!monitor) return -1;
+    unsigned s = atomic_load_explicit(&monitor->state, memory_order_relaxed);
+    for (;;) {
+        if (s & MONITOR_SIGNALED) {
+            /* auto reset so subsequent waiters block again */
+            if (atomic_compare_exchange_weak(&monitor->state, &s, s & ~MONITOR_SIGNALED)) {
+                return 0;
+            }
+            continue;
+        }
+        if (!atomic_compare_exchange_weak(&monitor->state, &s, s + MONITOR_WAITER)) {
+            continue;
+        }
+        /* Sleeps only while state still equals what we registered against;
+         * a signal in between changes it and the kernel returns at once. */
+        futex_wait(&monitor->state, s + MONITOR_WAITER);
+        s = atomic_fetch_sub(&monitor->state, MONITOR_WAITER) - MONITOR_WAITER;
+    }
+}
+
+#else /* portable fallback */
+
 int monitor_init(monitor_t* monitor) {
     if (!monitor) return -1;
     if (pthread_mutex_init(&monitor->mutex, NULL) != 0) return -1;
@@ -8,6 +76,7 @@ int monitor_init(monitor_t* monitor) {
         return -1;
     }
     monitor->signaled = 0;
+    monitor->waiters = 0;
     return 0;
 }
 
@@ -21,7 +90,9 @@ void monitor_signal(monitor_t* monitor) {
     if (!monitor) return;
     pthread_mutex_lock(&monitor->mutex);
     monitor->signaled = 1;
-    pthread_cond_broadcast(&monitor->condition);
+    if (monitor->waiters > 0) {
+        pthread_cond_signal(&monitor->condition);
+    }
     pthread_mutex_unlock(&monitor->mutex);
 }
 
@@ -35,11 +106,14 @@ void monitor_reset(monitor_t* monitor) {
 int monitor_wait(monitor_t* monitor) {
     if (!monitor) return -1;
     pthread_mutex_lock(&monitor->mutex);
+    monitor->waiters++;
     while (!monitor->signaled) {
         pthread_cond_wait(&monitor->condition, &monitor->mutex);
     }
+    monitor->waiters--;
     monitor->signaled = 0; /* auto reset so subsequent waiters block again */
     pthread_mutex_unlock(&monitor->mutex);
     return 0;
 }
 
+#endif
@@ -3,11 +3,26 @@
 
 #include <pthread.h>
 
+#if defined(__linux__)
+#include <stdatomic.h>
+
+/*
+ * Futex-backed parking primitive.
+ * state bit 0 is the "remembered" signal, the remaining bits count threads
+ * parked (or about to park) in monitor_wait. Signalling with nobody parked
+ * is a single atomic OR; the futex is only touched when a waiter exists.
+ */
+typedef struct {
+    atomic_uint state;          /* MONITOR_SIGNALED | waiters << 1 */
+} monitor_t;
+#else
 typedef struct {
     pthread_mutex_t mutex;      /* protects signaled flag */
     pthread_cond_t condition;   /* condition variable used for waits */
     int signaled;               /* "remembered" signal (0/1) */
+    int waiters;                /* threads blocked in monitor_wait */
 } monitor_t;
+#endif
 
 /* Initialize a monitor. Returns 0 on success, -1 on failure. */
 int monitor_init(monitor_t* monitor);
@@ -15,7 +30,7 @@ int monitor_init(monitor_t* monitor);
 /* Destroy a monitor and release its resources. */
 void monitor_destroy(monitor_t* monitor);
 
-/* Signal the monitor and wake all waiting threads. */
+/* Signal the monitor and wake a waiting thread, if any. */
 void monitor_signal(monitor_t* monitor);
 
 /* Manually clear the monitor's signaled state. */
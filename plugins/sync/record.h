@@ -0,0 +1,55 @@
+#ifndef SYNC_RECORD_H
+#define SYNC_RECORD_H
+
+#include <stddef.h>
+#include <string.h>
+
+#define RECORD_END      0x1u  /* end-of-stream marker, no payload */
+#define RECORD_BORROWED 0x2u  /* data belongs to a queue: change in place, never free */
+
+/*
+ * One line travelling through the pipeline. The payload is len bytes and
+ * may contain NULs; a terminator is kept at data[len] all the same, so the
+ * payload can still be handed to code that expects a C string. cap is the
+ * room at data including that terminator, so a stage may grow a line in
+ * place up to cap - 1 bytes.
+ *
+ * The layout is part of the plugin ABI (see plugin_sdk.h).
+ */
+typedef struct record {
+    char* data;               /* payload, NULL for RECORD_END */
+    size_t len;               /* payload bytes */
+    size_t cap;               /* bytes usable at data, terminator included */
+    unsigned flags;           /* RECORD_* */
+} record_t;
+
+#define RECORD_END_TOKEN "<END>"
+
+static inline int record_is_end(const record_t* rec) {
+    return (rec->flags & RECORD_END) != 0;
+}
+
+static inline record_t record_end(void) {
+    record_t rec = { NULL, 0, 0, RECORD_END };
+    return rec;
+}
+
+/*
+ * Wrap a C string from one of the char* entry points. The literal "<END>"
+ * becomes the end marker; this is the only place it is compared.
+ */
+static inline record_t record_from_cstr(const char* str) {
+    if (strcmp(str, RECORD_END_TOKEN) == 0) {
+        return record_end();
+    }
+    size_t len = strlen(str);
+    record_t rec = { (char*)str, len, len + 1, 0 };
+    return rec;
+}
+
+/* The C string form for char* callers: "<END>" for the end marker. */
+static inline char* record_cstr(const record_t* rec) {
+    return record_is_end(rec) ? (char*)RECORD_END_TOKEN : rec->data;
+}
+
+#endif // SYNC_RECORD_H
@@ -0,0 +1,331 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "slab.h"
+
+/* Bytes a thread's cache keeps per class before handing blocks back. */
+#define SLAB_CACHE_BYTES (256 * 1024)
+/* Bytes carved per chunk, rounded up to a few blocks for the big classes. */
+#define SLAB_CHUNK_BYTES (256 * 1024)
+#define SLAB_CHUNK_MIN_BLOCKS 8
+
+/* Precedes every block handed out; payloads stay 16-byte aligned. */
+typedef struct {
+    uint32_t cls;     /* size class, SLAB_LARGE for malloc'd blocks */
+    uint32_t owner;   /* id of the allocating cache, 0 if none */
+    uint64_t size;    /* usable bytes */
+} slab_header_t;
+
+/* A free block reuses its own first bytes as the list link. */
+typedef struct free_block {
+    struct free_block* next;
+} free_block_t;
+
+typedef struct {
+    uintptr_t next;   /* chunk list link */
+    uintptr_t pad;    /* keeps blocks 16-byte aligned */
+} chunk_header_t;
+
+/* One size class of a thread's cache. Counters are written by the owning
+ * thread only; they are atomics so slab_get_stats may read them. */
+typedef struct {
+    free_block_t* head;
+    free_block_t* tail;
+    size_t count;
+    char* bump;                 /* uncarved part of the current chunk */
+    char* bump_end;
+    atomic_ulong allocs;
+    atomic_ulong frees;
+    atomic_ulong remote_frees;
+} slab_bin_t;
+
+typedef struct slab_cache {
+    struct slab_cache* next;    /* registry link, never unlinked */
+    slab_t* slab;
+    unsigned id;
+    slab_bin_t bins[SLAB_CLASSES];
+} slab_cache_t;
+
+static size_t block_size(int cls) {
+    return (size_t)SLAB_MIN_BLOCK << cls;
+}
+
+static size_t cache_limit(int cls) {
+    size_t n = SLAB_CACHE_BYTES / block_size(cls);
+    return n < SLAB_CHUNK_MIN_BLOCKS ? SLAB_CHUNK_MIN_BLOCKS : n;
+}
+
+static void count_one(atomic_ulong* counter) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+/* Push the chain first..last onto the depot. Pushes only ever CAS the head
+ * against a value they link behind, so a recycled head cannot corrupt the
+ * stack; the only pop is take_depot's exchange. */
+static void push_depot(slab_class_t* cls, free_block_t* first, free_block_t* last) {
+    uintptr_t head = atomic_load_explicit(&cls->depot, memory_order_relaxed);
+    do {
+        last->next = (free_block_t*)head;
+    } while (!atomic_compare_exchange_weak_explicit(&cls->depot, &head, (uintptr_t)first,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+static void flush_bin(slab_t* slab, slab_bin_t* bin, int cls) {
+    if (!bin->head) {
+        return;
+    }
+    push_depot(&slab->classes[cls], bin->head, bin->tail);
+    bin->head = NULL;
+    bin->tail = NULL;
+    bin->count = 0;
+}
+
+/* Thread exit: hand cached blocks to the other threads. The cache itself
+ * stays registered for its counters until slab_destroy. */
+static void retire_cache(void* arg) {
+    slab_cache_t* cache = (slab_cache_t*)arg;
+    for (int i = 0; i < SLAB_CLASSES; ++i) {
+        flush_bin(cache->slab, &cache->bins[i], i);
+        cache->bins[i].bump = NULL;
+        cache->bins[i].bump_end = NULL;
+    }
+}
+
+int slab_init(slab_t* slab) {
+    if (!slab) {
+        return -1;
+    }
+    for (int i = 0; i < SLAB_CLASSES; ++i) {
+        atomic_init(&slab->classes[i].depot, 0);
+        atomic_init(&slab->classes[i].reserved, 0);
+    }
+    atomic_init(&slab->caches, 0);
+    atomic_init(&slab->chunks, 0);
+    atomic_init(&slab->next_id, 0);
+    atomic_init(&slab->large_allocs, 0);
+    atomic_init(&slab->large_frees, 0);
+    if (pthread_key_create(&slab->key, retire_cache) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void slab_destroy(slab_t* slab) {
+    if (!slab) {
+        return;
+    }
+    /* deleting the key runs no destructors: the caches are freed below */
+    pthread_key_delete(slab->key);
+    slab_cache_t* cache = (slab_cache_t*)atomic_exchange(&slab->caches, 0);
+    while (cache) {
+        slab_cache_t* next = cache->next;
+        free(cache);
+        cache = next;
+    }
+    chunk_header_t* chunk = (chunk_header_t*)atomic_exchange(&slab->chunks, 0);
+    while (chunk) {
+        chunk_header_t* next = (chunk_header_t*)chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    for (int i = 0; i < SLAB_CLASSES; ++i) {
+        atomic_store(&slab->classes[i].depot, 0);
+    }
+}
+
+static slab_cache_t* get_cache(slab_t* slab) {
+    slab_cache_t* cache = (slab_cache_t*)pthread_getspecific(slab->key);
+    if (cache) {
+        return cache;
+    }
+    cache = (slab_cache_t*)calloc(1, sizeof(*cache));
+    if (!cache) {
+        return NULL;
+    }
+    cache->slab = slab;
+    cache->id = atomic_fetch_add(&slab->next_id, 1) + 1;
+    for (int i = 0; i < SLAB_CLASSES; ++i) {
+        atomic_init(&cache->bins[i].allocs, 0);
+        atomic_init(&cache->bins[i].frees, 0);
+        atomic_init(&cache->bins[i].remote_frees, 0);
+    }
+    if (pthread_setspecific(slab->key, cache) != 0) {
+        free(cache);
+        return NULL;
+    }
+    uintptr_t head = atomic_load(&slab->caches);
+    do {
+        cache->next = (slab_cache_t*)head;
+    } while (!atomic_compare_exchange_weak(&slab->caches, &head, (uintptr_t)cache));
+    return cache;
+}
+
+static void* alloc_large(slab_t* slab, size_t len) {
+    slab_header_t* hdr = (slab_header_t*)malloc(sizeof(slab_header_t) + len);
+    if (!hdr) {
+        return NULL;
+    }
+    hdr->cls = SLAB_LARGE;
+    hdr->owner = 0;
+    hdr->size = len;
+    atomic_fetch_add_explicit(&slab->large_allocs, 1, memory_order_relaxed);
+    return hdr + 1;
+}
+
+/* Take every block other threads gave back for this class. */
+static void take_depot(slab_t* slab, slab_bin_t* bin, int cls) {
+    free_block_t* first = (free_block_t*)atomic_exchange_explicit(&slab->classes[cls].depot, 0,
+                                                                  memory_order_acquire);
+    if (!first) {
+        return;
+    }
+    size_t n = 1;
+    free_block_t* last = first;
+    while (last->next) {
+        last = last->next;
+        n++;
+    }
+    bin->head = first;
+    bin->tail = last;
+    bin->count = n;
+}
+
+/* Carve one block from the current chunk, starting a new chunk if needed. */
+static void* carve(slab_t* slab, slab_bin_t* bin, int cls) {
+    size_t size = block_size(cls);
+    if (bin->bump == bin->bump_end) {
+        size_t bytes = SLAB_CHUNK_BYTES;
+        if (bytes < size * SLAB_CHUNK_MIN_BLOCKS) {
+            bytes = size * SLAB_CHUNK_MIN_BLOCKS;
+        }
+        chunk_header_t* chunk = (chunk_header_t*)malloc(sizeof(chunk_header_t) + bytes);
+        if (!chunk) {
+            return NULL;
+        }
+        uintptr_t head = atomic_load(&slab->chunks);
+        do {
+            chunk->next = head;
+        } while (!atomic_compare_exchange_weak(&slab->chunks, &head, (uintptr_t)chunk));
+        atomic_fetch_add_explicit(&slab->classes[cls].reserved, bytes, memory_order_relaxed);
+        bin->bump = (char*)(chunk + 1);
+        bin->bump_end = bin->bump + bytes;
+    }
+    void* block = bin->bump;
+    bin->bump += size;
+    return block;
+}
+
+void* slab_alloc(slab_t* slab, size_t len) {
+    if (!slab) {
+        return malloc(len ? len : 1);
+    }
+    if (len > SLAB_MAX_BLOCK - sizeof(slab_header_t)) {
+        return alloc_large(slab, len);
+    }
+    int cls = 0;
+    while (block_size(cls) < len + sizeof(slab_header_t)) {
+        cls++;
+    }
+    slab_cache_t* cache = get_cache(slab);
+    if (!cache) {
+        return alloc_large(slab, len);
+    }
+
+    slab_bin_t* bin = &cache->bins[cls];
+    if (!bin->head) {
+        take_depot(slab, bin, cls);
+    }
+    void* block;
+    if (bin->head) {
+        block = bin->head;
+        bin->head = bin->head->next;
+        if (!bin->head) {
+            bin->tail = NULL;
+        }
+        bin->count--;
+    } else if (!(block = carve(slab, bin, cls))) {
+        return alloc_large(slab, len);
+    }
+    count_one(&bin->allocs);
+
+    slab_header_t* hdr = (slab_header_t*)block;
+    hdr->cls = (uint32_t)cls;
+    hdr->owner = cache->id;
+    hdr->size = block_size(cls) - sizeof(slab_header_t);
+    return hdr + 1;
+}
+
+void slab_free(slab_t* slab, void* ptr) {
+    if (!slab) {
+        free(ptr);
+        return;
+    }
+    if (!ptr) {
+        return;
+    }
+    slab_header_t* hdr = (slab_header_t*)ptr - 1;
+    if (hdr->cls == SLAB_LARGE) {
+        atomic_fetch_add_explicit(&slab->large_frees, 1, memory_order_relaxed);
+        free(hdr);
+        return;
+    }
+
+    int cls = (int)hdr->cls;
+    uint32_t owner = hdr->owner;
+    free_block_t* block = (free_block_t*)hdr;
+    slab_cache_t* cache = get_cache(slab);
+    if (!cache) {
+        push_depot(&slab->classes[cls], block, block);
+        return;
+    }
+
+    slab_bin_t* bin = &cache->bins[cls];
+    block->next = bin->head;
+    bin->head = block;
+    if (!bin->tail) {
+        bin->tail = block;
+    }
+    bin->count++;
+    count_one(&bin->frees);
+    if (owner != cache->id) {
+        count_one(&bin->remote_frees);
+    }
+    if (bin->count > cache_limit(cls)) {
+        flush_bin(slab, bin, cls);
+    }
+}
+
+size_t slab_usable_size(slab_t* slab, const void* ptr) {
+    if (!slab || !ptr) {
+        return 0;
+    }
+    return (size_t)((const slab_header_t*)ptr - 1)->size;
+}
+
+void slab_get_stats(slab_t* slab, slab_class_stats_t stats[SLAB_STAT_SLOTS]) {
+    if (!slab || !stats) {
+        return;
+    }
+    for (int i = 0; i < SLAB_CLASSES; ++i) {
+        stats[i].block_size = block_size(i);
+        stats[i].allocs = 0;
+        stats[i].frees = 0;
+        stats[i].remote_frees = 0;
+        stats[i].reserved = atomic_load_explicit(&slab->classes[i].reserved, memory_order_relaxed);
+    }
+    for (slab_cache_t* cache = (slab_cache_t*)atomic_load(&slab->caches); cache; cache = cache->next) {
+        for (int i = 0; i < SLAB_CLASSES; ++i) {
+            slab_bin_t* bin = &cache->bins[i];
+            stats[i].allocs += atomic_load_explicit(&bin->allocs, memory_order_relaxed);
+            stats[i].frees += atomic_load_explicit(&bin->frees, memory_order_relaxed);
+            stats[i].remote_frees += atomic_load_explicit(&bin->remote_frees, memory_order_relaxed);
+        }
+    }
+    stats[SLAB_LARGE].block_size = 0;
+    stats[SLAB_LARGE].allocs = atomic_load_explicit(&slab->large_allocs, memory_order_relaxed);
+    stats[SLAB_LARGE].frees = atomic_load_explicit(&slab->large_frees, memory_order_relaxed);
+    stats[SLAB_LARGE].remote_frees = 0;
+    stats[SLAB_LARGE].reserved = 0;
+}
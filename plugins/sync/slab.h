@@ -0,0 +1,85 @@
+#ifndef SYNC_SLAB_H
+#define SYNC_SLAB_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+/* Keeps the shared depots and the cache list off each other's lines. */
+#define SLAB_CACHE_LINE 64
+
+/* Size classes are powers of two, SLAB_MIN_BLOCK..SLAB_MAX_BLOCK bytes per
+ * block including the header; larger requests go to malloc. */
+#define SLAB_CLASSES   12
+#define SLAB_MIN_BLOCK 32
+#define SLAB_MAX_BLOCK (SLAB_MIN_BLOCK << (SLAB_CLASSES - 1))
+
+/* Stats slot for requests over SLAB_MAX_BLOCK. */
+#define SLAB_LARGE     SLAB_CLASSES
+#define SLAB_STAT_SLOTS (SLAB_CLASSES + 1)
+
+struct slab_cache;
+
+/* Per-class free blocks shared between threads. */
+typedef struct {
+    _Alignas(SLAB_CACHE_LINE) atomic_uintptr_t depot; /* lock-free stack of free blocks */
+    atomic_size_t reserved;                           /* bytes carved from chunks */
+} slab_class_t;
+
+/*
+ * Size-classed allocator for record buffers, shared by the host and every
+ * plugin of a pipeline.
+ *
+ * Each thread allocates from and frees into its own cache, found through a
+ * pthread key, so the common path takes no locks and no atomics. Records
+ * mostly die on a different thread than the one that made them: the
+ * consumer's cache fills up while the producer's runs dry. A cache that
+ * grows past its limit pushes its whole free list for that class onto the
+ * class depot with a single CAS, and an empty cache takes the entire depot
+ * with a single exchange. Whole-list take-and-push cannot suffer ABA, so
+ * the depot needs neither tags nor locks. Blocks are carved from chunks
+ * that are only returned by slab_destroy.
+ */
+typedef struct slab {
+    slab_class_t classes[SLAB_CLASSES];
+    pthread_key_t key;                  /* this thread's struct slab_cache */
+    _Alignas(SLAB_CACHE_LINE) atomic_uintptr_t caches; /* every cache, for stats */
+    atomic_uintptr_t chunks;            /* every chunk, for slab_destroy */
+    atomic_uint next_id;                /* cache ids, for remote-free stats */
+    atomic_ulong large_allocs;
+    atomic_ulong large_frees;
+} slab_t;
+
+typedef struct {
+    size_t block_size;          /* bytes per block, 0 for the malloc slot */
+    unsigned long allocs;       /* blocks handed out */
+    unsigned long frees;        /* blocks given back */
+    unsigned long remote_frees; /* ... by a thread other than the allocating one */
+    size_t reserved;            /* bytes carved from chunks */
+} slab_class_stats_t;
+
+/* Returns 0 on success, -1 on failure. */
+int    slab_init(slab_t* slab);
+
+/* Returns every chunk to the system. Outstanding blocks become invalid. */
+void   slab_destroy(slab_t* slab);
+
+/*
+ * Allocate len bytes, 16-byte aligned. With slab NULL this is malloc and
+ * slab_free is free, so callers can take the allocator as an option.
+ */
+void*  slab_alloc(slab_t* slab, size_t len);
+
+/* Free a block from slab_alloc on the same slab, from any thread. */
+void   slab_free(slab_t* slab, void* ptr);
+
+/* Bytes usable in a block returned by slab_alloc. */
+size_t slab_usable_size(slab_t* slab, const void* ptr);
+
+/*
+ * Totals per size class, SLAB_LARGE last. Counters are kept per thread and
+ * summed here; they are exact once the allocating threads have stopped.
+ */
+void   slab_get_stats(slab_t* slab, slab_class_stats_t stats[SLAB_STAT_SLOTS]);
+
+#endif // SYNC_SLAB_H
@@ -0,0 +1,182 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L /* mkstemp, pread, pwrite */
+#endif
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "spill_file.h"
+
+#define SPILL_END UINT64_MAX
+
+int spill_open(spill_file_t* spill, const char* dir) {
+    if (!spill || !dir || !*dir) return -1;
+
+    char path[4096];
+    int n = snprintf(path, sizeof(path), "%s/os-pipeline-spill-XXXXXX", dir);
+    if (n < 0 || (size_t)n >= sizeof(path)) return -1;
+    spill->fd = mkstemp(path);
+    if (spill->fd < 0) return -1;
+    (void)unlink(path);
+
+    spill->wbuf = (char*)malloc(SPILL_BLOCK);
+    spill->rbuf = (char*)malloc(SPILL_BLOCK);
+    if (!spill->wbuf || !spill->rbuf) {
+        spill_close(spill);
+        return -1;
+    }
+    spill->wlen = 0;
+    spill->rpos = 0;
+    spill->rlen = 0;
+    spill->file_end = 0;
+    spill->read_off = 0;
+    spill->records = 0;
+    spill->spilled = 0;
+    return 0;
+}
+
+void spill_close(spill_file_t* spill) {
+    if (!spill) return;
+    if (spill->fd >= 0) close(spill->fd);
+    spill->fd = -1;
+    free(spill->wbuf);
+    free(spill->rbuf);
+    spill->wbuf = NULL;
+    spill->rbuf = NULL;
+}
+
+static int write_at(int fd, const char* buf, size_t len, off_t off) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+        off += n;
+    }
+    return 0;
+}
+
+/* Best effort: bytes left past file_end are never read, only overwritten. */
+static void truncate_to(spill_file_t* spill, off_t len) {
+    int rc = ftruncate(spill->fd, len);
+    (void)rc;
+}
+
+static int flush(spill_file_t* spill) {
+    if (spill->wlen == 0) return 0;
+    if (write_at(spill->fd, spill->wbuf, spill->wlen, spill->file_end) != 0) return -1;
+    spill->file_end += (off_t)spill->wlen;
+    spill->wlen = 0;
+    return 0;
+}
+
+int spill_append(spill_file_t* spill, const char* data, size_t len, int end) {
+    uint64_t hdr = end ? SPILL_END : (uint64_t)len;
+    size_t size = sizeof(hdr) + (end ? 0 : len);
+
+    if (spill->wlen + size > SPILL_BLOCK && flush(spill) != 0) return -1;
+    if (size <= SPILL_BLOCK) {
+        memcpy(spill->wbuf + spill->wlen, &hdr, sizeof(hdr));
+        if (!end) memcpy(spill->wbuf + spill->wlen + sizeof(hdr), data, len);
+        spill->wlen += size;
+    } else {
+        /* larger than a block: straight to the file behind the flushed data */
+        if (write_at(spill->fd, (const char*)&hdr, sizeof(hdr), spill->file_end) != 0 ||
+            write_at(spill->fd, data, len, spill->file_end + (off_t)sizeof(hdr)) != 0) {
+            truncate_to(spill, spill->file_end);
+            return -1;
+        }
+        spill->file_end += (off_t)size;
+    }
+    spill->records++;
+    spill->spilled++;
+    return 0;
+}
+
+/* Make unread bytes available in rbuf. Returns -1 if there are none. */
+static int refill(spill_file_t* spill) {
+    if (spill->read_off < spill->file_end) {
+        off_t left = spill->file_end - spill->read_off;
+        size_t want = left < SPILL_BLOCK ? (size_t)left : SPILL_BLOCK;
+        ssize_t n;
+        do {
+            n = pread(spill->fd, spill->rbuf, want, spill->read_off);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) return -1;
+        spill->rlen = (size_t)n;
+        spill->read_off += n;
+    } else if (spill->wlen > 0) {
+        /* caught up with the file: take the pending block as-is */
+        char* tmp = spill->rbuf;
+        spill->rbuf = spill->wbuf;
+        spill->rlen = spill->wlen;
+        spill->wbuf = tmp;
+        spill->wlen = 0;
+    } else {
+        return -1;
+    }
+    spill->rpos = 0;
+    return 0;
+}
+
+static int read_bytes(spill_file_t* spill, char* dst, size_t len) {
+    while (len > 0) {
+        if (spill->rpos == spill->rlen && refill(spill) != 0) return -1;
+        size_t n = spill->rlen - spill->rpos;
+        if (n > len) n = len;
+        memcpy(dst, spill->rbuf + spill->rpos, n);
+        spill->rpos += n;
+        dst += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Everything has been read back: start the file over. */
+static void reset_if_drained(spill_file_t* spill) {
+    if (spill->records > 0) return;
+    if (spill->file_end > 0) truncate_to(spill, 0);
+    spill->file_end = 0;
+    spill->read_off = 0;
+    spill->rpos = 0;
+    spill->rlen = 0;
+    spill->wlen = 0;
+}
+
+/* A record could not be read back; nothing after it can be trusted. */
+static int discard_rest(spill_file_t* spill) {
+    spill->records = 0;
+    reset_if_drained(spill);
+    return -1;
+}
+
+int spill_take(spill_file_t* spill, slab_t* slab, record_t* out) {
+    uint64_t hdr;
+    if (spill->records == 0) return -1;
+    if (read_bytes(spill, (char*)&hdr, sizeof(hdr)) != 0) return discard_rest(spill);
+    spill->records--;
+    if (hdr == SPILL_END) {
+        reset_if_drained(spill);
+        *out = record_end();
+        return 0;
+    }
+
+    char* item = (hdr < SIZE_MAX) ? (char*)slab_alloc(slab, (size_t)hdr + 1) : NULL;
+    if (!item || read_bytes(spill, item, (size_t)hdr) != 0) {
+        slab_free(slab, item);
+        return discard_rest(spill);
+    }
+    item[hdr] = '\0';
+    reset_if_drained(spill);
+    out->data = item;
+    out->len = (size_t)hdr;
+    out->cap = (size_t)hdr + 1;
+    out->flags = 0;
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef SYNC_SPILL_FILE_H
+#define SYNC_SPILL_FILE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "record.h"
+#include "slab.h"
+
+/* Write and read-back granularity. */
+#define SPILL_BLOCK (64 * 1024)
+
+/*
+ * Append-only FIFO of records in an unlinked temp file.
+ *
+ * Appends collect in wbuf and reach the file one SPILL_BLOCK at a time;
+ * reads pull a SPILL_BLOCK back into rbuf. Once the reader has caught up
+ * with the file, records still in wbuf are handed over by swapping the two
+ * buffers, so recent spills never make a round trip through the disk. The
+ * file is truncated whenever it has been read back completely.
+ *
+ * Not thread-safe: the owning queue serializes access.
+ */
+typedef struct {
+    int fd;                   /* unlinked temp file */
+    char* wbuf;               /* appended, not yet written */
+    size_t wlen;
+    char* rbuf;               /* read back, not yet taken */
+    size_t rpos;
+    size_t rlen;
+    off_t file_end;           /* bytes written to the file */
+    off_t read_off;           /* file offset just past rbuf */
+    size_t records;           /* appended and not yet taken */
+    unsigned long spilled;    /* records ever appended */
+} spill_file_t;
+
+/* Create the temp file in dir. Returns 0 on success, -1 on failure. */
+int    spill_open(spill_file_t* spill, const char* dir);
+void   spill_close(spill_file_t* spill);
+
+/* Append a record; end marks the end-of-stream marker (data ignored).
+ * Returns 0, or -1 on a write error with nothing appended. */
+int    spill_append(spill_file_t* spill, const char* data, size_t len, int end);
+
+/*
+ * Take the oldest record into *out: a NUL-terminated copy from
+ * slab_alloc(slab), or the end-of-stream marker. Returns 0, or -1 on a read
+ * or allocation error, after which the remaining records are discarded.
+ */
+int    spill_take(spill_file_t* spill, slab_t* slab, record_t* out);
+
+#endif // SYNC_SPILL_FILE_H
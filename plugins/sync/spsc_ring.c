@@ -0,0 +1,190 @@
+#include <stdlib.h>
+
+#include "cpu_pause.h"
+#include "spsc_ring.h"
+
+int spsc_ring_init(spsc_ring_t* ring, size_t capacity) {
+    if (!ring || capacity == 0) return -1;
+
+    ring->slots = (record_t*)calloc(capacity, sizeof(record_t));
+    if (!ring->slots) return -1;
+    ring->capacity = capacity;
+    ring->cached_head = 0;
+    ring->cached_tail = 0;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->closed, 0);
+    atomic_init(&ring->consumer_parked, 0);
+    atomic_init(&ring->producer_parked, 0);
+    ring->policy.spin_iters = SPSC_DEFAULT_SPIN;
+    ring->policy.yield_iters = 0;
+    wait_stats_init(&ring->consumer_waits);
+    wait_stats_init(&ring->producer_waits);
+
+    if (monitor_init(&ring->not_empty) != 0) {
+        free(ring->slots);
+        ring->slots = NULL;
+        return -1;
+    }
+    if (monitor_init(&ring->not_full) != 0) {
+        monitor_destroy(&ring->not_empty);
+        free(ring->slots);
+        ring->slots = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void spsc_ring_destroy(spsc_ring_t* ring) {
+    if (!ring) return;
+    monitor_destroy(&ring->not_full);
+    monitor_destroy(&ring->not_empty);
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+static int producer_ready(void* arg) {
+    spsc_ring_t* ring = (spsc_ring_t*)arg;
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    return tail - atomic_load_explicit(&ring->head, memory_order_acquire) < ring->capacity;
+}
+
+/* Producer: wait until at least one slot is free. Returns the free count. */
+static size_t wait_not_full(spsc_ring_t* ring, size_t tail) {
+    int waited = 0;
+    wait_phase_t phase = WAIT_PHASE_SPIN;
+
+    while (tail - ring->cached_head >= ring->capacity) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail - ring->cached_head < ring->capacity) break;
+        if (!waited) {
+            waited = 1;
+            phase = wait_policy_poll(&ring->policy, producer_ready, ring);
+            continue;
+        }
+        /* Advertise that we are about to sleep, then re-check before parking
+         * so a pop that raced with us is never missed. */
+        phase = WAIT_PHASE_PARK;
+        atomic_store(&ring->producer_parked, 1);
+        ring->cached_head = atomic_load(&ring->head);
+        if (tail - ring->cached_head >= ring->capacity) {
+            (void)monitor_wait(&ring->not_full);
+        }
+        atomic_store_explicit(&ring->producer_parked, 0, memory_order_relaxed);
+    }
+    if (waited) {
+        wait_stats_record(&ring->producer_waits, phase);
+    }
+    return ring->capacity - (tail - ring->cached_head);
+}
+
+static void publish_tail(spsc_ring_t* ring, size_t tail) {
+    atomic_store(&ring->tail, tail);
+    if (atomic_load(&ring->consumer_parked)) {
+        monitor_signal(&ring->not_empty);
+    }
+}
+
+void spsc_ring_push(spsc_ring_t* ring, const record_t* item) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    (void)wait_not_full(ring, tail);
+    ring->slots[tail % ring->capacity] = *item;
+    publish_tail(ring, tail + 1);
+}
+
+void spsc_ring_push_batch(spsc_ring_t* ring, const record_t* items, size_t count) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t done = 0;
+    while (done < count) {
+        size_t room = wait_not_full(ring, tail);
+        size_t n = count - done < room ? count - done : room;
+        for (size_t i = 0; i < n; ++i) {
+            ring->slots[(tail + i) % ring->capacity] = items[done + i];
+        }
+        tail += n;
+        done += n;
+        publish_tail(ring, tail);
+    }
+}
+
+void spsc_ring_close(spsc_ring_t* ring) {
+    atomic_store(&ring->closed, 1);
+    if (atomic_load(&ring->consumer_parked)) {
+        monitor_signal(&ring->not_empty);
+    }
+}
+
+int spsc_ring_is_closed(spsc_ring_t* ring) {
+    return atomic_load_explicit(&ring->closed, memory_order_acquire);
+}
+
+static int consumer_ready(void* arg) {
+    spsc_ring_t* ring = (spsc_ring_t*)arg;
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    return atomic_load_explicit(&ring->tail, memory_order_acquire) != head ||
+           atomic_load_explicit(&ring->closed, memory_order_acquire);
+}
+
+/* Consumer: wait until at least one item is readable. Returns the readable
+ * count, or 0 once the ring is empty and closed. */
+static size_t wait_not_empty(spsc_ring_t* ring, size_t head) {
+    int waited = 0;
+    wait_phase_t phase = WAIT_PHASE_SPIN;
+
+    while (head == ring->cached_tail) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head != ring->cached_tail) break;
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+            /* closed is published after the last push; one more look. */
+            ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            break;
+        }
+        if (!waited) {
+            waited = 1;
+            phase = wait_policy_poll(&ring->policy, consumer_ready, ring);
+            continue;
+        }
+        phase = WAIT_PHASE_PARK;
+        atomic_store(&ring->consumer_parked, 1);
+        ring->cached_tail = atomic_load(&ring->tail);
+        if (head == ring->cached_tail && !atomic_load(&ring->closed)) {
+            (void)monitor_wait(&ring->not_empty);
+        }
+        atomic_store_explicit(&ring->consumer_parked, 0, memory_order_relaxed);
+    }
+    if (waited) {
+        wait_stats_record(&ring->consumer_waits, phase);
+    }
+    return ring->cached_tail - head;
+}
+
+static size_t take_slots(spsc_ring_t* ring, size_t head, record_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = ring->slots[(head + i) % ring->capacity];
+    }
+    atomic_store(&ring->head, head + n);
+    if (atomic_load(&ring->producer_parked)) {
+        monitor_signal(&ring->not_full);
+    }
+    return n;
+}
+
+int spsc_ring_pop(spsc_ring_t* ring, record_t* out) {
+    return spsc_ring_pop_batch(ring, out, 1) == 1;
+}
+
+size_t spsc_ring_pop_batch(spsc_ring_t* ring, record_t* out, size_t max) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t avail = wait_not_empty(ring, head);
+    if (avail == 0 || max == 0) return 0;
+    return take_slots(ring, head, out, avail < max ? avail : max);
+}
+
+int spsc_ring_try_pop(spsc_ring_t* ring, record_t* out) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head == ring->cached_tail) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head == ring->cached_tail) return 0;
+    }
+    return (int)take_slots(ring, head, out, 1);
+}
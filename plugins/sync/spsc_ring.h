@@ -0,0 +1,77 @@
+#ifndef SYNC_SPSC_RING_H
+#define SYNC_SPSC_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "monitor.h"
+#include "record.h"
+#include "wait_policy.h"
+
+#define SPSC_CACHE_LINE 64
+
+/*
+ * Bounded single-producer/single-consumer ring of record_t slots.
+ *
+ * head and tail are free-running counters published with release stores
+ * and read with acquire loads, so the fast path takes no locks. Each side
+ * keeps a private copy of the other side's index and only reloads it when
+ * the ring looks full (producer) or empty (consumer). A side that runs out
+ * of room parks on a monitor after advertising itself in *_parked; the other
+ * side only touches the monitor when it sees that flag. How long a side
+ * spins and yields before parking is set by its wait_policy_t.
+ */
+typedef struct {
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t head;  /* next slot to consume */
+    size_t cached_tail;                            /* consumer's view of tail */
+    atomic_int consumer_parked;                    /* consumer sleeping on not_empty */
+
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t tail;  /* next slot to produce */
+    size_t cached_head;                            /* producer's view of head */
+    atomic_int producer_parked;                    /* producer sleeping on not_full */
+
+    _Alignas(SPSC_CACHE_LINE) record_t* slots;     /* ring storage */
+    size_t capacity;                               /* number of slots */
+    atomic_int closed;                             /* producer published <END> */
+    monitor_t not_empty;                           /* wakes a parked consumer */
+    monitor_t not_full;                            /* wakes a parked producer */
+    wait_policy_t policy;                          /* spin/yield budget before parking */
+    wait_stats_t consumer_waits;                   /* how empty-ring waits ended */
+    wait_stats_t producer_waits;                   /* how full-ring waits ended */
+} spsc_ring_t;
+
+/* Default policy: a short spin, no yielding. */
+#define SPSC_DEFAULT_SPIN 128
+
+/* Returns 0 on success, -1 on failure. */
+int   spsc_ring_init(spsc_ring_t* ring, size_t capacity);
+void  spsc_ring_destroy(spsc_ring_t* ring);
+
+/* Producer side. Blocks while the ring is full. Never fails. */
+void  spsc_ring_push(spsc_ring_t* ring, const record_t* item);
+
+/* Producer side. Pushes all items, publishing the tail once per free run. */
+void  spsc_ring_push_batch(spsc_ring_t* ring, const record_t* items, size_t count);
+
+/* Producer side. Marks the ring closed; consumers drain what is left. */
+void  spsc_ring_close(spsc_ring_t* ring);
+
+/*
+ * Consumer side. Blocks while the ring is empty and open, then takes the
+ * oldest item. Returns 1, or 0 once the ring is empty and closed.
+ */
+int   spsc_ring_pop(spsc_ring_t* ring, record_t* out);
+
+/*
+ * Consumer side. Blocks like spsc_ring_pop, then takes every readable item
+ * up to max. Returns the number taken, 0 once the ring is empty and closed.
+ */
+size_t spsc_ring_pop_batch(spsc_ring_t* ring, record_t* out, size_t max);
+
+/* Consumer side. Returns 0 immediately if the ring is empty, else 1. */
+int   spsc_ring_try_pop(spsc_ring_t* ring, record_t* out);
+
+/* Either side: 1 if the producer has closed the ring. */
+int   spsc_ring_is_closed(spsc_ring_t* ring);
+
+#endif // SYNC_SPSC_RING_H
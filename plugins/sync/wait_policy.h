@@ -0,0 +1,67 @@
+#ifndef SYNC_WAIT_POLICY_H
+#define SYNC_WAIT_POLICY_H
+
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "cpu_pause.h"
+
+/*
+ * How a blocked producer or consumer waits: poll with cpu_pause() up to
+ * spin_iters times, then poll with sched_yield() up to yield_iters times,
+ * and only then park on the queue's monitor.
+ */
+typedef struct {
+    int spin_iters;
+    int yield_iters;
+} wait_policy_t;
+
+typedef enum {
+    WAIT_PHASE_SPIN = 0,    /* resolved while busy-spinning */
+    WAIT_PHASE_YIELD,       /* resolved after yielding the CPU */
+    WAIT_PHASE_PARK,        /* had to park in the kernel */
+    WAIT_PHASE_COUNT
+} wait_phase_t;
+
+/* Number of waits that ended in each phase. */
+typedef struct {
+    atomic_ulong hits[WAIT_PHASE_COUNT];
+} wait_stats_t;
+
+static inline void wait_stats_init(wait_stats_t* stats) {
+    for (int i = 0; i < WAIT_PHASE_COUNT; ++i) {
+        atomic_init(&stats->hits[i], 0);
+    }
+}
+
+static inline void wait_stats_record(wait_stats_t* stats, wait_phase_t phase) {
+    atomic_fetch_add_explicit(&stats->hits[phase], 1, memory_order_relaxed);
+}
+
+static inline unsigned long wait_stats_get(wait_stats_t* stats, wait_phase_t phase) {
+    return atomic_load_explicit(&stats->hits[phase], memory_order_relaxed);
+}
+
+/* Whether the policy polls at all before parking. */
+static inline int wait_policy_polls(const wait_policy_t* policy) {
+    return policy->spin_iters > 0 || policy->yield_iters > 0;
+}
+
+/*
+ * Run the spin and yield phases until ready(arg) returns non-zero.
+ * Returns the phase that saw it, or WAIT_PHASE_PARK if the caller must sleep.
+ */
+static inline wait_phase_t wait_policy_poll(const wait_policy_t* policy,
+                                            int (*ready)(void*), void* arg) {
+    for (int i = 0; i < policy->spin_iters; ++i) {
+        if (ready(arg)) return WAIT_PHASE_SPIN;
+        cpu_pause();
+    }
+    for (int i = 0; i < policy->yield_iters; ++i) {
+        if (ready(arg)) return WAIT_PHASE_YIELD;
+        sched_yield();
+    }
+    return WAIT_PHASE_PARK;
+}
+
+#endif // SYNC_WAIT_POLICY_H
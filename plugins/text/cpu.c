@@ -0,0 +1,51 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+static const char* const NAMES[TEXT_ISA_COUNT] = { "scalar", "sse2", "avx2", "avx512" };
+
+const char* text_isa_name(text_isa_t isa) {
+    return (unsigned)isa < TEXT_ISA_COUNT ? NAMES[isa] : "unknown";
+}
+
+int text_cpu_has(text_isa_t isa) {
+    switch (isa) {
+    case TEXT_ISA_SCALAR:
+        return 1;
+#if TEXT_X86
+    /* cpuid, plus xgetbv for the AVX register state the OS saves */
+    case TEXT_ISA_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2") != 0;
+    case TEXT_ISA_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    case TEXT_ISA_AVX512:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512bw") != 0;
+#endif
+    default:
+        return 0;
+    }
+}
+
+const char* text_isa_limit(text_isa_t* out) {
+    text_isa_t cap = TEXT_ISA_COUNT - 1;
+    const char* env = getenv(TEXT_SIMD_ENV);
+    if (env && *env && strcmp(env, "auto") != 0) {
+        int i = 0;
+        while (i < TEXT_ISA_COUNT && strcmp(env, NAMES[i]) != 0) {
+            i++;
+        }
+        if (i == TEXT_ISA_COUNT) {
+            return "unknown " TEXT_SIMD_ENV " value";
+        }
+        cap = (text_isa_t)i;
+    }
+    while (cap > TEXT_ISA_SCALAR && !text_cpu_has(cap)) {
+        cap--;
+    }
+    *out = cap;
+    return NULL;
+}
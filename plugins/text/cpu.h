@@ -0,0 +1,36 @@
+#ifndef TEXT_CPU_H
+#define TEXT_CPU_H
+
+/* Vector kernels are built where the compiler can target each ISA per
+ * function; everywhere else only the scalar versions exist. */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TEXT_X86 1
+#else
+#define TEXT_X86 0
+#endif
+
+/* Instruction sets the text kernels come in, weakest first. */
+typedef enum {
+    TEXT_ISA_SCALAR = 0,
+    TEXT_ISA_SSE2,
+    TEXT_ISA_AVX2,
+    TEXT_ISA_AVX512,              /* AVX-512BW */
+    TEXT_ISA_COUNT
+} text_isa_t;
+
+/* Environment variable capping the ISA (host option --simd). */
+#define TEXT_SIMD_ENV "PIPELINE_SIMD"
+
+const char* text_isa_name(text_isa_t isa);
+
+/* Whether this CPU (and OS) can run kernels for isa. */
+int         text_cpu_has(text_isa_t isa);
+
+/*
+ * The ISA to select kernels for: the best one this CPU has, capped by
+ * PIPELINE_SIMD=scalar|sse2|avx2|avx512 ("auto" or unset for no cap).
+ * Returns NULL on success or an error for an unknown value.
+ */
+const char* text_isa_limit(text_isa_t* out);
+
+#endif // TEXT_CPU_H
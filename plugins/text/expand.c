@@ -0,0 +1,100 @@
+#include "expand.h"
+
+#if TEXT_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * The vector kernels unpack a register of input against a register of
+ * separators, which yields two registers of byte/separator pairs. They
+ * stop while at least one input byte is left, so the pair stores never
+ * write past the separator before the last byte; the scalar loop writes
+ * the rest.
+ *
+ * The wide kernels hand their tails to the narrower ones. GCC emits no
+ * vzeroupper before such a tail call, and legacy SSE code running with
+ * dirty upper register halves pays a transition penalty on every
+ * instruction, so the kernels clear them first.
+ */
+
+static void interleave_scalar(char* out, const char* src, size_t len, char sep) {
+    for (size_t i = 0; i + 1 < len; ++i) {
+        *out++ = src[i];
+        *out++ = sep;
+    }
+    *out = src[len - 1];
+}
+
+#if TEXT_X86
+
+__attribute__((target("sse2")))
+static void interleave_sse2(char* out, const char* src, size_t len, char sep) {
+    const __m128i s = _mm_set1_epi8(sep);
+    size_t i = 0;
+    for (; i + 16 < len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(v, s));
+        _mm_storeu_si128((__m128i*)(out + 2 * i + 16), _mm_unpackhi_epi8(v, s));
+    }
+    interleave_scalar(out + 2 * i, src + i, len - i, sep);
+}
+
+/* Unpacks work within 128-bit lanes: order the quadwords 0,2,1,3 first so
+ * the low halves of the two lanes hold input bytes 0-15. */
+__attribute__((target("avx2")))
+static void interleave_avx2(char* out, const char* src, size_t len, char sep) {
+    const __m256i s = _mm256_set1_epi8(sep);
+    size_t i = 0;
+    for (; i + 32 < len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(out + 2 * i), _mm256_unpacklo_epi8(v, s));
+        _mm256_storeu_si256((__m256i*)(out + 2 * i + 32), _mm256_unpackhi_epi8(v, s));
+    }
+    _mm256_zeroupper();
+    interleave_sse2(out + 2 * i, src + i, len - i, sep);
+}
+
+/* Same with four lanes: quadwords 0,4,1,5,2,6,3,7. */
+__attribute__((target("avx512bw")))
+static void interleave_avx512(char* out, const char* src, size_t len, char sep) {
+    const __m512i s = _mm512_set1_epi8(sep);
+    const __m512i order = _mm512_setr_epi64(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 64 < len; i += 64) {
+        __m512i v = _mm512_permutexvar_epi64(order, _mm512_loadu_si512(src + i));
+        _mm512_storeu_si512(out + 2 * i, _mm512_unpacklo_epi8(v, s));
+        _mm512_storeu_si512(out + 2 * i + 64, _mm512_unpackhi_epi8(v, s));
+    }
+    _mm256_zeroupper();
+    interleave_avx2(out + 2 * i, src + i, len - i, sep);
+}
+
+#define X86_KERNEL(fn) fn
+#else
+#define X86_KERNEL(fn) NULL
+#endif
+
+static const text_interleave_fn KERNELS[TEXT_ISA_COUNT] = {
+    interleave_scalar,
+    X86_KERNEL(interleave_sse2),
+    X86_KERNEL(interleave_avx2),
+    X86_KERNEL(interleave_avx512),
+};
+
+text_interleave_fn text_interleave_kernel(text_isa_t isa) {
+    if ((unsigned)isa >= TEXT_ISA_COUNT || !KERNELS[isa] || !text_cpu_has(isa)) {
+        return NULL;
+    }
+    return KERNELS[isa];
+}
+
+text_interleave_fn text_interleave_select(text_isa_t limit) {
+    for (int isa = (int)limit; isa > TEXT_ISA_SCALAR; --isa) {
+        text_interleave_fn fn = text_interleave_kernel((text_isa_t)isa);
+        if (fn) {
+            return fn;
+        }
+    }
+    return interleave_scalar;
+}
@@ -0,0 +1,20 @@
+#ifndef TEXT_EXPAND_H
+#define TEXT_EXPAND_H
+
+#include <stddef.h>
+
+#include "cpu.h"
+
+/*
+ * Copy the len > 0 bytes at src to out with sep between every two of them,
+ * 2 * len - 1 bytes in all. out must not overlap src.
+ */
+typedef void (*text_interleave_fn)(char* out, const char* src, size_t len, char sep);
+
+/* The kernel for exactly isa, or NULL if it is not built or the CPU lacks it. */
+text_interleave_fn text_interleave_kernel(text_isa_t isa);
+
+/* The best kernel at or below limit; never NULL. */
+text_interleave_fn text_interleave_select(text_isa_t limit);
+
+#endif // TEXT_EXPAND_H
@@ -0,0 +1,278 @@
+#include "reverse.h"
+
+#if TEXT_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * The vector kernels work from both ends at once: load a register from the
+ * front and one from the back, reverse the bytes of each and store them
+ * crosswise. A middle of one to two registers is done the same way with
+ * the two registers overlapping; both are loaded before either is stored,
+ * so the shared bytes come out right. A shorter middle goes to the next
+ * narrower kernel.
+ * Before that hand-off the wide kernels clear the upper register halves
+ * (see expand.c).
+ *
+ * UTF-8 reversal first reverses the bytes, which leaves every multi-byte
+ * sequence backwards, continuation bytes first. A vector scan then skips
+ * ASCII and only the sequences it stops at are put back in order.
+ */
+
+typedef size_t (*find_high_fn)(const char* data, size_t len);
+
+static void reverse_scalar(char* data, size_t len) {
+    char* lo = data;
+    char* hi = data + len;
+    while (hi - lo > 1) {
+        char tmp = *lo;
+        *lo++ = *--hi;
+        *hi = tmp;
+    }
+}
+
+/* Index of the first byte >= 0x80, or len. */
+static size_t find_high_scalar(const char* data, size_t len) {
+    size_t i = 0;
+    while (i < len && (unsigned char)data[i] < 0x80) {
+        i++;
+    }
+    return i;
+}
+
+#if TEXT_X86
+
+/* SSE2 has no byte shuffle: reverse the dwords, then the words within each
+ * dword, then the bytes within each word. */
+__attribute__((target("sse2")))
+static inline __m128i reverse_16(__m128i v) {
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+__attribute__((target("sse2")))
+static void reverse_sse2(char* data, size_t len) {
+    char* lo = data;
+    char* hi = data + len;
+    while (hi - lo >= 32) {
+        hi -= 16;
+        __m128i front = _mm_loadu_si128((const __m128i*)lo);
+        __m128i back = _mm_loadu_si128((const __m128i*)hi);
+        _mm_storeu_si128((__m128i*)lo, reverse_16(back));
+        _mm_storeu_si128((__m128i*)hi, reverse_16(front));
+        lo += 16;
+    }
+    if (hi - lo >= 16) {
+        __m128i front = _mm_loadu_si128((const __m128i*)lo);
+        __m128i back = _mm_loadu_si128((const __m128i*)(hi - 16));
+        _mm_storeu_si128((__m128i*)lo, reverse_16(back));
+        _mm_storeu_si128((__m128i*)(hi - 16), reverse_16(front));
+    } else {
+        reverse_scalar(lo, (size_t)(hi - lo));
+    }
+}
+
+__attribute__((target("sse2")))
+static size_t find_high_sse2(const char* data, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(data + i)));
+        if (mask) {
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+        }
+    }
+    return i + find_high_scalar(data + i, len - i);
+}
+
+/* vpshufb reverses within each 128-bit lane; swapping the lanes finishes. */
+__attribute__((target("avx2")))
+static inline __m256i reverse_32(__m256i v) {
+    const __m256i idx = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                         15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    v = _mm256_shuffle_epi8(v, idx);
+    return _mm256_permute2x128_si256(v, v, 0x01);
+}
+
+__attribute__((target("avx2")))
+static void reverse_avx2(char* data, size_t len) {
+    char* lo = data;
+    char* hi = data + len;
+    while (hi - lo >= 64) {
+        hi -= 32;
+        __m256i front = _mm256_loadu_si256((const __m256i*)lo);
+        __m256i back = _mm256_loadu_si256((const __m256i*)hi);
+        _mm256_storeu_si256((__m256i*)lo, reverse_32(back));
+        _mm256_storeu_si256((__m256i*)hi, reverse_32(front));
+        lo += 32;
+    }
+    if (hi - lo >= 32) {
+        __m256i front = _mm256_loadu_si256((const __m256i*)lo);
+        __m256i back = _mm256_loadu_si256((const __m256i*)(hi - 32));
+        _mm256_storeu_si256((__m256i*)lo, reverse_32(back));
+        _mm256_storeu_si256((__m256i*)(hi - 32), reverse_32(front));
+    } else {
+        _mm256_zeroupper();
+        reverse_sse2(lo, (size_t)(hi - lo));
+    }
+}
+
+__attribute__((target("avx2")))
+static size_t find_high_avx2(const char* data, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        int mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(data + i)));
+        if (mask) {
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + find_high_sse2(data + i, len - i);
+}
+
+/* AVX-512BW: same in-lane shuffle, then the four lanes in reverse order. */
+__attribute__((target("avx512bw")))
+static inline __m512i reverse_64(__m512i v) {
+    const __m512i idx = _mm512_broadcast_i32x4(
+        _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+    v = _mm512_shuffle_epi8(v, idx);
+    return _mm512_shuffle_i64x2(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+__attribute__((target("avx512bw")))
+static void reverse_avx512(char* data, size_t len) {
+    char* lo = data;
+    char* hi = data + len;
+    while (hi - lo >= 128) {
+        hi -= 64;
+        __m512i front = _mm512_loadu_si512(lo);
+        __m512i back = _mm512_loadu_si512(hi);
+        _mm512_storeu_si512(lo, reverse_64(back));
+        _mm512_storeu_si512(hi, reverse_64(front));
+        lo += 64;
+    }
+    if (hi - lo >= 64) {
+        __m512i front = _mm512_loadu_si512(lo);
+        __m512i back = _mm512_loadu_si512(hi - 64);
+        _mm512_storeu_si512(lo, reverse_64(back));
+        _mm512_storeu_si512(hi - 64, reverse_64(front));
+    } else {
+        _mm256_zeroupper();
+        reverse_avx2(lo, (size_t)(hi - lo));
+    }
+}
+
+__attribute__((target("avx512bw")))
+static size_t find_high_avx512(const char* data, size_t len) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __mmask64 mask = _mm512_movepi8_mask(_mm512_loadu_si512(data + i));
+        if (mask) {
+            return i + (size_t)__builtin_ctzll(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + find_high_avx2(data + i, len - i);
+}
+
+#define X86_KERNEL(fn) fn
+#else
+#define X86_KERNEL(fn) NULL
+#endif
+
+/* Bytes announced by a lead byte, 0 for anything that is not one. */
+static size_t utf8_seq_len(unsigned char c) {
+    if (c >= 0xC0 && c < 0xE0) return 2;
+    if (c >= 0xE0 && c < 0xF0) return 3;
+    if (c >= 0xF0 && c < 0xF8) return 4;
+    return 0;
+}
+
+/* data has been byte-reversed: put each multi-byte sequence back in order. */
+static void fix_utf8(char* data, size_t len, find_high_fn find_high) {
+    size_t i = 0;
+    while ((i += find_high(data + i, len - i)) < len) {
+        size_t j = i;
+        while (j < len && ((unsigned char)data[j] & 0xC0) == 0x80) {
+            j++;
+        }
+        if (j == len) {
+            break;
+        }
+        size_t n = utf8_seq_len((unsigned char)data[j]);
+        if (n > 0 && n - 1 <= j - i) {
+            reverse_scalar(data + j + 1 - n, n);
+        }
+        i = j + 1;
+    }
+}
+
+static void reverse_utf8_scalar(char* data, size_t len) {
+    reverse_scalar(data, len);
+    fix_utf8(data, len, find_high_scalar);
+}
+
+#if TEXT_X86
+static void reverse_utf8_sse2(char* data, size_t len) {
+    reverse_sse2(data, len);
+    fix_utf8(data, len, find_high_sse2);
+}
+
+static void reverse_utf8_avx2(char* data, size_t len) {
+    reverse_avx2(data, len);
+    fix_utf8(data, len, find_high_avx2);
+}
+
+static void reverse_utf8_avx512(char* data, size_t len) {
+    reverse_avx512(data, len);
+    fix_utf8(data, len, find_high_avx512);
+}
+#endif
+
+static const text_reverse_fn KERNELS[TEXT_ISA_COUNT] = {
+    reverse_scalar,
+    X86_KERNEL(reverse_sse2),
+    X86_KERNEL(reverse_avx2),
+    X86_KERNEL(reverse_avx512),
+};
+
+static const text_reverse_fn UTF8_KERNELS[TEXT_ISA_COUNT] = {
+    reverse_utf8_scalar,
+    X86_KERNEL(reverse_utf8_sse2),
+    X86_KERNEL(reverse_utf8_avx2),
+    X86_KERNEL(reverse_utf8_avx512),
+};
+
+static text_reverse_fn pick(const text_reverse_fn* table, text_isa_t isa) {
+    if ((unsigned)isa >= TEXT_ISA_COUNT || !table[isa] || !text_cpu_has(isa)) {
+        return NULL;
+    }
+    return table[isa];
+}
+
+static text_reverse_fn pick_best(const text_reverse_fn* table, text_isa_t limit) {
+    for (int isa = (int)limit; isa > TEXT_ISA_SCALAR; --isa) {
+        text_reverse_fn fn = pick(table, (text_isa_t)isa);
+        if (fn) {
+            return fn;
+        }
+    }
+    return table[TEXT_ISA_SCALAR];
+}
+
+text_reverse_fn text_reverse_kernel(text_isa_t isa) {
+    return pick(KERNELS, isa);
+}
+
+text_reverse_fn text_reverse_select(text_isa_t limit) {
+    return pick_best(KERNELS, limit);
+}
+
+text_reverse_fn text_reverse_utf8_kernel(text_isa_t isa) {
+    return pick(UTF8_KERNELS, isa);
+}
+
+text_reverse_fn text_reverse_utf8_select(text_isa_t limit) {
+    return pick_best(UTF8_KERNELS, limit);
+}
@@ -0,0 +1,27 @@
+#ifndef TEXT_REVERSE_H
+#define TEXT_REVERSE_H
+
+#include <stddef.h>
+
+#include "cpu.h"
+
+/* Reverse len bytes in place. */
+typedef void (*text_reverse_fn)(char* data, size_t len);
+
+/* The kernel for exactly isa, or NULL if it is not built or the CPU lacks it. */
+text_reverse_fn text_reverse_kernel(text_isa_t isa);
+
+/* The best kernel at or below limit; never NULL. */
+text_reverse_fn text_reverse_select(text_isa_t limit);
+
+/*
+ * UTF-8 forms of the above: reverse the order of code points, keeping the
+ * bytes of each one in order. A multi-byte sequence is kept whole when its
+ * lead byte has at least the continuation bytes it announces; any other
+ * byte, such as a stray continuation or a truncated sequence, is moved as
+ * a byte of its own. Pure ASCII input costs one extra vector scan.
+ */
+text_reverse_fn text_reverse_utf8_kernel(text_isa_t isa);
+text_reverse_fn text_reverse_utf8_select(text_isa_t limit);
+
+#endif // TEXT_REVERSE_H
@@ -0,0 +1,131 @@
+#include "upper.h"
+
+#if TEXT_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * A byte c is a lower-case letter when (unsigned char)(c - 'a') < 26. The
+ * vector kernels test this for a whole register and subtract 0x20 where it
+ * holds. Up-casing is idempotent, so rather than finishing a line byte by
+ * byte they run the last full register again, overlapping the previous one.
+ * Short lines are handed to a narrower kernel with the upper register
+ * halves cleared first (see expand.c).
+ */
+
+static void upper_scalar(char* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)data[i];
+        if ((unsigned char)(c - 'a') < 26) {
+            data[i] = (char)(c - 0x20);
+        }
+    }
+}
+
+#if TEXT_X86
+
+/* SSE2 has signed byte compares only: shift 'a'..'z' to -128..-103. */
+__attribute__((target("sse2")))
+static inline __m128i upper_16(__m128i v) {
+    __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - 'a')));
+    __m128i lower = _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(0x80 + 26)));
+    return _mm_xor_si128(v, _mm_and_si128(lower, _mm_set1_epi8(0x20)));
+}
+
+__attribute__((target("sse2")))
+static void upper_sse2(char* data, size_t len) {
+    if (len < 16) {
+        upper_scalar(data, len);
+        return;
+    }
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        _mm_storeu_si128((__m128i*)(data + i), upper_16(v));
+    }
+    if (i < len) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + len - 16));
+        _mm_storeu_si128((__m128i*)(data + len - 16), upper_16(v));
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i upper_32(__m256i v) {
+    __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - 'a')));
+    __m256i lower = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + 26)), shifted);
+    return _mm256_xor_si256(v, _mm256_and_si256(lower, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+static void upper_avx2(char* data, size_t len) {
+    if (len < 32) {
+        _mm256_zeroupper();
+        upper_sse2(data, len);
+        return;
+    }
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        _mm256_storeu_si256((__m256i*)(data + i), upper_32(v));
+    }
+    if (i < len) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + len - 32));
+        _mm256_storeu_si256((__m256i*)(data + len - 32), upper_32(v));
+    }
+}
+
+/* AVX-512BW compares unsigned into a mask and finishes with a masked
+ * load and store, which never touch the bytes past the end. Masked stores
+ * are slow enough that short lines do better with the AVX2 kernel. */
+__attribute__((target("avx512bw")))
+static void upper_avx512(char* data, size_t len) {
+    if (len < 64) {
+        _mm256_zeroupper();
+        upper_avx2(data, len);
+        return;
+    }
+    const __m512i a = _mm512_set1_epi8('a');
+    const __m512i letters = _mm512_set1_epi8(26);
+    const __m512i flip = _mm512_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i v = _mm512_loadu_si512(data + i);
+        __mmask64 lower = _mm512_cmplt_epu8_mask(_mm512_sub_epi8(v, a), letters);
+        _mm512_storeu_si512(data + i, _mm512_mask_sub_epi8(v, lower, v, flip));
+    }
+    if (i < len) {
+        __mmask64 tail = ~0ULL >> (64 - (len - i));
+        __m512i v = _mm512_maskz_loadu_epi8(tail, data + i);
+        __mmask64 lower = _mm512_cmplt_epu8_mask(_mm512_sub_epi8(v, a), letters);
+        _mm512_mask_storeu_epi8(data + i, tail & lower, _mm512_sub_epi8(v, flip));
+    }
+}
+
+#define X86_KERNEL(fn) fn
+#else
+#define X86_KERNEL(fn) NULL
+#endif
+
+static const text_upper_fn KERNELS[TEXT_ISA_COUNT] = {
+    upper_scalar,
+    X86_KERNEL(upper_sse2),
+    X86_KERNEL(upper_avx2),
+    X86_KERNEL(upper_avx512),
+};
+
+text_upper_fn text_upper_kernel(text_isa_t isa) {
+    if ((unsigned)isa >= TEXT_ISA_COUNT || !KERNELS[isa] || !text_cpu_has(isa)) {
+        return NULL;
+    }
+    return KERNELS[isa];
+}
+
+text_upper_fn text_upper_select(text_isa_t limit) {
+    for (int isa = (int)limit; isa > TEXT_ISA_SCALAR; --isa) {
+        text_upper_fn fn = text_upper_kernel((text_isa_t)isa);
+        if (fn) {
+            return fn;
+        }
+    }
+    return upper_scalar;
+}
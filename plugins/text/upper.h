@@ -0,0 +1,18 @@
+#ifndef TEXT_UPPER_H
+#define TEXT_UPPER_H
+
+#include <stddef.h>
+
+#include "cpu.h"
+
+/* Upper-case ASCII letters in place; every other byte is left alone, as
+ * toupper() does in the C locale. */
+typedef void (*text_upper_fn)(char* data, size_t len);
+
+/* The kernel for exactly isa, or NULL if it is not built or the CPU lacks it. */
+text_upper_fn text_upper_kernel(text_isa_t isa);
+
+/* The best kernel at or below limit; never NULL. */
+text_upper_fn text_upper_select(text_isa_t limit);
+
+#endif // TEXT_UPPER_H
@@ -1,5 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
 #include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,8 +11,32 @@
 #include "plugin_common.h"
 #include "plugin_sdk.h"
 
+/*
+ * The characters go out from a thread of their own, one every g_delay_us
+ * on a fixed schedule, so the pace does not drift with the cost of the
+ * writes. Characters due within one tick of each other share a write.
+ *
+ * process only copies the line into a backlog of g_cap lines, waiting when
+ * it is full, so a burst still backs up into the stage queue. A line is
+ * forwarded once it has been typed, and <END> is held until the backlog is
+ * empty: the next stage sees each line after it appeared, as before.
+ */
+
 static plugin_context_t g_ctx;
 static long g_delay_us = 100000;
+static long g_tick_us = 1000;
+
+static record_t* g_backlog;   /* ring of g_cap lines; the head is being typed */
+static int g_cap;
+static int g_head;
+static int g_count;
+static int g_stop;
+static int g_started;
+static long long g_next_ns;   /* when the next line may start; emitter only */
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_more = PTHREAD_COND_INITIALIZER;   /* a line came or g_stop */
+static pthread_cond_t g_room = PTHREAD_COND_INITIALIZER;   /* a line was typed */
+static pthread_t g_thread;
 
 static void sleep_us(long delay) {
     if (delay <= 0) {
@@ -22,6 +48,19 @@ static void sleep_us(long delay) {
     nanosleep(&ts, NULL);
 }
 
+static long long mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_until(long long deadline) {
+    long long now;
+    while ((now = mono_ns()) < deadline) {
+        sleep_us((long)((deadline - now + 999) / 1000));
+    }
+}
+
 static long parse_delay_env(void) {
     const char* env = getenv("TYPEWRITER_DELAY_US");
     if (!env || !*env) {
@@ -36,41 +75,222 @@ static long parse_delay_env(void) {
     return val;
 }
 
-static char* typewriter_process(char* input) {
-    if (!input) {
-        return NULL;
+/* Positive number from the environment, def if unset. Returns -1 if
+ * malformed. */
+static int env_positive(const char* name, long def, long max, long* out) {
+    const char* env = getenv(name);
+    *out = def;
+    if (!env || !*env) {
+        return 0;
+    }
+    char* end = NULL;
+    errno = 0;
+    long val = strtol(env, &end, 10);
+    if (errno != 0 || end == env || *end != '\0' || val < 1 || val > max) {
+        return -1;
+    }
+    *out = val;
+    return 0;
+}
+
+/* Character i of the line, its newline at i == len, is due at
+ * start + i * delay. The next line starts with this one's newline. */
+static void type_line(const char* data, size_t len) {
+    long long step = (long long)g_delay_us * 1000LL;
+    long long tick = (long long)g_tick_us * 1000LL;
+    long long start = mono_ns();
+    if (start < g_next_ns) {
+        start = g_next_ns;
     }
-    size_t len = strlen(input);
-    for (size_t i = 0; i < len; ++i) {
-        fputc(input[i], stdout);
+    size_t i = 0;
+    while (i <= len) {
+        long long due = start + (long long)i * step;
+        sleep_until(due);
+        size_t j = i + 1;
+        while (j <= len && start + (long long)j * step < due + tick) {
+            j++;
+        }
+        size_t text_end = j <= len ? j : len;
+        flockfile(stdout);
+        fwrite(data + i, 1, text_end - i, stdout);
+        if (j > len) {
+            fputc('\n', stdout);
+        }
         fflush(stdout);
-        sleep_us(g_delay_us);
+        funlockfile(stdout);
+        i = j;
+    }
+    g_next_ns = start + (long long)len * step;
+}
+
+static void* emitter_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_lock);
+    for (;;) {
+        while (g_count == 0 && !g_stop) {
+            pthread_cond_wait(&g_more, &g_lock);
+        }
+        if (g_count == 0) {
+            break;
+        }
+        record_t rec = g_backlog[g_head];
+        pthread_mutex_unlock(&g_lock);
+
+        type_line(rec.data, rec.len);
+        common_plugin_forward(&g_ctx, &rec, 1);
+
+        pthread_mutex_lock(&g_lock);
+        g_head = (g_head + 1) % g_cap;
+        g_count--;
+        pthread_cond_broadcast(&g_room);
     }
-    fputc('\n', stdout);
-    fflush(stdout);
-    return input;
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+/* Hand the line to the emitter and drop it here; the copy is forwarded. */
+static int typewriter_process(record_t* rec) {
+    char* copy = common_plugin_alloc(&g_ctx, rec->len + 1);
+    if (!copy) {
+        log_error(&g_ctx, "out of memory, line dropped");
+        return 0;
+    }
+    memcpy(copy, rec->data, rec->len);
+    copy[rec->len] = '\0';
+    record_t line = { copy, rec->len, rec->len + 1, 0 };
+
+    pthread_mutex_lock(&g_lock);
+    while (g_count == g_cap) {
+        pthread_cond_wait(&g_room, &g_lock);
+    }
+    g_backlog[(g_head + g_count) % g_cap] = line;
+    g_count++;
+    pthread_cond_signal(&g_more);
+    pthread_mutex_unlock(&g_lock);
+    return 0;
+}
+
+/* Only <END> is ever kept: hold it until every line is typed and gone. */
+static void typewriter_batch(const record_t* recs, int count) {
+    (void)recs;
+    (void)count;
+    pthread_mutex_lock(&g_lock);
+    while (g_count > 0) {
+        pthread_cond_wait(&g_room, &g_lock);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+static void stop_emitter(void) {
+    if (g_started) {
+        pthread_mutex_lock(&g_lock);
+        g_stop = 1;
+        pthread_cond_signal(&g_more);
+        pthread_mutex_unlock(&g_lock);
+        pthread_join(g_thread, NULL);
+        g_started = 0;
+    }
+    free(g_backlog);
+    g_backlog = NULL;
 }
 
 const char* plugin_get_name(void) { return "typewriter"; }
 
 const char* plugin_init(int queue_size) {
+    long cap;
     g_delay_us = parse_delay_env();
-    return common_plugin_init(&g_ctx, typewriter_process, "typewriter", queue_size);
+    if (env_positive("TYPEWRITER_BACKLOG", 64, INT_MAX / 2, &cap) != 0) {
+        return "typewriter: invalid TYPEWRITER_BACKLOG value";
+    }
+    if (env_positive("TYPEWRITER_TICK_US", 1000, 1000000, &g_tick_us) != 0) {
+        return "typewriter: invalid TYPEWRITER_TICK_US value";
+    }
+    g_backlog = (record_t*)calloc((size_t)cap, sizeof(record_t));
+    if (!g_backlog) {
+        return "typewriter: out of memory";
+    }
+    g_cap = (int)cap;
+    g_head = 0;
+    g_count = 0;
+    g_stop = 0;
+    g_next_ns = 0;
+    if (pthread_create(&g_thread, NULL, emitter_thread, NULL) != 0) {
+        stop_emitter();
+        return "typewriter: pthread_create failed";
+    }
+    g_started = 1;
+    const char* err = common_plugin_init(&g_ctx, typewriter_process, "typewriter", queue_size);
+    if (err) {
+        stop_emitter();
+        return err;
+    }
+    common_plugin_set_batch_function(&g_ctx, typewriter_batch);
+    return NULL;
 }
 
 void plugin_attach(const char* (*next_place_work)(const char*)) {
     common_plugin_attach(&g_ctx, next_place_work);
 }
 
+void plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int)) {
+    common_plugin_attach_batch(&g_ctx, next_place_work_batch);
+}
+
+void plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+                         const char* (*next_place_work_owned_batch)(char* const*, int)) {
+    common_plugin_attach_owned(&g_ctx, next_place_work_owned, next_place_work_owned_batch);
+}
+
 const char* plugin_place_work(const char* str) {
     return common_plugin_place_work(&g_ctx, str);
 }
 
+const char* plugin_place_work_batch(const char* const* strs, int count) {
+    return common_plugin_place_work_batch(&g_ctx, strs, count);
+}
+
+const char* plugin_place_work_owned(char* str) {
+    return common_plugin_place_work_owned(&g_ctx, str);
+}
+
+const char* plugin_place_work_owned_batch(char* const* strs, int count) {
+    return common_plugin_place_work_owned_batch(&g_ctx, strs, count);
+}
+
+void plugin_attach_records(const char* (*next_place_work_records)(const struct record*, int),
+                           const char* (*next_place_work_records_owned)(const struct record*, int)) {
+    common_plugin_attach_records(&g_ctx, next_place_work_records, next_place_work_records_owned);
+}
+
+const char* plugin_place_work_records(const struct record* recs, int count) {
+    return common_plugin_place_work_records(&g_ctx, recs, count);
+}
+
+const char* plugin_place_work_records_owned(const struct record* recs, int count) {
+    return common_plugin_place_work_records_owned(&g_ctx, recs, count);
+}
+
+void plugin_set_memory_budget(struct byte_budget* budget) {
+    common_plugin_set_memory_budget(&g_ctx, budget);
+}
+
+void plugin_set_allocator(struct slab* slab) {
+    common_plugin_set_allocator(&g_ctx, slab);
+}
+
+/* The batch hook and the backlog wait on the emitter thread, which a
+ * worker must not do: keep the stage thread. */
+void plugin_set_executor(struct executor* ex) {
+    common_plugin_set_executor(&g_ctx, ex, 0);
+}
+
 const char* plugin_wait_finished(void) {
     return common_plugin_wait_finished(&g_ctx);
 }
 
 const char* plugin_fini(void) {
+    (void)common_plugin_wait_finished(&g_ctx);
+    stop_emitter();
     return common_plugin_fini(&g_ctx);
 }
 
@@ -1,36 +1,107 @@
-#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "plugin_common.h"
 #include "plugin_sdk.h"
+#include "text/upper.h"
 
 static plugin_context_t g_ctx;
+static text_upper_fn g_upper;
 
-static char* upper_process(char* input) {
-    if (!input) {
-        return NULL;
-    }
-    for (char* p = input; *p; ++p) {
-        *p = (char)toupper((unsigned char)*p);
-    }
-    return input;
+static int upper_process(record_t* rec) {
+    g_upper(rec->data, rec->len);
+    return 1;
 }
 
 const char* plugin_get_name(void) { return "uppercaser"; }
 
+/* Everything plugin_init sets up besides the queue and the thread. */
+static const char* configure(void) {
+    text_isa_t isa;
+    const char* err = text_isa_limit(&isa);
+    if (err) {
+        return err;
+    }
+    g_upper = text_upper_select(isa);
+    return NULL;
+}
+
 const char* plugin_init(int queue_size) {
-    return common_plugin_init(&g_ctx, upper_process, "uppercaser", queue_size);
+    const char* err = configure();
+    return err ? err : common_plugin_init(&g_ctx, upper_process, "uppercaser", queue_size);
+}
+
+const char* plugin_init_inline(int (**process)(struct record* rec)) {
+    const char* err = configure();
+    return err ? err : common_plugin_init_inline(&g_ctx, upper_process, "uppercaser", process);
 }
 
 void plugin_attach(const char* (*next_place_work)(const char*)) {
     common_plugin_attach(&g_ctx, next_place_work);
 }
 
+void plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int)) {
+    common_plugin_attach_batch(&g_ctx, next_place_work_batch);
+}
+
+void plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+                         const char* (*next_place_work_owned_batch)(char* const*, int)) {
+    common_plugin_attach_owned(&g_ctx, next_place_work_owned, next_place_work_owned_batch);
+}
+
 const char* plugin_place_work(const char* str) {
     return common_plugin_place_work(&g_ctx, str);
 }
 
+const char* plugin_place_work_batch(const char* const* strs, int count) {
+    return common_plugin_place_work_batch(&g_ctx, strs, count);
+}
+
+const char* plugin_place_work_owned(char* str) {
+    return common_plugin_place_work_owned(&g_ctx, str);
+}
+
+const char* plugin_place_work_owned_batch(char* const* strs, int count) {
+    return common_plugin_place_work_owned_batch(&g_ctx, strs, count);
+}
+
+void plugin_attach_records(const char* (*next_place_work_records)(const struct record*, int),
+                           const char* (*next_place_work_records_owned)(const struct record*, int)) {
+    common_plugin_attach_records(&g_ctx, next_place_work_records, next_place_work_records_owned);
+}
+
+const char* plugin_place_work_records(const struct record* recs, int count) {
+    return common_plugin_place_work_records(&g_ctx, recs, count);
+}
+
+const char* plugin_place_work_records_owned(const struct record* recs, int count) {
+    return common_plugin_place_work_records_owned(&g_ctx, recs, count);
+}
+
+void plugin_set_memory_budget(struct byte_budget* budget) {
+    common_plugin_set_memory_budget(&g_ctx, budget);
+}
+
+void plugin_set_allocator(struct slab* slab) {
+    common_plugin_set_allocator(&g_ctx, slab);
+}
+
+void plugin_set_executor(struct executor* ex) {
+    common_plugin_set_executor(&g_ctx, ex, 1);
+}
+
+int plugin_process_record(struct record* rec) {
+    return upper_process(rec);
+}
+
+const char* plugin_fuse(int (*process_record)(struct record* rec)) {
+    return common_plugin_fuse(&g_ctx, process_record);
+}
+
+const char* plugin_set_replicas(int replicas) {
+    return common_plugin_set_replicas(&g_ctx, replicas);
+}
+
 const char* plugin_wait_finished(void) {
     return common_plugin_wait_finished(&g_ctx);
 }
@@ -8,6 +8,13 @@
 #include <unistd.h>
 
 #include "bq.h"
+#include "options.h"
+#include "placement.h"
+#include "plan.h"
+#include "sync/byte_budget.h"
+#include "sync/executor.h"
+#include "sync/record.h"
+#include "sync/slab.h"
 #include "util.h"
 
 typedef const char* (*fn_get_name)(void);
@@ -16,6 +23,20 @@ typedef const char* (*fn_place)(const char*);
 typedef void        (*fn_attach)(const char* (*)(const char*));
 typedef const char* (*fn_fini)(void);
 typedef const char* (*fn_wait)(void);
+typedef const char* (*fn_place_batch)(const char* const*, int);
+typedef void        (*fn_attach_batch)(const char* (*)(const char* const*, int));
+typedef const char* (*fn_place_owned)(char*);
+typedef const char* (*fn_place_owned_batch)(char* const*, int);
+typedef void        (*fn_attach_owned)(fn_place_owned, fn_place_owned_batch);
+typedef void        (*fn_set_budget)(struct byte_budget*);
+typedef void        (*fn_set_allocator)(struct slab*);
+typedef const char* (*fn_place_records)(const struct record*, int);
+typedef void        (*fn_attach_records)(fn_place_records, fn_place_records);
+typedef int         (*fn_process_record)(struct record*);
+typedef const char* (*fn_fuse)(fn_process_record);
+typedef const char* (*fn_set_replicas)(int);
+typedef void        (*fn_set_executor)(struct executor*);
+typedef const char* (*fn_init_inline)(fn_process_record*);
 
 typedef struct plugin_handle_t {
     fn_init init;
@@ -23,6 +44,23 @@ typedef struct plugin_handle_t {
     fn_place place_work;
     fn_attach attach;
     fn_wait wait_finished;
+    fn_place_batch place_work_batch;   // optional
+    fn_attach_batch attach_batch;      // optional
+    fn_place_owned place_work_owned;   // optional
+    fn_place_owned_batch place_work_owned_batch; // optional
+    fn_attach_owned attach_owned;      // optional
+    fn_set_budget set_memory_budget;   // optional
+    fn_set_allocator set_allocator;    // optional
+    fn_place_records place_work_records;         // optional
+    fn_place_records place_work_records_owned;   // optional
+    fn_attach_records attach_records;            // optional
+    fn_process_record process_record;            // optional, stateless stages
+    fn_fuse fuse;                                // optional, stateless stages
+    fn_set_replicas set_replicas;                // optional, stateless stages
+    fn_set_executor set_executor;                // optional
+    fn_init_inline init_inline;                  // optional
+    fn_process_record run_inline;                // set when the reader runs the stage
+    int replicas;                                // workers on the stage's queue
     char name[64];
     void *handle;
 } plugin_handle_t;
@@ -50,8 +88,42 @@ static int copy_file(const char *src, const char *dst) {
     return err;
 }
 
+// Push a line through the leading n stages, which the reader runs itself
+// (--executor=inline). Returns 0 once one drops it; *owned tells whether
+// rec now holds a buffer to free with slab.
+static int run_inline(plugin_handle_t *stages, int n, slab_t *slab, record_t *rec, int *owned) {
+    for (int k = 0; k < n; ++k) {
+        char *input = rec->data;
+        int keep = stages[k].run_inline(rec);
+        if (rec->data != input) {
+            if (*owned) slab_free(slab, input);
+            *owned = 1;
+        }
+        if (!keep) {
+            if (*owned) slab_free(slab, rec->data);
+            *owned = 0;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void report_slab(slab_t *slab) {
+    slab_class_stats_t st[SLAB_STAT_SLOTS];
+    slab_get_stats(slab, st);
+    for (int i = 0; i < SLAB_STAT_SLOTS; ++i) {
+        if (st[i].allocs == 0) continue;
+        if (i == SLAB_LARGE) {
+            LOG_INFO("slab: large allocs=%lu frees=%lu", st[i].allocs, st[i].frees);
+        } else {
+            LOG_INFO("slab: %zu B allocs=%lu frees=%lu remote=%lu reserved=%zu",
+                     st[i].block_size, st[i].allocs, st[i].frees, st[i].remote_frees, st[i].reserved);
+        }
+    }
+}
+
 static void print_usage(void) {
-    printf("Usage: ./analyzer <queue_size> <plugin1> <plugin2> ... <pluginN>\n");
+    printf("Usage: ./analyzer [options] <queue_size> <plugin1> <plugin2> ... <pluginN>\n");
     printf("Arguments:\n");
     printf(" queue_size Maximum number of items in each plugin's queue\n");
     printf(" plugin1..N Names of plugins to load (without .so extension)\n");
@@ -62,6 +134,8 @@ static void print_usage(void) {
     printf(" rotator - Move every character to the right. Last character moves to the beginning.\n");
     printf(" flipper - Reverses the order of characters\n");
     printf(" expander - Expands each character with spaces\n");
+    printf(" A stateless plugin written name*N runs N workers, e.g. expander*4\n");
+    host_print_options(stdout);
     printf("Example:\n");
     printf(" ./analyzer 20 uppercaser rotator logger\n");
     printf(" echo 'hello' | ./analyzer 20 uppercaser rotator logger\n");
@@ -79,8 +153,48 @@ static void *load_symbol(void *handle, const char *sym) {
     return fn;
 }
 
+// Same as load_symbol, for optional exports: a missing symbol is not an error.
+static void *load_optional_symbol(void *handle, const char *sym) {
+    dlerror();
+    void *fn = dlsym(handle, sym);
+    (void)dlerror();
+    return fn;
+}
+
+// Both free line buffers with the same allocator
+static int same_allocator(const plugin_handle_t *a, const plugin_handle_t *b, int use_slab) {
+    return !use_slab || (a->set_allocator != NULL) == (b->set_allocator != NULL);
+}
+
+// Unwind after a failed setup: stages first..running-1 have their threads
+// started and only stop once they see <END>; all of 0..count-1 are unloaded
+static void stop_stages(plugin_handle_t *plugins, int first, int running, int count) {
+    for (int j = first; j < running; ++j) { plugins[j].attach(NULL); (void)plugins[j].place_work(BQ_END_SENTINEL); }
+    for (int j = 0; j < count; ++j) { (void)plugins[j].fini(); (void)plugins[j].wait_finished(); if (plugins[j].handle) dlclose(plugins[j].handle); }
+}
+
+// Feed from's output to to
+static void attach_stage(plugin_handle_t *from, plugin_handle_t *to, int use_slab) {
+    from->attach(to->place_work);
+    if (from->attach_batch && to->place_work_batch) {
+        from->attach_batch(to->place_work_batch);
+    }
+    // Hand processed buffers over instead of copying them per hop, as
+    // long as both sides free them with the same allocator
+    int same_alloc = same_allocator(from, to, use_slab);
+    if (from->attach_owned && to->place_work_owned && same_alloc) {
+        from->attach_owned(to->place_work_owned, to->place_work_owned_batch);
+    }
+    // Pass lengths along with the bytes when both sides speak records
+    if (from->attach_records && to->place_work_records) {
+        from->attach_records(to->place_work_records,
+                             same_alloc ? to->place_work_records_owned : NULL);
+    }
+}
+
 int main(int argc, char **argv) {
-    if (argc < 3) {
+    int first_arg = 0;
+    if (host_parse_options(argc, argv, &first_arg) != 0 || argc - first_arg < 2) {
         fprintf(stderr, "invalid arguments\n");
         print_usage();
         return 1;
@@ -88,15 +202,82 @@ int main(int argc, char **argv) {
 
     char *end = NULL;
     errno = 0;
-    long qsize_long = strtol(argv[1], &end, 10);
-    if (errno != 0 || end == argv[1] || qsize_long <= 0 || qsize_long > 1000000) {
+    long qsize_long = strtol(argv[first_arg], &end, 10);
+    if (errno != 0 || end == argv[first_arg] || qsize_long <= 0 || qsize_long > 1000000) {
         fprintf(stderr, "invalid queue_size\n");
         print_usage();
         return 1;
     }
     int queue_size = (int)qsize_long;
 
-    int num = argc - 2;
+    // Pipeline-wide ceiling on bytes waiting in stage queues (--memory-limit)
+    size_t mem_limit = 0;
+    byte_budget_t mem_budget;
+    if (host_option_bytes("PIPELINE_MEMORY_LIMIT", &mem_limit) != 0) {
+        fprintf(stderr, "invalid --memory-limit value\n");
+        print_usage();
+        return 1;
+    }
+    if (mem_limit > 0 && byte_budget_init(&mem_budget, mem_limit) != 0) {
+        fprintf(stderr, "memory budget init failed\n");
+        return 1;
+    }
+
+    // One allocator for every line buffer, shared by all stages (--allocator)
+    const char *alloc_name = getenv("PIPELINE_ALLOCATOR");
+    int use_slab = !alloc_name || !*alloc_name || strcmp(alloc_name, "slab") == 0;
+    slab_t slab;
+    if (!use_slab && strcmp(alloc_name, "malloc") != 0) {
+        fprintf(stderr, "invalid --allocator value\n");
+        print_usage();
+        return 1;
+    }
+    if (use_slab && slab_init(&slab) != 0) {
+        fprintf(stderr, "slab init failed\n");
+        return 1;
+    }
+
+    // Stage threads on CPUs of their own (--placement)
+    placement where;
+    const char *place_err = placement_init(&where, getenv("PIPELINE_PLACEMENT"));
+    if (place_err) {
+        fprintf(stderr, "invalid --placement value: %s\n", place_err);
+        print_usage();
+        return 1;
+    }
+
+    // Stages as tasks on one pool of workers instead of a thread each, or
+    // the leading ones on the reader's thread (--executor)
+    const char *exec_name = getenv("PIPELINE_EXECUTOR");
+    int use_pool = exec_name && strcmp(exec_name, "pool") == 0;
+    int use_inline = exec_name && strcmp(exec_name, "inline") == 0;
+    long workers = parse_long_env("PIPELINE_WORKERS", 0);
+    executor_t executor;
+    if ((exec_name && *exec_name && !use_pool && !use_inline && strcmp(exec_name, "threads") != 0) ||
+        workers < 0 || workers > EXECUTOR_MAX_WORKERS) {
+        fprintf(stderr, "invalid --executor or --workers value\n");
+        print_usage();
+        return 1;
+    }
+    // the workers take the first slots of the placement
+    char cpus[128];
+    if (use_pool && placement_pin(&where, 0, workers > 0 ? (int)workers : (int)where.num, cpus, sizeof(cpus)) != 0) {
+        fprintf(stderr, "failed to pin the workers to CPUs %s\n", cpus);
+        return 1;
+    }
+    if (use_pool && executor_init(&executor, (int)workers) != 0) {
+        fprintf(stderr, "executor init failed\n");
+        return 1;
+    }
+
+    // Rewrite the chain into the one that is actually run
+    char **names = argv + first_arg + 1;
+    plan chain;
+    const char *plan_err = plan_build(&chain, names, (size_t)(argc - first_arg - 1));
+    if (plan_err) { fprintf(stderr, "%s\n", plan_err); print_usage(); return 1; }
+    if (parse_long_env("PIPELINE_EXPLAIN", 0) != 0) plan_explain(&chain, names, (size_t)(argc - first_arg - 1), stderr);
+
+    int num = (int)chain.num;
     plugin_handle_t *plugins = (plugin_handle_t *)calloc((size_t)num, sizeof(plugin_handle_t));
     if (!plugins) { fprintf(stderr, "OOM\n"); return 1; }
 
@@ -104,7 +285,7 @@ int main(int argc, char **argv) {
 
     // Load plugins
     for (int i = 0; i < num; ++i) {
-        const char *tok = argv[i + 2];
+        const char *tok = chain.stages[i].name;
         snprintf(plugins[i].name, sizeof(plugins[i].name), "%s", tok);
         char so_path[256];
         char inst_path[512];
@@ -141,47 +322,143 @@ int main(int argc, char **argv) {
             free(plugins);
             return 1;
         }
+        plugins[i].place_work_batch = (fn_place_batch)load_optional_symbol(plugins[i].handle, "plugin_place_work_batch");
+        plugins[i].attach_batch = (fn_attach_batch)load_optional_symbol(plugins[i].handle, "plugin_attach_batch");
+        plugins[i].place_work_owned = (fn_place_owned)load_optional_symbol(plugins[i].handle, "plugin_place_work_owned");
+        plugins[i].place_work_owned_batch = (fn_place_owned_batch)load_optional_symbol(plugins[i].handle, "plugin_place_work_owned_batch");
+        plugins[i].attach_owned = (fn_attach_owned)load_optional_symbol(plugins[i].handle, "plugin_attach_owned");
+        plugins[i].set_memory_budget = (fn_set_budget)load_optional_symbol(plugins[i].handle, "plugin_set_memory_budget");
+        plugins[i].set_allocator = (fn_set_allocator)load_optional_symbol(plugins[i].handle, "plugin_set_allocator");
+        plugins[i].place_work_records = (fn_place_records)load_optional_symbol(plugins[i].handle, "plugin_place_work_records");
+        plugins[i].place_work_records_owned = (fn_place_records)load_optional_symbol(plugins[i].handle, "plugin_place_work_records_owned");
+        plugins[i].attach_records = (fn_attach_records)load_optional_symbol(plugins[i].handle, "plugin_attach_records");
+        plugins[i].process_record = (fn_process_record)load_optional_symbol(plugins[i].handle, "plugin_process_record");
+        plugins[i].fuse = (fn_fuse)load_optional_symbol(plugins[i].handle, "plugin_fuse");
+        plugins[i].set_replicas = (fn_set_replicas)load_optional_symbol(plugins[i].handle, "plugin_set_replicas");
+        plugins[i].set_executor = (fn_set_executor)load_optional_symbol(plugins[i].handle, "plugin_set_executor");
+        plugins[i].init_inline = (fn_init_inline)load_optional_symbol(plugins[i].handle, "plugin_init_inline");
+        plugins[i].replicas = chain.stages[i].replicas;
     }
 
-    // Initialize
+    // Initialize; whatever init and set_replicas start or allocate inherits
+    // the stage's CPUs
+    size_t slot = 0;
+    int n_inline = 0;
     for (int i = 0; i < num; ++i) {
-        const char *err = plugins[i].init(queue_size);
+        const char *err = NULL;
+        if (placement_pin(&where, slot, plugins[i].replicas, cpus, sizeof(cpus)) != 0) {
+            err = "failed to pin to its CPUs";
+        }
+        slot += (size_t)plugins[i].replicas;
+        if (use_pool && plugins[i].set_executor) plugins[i].set_executor(&executor);
+        if (!err && plan_env_apply(&chain.stages[i]) != 0) err = "failed to apply the optimized plan";
+        // The reader runs stages itself until one needs a thread; it frees
+        // their buffers, so they must allocate from its slab
+        if (!err && n_inline == i && use_inline && plugins[i].init_inline && plugins[i].replicas == 1 &&
+            (!use_slab || plugins[i].set_allocator) && plugins[i].init_inline(&plugins[i].run_inline) == NULL) {
+            n_inline++;
+        } else if (!err) {
+            err = plugins[i].init(queue_size);
+        }
+        plan_env_restore();
         if (err) {
             fprintf(stderr, "%s: init failed: %s\n", plugins[i].name, err);
-            for (int j = 0; j <= i; ++j) { (void)plugins[j].fini(); (void)plugins[j].wait_finished(); if (plugins[j].handle) dlclose(plugins[j].handle); }
+            stop_stages(plugins, n_inline, i, i + 1);
             free(plugins);
             return 2;
         }
+        if (plugins[i].replicas > 1) {
+            err = plugins[i].set_replicas ? plugins[i].set_replicas(plugins[i].replicas)
+                                          : "keeps state and cannot be replicated";
+            if (err) {
+                fprintf(stderr, "%s: %s\n", plugins[i].name, err);
+                stop_stages(plugins, n_inline, i + 1, i + 1);
+                free(plugins);
+                return 2;
+            }
+        }
+        if (mem_limit > 0 && plugins[i].set_memory_budget) plugins[i].set_memory_budget(&mem_budget);
+        if (use_slab && plugins[i].set_allocator) plugins[i].set_allocator(&slab);
+    }
+
+    // Attach.
+    // A run of adjacent stateless stages works on the thread of its
+    // first stage, which applies the others' transforms and feeds the stage
+    // after the run; the others are closed right away (--fuse=0 keeps a
+    // thread per stage). A replicated stage may only lead a run
+    int fuse = parse_long_env("PIPELINE_FUSE", 1) != 0;
+    for (int head = n_inline; head < num;) {
+        int last = head;
+        if (fuse && plugins[head].fuse && plugins[head].process_record) {
+            while (last + 1 < num && plugins[last + 1].process_record && plugins[last + 1].replicas == 1 &&
+                   same_allocator(&plugins[head], &plugins[last + 1], use_slab) &&
+                   plugins[head].fuse(plugins[last + 1].process_record) == NULL) {
+                last++;
+            }
+        }
+        for (int k = head + 1; k <= last; ++k) {
+            plugins[k].attach(NULL);
+            (void)plugins[k].place_work(BQ_END_SENTINEL);
+        }
+        if (last + 1 < num) {
+            attach_stage(&plugins[head], &plugins[last + 1], use_slab);
+        } else {
+            plugins[head].attach(NULL);
+        }
+        head = last + 1;
     }
 
-    // Attach
-    for (int i = 0; i + 1 < num; ++i) {
-        plugins[i].attach(plugins[i + 1].place_work);
+    // The reader shares the first stage's CPUs
+    if (placement_pin(&where, 0, plugins[0].replicas, cpus, sizeof(cpus)) != 0) {
+        fprintf(stderr, "failed to pin the reader to CPUs %s\n", cpus);
     }
-    if (num > 0) plugins[num - 1].attach(NULL);
 
     // Read stdin with fgets up to 1024 (without trailing \n)
+    // through the stages run inline first, if any
+    plugin_handle_t *next = n_inline < num ? &plugins[n_inline] : NULL;
+    slab_t *inline_slab = use_slab ? &slab : NULL;
     char buf[1025];
     while (fgets(buf, sizeof(buf), stdin) != NULL) {
         size_t n = strlen(buf);
         if (n > 0 && buf[n - 1] == '\n') { buf[n - 1] = '\0'; n--; }
         const char *line = buf;
+        if (n_inline > 0) {
+            if (strcmp(line, "<END>") == 0) break;
+            record_t rec = { buf, n, sizeof(buf), 0 };
+            int owned = 0;
+            int keep = run_inline(plugins, n_inline, inline_slab, &rec, &owned);
+            const char *err = keep && next ? next->place_work(record_cstr(&rec)) : NULL;
+            if (owned) slab_free(inline_slab, rec.data);
+            if (err) { fprintf(stderr, "place_work failed in %s: %s\n", next->name, err); break; }
+            continue;
+        }
         const char *err = plugins[0].place_work(line);
         if (err) { fprintf(stderr, "place_work failed in %s: %s\n", plugins[0].name, err); break; }
         if (strcmp(line, "<END>") == 0) break;
     }
 
     // Always send final sentinel one more time to close a pipeline where no <END> was provided
-    (void)plugins[0].place_work(BQ_END_SENTINEL);
+    if (next) (void)next->place_work(BQ_END_SENTINEL);
 
     // Wait then fini
     for (int i = 0; i < num; ++i) (void)plugins[i].wait_finished();
     for (int i = 0; i < num; ++i) (void)plugins[i].fini();
+    if (use_pool) executor_destroy(&executor);
 
     // Unload
     for (int i = 0; i < num; ++i) if (plugins[i].handle) dlclose(plugins[i].handle);
     free(plugins);
+    placement_free(&where);
+    plan_free(&chain);
 
+    if (mem_limit > 0) {
+        fprintf(stderr, "[info] memory: peak %zu of %zu bytes queued\n", byte_budget_peak(&mem_budget), mem_limit);
+        byte_budget_destroy(&mem_budget);
+    }
+    if (use_slab) {
+        if (parse_long_env("PIPELINE_ALLOC_STATS", 0) != 0) report_slab(&slab);
+        slab_destroy(&slab);
+    }
     printf("Pipeline shutdown complete\n");
     return 0;
 }
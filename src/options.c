@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+#include "options.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct host_option {
+    const char *name;
+    const char *env;
+    const char *arg;
+    const char *help;
+} host_option;
+
+static const host_option OPTIONS[] = {
+    { "queue", "PIPELINE_QUEUE", "locked|spsc|bytes", "Stage queue implementation (default locked)" },
+    { "ring-bytes", "PIPELINE_RING_BYTES", "N", "Byte-ring capacity per stage for --queue=bytes (default 256 per slot)" },
+    { "spin", "PIPELINE_SPIN", "N", "Busy-wait polls before a blocked stage yields" },
+    { "yield", "PIPELINE_YIELD", "N", "sched_yield polls before a blocked stage parks" },
+    { "queue-bytes", "PIPELINE_QUEUE_BYTES", "N[k|m|g]", "Max bytes waiting in each stage queue (default unbounded)" },
+    { "memory-limit", "PIPELINE_MEMORY_LIMIT", "N[k|m|g]", "Max bytes waiting across all stage queues (default unbounded)" },
+    { "spill", "PIPELINE_SPILL", "DIR", "Overflow full stage queues to temp files in DIR instead of blocking (locked queue)" },
+    { "allocator", "PIPELINE_ALLOCATOR", "slab|malloc", "Allocator for line buffers shared by the stages (default slab)" },
+    { "alloc-stats", "PIPELINE_ALLOC_STATS", "0|1", "Report per-size-class allocator usage on shutdown" },
+    { "wait-stats", "PIPELINE_WAIT_STATS", "0|1", "Report per-stage wait phase counts on shutdown" },
+    { "optimize", "PIPELINE_OPTIMIZE", "0|1", "Rewrite runs of uppercaser, rotator and flipper into fewer stages before loading (default 1)" },
+    { "explain", "PIPELINE_EXPLAIN", "0|1", "Print the chain as given and as run" },
+    { "fuse", "PIPELINE_FUSE", "0|1", "Run adjacent stateless stages on one thread (default 1)" },
+    { "executor", "PIPELINE_EXECUTOR", "threads|pool|inline", "Give every stage a thread, run stages as tasks on a shared pool of workers, or run the leading stages on the reader's thread with no queues in between (default threads)" },
+    { "workers", "PIPELINE_WORKERS", "N", "Worker threads for --executor=pool (default one per CPU)" },
+    { "placement", "PIPELINE_PLACEMENT", "none|compact|spread|CPUS", "Pin stage threads: neighbours on sibling cores, neighbours on different NUMA nodes, or one CPU per stage thread from a list such as 0,2,4-7 (default none)" },
+    { "simd", "PIPELINE_SIMD", "auto|scalar|sse2|avx2|avx512", "Cap the vector instruction set of the text stages (default auto)" },
+    { "flip-utf8", "FLIPPER_UTF8", "0|1", "flipper reverses UTF-8 code points instead of bytes" },
+    { "rotate-by", "ROTATOR_AMOUNT", "N", "Positions rotator moves each line by (default 1)" },
+    { "rotate-dir", "ROTATOR_DIRECTION", "right|left", "Direction rotator moves characters (default right)" },
+    { "expand-sep", "EXPANDER_SEPARATOR", "STR", "Separator expander puts between characters (default one space)" },
+    { "expand-repeat", "EXPANDER_REPEAT", "N", "Copies of the separator per gap (default 1)" },
+    { "typewriter-backlog", "TYPEWRITER_BACKLOG", "N", "Lines typewriter takes ahead of the one it is typing (default 64)" },
+    { "typewriter-tick", "TYPEWRITER_TICK_US", "N", "typewriter writes the characters due within this many microseconds together (default 1000)" },
+    { "log-mode", "LOGGER_MODE", "sync|async|mmap|uring", "logger writes each line itself, hands blocks to a writer thread, copies lines into a mapped log, or writes through io_uring (default sync)" },
+    { "log-flush-bytes", "LOGGER_FLUSH_BYTES", "N[k|m|g]", "Async logger block size per output (default 1m)" },
+    { "log-flush-ms", "LOGGER_FLUSH_MS", "N", "Async logger writes a partial block after this long (default 100)" },
+    { "log-sync-ms", "LOGGER_SYNC_MS", "N", "Async logger fdatasyncs the log at most this often, 0 for never (default 0)" },
+    { "log-extent", "LOGGER_EXTENT_BYTES", "N[k|m|g]", "Mapped logger reserves and maps the log this much at a time (default 16m)" },
+    { "sink-mode", "SINK_MODE", "sync|uring|writev", "sink_stdout writes each line itself, through io_uring, or in writev batches (default sync)" },
+    { "sink-batch-lines", "SINK_BATCH_LINES", "N", "writev sink: write once this many lines wait (default 1024)" },
+    { "sink-batch-bytes", "SINK_BATCH_BYTES", "N[k|m|g]", "writev sink: write once this many bytes wait (default 64k)" },
+    { "sink-idle-us", "SINK_IDLE_US", "N", "writev sink: write when no line came for this long (default 1000)" },
+    { "sink-max-delay-us", "SINK_MAX_DELAY_US", "N", "writev sink: never hold a line longer than this, 0 holds none (default 10000)" },
+    { "sink-vmsplice", "SINK_VMSPLICE", "0|1", "writev sink: lend pages to a stdout pipe with vmsplice instead of copying" },
+    { "io-depth", "PIPELINE_IO_DEPTH", "N", "io_uring outputs: buffers, and so writes in flight (default 8, max 64)" },
+    { "io-block", "PIPELINE_IO_BLOCK", "N[k|m|g]", "io_uring outputs: bytes per buffer (default 64k)" },
+    { "io-threads", "PIPELINE_IO_THREADS", "0|1", "io_uring outputs: use the thread-pool writer even where io_uring works" },
+    { "io-stats", "PIPELINE_IO_STATS", "0|1", "Report the backend and write queue depth of io_uring outputs on shutdown" },
+};
+
+#define NUM_OPTIONS (sizeof(OPTIONS) / sizeof(OPTIONS[0]))
+
+static const host_option *find_option(const char *name, size_t len) {
+    for (size_t i = 0; i < NUM_OPTIONS; ++i) {
+        if (strlen(OPTIONS[i].name) == len && strncmp(OPTIONS[i].name, name, len) == 0) {
+            return &OPTIONS[i];
+        }
+    }
+    return NULL;
+}
+
+int host_parse_options(int argc, char **argv, int *first_arg) {
+    int i = 1;
+    for (; i < argc; ++i) {
+        const char *a = argv[i];
+        if (strncmp(a, "--", 2) != 0) break;
+        a += 2;
+        const char *eq = strchr(a, '=');
+        if (!eq || eq == a || eq[1] == '\0') {
+            fprintf(stderr, "invalid option '%s' (expected --name=value)\n", argv[i]);
+            return -1;
+        }
+        const host_option *opt = find_option(a, (size_t)(eq - a));
+        if (!opt) {
+            fprintf(stderr, "unknown option '%s'\n", argv[i]);
+            return -1;
+        }
+        if (setenv(opt->env, eq + 1, 1) != 0) {
+            fprintf(stderr, "failed to apply option '%s'\n", argv[i]);
+            return -1;
+        }
+    }
+    *first_arg = i;
+    return 0;
+}
+
+int host_option_bytes(const char *env, size_t *out) {
+    const char *val = getenv(env);
+    *out = 0;
+    if (!val || !*val) return 0;
+
+    char *end = NULL;
+    errno = 0;
+    unsigned long long n = strtoull(val, &end, 10);
+    if (errno != 0 || end == val || val[0] == '-') return -1;
+    unsigned shift = 0;
+    switch (tolower((unsigned char)*end)) {
+    case 'k': shift = 10; end++; break;
+    case 'm': shift = 20; end++; break;
+    case 'g': shift = 30; end++; break;
+    default: break;
+    }
+    if (*end != '\0' || n > (SIZE_MAX >> shift)) return -1;
+    *out = (size_t)(n << shift);
+    return 0;
+}
+
+void host_print_options(FILE *out) {
+    fprintf(out, "Options:\n");
+    for (size_t i = 0; i < NUM_OPTIONS; ++i) {
+        fprintf(out, " --%s=%s %s [%s]\n", OPTIONS[i].name, OPTIONS[i].arg, OPTIONS[i].help, OPTIONS[i].env);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdio.h>
+
+// Host command-line options of the form --name=value. Every option is
+// forwarded to the plugins as an environment variable (the same channel
+// typewriter uses for TYPEWRITER_DELAY_US), so it must be applied before
+// any plugin_init() call.
+
+// Consume leading options from argv. On success stores the index of the
+// first positional argument in *first_arg and returns 0. On an unknown or
+// malformed option prints a message to stderr and returns -1.
+int host_parse_options(int argc, char **argv, int *first_arg);
+
+// Read a byte count set through an option (e.g. PIPELINE_MEMORY_LIMIT).
+// Accepts a plain number with an optional k/m/g suffix (powers of 1024).
+// Stores 0 when unset. Returns -1 if the value is malformed.
+int host_option_bytes(const char *env, size_t *out);
+
+// Print the option table for usage messages.
+void host_print_options(FILE *out);
+
+#endif // OPTIONS_H
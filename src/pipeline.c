@@ -9,6 +9,13 @@
 #include <unistd.h>
 
 #include "bq.h"
+#include "options.h"
+#include "placement.h"
+#include "plan.h"
+#include "sync/byte_budget.h"
+#include "sync/executor.h"
+#include "sync/record.h"
+#include "sync/slab.h"
 #include "util.h"
 
 typedef const char* (*fn_get_name)(void);
@@ -17,6 +24,20 @@ typedef const char* (*fn_place)(const char*);
 typedef void        (*fn_attach)(const char* (*)(const char*));
 typedef const char* (*fn_fini)(void);
 typedef const char* (*fn_wait)(void);
+typedef const char* (*fn_place_batch)(const char* const*, int);
+typedef void        (*fn_attach_batch)(const char* (*)(const char* const*, int));
+typedef const char* (*fn_place_owned)(char*);
+typedef const char* (*fn_place_owned_batch)(char* const*, int);
+typedef void        (*fn_attach_owned)(fn_place_owned, fn_place_owned_batch);
+typedef void        (*fn_set_budget)(struct byte_budget*);
+typedef void        (*fn_set_allocator)(struct slab*);
+typedef const char* (*fn_place_records)(const struct record*, int);
+typedef void        (*fn_attach_records)(fn_place_records, fn_place_records);
+typedef int         (*fn_process_record)(struct record*);
+typedef const char* (*fn_fuse)(fn_process_record);
+typedef const char* (*fn_set_replicas)(int);
+typedef void        (*fn_set_executor)(struct executor*);
+typedef const char* (*fn_init_inline)(fn_process_record*);
 
 typedef struct loaded_plugin {
     void *handle;
@@ -27,8 +48,38 @@ typedef struct loaded_plugin {
     fn_attach attach;
     fn_fini fini;
     fn_wait wait_finished;
+    fn_place_batch place_work_batch;   // optional
+    fn_attach_batch attach_batch;      // optional
+    fn_place_owned place_work_owned;   // optional
+    fn_place_owned_batch place_work_owned_batch; // optional
+    fn_attach_owned attach_owned;      // optional
+    fn_set_budget set_memory_budget;   // optional
+    fn_set_allocator set_allocator;    // optional
+    fn_place_records place_work_records;         // optional
+    fn_place_records place_work_records_owned;   // optional
+    fn_attach_records attach_records;            // optional
+    fn_process_record process_record;            // optional, stateless stages
+    fn_fuse fuse;                                // optional, stateless stages
+    fn_set_replicas set_replicas;                // optional, stateless stages
+    fn_set_executor set_executor;                // optional
+    fn_init_inline init_inline;                  // optional
+    fn_process_record run_inline;                // set when the reader runs the stage
+    int replicas;                                // workers on the stage's queue
 } loaded_plugin;
 
+// The leading stages the reader runs itself (--executor=inline), and the
+// stage that gets what they keep
+typedef struct inline_run {
+    loaded_plugin *stages;
+    size_t num;
+    loaded_plugin *next;                         // NULL if every stage runs inline
+    slab_t *slab;                                // what the stages allocate from
+    int ended;                                   // <END> went through
+} inline_run;
+
+// Lines handed to the first plugin per place_work_batch call
+#define FEED_BATCH 256
+
 static int copy_file(const char *src, const char *dst) {
     FILE *in = fopen(src, "rb");
     if (!in) return -1;
@@ -63,8 +114,155 @@ static void *load_symbol(void *handle, const char *sym) {
     return fn;
 }
 
+// Same as load_symbol, for optional exports: a missing symbol is not an error.
+static void *load_optional_symbol(void *handle, const char *sym) {
+    dlerror();
+    void *fn = dlsym(handle, sym);
+    (void)dlerror();
+    return fn;
+}
+
+// One input line as a record; the "<END>" line becomes the end marker.
+static record_t line_record(char *line, size_t len) {
+    if (len == sizeof(RECORD_END_TOKEN) - 1 && memcmp(line, RECORD_END_TOKEN, len) == 0) {
+        return record_end();
+    }
+    record_t rec = { line, len, len + 1, 0 };
+    return rec;
+}
+
+static const char *dispatch_lines(loaded_plugin *p, const record_t *lines, size_t n) {
+    if (n == 0) return NULL;
+    if (p->place_work_records) return p->place_work_records(lines, (int)n);
+    // Pre-record plugins get C strings, cut at the first NUL
+    const char *strs[FEED_BATCH];
+    for (size_t i = 0; i < n; ++i) strs[i] = record_cstr(&lines[i]);
+    if (p->place_work_batch) return p->place_work_batch(strs, (int)n);
+    for (size_t i = 0; i < n; ++i) {
+        const char *err = p->place_work(strs[i]);
+        if (err) return err;
+    }
+    return NULL;
+}
+
+// Push a line through the inline stages in chain order. Returns 0 once one
+// drops it; *owned tells whether rec now holds a buffer to free.
+static int run_inline(const inline_run *run, record_t *rec, int *owned) {
+    for (size_t k = 0; k < run->num; ++k) {
+        char *input = rec->data;
+        int keep = run->stages[k].run_inline(rec);
+        if (rec->data != input) {
+            if (*owned) slab_free(run->slab, input);
+            *owned = 1;
+        }
+        if (!keep) {
+            if (*owned) slab_free(run->slab, rec->data);
+            *owned = 0;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static const char *dispatch_inline(inline_run *run, const record_t *lines, size_t n) {
+    record_t kept[FEED_BATCH];
+    int owned[FEED_BATCH];
+    size_t k = 0;
+    for (size_t i = 0; i < n && !run->ended; ++i) {
+        if (record_is_end(&lines[i])) {
+            run->ended = 1;
+            break;
+        }
+        kept[k] = lines[i];
+        owned[k] = 0;
+        if (run_inline(run, &kept[k], &owned[k])) k++;
+    }
+    // the next stage copies them: lines still point into the read buffer
+    const char *err = run->next && k > 0 ? dispatch_lines(run->next, kept, k) : NULL;
+    for (size_t i = 0; i < k; ++i) {
+        if (owned[i]) slab_free(run->slab, kept[i].data);
+    }
+    return err;
+}
+
+// Read stdin in large blocks and hand every complete line of a block to the
+// first plugin together, so it is enqueued under one lock with one wakeup.
+// A read returns whatever is available, so interactive input is not delayed.
+// Stages run inline are applied to each line on the way, in this thread.
+static void feed_stdin(loaded_plugin *first, inline_run *run) {
+    size_t cap = 65536;
+    size_t len = 0;
+    size_t scanned = 0;
+    char *buf = (char *)malloc(cap);
+    if (!buf) {
+        LOG_ERR("OOM");
+        return;
+    }
+    record_t lines[FEED_BATCH];
+    const char *err = NULL;
+    for (;;) {
+        if (len + 1 >= cap) {
+            char *grown = (char *)realloc(buf, cap * 2);
+            if (!grown) {
+                LOG_ERR("OOM");
+                break;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+        ssize_t n = read(STDIN_FILENO, buf + len, cap - len - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            // last line without a trailing newline
+            if (len > 0) {
+                buf[len] = '\0';
+                lines[0] = line_record(buf, len);
+                err = run->num > 0 ? dispatch_inline(run, lines, 1) : dispatch_lines(first, lines, 1);
+            }
+            break;
+        }
+        len += (size_t)n;
+
+        size_t start = 0;
+        size_t count = 0;
+        char *nl;
+        while ((nl = memchr(buf + scanned, '\n', len - scanned)) != NULL) {
+            *nl = '\0';
+            lines[count++] = line_record(buf + start, (size_t)(nl - buf) - start);
+            start = scanned = (size_t)(nl - buf) + 1;
+            if (count == FEED_BATCH) {
+                err = run->num > 0 ? dispatch_inline(run, lines, count) : dispatch_lines(first, lines, count);
+                count = 0;
+                if (err) break;
+            }
+        }
+        if (!err) err = run->num > 0 ? dispatch_inline(run, lines, count) : dispatch_lines(first, lines, count);
+        if (err) break;
+
+        memmove(buf, buf + start, len - start);
+        len -= start;
+        scanned = len;
+    }
+    if (err) LOG_ERR("place_work failed in %s: %s", first->name, err);
+    free(buf);
+}
+
 // New SDK has init/fini/wait on plain functions, no opaque ctx here.
 
+static void report_slab(slab_t *slab) {
+    slab_class_stats_t st[SLAB_STAT_SLOTS];
+    slab_get_stats(slab, st);
+    for (int i = 0; i < SLAB_STAT_SLOTS; ++i) {
+        if (st[i].allocs == 0) continue;
+        if (i == SLAB_LARGE) {
+            LOG_INFO("slab: large allocs=%lu frees=%lu", st[i].allocs, st[i].frees);
+        } else {
+            LOG_INFO("slab: %zu B allocs=%lu frees=%lu remote=%lu reserved=%zu",
+                     st[i].block_size, st[i].allocs, st[i].frees, st[i].remote_frees, st[i].reserved);
+        }
+    }
+}
+
 static char *next_token(char **p) {
     if (!p || !*p) return NULL;
     char *s = *p;
@@ -85,9 +283,35 @@ static int mkdir_p(const char *path) {
     return mkdir(path, 0755);
 }
 
+// Both free line buffers with the same allocator
+static int same_allocator(const loaded_plugin *a, const loaded_plugin *b, int use_slab) {
+    return !use_slab || (a->set_allocator != NULL) == (b->set_allocator != NULL);
+}
+
+// Feed from's output to to
+static void attach_stage(loaded_plugin *from, loaded_plugin *to, int use_slab) {
+    from->attach(to->place_work);
+    if (from->attach_batch && to->place_work_batch) {
+        from->attach_batch(to->place_work_batch);
+    }
+    // Hand processed buffers over instead of copying them per hop, as
+    // long as both sides free them with the same allocator
+    int same_alloc = same_allocator(from, to, use_slab);
+    if (from->attach_owned && to->place_work_owned && same_alloc) {
+        from->attach_owned(to->place_work_owned, to->place_work_owned_batch);
+    }
+    // Pass lengths along with the bytes when both sides speak records
+    if (from->attach_records && to->place_work_records) {
+        from->attach_records(to->place_work_records,
+                             same_alloc ? to->place_work_records_owned : NULL);
+    }
+}
+
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s name1,name2,...\n", argv[0]);
+    int first_arg = 0;
+    if (host_parse_options(argc, argv, &first_arg) != 0 || argc - first_arg != 1) {
+        fprintf(stderr, "Usage: %s [options] name1[*N],name2,...\n", argv[0]);
+        host_print_options(stderr);
         return 1;
     }
 
@@ -95,15 +319,38 @@ int main(int argc, char **argv) {
     mkdir_p("build/plugins");
     mkdir_p("output");
 
-    char *spec = dup_cstr(argv[1]);
+    char *spec = dup_cstr(argv[first_arg]);
     if (!spec) {
         LOG_ERR("OOM");
         return 1;
     }
 
-    // Count plugins and allocate
-    size_t num = 1;
-    for (const char *p = spec; *p; ++p) if (*p == ',') num++;
+    // Split the spec and rewrite it into the chain that is actually run
+    size_t num_names = 1;
+    for (const char *p = spec; *p; ++p) if (*p == ',') num_names++;
+    char **names = (char **)calloc(num_names, sizeof(char *));
+    if (!names) {
+        LOG_ERR("OOM");
+        free(spec);
+        return 1;
+    }
+    char *cursor = spec;
+    for (size_t i = 0; i < num_names; ++i) {
+        names[i] = next_token(&cursor);
+        if (!names[i] || !*names[i]) {
+            LOG_ERR("Invalid plugin name at position %zu", i);
+            return 1;
+        }
+    }
+    plan chain;
+    const char *plan_err = plan_build(&chain, names, num_names);
+    if (plan_err) {
+        LOG_ERR("%s", plan_err);
+        return 1;
+    }
+    if (parse_long_env("PIPELINE_EXPLAIN", 0) != 0) plan_explain(&chain, names, num_names, stderr);
+
+    size_t num = chain.num;
     loaded_plugin *plugins = (loaded_plugin *)calloc(num, sizeof(loaded_plugin));
     if (!plugins) {
         LOG_ERR("OOM");
@@ -115,14 +362,71 @@ int main(int argc, char **argv) {
 
     const size_t Q_CAP = 128;
 
+    // Pipeline-wide ceiling on bytes waiting in stage queues (--memory-limit)
+    size_t mem_limit = 0;
+    byte_budget_t mem_budget;
+    if (host_option_bytes("PIPELINE_MEMORY_LIMIT", &mem_limit) != 0) {
+        LOG_ERR("invalid --memory-limit value");
+        return 1;
+    }
+    if (mem_limit > 0 && byte_budget_init(&mem_budget, mem_limit) != 0) {
+        LOG_ERR("memory budget init failed");
+        return 1;
+    }
+
+    // One allocator for every line buffer, shared by all stages (--allocator)
+    const char *alloc_name = getenv("PIPELINE_ALLOCATOR");
+    int use_slab = !alloc_name || !*alloc_name || strcmp(alloc_name, "slab") == 0;
+    slab_t slab;
+    if (!use_slab && strcmp(alloc_name, "malloc") != 0) {
+        LOG_ERR("invalid --allocator value");
+        return 1;
+    }
+    if (use_slab && slab_init(&slab) != 0) {
+        LOG_ERR("slab init failed");
+        return 1;
+    }
+
+    // Stage threads on CPUs of their own (--placement)
+    placement where;
+    const char *place_err = placement_init(&where, getenv("PIPELINE_PLACEMENT"));
+    if (place_err) {
+        LOG_ERR("invalid --placement value: %s", place_err);
+        return 1;
+    }
+
+    // Stages as tasks on one pool of workers instead of a thread each, or
+    // the leading ones on the reader's thread (--executor)
+    const char *exec_name = getenv("PIPELINE_EXECUTOR");
+    int use_pool = exec_name && strcmp(exec_name, "pool") == 0;
+    int use_inline = exec_name && strcmp(exec_name, "inline") == 0;
+    long workers = parse_long_env("PIPELINE_WORKERS", 0);
+    executor_t executor;
+    if (exec_name && *exec_name && !use_pool && !use_inline && strcmp(exec_name, "threads") != 0) {
+        LOG_ERR("invalid --executor value");
+        return 1;
+    }
+    if (workers < 0 || workers > EXECUTOR_MAX_WORKERS) {
+        LOG_ERR("invalid --workers value");
+        return 1;
+    }
+    // the workers take the first slots of the placement
+    char cpus[128];
+    if (use_pool && placement_pin(&where, 0, workers > 0 ? (int)workers : (int)where.num, cpus, sizeof(cpus)) != 0) {
+        LOG_ERR("failed to pin the workers to CPUs %s", cpus);
+        return 1;
+    }
+    if (use_pool && cpus[0]) LOG_INFO("place workers on cpus %s", cpus);
+    if (use_pool && executor_init(&executor, (int)workers) != 0) {
+        LOG_ERR("executor init failed");
+        return 1;
+    }
+
     // Load each plugin
-    char *cursor = spec;
+    size_t slot = 0;
+    size_t n_inline = 0;
     for (size_t i = 0; i < num; ++i) {
-        char *tok = next_token(&cursor);
-        if (!tok || !*tok) {
-            LOG_ERR("Invalid plugin name at position %zu", i);
-            return 1;
-        }
+        const char *tok = chain.stages[i].name;
         snprintf(plugins[i].name, sizeof(plugins[i].name), "%s", tok);
         // Build full path to module
         char so_path[256];
@@ -154,51 +458,134 @@ int main(int argc, char **argv) {
             LOG_ERR("%s: missing required symbols", tok);
             return 1;
         }
+        plugins[i].place_work_batch = (fn_place_batch)load_optional_symbol(plugins[i].handle, "plugin_place_work_batch");
+        plugins[i].attach_batch = (fn_attach_batch)load_optional_symbol(plugins[i].handle, "plugin_attach_batch");
+        plugins[i].place_work_owned = (fn_place_owned)load_optional_symbol(plugins[i].handle, "plugin_place_work_owned");
+        plugins[i].place_work_owned_batch = (fn_place_owned_batch)load_optional_symbol(plugins[i].handle, "plugin_place_work_owned_batch");
+        plugins[i].attach_owned = (fn_attach_owned)load_optional_symbol(plugins[i].handle, "plugin_attach_owned");
+        plugins[i].set_memory_budget = (fn_set_budget)load_optional_symbol(plugins[i].handle, "plugin_set_memory_budget");
+        plugins[i].set_allocator = (fn_set_allocator)load_optional_symbol(plugins[i].handle, "plugin_set_allocator");
+        plugins[i].place_work_records = (fn_place_records)load_optional_symbol(plugins[i].handle, "plugin_place_work_records");
+        plugins[i].place_work_records_owned = (fn_place_records)load_optional_symbol(plugins[i].handle, "plugin_place_work_records_owned");
+        plugins[i].attach_records = (fn_attach_records)load_optional_symbol(plugins[i].handle, "plugin_attach_records");
+        plugins[i].process_record = (fn_process_record)load_optional_symbol(plugins[i].handle, "plugin_process_record");
+        plugins[i].fuse = (fn_fuse)load_optional_symbol(plugins[i].handle, "plugin_fuse");
+        plugins[i].set_replicas = (fn_set_replicas)load_optional_symbol(plugins[i].handle, "plugin_set_replicas");
+        plugins[i].set_executor = (fn_set_executor)load_optional_symbol(plugins[i].handle, "plugin_set_executor");
+        plugins[i].init_inline = (fn_init_inline)load_optional_symbol(plugins[i].handle, "plugin_init_inline");
+        plugins[i].replicas = chain.stages[i].replicas;
         if (plugins[i].get_name) {
             const char *nm = plugins[i].get_name();
             if (nm && *nm) snprintf(plugins[i].name, sizeof(plugins[i].name), "%s", nm);
         }
-        const char *err = plugins[i].init((int)Q_CAP);
+        // whatever init and set_replicas start or allocate inherits the CPUs
+        if (placement_pin(&where, slot, plugins[i].replicas, cpus, sizeof(cpus)) != 0) {
+            LOG_ERR("%s: failed to pin to CPUs %s", plugins[i].name, cpus);
+            return 1;
+        }
+        if (cpus[0]) LOG_INFO("place %s on cpus %s", plugins[i].name, cpus);
+        slot += (size_t)plugins[i].replicas;
+        if (use_pool && plugins[i].set_executor) plugins[i].set_executor(&executor);
+        if (plan_env_apply(&chain.stages[i]) != 0) {
+            LOG_ERR("%s: failed to apply the optimized plan", tok);
+            return 1;
+        }
+        // The reader runs stages itself until one needs a thread; it frees
+        // their buffers, so they must allocate from its slab
+        const char *err = NULL;
+        if (n_inline == i && use_inline && plugins[i].init_inline && plugins[i].replicas == 1 &&
+            (!use_slab || plugins[i].set_allocator)) {
+            err = plugins[i].init_inline(&plugins[i].run_inline);
+            if (err) LOG_INFO("%s runs threaded: %s", plugins[i].name, err);
+            else LOG_INFO("run %s inline", plugins[i].name);
+        }
+        if (plugins[i].run_inline) n_inline++;
+        else err = plugins[i].init((int)Q_CAP);
+        plan_env_restore();
         if (err) { LOG_ERR("%s: init failed: %s", plugins[i].name[0] ? plugins[i].name : tok, err); return 1; }
+        if (plugins[i].replicas > 1) {
+            if (!plugins[i].set_replicas) {
+                LOG_ERR("%s: keeps state and cannot be replicated", plugins[i].name);
+                return 1;
+            }
+            err = plugins[i].set_replicas(plugins[i].replicas);
+            if (err) { LOG_ERR("%s: %s", plugins[i].name, err); return 1; }
+            LOG_INFO("replicate %s x%d", plugins[i].name, plugins[i].replicas);
+        }
+        if (mem_limit > 0 && plugins[i].set_memory_budget) plugins[i].set_memory_budget(&mem_budget);
+        if (use_slab && plugins[i].set_allocator) plugins[i].set_allocator(&slab);
     }
 
-    // Wire callbacks in order
-    for (size_t i = 0; i + 1 < num; ++i) {
-        LOG_INFO("attach %s -> %s", plugins[i].name, plugins[i+1].name);
-        plugins[i].attach(plugins[i + 1].place_work);
+    // Wire callbacks in order.
+    // A run of adjacent stateless stages works on the thread of its
+    // first stage, which applies the others' transforms and feeds the stage
+    // after the run; the others are closed right away (--fuse=0 keeps a
+    // thread per stage). A replicated stage may only lead a run
+    int fuse = parse_long_env("PIPELINE_FUSE", 1) != 0;
+    for (size_t head = n_inline; head < num;) {
+        size_t last = head;
+        if (fuse && plugins[head].fuse && plugins[head].process_record) {
+            while (last + 1 < num && plugins[last + 1].process_record && plugins[last + 1].replicas == 1 &&
+                   same_allocator(&plugins[head], &plugins[last + 1], use_slab) &&
+                   plugins[head].fuse(plugins[last + 1].process_record) == NULL) {
+                last++;
+                LOG_INFO("fuse %s into %s", plugins[last].name, plugins[head].name);
+            }
+        }
+        for (size_t k = head + 1; k <= last; ++k) {
+            plugins[k].attach(NULL);
+            (void)plugins[k].place_work(BQ_END_SENTINEL);
+        }
+        if (last + 1 < num) {
+            LOG_INFO("attach %s -> %s", plugins[head].name, plugins[last + 1].name);
+            attach_stage(&plugins[head], &plugins[last + 1], use_slab);
+        } else {
+            LOG_INFO("attach %s -> (end)", plugins[head].name);
+            plugins[head].attach(NULL);
+        }
+        head = last + 1;
     }
-    if (num > 0) { LOG_INFO("attach %s -> (end)", plugins[num-1].name); plugins[num - 1].attach(NULL); }
 
-    // Read stdin and feed first plugin via its input queue by place_work()
-    char *line = NULL;
-    size_t cap = 0;
-    ssize_t len;
-    while ((len = getline(&line, &cap, stdin)) != -1) {
-        // trim trailing \n
-        if (len > 0 && line[len - 1] == '\n') {
-            line[len - 1] = '\0';
-            len--;
-        }
-        const char *err = plugins[0].place_work(line);
-        free(line);
-        line = NULL;
-        if (err) { LOG_ERR("place_work failed in %s: %s", plugins[0].name, err); break; }
+    // The reader shares the first stage's CPUs
+    if (placement_pin(&where, 0, plugins[0].replicas, cpus, sizeof(cpus)) != 0) {
+        LOG_ERR("failed to pin the reader to CPUs %s", cpus);
     }
-    free(line);
 
-    // Signal end-of-stream once to the first plugin
-    (void)plugins[0].place_work(BQ_END_SENTINEL);
+    // Read stdin and feed first plugin via its input queue by place_work()
+    inline_run run = { plugins, n_inline, n_inline < num ? &plugins[n_inline] : NULL,
+                       use_slab ? &slab : NULL, 0 };
+    feed_stdin(run.next ? run.next : &plugins[0], &run);
+
+    // Signal end-of-stream once to the first threaded plugin
+    if (run.next) (void)run.next->place_work(BQ_END_SENTINEL);
 
     // Wait for all plugins to finish processing before finalizing
     for (size_t i = 0; i < num; ++i) (void)plugins[i].wait_finished();
     for (size_t i = 0; i < num; ++i) (void)plugins[i].fini();
 
+    // Workers may still be returning through plugin code
+    if (use_pool) {
+        char line[160];
+        executor_format_stats(&executor, line, sizeof(line));
+        LOG_INFO("%s", line);
+        executor_destroy(&executor);
+    }
     for (size_t i = 0; i < num; ++i) {
         if (plugins[i].handle) dlclose(plugins[i].handle);
     }
 
-    
+    if (mem_limit > 0) {
+        LOG_INFO("memory: peak %zu of %zu bytes queued", byte_budget_peak(&mem_budget), mem_limit);
+        byte_budget_destroy(&mem_budget);
+    }
+    if (use_slab) {
+        if (parse_long_env("PIPELINE_ALLOC_STATS", 0) != 0) report_slab(&slab);
+        slab_destroy(&slab);
+    }
     free(plugins);
+    placement_free(&where);
+    plan_free(&chain);
+    free(names);
     free(spec);
     return 0;
 }
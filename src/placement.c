@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include "placement.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <sched.h>
+
+// One CPU this process may run on, with where it sits
+typedef struct cpu_info {
+    int cpu;
+    int node;
+    int package;
+    int core;
+} cpu_info;
+
+static int read_int(const char *path, int fallback) {
+    FILE *f = fopen(path, "r");
+    if (!f) return fallback;
+    int v = fallback;
+    if (fscanf(f, "%d", &v) != 1) v = fallback;
+    fclose(f);
+    return v;
+}
+
+// The cpuN directory links the node it belongs to as nodeM
+static int cpu_node(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (!dir) return 0;
+    int node = 0;
+    struct dirent *e;
+    while ((e = readdir(dir)) != NULL) {
+        if (strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9') {
+            node = atoi(e->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+static cpu_info describe(int cpu) {
+    char path[96];
+    cpu_info c = { cpu, cpu_node(cpu), 0, cpu };
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    c.package = read_int(path, 0);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    c.core = read_int(path, cpu);
+    return c;
+}
+
+// Node, then socket, then core: hyperthreads of one core end up next to
+// each other, then the other cores of the socket
+static int compare_compact(const void *a, const void *b) {
+    const cpu_info *x = (const cpu_info *)a;
+    const cpu_info *y = (const cpu_info *)b;
+    if (x->node != y->node) return x->node < y->node ? -1 : 1;
+    if (x->package != y->package) return x->package < y->package ? -1 : 1;
+    if (x->core != y->core) return x->core < y->core ? -1 : 1;
+    return x->cpu < y->cpu ? -1 : x->cpu > y->cpu;
+}
+
+// Nodes when there are several, sockets otherwise
+static int domain(const cpu_info *c, int by_node) {
+    return by_node ? c->node : c->package;
+}
+
+// Deal the compact order out one domain at a time, so consecutive slots
+// alternate between them
+static void spread(const cpu_info *sorted, size_t n, int *out) {
+    int by_node = 0;
+    for (size_t i = 1; i < n; ++i) {
+        if (sorted[i].node != sorted[0].node) by_node = 1;
+    }
+    size_t *next = (size_t *)calloc(n, sizeof(size_t));  // start of each domain's rest
+    size_t *end = (size_t *)calloc(n, sizeof(size_t));
+    if (!next || !end) {
+        for (size_t i = 0; i < n; ++i) out[i] = sorted[i].cpu;
+        free(next);
+        free(end);
+        return;
+    }
+    size_t domains = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (i == 0 || domain(&sorted[i], by_node) != domain(&sorted[i - 1], by_node)) {
+            next[domains++] = i;
+        }
+        end[domains - 1] = i + 1;
+    }
+    size_t k = 0;
+    while (k < n) {
+        for (size_t d = 0; d < domains; ++d) {
+            if (next[d] < end[d]) out[k++] = sorted[next[d]++].cpu;
+        }
+    }
+    free(next);
+    free(end);
+}
+
+// "0,2,4-7", each CPU one this process may use
+static const char *parse_list(placement *pl, const char *spec, const cpu_set_t *allowed) {
+    const char *p = spec;
+    size_t cap = 0;
+    for (;;) {
+        char *end = NULL;
+        errno = 0;
+        long lo = strtol(p, &end, 10);
+        long hi = lo;
+        if (end == p || errno != 0 || lo < 0) return "expected compact, spread or a CPU list";
+        p = end;
+        if (*p == '-') {
+            const char *q = p + 1;
+            hi = strtol(q, &end, 10);
+            if (end == q || errno != 0 || hi < lo) return "expected compact, spread or a CPU list";
+            p = end;
+        }
+        for (long cpu = lo; cpu <= hi; ++cpu) {
+            if (cpu >= CPU_SETSIZE || !CPU_ISSET((int)cpu, allowed)) return "CPU not available";
+            if (pl->num == cap) {
+                cap = cap ? cap * 2 : 16;
+                int *grown = (int *)realloc(pl->cpus, cap * sizeof(int));
+                if (!grown) return "out of memory";
+                pl->cpus = grown;
+            }
+            pl->cpus[pl->num++] = (int)cpu;
+        }
+        if (*p == '\0') return NULL;
+        if (*p++ != ',') return "expected compact, spread or a CPU list";
+    }
+}
+
+const char *placement_init(placement *pl, const char *spec) {
+    memset(pl, 0, sizeof(*pl));
+    if (!spec || !*spec || strcmp(spec, "none") == 0) return NULL;
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return "cannot read the CPU affinity";
+    if (strcmp(spec, "compact") != 0 && strcmp(spec, "spread") != 0) {
+        pl->mode = PLACEMENT_LIST;
+        return parse_list(pl, spec, &allowed);
+    }
+    pl->mode = strcmp(spec, "compact") == 0 ? PLACEMENT_COMPACT : PLACEMENT_SPREAD;
+
+    size_t n = (size_t)CPU_COUNT(&allowed);
+    cpu_info *info = (cpu_info *)calloc(n > 0 ? n : 1, sizeof(cpu_info));
+    pl->cpus = (int *)calloc(n > 0 ? n : 1, sizeof(int));
+    if (!info || !pl->cpus) {
+        free(info);
+        return "out of memory";
+    }
+    size_t k = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && k < n; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) info[k++] = describe(cpu);
+    }
+    qsort(info, k, sizeof(cpu_info), compare_compact);
+    if (pl->mode == PLACEMENT_SPREAD) {
+        spread(info, k, pl->cpus);
+    } else {
+        for (size_t i = 0; i < k; ++i) pl->cpus[i] = info[i].cpu;
+    }
+    pl->num = k;
+    free(info);
+    return k > 0 ? NULL : "no CPU available";
+}
+
+int placement_pin(const placement *pl, size_t first, int count, char *desc, size_t size) {
+    if (size > 0) desc[0] = '\0';
+    if (pl->mode == PLACEMENT_NONE || pl->num == 0) return 0;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    size_t used = 0;
+    for (int k = 0; k < count; ++k) {
+        int cpu = pl->cpus[(first + (size_t)k) % pl->num];
+        if (CPU_ISSET(cpu, &set)) continue;
+        CPU_SET(cpu, &set);
+        int w = snprintf(desc + used, size - used, "%s%d", used ? "," : "", cpu);
+        if (w > 0 && used + (size_t)w < size) used += (size_t)w;
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+#else
+
+const char *placement_init(placement *pl, const char *spec) {
+    memset(pl, 0, sizeof(*pl));
+    if (!spec || !*spec || strcmp(spec, "none") == 0) return NULL;
+    return "not supported on this platform";
+}
+
+int placement_pin(const placement *pl, size_t first, int count, char *desc, size_t size) {
+    (void)pl;
+    (void)first;
+    (void)count;
+    if (size > 0) desc[0] = '\0';
+    return 0;
+}
+
+#endif
+
+void placement_free(placement *pl) {
+    free(pl->cpus);
+    pl->cpus = NULL;
+    pl->num = 0;
+    pl->mode = PLACEMENT_NONE;
+}
@@ -0,0 +1,36 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+
+// Where stage threads run (--placement). Stages take CPUs one slot per
+// thread, in chain order, wrapping around when the chain is longer than
+// the list.
+typedef enum placement_mode {
+    PLACEMENT_NONE = 0,          // threads float
+    PLACEMENT_COMPACT,           // neighbouring stages on sibling cores, one node at a time
+    PLACEMENT_SPREAD,            // neighbouring stages on different nodes (or sockets)
+    PLACEMENT_LIST,              // the CPUs given, in order
+} placement_mode;
+
+typedef struct placement {
+    placement_mode mode;
+    int *cpus;                   // slot -> CPU
+    size_t num;
+} placement;
+
+// Parse "compact", "spread", "none" or a CPU list such as "0,2,4-7" into
+// slots over the CPUs this process may run on. NULL or empty is "none".
+// Returns NULL, or an error; placement_free is needed either way.
+const char *placement_init(placement *pl, const char *spec);
+
+void placement_free(placement *pl);
+
+// Pin the calling thread to the count CPUs from slot first on. Threads it
+// starts inherit them, and memory it touches first comes from their NUMA
+// node, so the host calls this around a stage's plugin_init: the stage's
+// queue, its threads and their buffers all end up where it runs. Writes
+// the CPUs to desc as a list. A no-op for "none". Returns 0, or -1.
+int placement_pin(const placement *pl, size_t first, int count, char *desc, size_t size);
+
+#endif // PLACEMENT_H
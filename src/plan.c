@@ -0,0 +1,224 @@
+#define _POSIX_C_SOURCE 200809L
+#include "plan.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+// ROTATOR_AMOUNT and ROTATOR_DIRECTION as rotator reads them
+typedef struct rotation {
+    int valid;
+    unsigned long long by;
+    int left;
+} rotation;
+
+static rotation rotator_config(void) {
+    rotation r = { 1, 1, 0 };
+    const char *amount = getenv("ROTATOR_AMOUNT");
+    if (amount && *amount) {
+        char *end = NULL;
+        errno = 0;
+        r.by = strtoull(amount, &end, 10);
+        if (errno != 0 || end == amount || *end != '\0' || amount[0] == '-') r.valid = 0;
+    }
+    const char *dir = getenv("ROTATOR_DIRECTION");
+    if (dir && *dir) {
+        if (strcmp(dir, "left") == 0) r.left = 1;
+        else if (strcmp(dir, "right") != 0) r.valid = 0;
+    }
+    if (r.by > LLONG_MAX) r.valid = 0;  // too large to add up
+    return r;
+}
+
+// flipper moves bytes, not UTF-8 code points
+static int flipper_reverses_bytes(void) {
+    const char *env = getenv("FLIPPER_UTF8");
+    return !env || !*env || strcmp(env, "0") == 0;
+}
+
+static int movable(const char *name, const rotation *rot, int flip_bytes) {
+    if (strcmp(name, "uppercaser") == 0) return 1;
+    if (strcmp(name, "rotator") == 0) return rot->valid;
+    if (strcmp(name, "flipper") == 0) return flip_bytes;
+    return 0;
+}
+
+static plan_stage stage_named(const char *name) {
+    plan_stage s = { dup_cstr(name), 1, 0, 0, 0 };
+    return s;
+}
+
+// Split "name*N" into the stage. Returns NULL or an error.
+static const char *parse_stage(const char *tok, plan_stage *s) {
+    const char *star = strchr(tok, '*');
+    *s = stage_named(tok);
+    if (!s->name) return "out of memory";
+    if (!star) return NULL;
+    s->name[star - tok] = '\0';
+    char *end = NULL;
+    errno = 0;
+    long n = strtol(star + 1, &end, 10);
+    if (errno != 0 || end == star + 1 || *end != '\0' || n < 1 || n > PLAN_MAX_REPLICAS ||
+        star == tok) {
+        return "invalid replica count (expected name*N, N from 1 to 64)";
+    }
+    s->replicas = (int)n;
+    return NULL;
+}
+
+// Reduce run[0..n) to an uppercaser, a rotator and a flipper, each only
+// if needed. The run as a whole maps a line to flip^f(rotate(m, x)), with
+// m counted to the right; a rotator after a flip moves the other way.
+// Returns the stages written, or -1 if m would overflow.
+static int reduce_run(const plan_stage *run, size_t n, const rotation *rot, plan_stage *out) {
+    int upper = 0;
+    int flip = 0;
+    long long m = 0;
+    long long step = rot->left ? -(long long)rot->by : (long long)rot->by;
+    for (size_t i = 0; i < n; ++i) {
+        if (strcmp(run[i].name, "uppercaser") == 0) {
+            upper = 1;
+        } else if (strcmp(run[i].name, "flipper") == 0) {
+            flip ^= 1;
+        } else {
+            long long d = flip ? -step : step;
+            if ((d > 0 && m > LLONG_MAX - d) || (d < 0 && m < LLONG_MIN - d)) return -1;
+            m += d;
+        }
+    }
+    int k = 0;
+    if (upper) out[k++] = stage_named("uppercaser");
+    if (m != 0) {
+        plan_stage r = stage_named("rotator");
+        r.rotate_left = m < 0;
+        r.rotate_by = m < 0 ? (unsigned long long)(-(m + 1)) + 1 : (unsigned long long)m;
+        r.rotate_set = r.rotate_by != rot->by || r.rotate_left != rot->left;
+        out[k++] = r;
+    }
+    if (flip) out[k++] = stage_named("flipper");
+    return k;
+}
+
+const char *plan_build(plan *p, char *const *names, size_t num) {
+    p->num = 0;
+    p->stages = (plan_stage *)calloc(num > 0 ? num : 1, sizeof(plan_stage));
+    if (!p->stages) return "out of memory";
+
+    plan_stage *given = (plan_stage *)calloc(num > 0 ? num : 1, sizeof(plan_stage));
+    if (!given) {
+        plan_free(p);
+        return "out of memory";
+    }
+    const char *err = NULL;
+    for (size_t i = 0; i < num && !err; ++i) err = parse_stage(names[i], &given[i]);
+    if (err) {
+        for (size_t i = 0; i < num; ++i) free(given[i].name);
+        free(given);
+        plan_free(p);
+        return err;
+    }
+
+    int optimize = parse_long_env("PIPELINE_OPTIMIZE", 1) != 0;
+    rotation rot = rotator_config();
+    int flip_bytes = flipper_reverses_bytes();
+    size_t i = 0;
+    while (i < num) {
+        size_t end = i;
+        while (optimize && end < num && given[end].replicas == 1 &&
+               movable(given[end].name, &rot, flip_bytes)) {
+            end++;
+        }
+        if (end == i) {
+            p->stages[p->num++] = given[i++];
+            continue;
+        }
+        // a run never grows: it has at least as many stages as it keeps
+        int k = reduce_run(given + i, end - i, &rot, p->stages + p->num);
+        if (k < 0) {
+            while (i < end) p->stages[p->num++] = given[i++];
+            continue;
+        }
+        p->num += (size_t)k;
+        for (; i < end; ++i) free(given[i].name);
+    }
+    free(given);
+    if (num > 0 && p->num == 0) {
+        // the whole chain cancelled out: keep a stage that changes nothing
+        plan_stage r = stage_named("rotator");
+        r.rotate_set = 1;
+        p->stages[p->num++] = r;
+    }
+    for (size_t k = 0; k < p->num; ++k) {
+        if (!p->stages[k].name) return "out of memory";
+    }
+    return NULL;
+}
+
+void plan_free(plan *p) {
+    for (size_t i = 0; i < p->num; ++i) free(p->stages[i].name);
+    free(p->stages);
+    p->stages = NULL;
+    p->num = 0;
+}
+
+static void print_stage(const plan_stage *s, FILE *out) {
+    fputs(s->name, out);
+    if (s->replicas > 1) fprintf(out, "*%d", s->replicas);
+    if (s->rotate_set) fprintf(out, "(%llu %s)", s->rotate_by, s->rotate_left ? "left" : "right");
+}
+
+void plan_explain(const plan *p, char *const *names, size_t num, FILE *out) {
+    fputs("[info] plan: ", out);
+    for (size_t i = 0; i < num; ++i) fprintf(out, "%s%s", i ? "," : "", names[i]);
+    fprintf(out, " (%zu stage%s)\n", num, num == 1 ? "" : "s");
+    fputs("[info] optimized: ", out);
+    for (size_t i = 0; i < p->num; ++i) {
+        if (i) fputc(',', out);
+        print_stage(&p->stages[i], out);
+    }
+    fprintf(out, " (%zu stage%s)\n", p->num, p->num == 1 ? "" : "s");
+}
+
+static char *saved_amount;
+static char *saved_dir;
+static int saved;
+
+static void restore_var(const char *name, const char *value) {
+    if (value) setenv(name, value, 1);
+    else unsetenv(name);
+}
+
+int plan_env_apply(const plan_stage *s) {
+    if (!s->rotate_set) return 0;
+    if (!saved) {
+        const char *amount = getenv("ROTATOR_AMOUNT");
+        const char *dir = getenv("ROTATOR_DIRECTION");
+        saved_amount = amount ? dup_cstr(amount) : NULL;
+        saved_dir = dir ? dup_cstr(dir) : NULL;
+        if ((amount && !saved_amount) || (dir && !saved_dir)) {
+            free(saved_amount);
+            free(saved_dir);
+            saved_amount = saved_dir = NULL;
+            return -1;
+        }
+        saved = 1;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu", s->rotate_by);
+    if (setenv("ROTATOR_AMOUNT", buf, 1) != 0) return -1;
+    return setenv("ROTATOR_DIRECTION", s->rotate_left ? "left" : "right", 1);
+}
+
+void plan_env_restore(void) {
+    if (!saved) return;
+    restore_var("ROTATOR_AMOUNT", saved_amount);
+    restore_var("ROTATOR_DIRECTION", saved_dir);
+    free(saved_amount);
+    free(saved_dir);
+    saved_amount = NULL;
+    saved_dir = NULL;
+    saved = 0;
+}
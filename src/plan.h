@@ -0,0 +1,47 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <stdio.h>
+
+// Most workers "name*N" may ask for; the plugins' PLUGIN_MAX_REPLICAS
+#define PLAN_MAX_REPLICAS 64
+
+// One stage of an optimized chain. A rotator may run with an amount and
+// direction of its own instead of ROTATOR_AMOUNT and ROTATOR_DIRECTION.
+typedef struct plan_stage {
+    char *name;                  // plugin name, without "*N"
+    int replicas;                // "name*N" runs N workers; 1 otherwise
+    int rotate_set;
+    unsigned long long rotate_by;
+    int rotate_left;
+} plan_stage;
+
+typedef struct plan {
+    plan_stage *stages;
+    size_t num;
+} plan;
+
+// Rewrite a chain of plugin names into one with the same output, before
+// anything is loaded. Runs of uppercaser, rotator and flipper between
+// other stages are reduced with what the built-in plugins guarantee:
+// uppercasing is idempotent and commutes with moving bytes around, two
+// flips cancel and rotations add up, also across a flip (which turns
+// their direction around). A run becomes at most an uppercaser, one
+// rotator and a flipper. Any other plugin, and a stage whose configuration
+// is invalid, which reverses UTF-8 code points or which is replicated, is
+// left where it is. With PIPELINE_OPTIMIZE=0 the chain is copied as is.
+// Returns NULL, or an error for a malformed replica count or when out of
+// memory. plan_free is needed after success; on error nothing is left.
+const char *plan_build(plan *p, char *const *names, size_t num);
+
+void plan_free(plan *p);
+
+// Print the chain before and after, one "[info] " line each.
+void plan_explain(const plan *p, char *const *names, size_t num, FILE *out);
+
+// Set the environment a stage's plugin_init should see, and put the
+// user's values back afterwards. Stage threads never read it.
+int plan_env_apply(const plan_stage *s);
+void plan_env_restore(void);
+
+#endif // PLAN_H
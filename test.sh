@@ -157,7 +157,8 @@ pass "monitor unit test"
 # 11) consumer_producer queue unit test
 ${cc_cmd} -std=c11 -O2 -Wall -Wextra -Werror -pthread \
   -Iplugins tests/consumer_producer_test.c \
-  plugins/sync/monitor.c plugins/sync/consumer_producer.c -o build/consumer_producer_test
+  plugins/sync/monitor.c plugins/sync/consumer_producer.c plugins/sync/spsc_ring.c plugins/sync/byte_ring.c plugins/sync/byte_budget.c plugins/sync/spill_file.c plugins/sync/slab.c plugins/sync/executor.c \
+  -o build/consumer_producer_test
 run_with_timeout ./build/consumer_producer_test >/dev/null 2>&1 || fail "consumer_producer_test failed"
 pass "consumer_producer unit test"
 
@@ -380,4 +381,628 @@ if [[ "$out" != "CAB"$'' ]]; then
 fi
 pass "mixed uppercaser+rotator"
 
+# 31) lock-free SPSC stage queues keep chain output and ordering
+out="$(run_with_timeout sh -c 'printf "abc\n<END>\n" | ./build/pipeline --queue=spsc expander,uppercaser,flipper,sink_stdout' | cat)"
+if [[ "$out" != "C B A" ]]; then
+  fail "spsc chain: expected 'C B A', got '$out'"
+fi
+SPSC_OUT=$(run_with_timeout_n 15 bash -c "./output/analyzer --queue=spsc 1 uppercaser rotator flipper sink_stdout < '$tmp_many'")
+SPSC_EXP=$(python3 - "$tmp_many" <<'PY'
+import sys
+for l in open(sys.argv[1]).read().splitlines()[:-1]:
+    u = l.upper()
+    print((u[-1] + u[:-1])[::-1])
+PY
+)
+if [[ "$(printf '%s\n' "$SPSC_OUT" | sed '$d')" != "$SPSC_EXP" ]]; then
+  fail "spsc backpressure: output mismatch"
+fi
+pass "spsc queue"
+
+# 32) unknown queue kind is rejected
+set +e
+printf "x\n<END>\n" | ./build/pipeline --queue=bogus sink_stdout >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "unknown queue kind: expected failure"
+fi
+pass "unknown queue kind"
+
+# 33) batched feed: many short lines keep order; last line without newline kept
+tmp_batch="/tmp/os_pipeline_batch.txt"
+python3 - > "$tmp_batch" <<'PY'
+import sys
+sys.stdout.write("".join("line-%d\n" % i for i in range(5000)) + "tail")
+PY
+BATCH_OUT=$(run_with_timeout_n 10 bash -c "./build/pipeline uppercaser,flipper,sink_stdout < '$tmp_batch'")
+BATCH_EXP=$(python3 - "$tmp_batch" <<'PY'
+import sys
+for l in open(sys.argv[1]).read().split("\n"):
+    print(l.upper()[::-1])
+PY
+)
+if [[ "$BATCH_OUT" != "$BATCH_EXP" ]]; then
+  fail "batched feed: output mismatch"
+fi
+pass "batched feed"
+
+# 34) wait policy options are accepted and phase counts are reported
+WS_ERR=$(printf "a\nb\n<END>\n" | run_with_timeout ./output/analyzer --spin=200 --yield=4 --wait-stats=1 4 uppercaser sink_stdout 2>&1 >/dev/null)
+if ! printf '%s\n' "$WS_ERR" | grep -q "\[INFO\]\[uppercaser\] - waits: consumer spin=[0-9]* yield=[0-9]* park=[0-9]*"; then
+  echo "--- stderr ---"; printf '%s\n' "$WS_ERR"
+  fail "wait stats: expected per-stage wait report"
+fi
+pass "wait policy stats"
+
+# 35) inline byte-ring queues: in-place and copying stages, long lines spill to heap
+tmp_bytes="/tmp/os_pipeline_bytes.txt"
+python3 - > "$tmp_bytes" <<'PY'
+for i in range(300):
+    print("".join(chr(97 + (i + k) % 26) for k in range(1 + i * 7 % 300)))
+print("<END>")
+PY
+BYTES_OUT=$(run_with_timeout_n 15 bash -c "./output/analyzer --queue=bytes --ring-bytes=256 1 uppercaser rotator expander flipper sink_stdout < '$tmp_bytes'")
+BYTES_EXP=$(python3 - "$tmp_bytes" <<'PY'
+import sys
+for l in open(sys.argv[1]).read().splitlines()[:-1]:
+    u = l.upper()
+    print(" ".join(u[-1] + u[:-1])[::-1])
+PY
+)
+if [[ "$(printf '%s\n' "$BYTES_OUT" | sed '$d')" != "$BYTES_EXP" ]]; then
+  fail "byte ring: output mismatch"
+fi
+out="$(run_with_timeout sh -c 'printf "abc\n<END>\n" | ./build/pipeline --queue=bytes uppercaser,flipper,sink_stdout' | cat)"
+if [[ "$out" != "CBA" ]]; then
+  fail "byte ring chain: expected 'CBA', got '$out'"
+fi
+pass "byte ring queue"
+
+# 36) ownership transfer between stages: allocating stages hand buffers on
+for q in locked spsc bytes; do
+  out="$(run_with_timeout sh -c "printf 'ab\nxyz\n<END>\n' | ./build/pipeline --queue=$q expander,expander,flipper,uppercaser,sink_stdout" | cat)"
+  if [[ "$out" != $'B   A\nZ   Y   X' ]]; then
+    fail "owned hand-off ($q): unexpected output '$out'"
+  fi
+done
+pass "owned hand-off"
+
+# 37) byte budgets: skewed line sizes under per-queue and pipeline-wide limits
+tmp_skew="/tmp/os_pipeline_skew.txt"
+python3 - > "$tmp_skew" <<'PY'
+for i in range(400):
+    print(("s%d" % i) if i % 50 else "L" * 200000)
+PY
+for q in locked spsc; do
+  SKEW_ERR="/tmp/os_pipeline_skew.err"
+  SKEW_SUM=$(run_with_timeout_n 20 bash -c "./build/pipeline --queue=$q --queue-bytes=64k --memory-limit=256k uppercaser,expander,flipper,sink_stdout < '$tmp_skew' 2>'$SKEW_ERR'" | cksum)
+  SKEW_EXP=$(python3 - "$tmp_skew" <<'PY' | cksum
+import sys
+for l in open(sys.argv[1]).read().splitlines():
+    print(" ".join(l.upper())[::-1])
+PY
+)
+  if [[ "$SKEW_SUM" != "$SKEW_EXP" ]]; then
+    fail "byte budget ($q): output mismatch"
+  fi
+  if ! grep -q "memory: peak [0-9]* of 262144 bytes queued" "$SKEW_ERR"; then
+    fail "byte budget ($q): expected memory report"
+  fi
+done
+set +e
+printf "x\n<END>\n" | ./build/pipeline --memory-limit=lots sink_stdout >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "byte budget: malformed --memory-limit accepted"
+fi
+pass "byte budgets"
+
+# 38) spill-to-disk: a burst into a slow typewriter is absorbed, order kept
+tmp_spill="/tmp/os_pipeline_spill.txt"
+python3 - > "$tmp_spill" <<'PY'
+for i in range(3000):
+    print("t%d" % i)
+PY
+SPILL_ERR="/tmp/os_pipeline_spill.err"
+SPILL_OUT=$(run_with_timeout_n 30 bash -c "./build/pipeline --spill=/tmp uppercaser,typewriter < '$tmp_spill' 2>'$SPILL_ERR'")
+if [[ "$SPILL_OUT" != "$(tr a-z A-Z < "$tmp_spill")" ]]; then
+  fail "spill: output mismatch"
+fi
+if ! grep -q "\[INFO\]\[typewriter\] - spilled [1-9][0-9]* items to disk" "$SPILL_ERR"; then
+  echo "--- stderr ---"; cat "$SPILL_ERR"
+  fail "spill: expected the typewriter queue to spill"
+fi
+set +e
+printf "x\n<END>\n" | ./build/pipeline --queue=spsc --spill=/tmp sink_stdout >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "spill: expected failure with a non-locked queue"
+fi
+pass "spill to disk"
+
+# 39) slab allocator: same output as malloc, blocks freed across threads
+SLAB_IN=$(python3 -c "
+for i in range(2000): print('line %d ' % i + 'x' * (i % 300))")
+SLAB_ERR="/tmp/os_pipeline_slab.err"
+SLAB_OUT=$(printf "%s\n<END>\n" "$SLAB_IN" | ./build/pipeline --alloc-stats=1 uppercaser,expander,flipper,sink_stdout 2>"$SLAB_ERR")
+MALLOC_OUT=$(printf "%s\n<END>\n" "$SLAB_IN" | ./build/pipeline --allocator=malloc uppercaser,expander,flipper,sink_stdout 2>/dev/null)
+if [[ -z "$SLAB_OUT" || "$SLAB_OUT" != "$MALLOC_OUT" ]]; then
+  fail "slab: output differs from --allocator=malloc"
+fi
+if ! grep -q "slab: 256 B allocs=[1-9][0-9]* frees=[0-9]* remote=[1-9]" "$SLAB_ERR"; then
+  echo "--- stderr ---"; cat "$SLAB_ERR"
+  fail "slab: expected per-class stats with remote frees"
+fi
+set +e
+printf "x\n<END>\n" | ./build/pipeline --allocator=jemalloc sink_stdout >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "slab: expected failure for an unknown allocator"
+fi
+pass "slab allocator"
+
+# 40) records: lines keep their length, embedded NULs included
+NUL_EXPECT="/tmp/os_pipeline_nul.expect"
+NUL_OUT="/tmp/os_pipeline_nul.out"
+printf 'DC\0BA\nOLLEH\n' >"$NUL_EXPECT"
+for q in locked spsc bytes; do
+  printf 'ab\0cd\nhello\n<END>\n' | ./build/pipeline --queue=$q uppercaser,flipper,sink_stdout >"$NUL_OUT" 2>/dev/null
+  if ! cmp -s "$NUL_OUT" "$NUL_EXPECT"; then
+    od -c "$NUL_OUT"
+    fail "records: embedded NUL lost with --queue=$q"
+  fi
+done
+# a line over half the ring goes to the heap, and keeps its length there too
+LONG_NUL=$(python3 -c "print('ab' + 'c' * 198)")
+printf 'ab\0%s\n<END>\n' "$LONG_NUL" | ./build/pipeline --queue=bytes --ring-bytes=128 sink_stdout >"$NUL_OUT" 2>/dev/null
+printf 'ab\0%s\n' "$LONG_NUL" >"$NUL_EXPECT"
+if ! cmp -s "$NUL_OUT" "$NUL_EXPECT"; then
+  od -c "$NUL_OUT" | head
+  fail "records: embedded NUL lost in a heap record with --queue=bytes"
+fi
+pass "records keep embedded NULs"
+
+# 41) SIMD text kernels: exhaustive unit test, same output at every --simd level
+${cc_cmd} -std=c11 -O2 -Wall -Wextra -Werror \
+  -Iplugins tests/text_test.c plugins/text/cpu.c plugins/text/upper.c plugins/text/reverse.c plugins/text/expand.c \
+  -o build/text_test
+run_with_timeout ./build/text_test >/dev/null 2>&1 || fail "text_test failed"
+SIMD_IN=$(python3 -c "
+for i in range(300): print(''.join(chr(32 + (i * 7 + k) % 95) for k in range(i)))")
+SIMD_REF=$(printf "%s\n<END>\n" "$SIMD_IN" | ./build/pipeline --simd=scalar uppercaser,sink_stdout 2>/dev/null)
+if [[ "$SIMD_REF" != "$(printf "%s\n" "$SIMD_IN" | tr a-z A-Z)" ]]; then
+  fail "simd: scalar uppercaser output differs from tr"
+fi
+for isa in sse2 avx2 avx512 auto; do
+  SIMD_OUT=$(printf "%s\n<END>\n" "$SIMD_IN" | ./build/pipeline --simd=$isa uppercaser,sink_stdout 2>/dev/null)
+  if [[ "$SIMD_OUT" != "$SIMD_REF" ]]; then
+    fail "simd: --simd=$isa output differs from scalar"
+  fi
+done
+set +e
+printf "x\n<END>\n" | ./build/pipeline --simd=neon uppercaser,sink_stdout >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "simd: expected failure for an unknown instruction set"
+fi
+pass "SIMD text kernels"
+
+# 42) flipper: vector reversal at every --simd level, UTF-8 mode
+FLIP_REF=$(printf "%s\n" "$SIMD_IN" | rev)
+for isa in scalar sse2 avx2 avx512; do
+  FLIP_OUT=$(printf "%s\n<END>\n" "$SIMD_IN" | ./build/pipeline --simd=$isa flipper,sink_stdout 2>/dev/null)
+  if [[ "$FLIP_OUT" != "$FLIP_REF" ]]; then
+    fail "flipper: --simd=$isa output differs from rev"
+  fi
+done
+UTF8_OUT=$(printf 'caf\xc3\xa9 \xe2\x82\xac5\n<END>\n' | ./build/pipeline --flip-utf8=1 flipper,sink_stdout 2>/dev/null)
+if [[ "$UTF8_OUT" != $'5\xe2\x82\xac \xc3\xa9fac' ]]; then
+  fail "flipper: --flip-utf8=1 should reverse code points, got '$UTF8_OUT'"
+fi
+set +e
+printf "x\n<END>\n" | ./build/pipeline --flip-utf8=yes flipper,sink_stdout >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "flipper: expected failure for an invalid FLIPPER_UTF8 value"
+fi
+pass "flipper vector and UTF-8 reversal"
+
+# 43) rotator: rotate by N in either direction in one stage
+ROT_IN=$(python3 -c "
+print('abcdefghij'); print(''); print('z')
+for n in (300, 1000, 5000): print(''.join(chr(33 + i % 90) for i in range(n)))")
+ROT3=$(printf "%s\n<END>\n" "$ROT_IN" | ./build/pipeline --rotate-by=3 rotator,sink_stdout 2>/dev/null)
+ROT111=$(printf "%s\n<END>\n" "$ROT_IN" | ./build/pipeline rotator,rotator,rotator,sink_stdout 2>/dev/null)
+if [[ -z "$ROT3" || "$ROT3" != "$ROT111" ]]; then
+  fail "rotator: --rotate-by=3 differs from three rotators"
+fi
+for n in 0 7 280 700 4999 100003; do
+  for dir in right left; do
+    GOT=$(printf "%s\n<END>\n" "$ROT_IN" | ./build/pipeline --rotate-by=$n --rotate-dir=$dir rotator,sink_stdout 2>/dev/null)
+    WANT=$(printf "%s\n" "$ROT_IN" | python3 -c "
+import sys
+for l in sys.stdin.read().split('\n')[:-1]:
+    k = $n % len(l) if l else 0
+    if '$dir' == 'left': k = (len(l) - k) % len(l) if l else 0
+    print(l[len(l) - k:] + l[:len(l) - k])")
+    if [[ "$GOT" != "$WANT" ]]; then
+      fail "rotator: --rotate-by=$n --rotate-dir=$dir"
+    fi
+  done
+done
+set +e
+printf "x\n<END>\n" | ./build/pipeline --rotate-dir=up rotator,sink_stdout >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "rotator: expected failure for an invalid direction"
+fi
+pass "rotator by N"
+
+# 44) expander: vector interleave at every --simd level, separator and repeat count
+EXP_REF=$(printf "%s\n" "$SIMD_IN" | python3 -c "
+import sys
+for l in sys.stdin.read().split('\n')[:-1]: print(' '.join(l))")
+for isa in scalar sse2 avx2 avx512; do
+  EXP_OUT=$(printf "%s\n<END>\n" "$SIMD_IN" | ./build/pipeline --simd=$isa expander,sink_stdout 2>/dev/null)
+  if [[ "$EXP_OUT" != "$EXP_REF" ]]; then
+    fail "expander: --simd=$isa output differs from the reference"
+  fi
+done
+EXP_OUT=$(printf "abc\n<END>\n" | ./build/pipeline --expand-sep=-= --expand-repeat=2 expander,sink_stdout 2>/dev/null)
+if [[ "$EXP_OUT" != "a-=-=b-=-=c" ]]; then
+  fail "expander: --expand-sep=-= --expand-repeat=2 gave '$EXP_OUT'"
+fi
+EXP_OUT=$(printf "abc\n<END>\n" | ./build/pipeline --expand-repeat=3 expander,sink_stdout 2>/dev/null)
+if [[ "$EXP_OUT" != "a   b   c" ]]; then
+  fail "expander: --expand-repeat=3 gave '$EXP_OUT'"
+fi
+set +e
+printf "x\n<END>\n" | ./build/pipeline --expand-repeat=-1 expander,sink_stdout >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "expander: expected failure for a negative repeat count"
+fi
+pass "expander interleave and separator"
+
+# 45) async logger: group-commit writer unit test, same output as sync mode
+${cc_cmd} -std=c11 -O2 -Wall -Wextra -Werror -pthread \
+  -Iplugins tests/io_test.c plugins/io/async_writer.c plugins/io/mmap_log.c plugins/io/uring_writer.c \
+  plugins/io/line_batch.c -o build/io_test
+run_with_timeout ./build/io_test >/dev/null 2>&1 || fail "io_test failed"
+LOG_IN=$(seq 1 3000 | sed 's/^/log line /')
+: > output/pipeline.log
+LOG_SYNC=$(printf "%s\n<END>\n" "$LOG_IN" | ./build/pipeline logger 2>/dev/null)
+LOG_SYNC_FILE=$(cat output/pipeline.log)
+: > output/pipeline.log
+LOG_ASYNC=$(printf "%s\n<END>\n" "$LOG_IN" | ./build/pipeline --log-mode=async --log-flush-bytes=4k logger 2>/dev/null)
+if [[ "$LOG_ASYNC" != "$LOG_SYNC" ]]; then
+  fail "async logger: stdout differs from sync mode"
+fi
+if [[ "$(cat output/pipeline.log)" != "$LOG_SYNC_FILE" || "$LOG_SYNC_FILE" != "$LOG_IN" ]]; then
+  fail "async logger: output/pipeline.log differs from sync mode"
+fi
+set +e
+printf "x\n<END>\n" | ./build/pipeline --log-mode=later logger >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "async logger: expected failure for an unknown mode"
+fi
+pass "async logger"
+
+# 46) mapped logger: same log as sync mode, leftovers of an untrimmed run dropped
+: > output/pipeline.log
+LOG_MMAP=$(printf "%s\n<END>\n" "$LOG_IN" | ./build/pipeline --log-mode=mmap --log-extent=4k logger 2>/dev/null)
+if [[ "$LOG_MMAP" != "$LOG_SYNC" ]]; then
+  fail "mapped logger: stdout differs from sync mode"
+fi
+if [[ "$(cat output/pipeline.log)" != "$LOG_SYNC_FILE" ]]; then
+  fail "mapped logger: output/pipeline.log differs from sync mode"
+fi
+printf 'before\n\0\0\0\0' > output/pipeline.log
+printf "after\n<END>\n" | ./build/pipeline --log-mode=mmap logger >/dev/null 2>&1
+if [[ "$(od -An -c output/pipeline.log | tr -s ' ')" != "$(printf 'before\nafter\n' | od -An -c | tr -s ' ')" ]]; then
+  od -c output/pipeline.log
+  fail "mapped logger: expected 'before' and 'after' with nothing in between"
+fi
+pass "mapped logger"
+
+# 47) io_uring outputs: same bytes as sync mode into a file and a pipe, thread-pool fallback
+URING_REF=$(printf "%s\n<END>\n" "$LOG_IN" | ./build/pipeline sink_stdout 2>/dev/null)
+for extra in "" "--io-threads=1"; do
+  URING_OUT="/tmp/os_pipeline_uring.out"
+  printf "%s\n<END>\n" "$LOG_IN" | ./build/pipeline --sink-mode=uring --io-block=1k $extra sink_stdout >"$URING_OUT" 2>/dev/null
+  if [[ "$(cat "$URING_OUT")" != "$URING_REF" ]]; then
+    fail "io_uring: sink_stdout $extra into a file differs from sync mode"
+  fi
+  URING_PIPE=$(printf "%s\n<END>\n" "$LOG_IN" | ./build/pipeline --sink-mode=uring --io-block=1k $extra sink_stdout 2>/dev/null | cat)
+  if [[ "$URING_PIPE" != "$URING_REF" ]]; then
+    fail "io_uring: sink_stdout $extra into a pipe differs from sync mode"
+  fi
+  : > output/pipeline.log
+  URING_LOG=$(printf "%s\n<END>\n" "$LOG_IN" | ./build/pipeline --log-mode=uring --io-block=1k $extra logger 2>/dev/null)
+  if [[ "$URING_LOG" != "$LOG_SYNC" || "$(cat output/pipeline.log)" != "$LOG_SYNC_FILE" ]]; then
+    fail "io_uring: logger $extra output differs from sync mode"
+  fi
+done
+URING_STATS=$(printf "x\n<END>\n" | ./build/pipeline --sink-mode=uring --io-stats=1 sink_stdout 2>&1 >/dev/null)
+if ! grep -q "writes of up to .* depth avg" <<<"$URING_STATS"; then
+  fail "io_uring: --io-stats=1 printed no depth report: '$URING_STATS'"
+fi
+for bad in "--sink-mode=direct" "--sink-mode=uring --io-depth=0"; do
+  set +e
+  printf "x\n<END>\n" | ./build/pipeline $bad sink_stdout >/dev/null 2>&1
+  rc=$?
+  set -e
+  if [[ $rc -eq 0 ]]; then
+    fail "io_uring: expected failure for $bad"
+  fi
+done
+pass "io_uring outputs"
+
+# 48) writev sink: batched output matches sync mode, vmsplice into a pipe, max delay honoured
+for extra in "" "--sink-vmsplice=1"; do
+  BATCH_OUT=$(printf "%s\n<END>\n" "$LOG_IN" | ./build/pipeline --sink-mode=writev --sink-batch-bytes=1k $extra sink_stdout 2>/dev/null | cat)
+  if [[ "$BATCH_OUT" != "$URING_REF" ]]; then
+    fail "writev sink: $extra output differs from sync mode"
+  fi
+done
+BATCH_FILE="/tmp/os_pipeline_batch.out"
+(printf "early\n"; sleep 1; printf "<END>\n") |
+  ./build/pipeline --sink-mode=writev --sink-idle-us=60000000 --sink-max-delay-us=50000 sink_stdout >"$BATCH_FILE" 2>/dev/null &
+batch_pid=$!
+sleep 0.5
+BATCH_EARLY=$(cat "$BATCH_FILE")
+wait $batch_pid
+if [[ "$BATCH_EARLY" != "early" ]]; then
+  fail "writev sink: line held past --sink-max-delay-us (got '$BATCH_EARLY' after 0.5s)"
+fi
+set +e
+printf "x\n<END>\n" | ./build/pipeline --sink-mode=writev --sink-max-delay-us=soon sink_stdout >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "writev sink: expected failure for a malformed max delay"
+fi
+pass "writev sink"
+
+# 49) typewriter: typed lines still reach the next stage, pace kept, backlog bounded
+TW_IN=$(python3 -c "
+for i in range(300): print('tw %d ' % i + 'y' * (i % 40))")
+TW_OUT=$(printf "%s\n<END>\n" "$TW_IN" | TYPEWRITER_DELAY_US=0 ./build/pipeline --typewriter-backlog=4 typewriter,sink_stdout 2>/dev/null)
+if [[ "$(sort <<<"$TW_OUT")" != "$(printf "%s\n%s\n" "$TW_IN" "$TW_IN" | sort)" ]]; then
+  fail "typewriter: every line should be typed and reach the next stage before <END>"
+fi
+tw_start=$(date +%s%N)
+TW_OUT=$(printf "abcdefghij\nabcdefghij\nabcdefghij\n<END>\n" | TYPEWRITER_DELAY_US=20000 ./build/pipeline typewriter 2>/dev/null)
+tw_ms=$(( ($(date +%s%N) - tw_start) / 1000000 ))
+if [[ "$TW_OUT" != "$(printf "abcdefghij\nabcdefghij\nabcdefghij")" ]]; then
+  fail "typewriter: paced output differs"
+fi
+if (( tw_ms < 580 || tw_ms > 2000 )); then
+  fail "typewriter: 30 characters at 20ms took ${tw_ms}ms, expected about 600ms"
+fi
+set +e
+printf "x\n<END>\n" | ./build/pipeline --typewriter-backlog=0 typewriter >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "typewriter: expected failure for an empty backlog"
+fi
+pass "typewriter pacing"
+
+# 50) fused stages: adjacent stateless stages share a thread, output unchanged
+FUSE_IN=$(python3 -c "
+for i in range(3000): print('Fuse %d ' % i + 'ab' * (i % 50))")
+# (one stdout writer per chain: logger and sink_stdout can split each other's lines)
+for chain in "uppercaser,rotator,flipper,expander,sink_stdout" "expander,uppercaser,logger,rotator,flipper"; do
+  FUSE_ERR="/tmp/os_pipeline_fuse.err"
+  FUSED=$(printf "%s\n<END>\n" "$FUSE_IN" | ./build/pipeline "$chain" 2>"$FUSE_ERR")
+  if ! grep -q "^\[info\] fuse " "$FUSE_ERR"; then
+    fail "fuse: $chain was not fused"
+  fi
+  UNFUSED=$(printf "%s\n<END>\n" "$FUSE_IN" | ./build/pipeline --fuse=0 "$chain" 2>"$FUSE_ERR")
+  if grep -q "^\[info\] fuse " "$FUSE_ERR"; then
+    fail "fuse: --fuse=0 still fused $chain"
+  fi
+  if [[ "$FUSED" != "$UNFUSED" ]]; then
+    fail "fuse: $chain output differs from the unfused run"
+  fi
+done
+FUSED=$(printf "%s\n<END>\n" "$FUSE_IN" | ./output/analyzer 20 uppercaser rotator expander sink_stdout 2>/dev/null)
+UNFUSED=$(printf "%s\n<END>\n" "$FUSE_IN" | ./output/analyzer --fuse=0 20 uppercaser rotator expander sink_stdout 2>/dev/null)
+if [[ "$FUSED" != "$UNFUSED" ]]; then
+  fail "fuse: analyzer output differs from the unfused run"
+fi
+pass "fused stages"
+
+# 51) plan optimizer: redundant stages rewritten away, output byte-identical
+PLAN_IN=$(python3 -c "
+import random
+random.seed(7)
+for i in range(2000): print(''.join(random.choice('abcXYZ 12') for _ in range(random.randint(0, 40))))")
+PLAN_ERR="/tmp/os_pipeline_plan.err"
+for opts in "" "--rotate-by=3" "--rotate-by=2 --rotate-dir=left" "--flip-utf8=1"; do
+  for chain in "flipper,flipper,sink_stdout" "rotator,rotator,rotator,sink_stdout" \
+               "uppercaser,rotator,flipper,uppercaser,rotator,flipper,sink_stdout" \
+               "flipper,rotator,expander,rotator,flipper,uppercaser,sink_stdout"; do
+    OPT=$(printf "%s\n<END>\n" "$PLAN_IN" | ./build/pipeline $opts "$chain" 2>/dev/null)
+    REF=$(printf "%s\n<END>\n" "$PLAN_IN" | ./build/pipeline $opts --optimize=0 "$chain" 2>/dev/null)
+    if [[ "$OPT" != "$REF" ]]; then
+      fail "plan: $chain $opts differs from the unoptimized run"
+    fi
+  done
+done
+printf "ab\n<END>\n" | ./build/pipeline --explain=1 rotator,flipper,rotator,uppercaser,uppercaser,sink_stdout >/dev/null 2>"$PLAN_ERR"
+if ! grep -q "^\[info\] optimized: uppercaser,flipper,sink_stdout (3 stages)$" "$PLAN_ERR"; then
+  echo "--- stderr ---"; cat "$PLAN_ERR"
+  fail "plan: expected the rotations to cancel across the flip"
+fi
+ACTUAL=$(printf "hello\n<END>\n" | ./output/analyzer --explain=1 10 flipper flipper uppercaser uppercaser sink_stdout 2>"$PLAN_ERR")
+if [[ "${ACTUAL%%$'\n'*}" != "HELLO" ]] || ! grep -q "^\[info\] optimized: uppercaser,sink_stdout" "$PLAN_ERR"; then
+  fail "plan: analyzer should run the optimized chain (got '$ACTUAL')"
+fi
+pass "plan optimizer"
+
+# 52) replicated stages: N workers per stage, output order unchanged
+REP_IN=$(python3 -c "
+for i in range(5000): print('Rep %d ' % i + 'xy' * (i % 40))")
+REP_ERR="/tmp/os_pipeline_rep.err"
+REF=$(printf "%s\n<END>\n" "$REP_IN" | ./build/pipeline expander,flipper,uppercaser,sink_stdout 2>/dev/null)
+for chain in "expander*8,flipper,uppercaser,sink_stdout" "expander*3,flipper*2,uppercaser*5,sink_stdout"; do
+  REP=$(printf "%s\n<END>\n" "$REP_IN" | ./build/pipeline "$chain" 2>"$REP_ERR")
+  if ! grep -q "^\[info\] replicate expander x" "$REP_ERR"; then
+    fail "replicas: $chain was not replicated"
+  fi
+  if [[ "$REP" != "$REF" ]]; then
+    fail "replicas: $chain changed the output or its order"
+  fi
+done
+REP=$(printf "%s\n<END>\n" "$REP_IN" | ./output/analyzer 8 'rotator*4' sink_stdout 2>/dev/null)
+if [[ "$REP" != "$(printf "%s\n<END>\n" "$REP_IN" | ./output/analyzer 8 rotator sink_stdout 2>/dev/null)" ]]; then
+  fail "replicas: analyzer output differs from the single worker"
+fi
+set +e
+for chain in "logger*2" "typewriter*2" "expander*0" "expander*x"; do
+  printf "x\n<END>\n" | ./build/pipeline "$chain" >/dev/null 2>"$REP_ERR"
+  if [[ $? -eq 0 ]]; then
+    set -e
+    fail "replicas: expected $chain to be refused"
+  fi
+done
+printf "x\n<END>\n" | ./build/pipeline --queue=spsc 'uppercaser*2' >/dev/null 2>"$REP_ERR"
+rc=$?
+set -e
+if [[ $rc -eq 0 ]] || ! grep -q "locked queue" "$REP_ERR"; then
+  fail "replicas: expected the spsc queue to refuse replicas"
+fi
+pass "replicated stages"
+
+# 53) executor: stages as tasks on a fixed pool of workers, output unchanged
+${cc_cmd} -std=c11 -O2 -Wall -Wextra -Werror -pthread \
+  -Iplugins tests/executor_test.c \
+  plugins/sync/monitor.c plugins/sync/consumer_producer.c plugins/sync/spsc_ring.c plugins/sync/byte_ring.c plugins/sync/byte_budget.c plugins/sync/spill_file.c plugins/sync/slab.c plugins/sync/executor.c \
+  -o build/executor_test
+run_with_timeout ./build/executor_test >/dev/null 2>&1 || fail "executor_test failed"
+EXEC_IN=$(python3 -c "
+for i in range(4000): print('Pool %d ' % i + 'cd' * (i % 30))")
+EXEC_CHAIN="uppercaser,rotator,flipper,expander,rotator,flipper,uppercaser,sink_stdout"
+REF=$(printf "%s\n<END>\n" "$EXEC_IN" | ./build/pipeline --fuse=0 "$EXEC_CHAIN" 2>/dev/null)
+for workers in 1 3; do
+  POOL=$(printf "%s\n<END>\n" "$EXEC_IN" | run_with_timeout ./build/pipeline --executor=pool --workers=$workers --fuse=0 --queue-bytes=64 "$EXEC_CHAIN" 2>/dev/null)
+  if [[ "$POOL" != "$REF" ]]; then
+    fail "executor: --workers=$workers output differs from a thread per stage"
+  fi
+done
+# typewriter keeps its own thread in between pool stages
+POOL=$(printf "ab\ncd\n<END>\n" | TYPEWRITER_DELAY_US=0 run_with_timeout ./build/pipeline --executor=pool --workers=1 uppercaser,typewriter,flipper,sink_stdout 2>/dev/null)
+if [[ "$(sort <<<"$POOL")" != "$(printf "AB\nBA\nCD\nDC" | sort)" ]]; then
+  fail "executor: typewriter between pool stages (got '$POOL')"
+fi
+POOL=$(printf "%s\n<END>\n" "$EXEC_IN" | run_with_timeout ./output/analyzer --executor=pool 4 uppercaser rotator flipper sink_stdout 2>/dev/null)
+if [[ "$POOL" != "$(printf "%s\n<END>\n" "$EXEC_IN" | ./output/analyzer 4 uppercaser rotator flipper sink_stdout 2>/dev/null)" ]]; then
+  fail "executor: analyzer output differs from a thread per stage"
+fi
+set +e
+printf "x\n<END>\n" | ./build/pipeline --executor=fibers uppercaser >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "executor: expected failure for an unknown --executor"
+fi
+pass "executor pool"
+
+# 54) placement: stage threads pinned compact, spread or to listed CPUs, output unchanged
+PLACE_CHAIN="uppercaser,rotator*2,flipper,sink_stdout"
+REF=$(printf "%s\n<END>\n" "$EXEC_IN" | ./build/pipeline --optimize=0 --fuse=0 "$PLACE_CHAIN" 2>/dev/null)
+PLACE_ERR="/tmp/os_pipeline_place.err"
+FIRST_CPU=$(python3 -c "import os; print(min(os.sched_getaffinity(0)))")
+for policy in compact spread "$FIRST_CPU"; do
+  PLACED=$(printf "%s\n<END>\n" "$EXEC_IN" | run_with_timeout ./build/pipeline --placement="$policy" --optimize=0 --fuse=0 "$PLACE_CHAIN" 2>"$PLACE_ERR")
+  if [[ "$PLACED" != "$REF" ]]; then
+    fail "placement: --placement=$policy output differs"
+  fi
+  grep -q "place rotator on cpus" "$PLACE_ERR" || fail "placement: --placement=$policy logged no placement"
+done
+# every thread of a running pipeline is confined to the listed CPU
+if [[ -d /proc/self/task ]]; then
+  (sleep 1; printf "x\n<END>\n") | ./build/pipeline --placement="$FIRST_CPU" "uppercaser,rotator,sink_stdout" >/dev/null 2>&1 &
+  PLACE_PID=$!
+  sleep 0.3
+  for st in /proc/$PLACE_PID/task/*/status; do
+    allowed=$(awk '/^Cpus_allowed_list/ {print $2}' "$st" 2>/dev/null || true)
+    if [[ -n "$allowed" && "$allowed" != "$FIRST_CPU" ]]; then
+      fail "placement: a thread may run on CPUs $allowed"
+    fi
+  done
+  wait $PLACE_PID
+fi
+PLACED=$(printf "%s\n<END>\n" "$EXEC_IN" | run_with_timeout ./output/analyzer --placement=compact 4 uppercaser rotator flipper sink_stdout 2>/dev/null)
+if [[ "$PLACED" != "$(printf "%s\n<END>\n" "$EXEC_IN" | ./output/analyzer 4 uppercaser rotator flipper sink_stdout 2>/dev/null)" ]]; then
+  fail "placement: analyzer output differs"
+fi
+set +e
+printf "x\n<END>\n" | ./build/pipeline --placement=4096 uppercaser >/dev/null 2>&1
+rc=$?
+set -e
+if [[ $rc -eq 0 ]]; then
+  fail "placement: expected failure for a CPU that is not available"
+fi
+pass "placement"
+
+# 55) inline executor: leading stages run on the reader thread, output unchanged
+INLINE_ERR="/tmp/os_pipeline_inline.err"
+for chain in "uppercaser,rotator,flipper,expander,sink_stdout" "expander,rotator,typewriter" "uppercaser*2,flipper,sink_stdout"; do
+  REF=$(printf "%s\n<END>\n" "$EXEC_IN" | TYPEWRITER_DELAY_US=0 ./build/pipeline "$chain" 2>/dev/null)
+  INL=$(printf "%s\n<END>\n" "$EXEC_IN" | TYPEWRITER_DELAY_US=0 run_with_timeout ./build/pipeline --executor=inline "$chain" 2>"$INLINE_ERR")
+  if [[ "$INL" != "$REF" ]]; then
+    fail "inline: output differs for $chain"
+  fi
+done
+# only the stages before typewriter run inline; a replicated one never does
+printf "x\n<END>\n" | TYPEWRITER_DELAY_US=0 ./build/pipeline --executor=inline expander,typewriter,flipper,sink_stdout 2>"$INLINE_ERR" >/dev/null
+grep -q "run expander inline" "$INLINE_ERR" || fail "inline: expander did not run inline"
+if grep -q "run flipper inline\|run sink_stdout inline" "$INLINE_ERR"; then
+  fail "inline: a stage after typewriter ran inline"
+fi
+printf "x\n<END>\n" | ./build/pipeline --executor=inline "uppercaser*2,sink_stdout" 2>"$INLINE_ERR" >/dev/null
+if grep -q "run uppercaser inline" "$INLINE_ERR"; then
+  fail "inline: a replicated stage ran inline"
+fi
+# a sink mode that needs its thread falls back to one
+INL=$(printf "ab\n<END>\n" | run_with_timeout ./build/pipeline --executor=inline --sink-mode=writev uppercaser,sink_stdout 2>"$INLINE_ERR")
+if [[ "$INL" != "AB" ]] || ! grep -q "sink_stdout runs threaded" "$INLINE_ERR"; then
+  fail "inline: writev sink did not fall back to its thread (got '$INL')"
+fi
+INL=$(printf "%s\n<END>\n" "$EXEC_IN" | run_with_timeout ./output/analyzer --executor=inline 4 uppercaser expander flipper sink_stdout 2>/dev/null)
+if [[ "$INL" != "$(printf "%s\n<END>\n" "$EXEC_IN" | ./output/analyzer 4 uppercaser expander flipper sink_stdout 2>/dev/null)" ]]; then
+  fail "inline: analyzer output differs"
+fi
+pass "inline executor"
+
+# 56) analyzer: a stage that fails init stops the ones already running and exits 2
+INIT_BAD=(
+  "--simd=bogus logger uppercaser"
+  "--rotate-by=abc uppercaser rotator"
+  "--log-mode=bogus uppercaser logger"
+)
+for args in "${INIT_BAD[@]}"; do
+  set +e
+  printf "x\n<END>\n" | run_with_timeout ./output/analyzer ${args%% *} 10 ${args#* } >/dev/null 2>&1
+  rc=$?
+  set -e
+  if [[ $rc -ne 2 ]]; then
+    fail "analyzer: expected exit 2 for $args, got $rc"
+  fi
+done
+pass "analyzer init failure"
+
 echo "All smoke tests passed."
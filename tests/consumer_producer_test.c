@@ -1,8 +1,10 @@
 #define _POSIX_C_SOURCE 200809L
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include "sync/consumer_producer.h"
@@ -63,6 +65,7 @@ int main_(void) {
 
 #define _POSIX_C_SOURCE 200809L
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -104,6 +107,21 @@ static int test_basic_flow(void) {
     return ok ? 0 : 1;
 }
 
+/* init must not rely on the caller having zeroed the queue. */
+static int test_init_ignores_stale_memory(void) {
+    consumer_producer_t queue;
+    memset(&queue, 0xAB, sizeof(queue));
+    if (consumer_producer_init(&queue, 4) != NULL) {
+        return 1;
+    }
+    int ok = consumer_producer_put(&queue, "hi") == NULL;
+    char* item = consumer_producer_get(&queue);
+    ok = ok && streq(item, "hi");
+    free(item);
+    consumer_producer_destroy(&queue);
+    return ok ? 0 : 1;
+}
+
 typedef struct {
     consumer_producer_t* queue;
     char* items[4];
@@ -167,11 +185,700 @@ static int test_put_after_close_fails(void) {
     return err ? 0 : 1;
 }
 
+typedef struct {
+    consumer_producer_t* queue;
+    int count;
+} stream_args_t;
+
+static void* stream_producer(void* arg) {
+    stream_args_t* args = (stream_args_t*)arg;
+    char buf[32];
+    for (int i = 0; i < args->count; ++i) {
+        snprintf(buf, sizeof(buf), "S%d", i);
+        consumer_producer_put(args->queue, buf);
+    }
+    consumer_producer_put(args->queue, "<END>");
+    return NULL;
+}
+
+static int test_spsc_ordered_stream(void) {
+    consumer_producer_t queue;
+    if (consumer_producer_init_kind(&queue, 8, CP_QUEUE_SPSC) != NULL) {
+        fprintf(stderr, "queue init failed\n");
+        return 1;
+    }
+
+    stream_args_t args = { .queue = &queue, .count = 20000 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, stream_producer, &args);
+
+    int ok = 1;
+    int seen = 0;
+    char expect[32];
+    for (;;) {
+        char* item = consumer_producer_get(&queue);
+        if (!item) {
+            ok = 0;
+            break;
+        }
+        if (streq(item, "<END>")) {
+            break;
+        }
+        snprintf(expect, sizeof(expect), "S%d", seen);
+        if (!streq(item, expect)) {
+            ok = 0;
+        }
+        ++seen;
+        free(item);
+    }
+    pthread_join(thread, NULL);
+
+    /* drained and closed: further gets return NULL, puts fail */
+    if (consumer_producer_get(&queue) != NULL) {
+        ok = 0;
+    }
+    if (consumer_producer_put(&queue, "late") == NULL) {
+        ok = 0;
+    }
+
+    consumer_producer_destroy(&queue);
+    return ok && seen == args.count ? 0 : 1;
+}
+
+static int test_spsc_destroy_frees_pending(void) {
+    consumer_producer_t queue;
+    if (consumer_producer_init_kind(&queue, 4, CP_QUEUE_SPSC) != NULL) {
+        return 1;
+    }
+    consumer_producer_put(&queue, "left");
+    consumer_producer_put(&queue, "over");
+    consumer_producer_put(&queue, "<END>");
+    consumer_producer_destroy(&queue);
+    return 0;
+}
+
+typedef struct {
+    consumer_producer_t* queue;
+    int seen;
+    int max_batch;
+    int ordered;
+} batch_consumer_t;
+
+static void* batch_consumer(void* arg) {
+    batch_consumer_t* c = (batch_consumer_t*)arg;
+    char* items[CP_BATCH_MAX];
+    char expect[32];
+    for (;;) {
+        int n = consumer_producer_get_batch(c->queue, items, CP_BATCH_MAX);
+        if (n == 0) {
+            break;
+        }
+        if (n > c->max_batch) {
+            c->max_batch = n;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (streq(items[i], "<END>")) {
+                continue;
+            }
+            snprintf(expect, sizeof(expect), "B%d", c->seen++);
+            if (!streq(items[i], expect)) {
+                c->ordered = 0;
+            }
+            free(items[i]);
+        }
+    }
+    return NULL;
+}
+
+static int run_batch_flow(consumer_producer_kind_t kind) {
+    consumer_producer_t queue;
+    if (consumer_producer_init_kind(&queue, 4, kind) != NULL) {
+        return 1;
+    }
+
+    batch_consumer_t c = { .queue = &queue, .seen = 0, .max_batch = 0, .ordered = 1 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, batch_consumer, &c);
+
+    enum { TOTAL = 1000 };
+    static char bufs[TOTAL + 1][16];
+    const char* items[TOTAL + 1];
+    for (int i = 0; i < TOTAL; ++i) {
+        snprintf(bufs[i], sizeof(bufs[i]), "B%d", i);
+        items[i] = bufs[i];
+    }
+    items[TOTAL] = "<END>";
+
+    const char* err = consumer_producer_put_batch(&queue, items, TOTAL + 1);
+    pthread_join(thread, NULL);
+
+    /* items after <END> are refused */
+    const char* late[] = { "<END>", "x" };
+    const char* late_err = consumer_producer_put_batch(&queue, late, 2);
+
+    consumer_producer_destroy(&queue);
+    return !err && late_err && c.ordered && c.seen == TOTAL && c.max_batch <= 4 ? 0 : 1;
+}
+
+static int test_batch_flow(void) {
+    return run_batch_flow(CP_QUEUE_LOCKED) || run_batch_flow(CP_QUEUE_SPSC) ||
+           run_batch_flow(CP_QUEUE_BYTES);
+}
+
+static int test_get_batch_drains_available(void) {
+    consumer_producer_t queue;
+    if (consumer_producer_init(&queue, 8) != NULL) {
+        return 1;
+    }
+    const char* items[] = { "a", "b", "c" };
+    consumer_producer_put_batch(&queue, items, 3);
+
+    char* out[CP_BATCH_MAX];
+    int n = consumer_producer_get_batch(&queue, out, CP_BATCH_MAX);
+    int ok = n == 3 && streq(out[0], "a") && streq(out[1], "b") && streq(out[2], "c");
+    for (int i = 0; i < n; ++i) {
+        free(out[i]);
+    }
+    consumer_producer_destroy(&queue);
+    return ok ? 0 : 1;
+}
+
+static int test_repeated_end_keeps_items(void) {
+    consumer_producer_t queue;
+    if (consumer_producer_init(&queue, 2) != NULL) {
+        return 1;
+    }
+    /* a second <END> on a full, closed queue must not overwrite "last" */
+    consumer_producer_put(&queue, "last");
+    consumer_producer_put(&queue, "<END>");
+    consumer_producer_put(&queue, "<END>");
+    char* first = consumer_producer_get(&queue);
+    int ok = streq(first, "last");
+    free(first);
+    consumer_producer_destroy(&queue);
+    return ok ? 0 : 1;
+}
+
+static void* single_get(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    char* item = consumer_producer_get(queue);
+    if (item && !streq(item, "<END>")) {
+        free(item);
+    }
+    return NULL;
+}
+
+/* A consumer that blocks on an empty queue ends its wait in the expected phase. */
+static int wait_phase_hit(consumer_producer_kind_t kind, int spin, int yield, wait_phase_t expect) {
+    consumer_producer_t queue;
+    if (consumer_producer_init_kind(&queue, 2, kind) != NULL) {
+        return 1;
+    }
+    wait_policy_t policy = { .spin_iters = spin, .yield_iters = yield };
+    consumer_producer_set_wait_policy(&queue, &policy);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, single_get, &queue);
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 10 * 1000 * 1000 };
+    nanosleep(&ts, NULL);
+    consumer_producer_put(&queue, "wake");
+    pthread_join(thread, NULL);
+
+    unsigned long c[WAIT_PHASE_COUNT];
+    consumer_producer_get_wait_stats(&queue, c, NULL);
+    consumer_producer_destroy(&queue);
+    return c[expect] == 1 ? 0 : 1;
+}
+
+static int test_wait_policy_phases(void) {
+    return wait_phase_hit(CP_QUEUE_LOCKED, 0, 0, WAIT_PHASE_PARK) ||
+           wait_phase_hit(CP_QUEUE_LOCKED, 0, 100000000, WAIT_PHASE_YIELD) ||
+           wait_phase_hit(CP_QUEUE_SPSC, 0, 0, WAIT_PHASE_PARK) ||
+           wait_phase_hit(CP_QUEUE_SPSC, 0, 100000000, WAIT_PHASE_YIELD) ||
+           wait_phase_hit(CP_QUEUE_BYTES, 0, 0, WAIT_PHASE_PARK);
+}
+
+/* Line i of the byte-ring stream: length varies from empty to larger than
+ * the ring, so records wrap and some go to the heap. */
+static size_t bytes_line(int i, char* buf) {
+    size_t len = (size_t)(i * 37) % 400;
+    for (size_t k = 0; k < len; ++k) {
+        buf[k] = (char)('a' + (i + (int)k) % 26);
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static void* bytes_producer(void* arg) {
+    stream_args_t* a = (stream_args_t*)arg;
+    char buf[512];
+    for (int i = 0; i < a->count; ++i) {
+        bytes_line(i, buf);
+        consumer_producer_put(a->queue, buf);
+    }
+    consumer_producer_put(a->queue, "<END>");
+    return NULL;
+}
+
+static int test_bytes_views_in_place(void) {
+    consumer_producer_t queue;
+    if (consumer_producer_init_kind(&queue, 512, CP_QUEUE_BYTES) != NULL) {
+        fprintf(stderr, "queue init failed\n");
+        return 1;
+    }
+    if (!consumer_producer_borrows(&queue)) {
+        consumer_producer_destroy(&queue);
+        return 1;
+    }
+
+    stream_args_t args = { .queue = &queue, .count = 5000 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, bytes_producer, &args);
+
+    int ok = 1;
+    int seen = 0;
+    int done = 0;
+    char expect[512];
+    char* items[CP_BATCH_MAX];
+    while (!done) {
+        int n = consumer_producer_acquire_batch(&queue, items, CP_BATCH_MAX);
+        if (n == 0) {
+            ok = 0;
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (streq(items[i], "<END>")) {
+                done = 1;
+                break;
+            }
+            size_t len = bytes_line(seen, expect);
+            if (strlen(items[i]) != len || memcmp(items[i], expect, len) != 0) {
+                ok = 0;
+            }
+            /* views are writable in place */
+            for (size_t k = 0; k < len; ++k) {
+                items[i][k] = (char)(items[i][k] - 'a' + 'A');
+            }
+            ++seen;
+        }
+        consumer_producer_release(&queue);
+    }
+    pthread_join(thread, NULL);
+
+    if (consumer_producer_put(&queue, "late") == NULL) {
+        ok = 0;
+    }
+    consumer_producer_destroy(&queue);
+    return ok && seen == args.count ? 0 : 1;
+}
+
+static int test_bytes_owned_get_and_destroy(void) {
+    consumer_producer_t queue;
+    if (consumer_producer_init_kind(&queue, 128, CP_QUEUE_BYTES) != NULL) {
+        return 1;
+    }
+    char big[200];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    consumer_producer_put(&queue, "one");
+    char* first = consumer_producer_get(&queue);
+    int ok = streq(first, "one");
+    free(first);
+
+    /* destroy frees an oversized (heap) record left in the ring */
+    consumer_producer_put(&queue, big);
+    consumer_producer_put(&queue, "<END>");
+    consumer_producer_destroy(&queue);
+    return ok ? 0 : 1;
+}
+
+static char* heap_str(const char* s) {
+    char* copy = (char*)malloc(strlen(s) + 1);
+    if (copy) {
+        strcpy(copy, s);
+    }
+    return copy;
+}
+
+/* Owned puts hand the very same buffers to the consumer, no copy. */
+static int run_owned_flow(consumer_producer_kind_t kind) {
+    consumer_producer_t queue;
+    if (consumer_producer_init_kind(&queue, 8, kind) != NULL) {
+        return 1;
+    }
+    char* items[3] = { heap_str("a"), heap_str("b"), heap_str("<END>") };
+    const char* err = consumer_producer_put_owned_batch(&queue, items, 3);
+    int ok = err == NULL;
+
+    char* out[CP_BATCH_MAX];
+    int n = consumer_producer_get_batch(&queue, out, CP_BATCH_MAX);
+    ok = ok && n == 3 && streq(out[0], "a") && streq(out[1], "b") && streq(out[2], "<END>");
+    ok = ok && out[0] == items[0] && out[1] == items[1];
+    free(out[0]);
+    free(out[1]);
+    free(items[2]); /* <END> stays with the caller */
+
+    /* rejected buffers are freed by the queue */
+    ok = ok && consumer_producer_put_owned(&queue, heap_str("late")) != NULL;
+    consumer_producer_destroy(&queue);
+    return ok ? 0 : 1;
+}
+
+static int test_owned_flow(void) {
+    return run_owned_flow(CP_QUEUE_LOCKED) || run_owned_flow(CP_QUEUE_SPSC);
+}
+
+typedef struct {
+    consumer_producer_t* queue;
+    const char* item;
+    atomic_int done;
+} put_args_t;
+
+static void* blocking_put(void* arg) {
+    put_args_t* a = (put_args_t*)arg;
+    consumer_producer_put(a->queue, a->item);
+    atomic_store(&a->done, 1);
+    return NULL;
+}
+
+/* A put that would exceed the byte budget waits for a get, while an
+ * oversized line still enters an empty queue. */
+static int run_byte_budget(consumer_producer_kind_t kind) {
+    consumer_producer_t queue;
+    if (consumer_producer_init_kind(&queue, 100, kind) != NULL) {
+        return 1;
+    }
+    byte_budget_t shared;
+    byte_budget_init(&shared, 1000);
+    consumer_producer_set_shared_budget(&queue, &shared);
+    int ok = consumer_producer_set_byte_budget(&queue, 16) == NULL;
+
+    /* 8 bytes each with the terminator: two fit, the third must wait */
+    consumer_producer_put(&queue, "1234567");
+    consumer_producer_put(&queue, "abcdefg");
+    put_args_t args = { .queue = &queue, .item = "ABCDEFG" };
+    atomic_init(&args.done, 0);
+    pthread_t thread;
+    pthread_create(&thread, NULL, blocking_put, &args);
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 20 * 1000 * 1000 };
+    nanosleep(&ts, NULL);
+    ok = ok && atomic_load(&args.done) == 0 && byte_budget_used(&shared) == 16;
+
+    char* item = consumer_producer_get(&queue);
+    free(item);
+    pthread_join(thread, NULL);
+    ok = ok && atomic_load(&args.done) == 1 && byte_budget_used(&shared) == 16;
+    for (int i = 0; i < 2; ++i) {
+        free(consumer_producer_get(&queue));
+    }
+
+    char big[64];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    ok = ok && consumer_producer_put(&queue, big) == NULL && byte_budget_used(&shared) == 64;
+    consumer_producer_put(&queue, "<END>");
+    consumer_producer_destroy(&queue);
+    ok = ok && byte_budget_used(&shared) == 0 && byte_budget_peak(&shared) == 64;
+    byte_budget_destroy(&shared);
+    return ok ? 0 : 1;
+}
+
+static int test_byte_budget(void) {
+    return run_byte_budget(CP_QUEUE_LOCKED) || run_byte_budget(CP_QUEUE_SPSC);
+}
+
+/* With spilling the producer never blocks, and the consumer still sees
+ * every item in order, including ones larger than a spill block. */
+static int test_spill_keeps_order(void) {
+    consumer_producer_t queue;
+    if (consumer_producer_init(&queue, 4) != NULL) {
+        return 1;
+    }
+    int ok = consumer_producer_enable_spill(&queue, "/tmp") == NULL;
+    ok = ok && consumer_producer_set_byte_budget(&queue, 64) == NULL;
+
+    enum { TOTAL = 3000 };
+    static char big[SPILL_BLOCK + 100];
+    memset(big, 'b', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    char buf[32];
+    for (int i = 0; ok && i < TOTAL; ++i) {
+        snprintf(buf, sizeof(buf), "P%d", i);
+        ok = consumer_producer_put(&queue, i % 1000 == 500 ? big : buf) == NULL;
+    }
+    consumer_producer_put(&queue, "<END>");
+    ok = ok && consumer_producer_spilled(&queue) > 0;
+
+    int seen = 0;
+    char* out[CP_BATCH_MAX];
+    int n;
+    while (ok && (n = consumer_producer_get_batch(&queue, out, CP_BATCH_MAX)) > 0) {
+        for (int i = 0; i < n; ++i) {
+            if (streq(out[i], "<END>")) {
+                continue;
+            }
+            snprintf(buf, sizeof(buf), "P%d", seen);
+            if (!streq(out[i], seen % 1000 == 500 ? big : buf)) {
+                ok = 0;
+            }
+            ++seen;
+            free(out[i]);
+        }
+    }
+    consumer_producer_destroy(&queue);
+    return ok && seen == TOTAL ? 0 : 1;
+}
+
+/* A spill file that cannot be read back loses what is in it, but not the
+ * end of the stream: the consumer still gets <END>, and the loss is kept. */
+static int test_spill_read_error_keeps_end(void) {
+    consumer_producer_t queue;
+    if (consumer_producer_init(&queue, 4) != NULL) {
+        return 1;
+    }
+    int ok = consumer_producer_enable_spill(&queue, "/tmp") == NULL;
+    static char big[SPILL_BLOCK + 100];
+    memset(big, 'b', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    const char* ring[] = { "R0", "R1", "R2", "R3" };
+    ok = ok && consumer_producer_put_batch(&queue, ring, 4) == NULL;
+    ok = ok && consumer_producer_put(&queue, big) == NULL; /* straight to the file */
+    ok = ok && consumer_producer_put(&queue, "<END>") == NULL;
+    ok = ok && consumer_producer_spilled(&queue) == 2 && consumer_producer_error(&queue) == NULL;
+
+    /* reads of the file now fail */
+    int wronly = open("/dev/null", O_WRONLY);
+    ok = ok && wronly >= 0 && dup2(wronly, queue.spill.fd) >= 0;
+    if (wronly >= 0) {
+        close(wronly);
+    }
+
+    char* out[CP_BATCH_MAX];
+    int n = ok ? consumer_producer_get_batch(&queue, out, CP_BATCH_MAX) : 0;
+    ok = ok && n == 5 && streq(out[4], "<END>");
+    for (int i = 0; i < n; ++i) {
+        if (i < 4 && !streq(out[i], ring[i])) {
+            ok = 0;
+        }
+        if (!streq(out[i], "<END>")) {
+            free(out[i]);
+        }
+    }
+    ok = ok && consumer_producer_error(&queue) != NULL;
+    ok = ok && consumer_producer_get_batch(&queue, out, CP_BATCH_MAX) == 0;
+    consumer_producer_destroy(&queue);
+    return ok ? 0 : 1;
+}
+
+typedef struct {
+    consumer_producer_t* queue;
+    slab_t* slab;
+    int seen;
+} slab_consumer_args_t;
+
+static void* slab_consumer(void* arg) {
+    slab_consumer_args_t* args = (slab_consumer_args_t*)arg;
+    char* out[CP_BATCH_MAX];
+    char buf[32];
+    int n;
+    while ((n = consumer_producer_get_batch(args->queue, out, CP_BATCH_MAX)) > 0) {
+        for (int i = 0; i < n; ++i) {
+            if (streq(out[i], "<END>")) {
+                continue;
+            }
+            snprintf(buf, sizeof(buf), "S%d", args->seen);
+            if (streq(out[i], buf) || strlen(out[i]) == SLAB_MAX_BLOCK) {
+                args->seen++;
+            }
+            slab_free(args->slab, out[i]);
+        }
+    }
+    return NULL;
+}
+
+static int test_slab_cross_thread_frees(void) {
+    slab_t slab;
+    if (slab_init(&slab) != 0) {
+        return 1;
+    }
+    int ok = 1;
+    for (size_t len = 0; ok && len <= SLAB_MAX_BLOCK; len = len * 2 + 1) {
+        char* p = (char*)slab_alloc(&slab, len);
+        ok = p && ((uintptr_t)p % 16) == 0 && slab_usable_size(&slab, p) >= len;
+        if (p) {
+            memset(p, 'x', len);
+            slab_free(&slab, p);
+        }
+    }
+
+    /* lines copied on this thread, freed on the consumer's */
+    enum { TOTAL = 20000 };
+    static char big[SLAB_MAX_BLOCK + 1];
+    memset(big, 'B', SLAB_MAX_BLOCK);
+    size_t reserved_after_first = 0;
+    for (int round = 0; ok && round < 3; ++round) {
+        consumer_producer_t queue;
+        if (consumer_producer_init(&queue, 16) != NULL) {
+            ok = 0;
+            break;
+        }
+        consumer_producer_set_allocator(&queue, &slab);
+        slab_consumer_args_t args = { &queue, &slab, 0 };
+        pthread_t th;
+        pthread_create(&th, NULL, slab_consumer, &args);
+        char buf[32];
+        for (int i = 0; ok && i < TOTAL; ++i) {
+            snprintf(buf, sizeof(buf), "S%d", i);
+            ok = consumer_producer_put(&queue, i == TOTAL / 2 ? big : buf) == NULL;
+        }
+        consumer_producer_put(&queue, "<END>");
+        pthread_join(th, NULL);
+        consumer_producer_destroy(&queue);
+        ok = ok && args.seen == TOTAL;
+
+        /* blocks come back to the producer instead of new chunks */
+        slab_class_stats_t st[SLAB_STAT_SLOTS];
+        slab_get_stats(&slab, st);
+        size_t reserved = 0;
+        for (int i = 0; i < SLAB_CLASSES; ++i) {
+            ok = ok && st[i].allocs == st[i].frees;
+            reserved += st[i].reserved;
+        }
+        /* the size sweep above ends with one oversized block */
+        ok = ok && st[SLAB_LARGE].allocs == (unsigned long)round + 2 &&
+             st[SLAB_LARGE].frees == st[SLAB_LARGE].allocs;
+        ok = ok && st[0].remote_frees >= (unsigned long)(round + 1) * (TOTAL - 1);
+        if (round == 0) {
+            reserved_after_first = reserved;
+        } else {
+            ok = ok && reserved == reserved_after_first;
+        }
+    }
+    slab_destroy(&slab);
+    return ok ? 0 : 1;
+}
+
+/* Payloads with embedded NULs come back whole from every queue kind. */
+static int records_round_trip(consumer_producer_kind_t kind, int spill) {
+    consumer_producer_t queue;
+    if (consumer_producer_init_kind(&queue, 256, kind) != NULL) {
+        return 1;
+    }
+    int ok = 1;
+    if (spill) {
+        ok = consumer_producer_enable_spill(&queue, "/tmp") == NULL &&
+             consumer_producer_set_byte_budget(&queue, 8) == NULL;
+    }
+
+    static char payloads[3][8] = { "a\0b", "\0\0", "xyz\0w" };
+    static const size_t lens[3] = { 3, 2, 5 };
+    record_t in[4];
+    for (int i = 0; i < 3; ++i) {
+        in[i].data = payloads[i];
+        in[i].len = lens[i];
+        in[i].cap = lens[i] + 1;
+        in[i].flags = 0;
+    }
+    in[3] = record_end();
+    ok = ok && consumer_producer_put_records(&queue, in, 4) == NULL;
+
+    int seen = 0;
+    int done = 0;
+    record_t out[4];
+    while (ok && !done) {
+        int n = consumer_producer_get_records(&queue, out, 4);
+        if (n == 0) {
+            ok = 0;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (record_is_end(&out[i])) {
+                done = 1;
+                continue;
+            }
+            if (seen >= 3 || out[i].len != lens[seen] ||
+                memcmp(out[i].data, payloads[seen], lens[seen]) != 0 ||
+                out[i].data[out[i].len] != '\0') {
+                ok = 0;
+            }
+            ++seen;
+            free(out[i].data);
+        }
+    }
+    consumer_producer_destroy(&queue);
+    return ok && seen == 3 ? 0 : 1;
+}
+
+static int test_records_keep_embedded_nuls(void) {
+    return records_round_trip(CP_QUEUE_LOCKED, 0) || records_round_trip(CP_QUEUE_SPSC, 0) ||
+           records_round_trip(CP_QUEUE_BYTES, 0) || records_round_trip(CP_QUEUE_LOCKED, 1);
+}
+
+static void* seq_get(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    record_t out[1];
+    unsigned long seq = 0;
+    int n = consumer_producer_get_records_seq(queue, out, 1, &seq);
+    if (n == 1 && !record_is_end(&out[0])) {
+        free(out[0].data);
+    }
+    return NULL;
+}
+
+static int test_seq_numbers_and_close_wakes_all(void) {
+    consumer_producer_t queue;
+    if (consumer_producer_init(&queue, 8) != NULL) {
+        return 1;
+    }
+    const char* items[] = { "a", "b", "c", "d", "e" };
+    consumer_producer_put_batch(&queue, items, 5);
+    record_t out[2];
+    int ok = 1;
+    for (unsigned long want = 0; want < 3; ++want) {
+        unsigned long seq = 99;
+        int n = consumer_producer_get_records_seq(&queue, out, 2, &seq);
+        ok = ok && n == (want < 2 ? 2 : 1) && seq == want;
+        for (int i = 0; i < n; ++i) {
+            free(out[i].data);
+        }
+    }
+    /* several consumers asleep on an empty queue all return on <END> */
+    pthread_t threads[3];
+    for (int i = 0; i < 3; ++i) {
+        pthread_create(&threads[i], NULL, seq_get, &queue);
+    }
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 20 * 1000 * 1000 };
+    nanosleep(&ts, NULL);
+    consumer_producer_put(&queue, "<END>");
+    for (int i = 0; i < 3; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    consumer_producer_destroy(&queue);
+    return ok ? 0 : 1;
+}
+
+static int test_kind_parse(void) {
+    consumer_producer_kind_t kind = CP_QUEUE_LOCKED;
+    if (consumer_producer_kind_parse("spsc", &kind) != 0 || kind != CP_QUEUE_SPSC) {
+        return 1;
+    }
+    if (consumer_producer_kind_parse("locked", &kind) != 0 || kind != CP_QUEUE_LOCKED) {
+        return 1;
+    }
+    if (consumer_producer_kind_parse("bytes", &kind) != 0 || kind != CP_QUEUE_BYTES) {
+        return 1;
+    }
+    return consumer_producer_kind_parse("bogus", &kind) == -1 ? 0 : 1;
+}
+
 int main(void) {
     if (test_basic_flow() != 0) {
         fprintf(stderr, "test_basic_flow failed\n");
         return 1;
     }
+    if (test_init_ignores_stale_memory() != 0) {
+        fprintf(stderr, "test_init_ignores_stale_memory failed\n");
+        return 1;
+    }
     if (test_blocking_behavior() != 0) {
         fprintf(stderr, "test_blocking_behavior failed\n");
         return 1;
@@ -180,6 +887,70 @@ int main(void) {
         fprintf(stderr, "test_put_after_close_fails failed\n");
         return 1;
     }
+    if (test_spsc_ordered_stream() != 0) {
+        fprintf(stderr, "test_spsc_ordered_stream failed\n");
+        return 1;
+    }
+    if (test_spsc_destroy_frees_pending() != 0) {
+        fprintf(stderr, "test_spsc_destroy_frees_pending failed\n");
+        return 1;
+    }
+    if (test_kind_parse() != 0) {
+        fprintf(stderr, "test_kind_parse failed\n");
+        return 1;
+    }
+    if (test_batch_flow() != 0) {
+        fprintf(stderr, "test_batch_flow failed\n");
+        return 1;
+    }
+    if (test_get_batch_drains_available() != 0) {
+        fprintf(stderr, "test_get_batch_drains_available failed\n");
+        return 1;
+    }
+    if (test_repeated_end_keeps_items() != 0) {
+        fprintf(stderr, "test_repeated_end_keeps_items failed\n");
+        return 1;
+    }
+    if (test_wait_policy_phases() != 0) {
+        fprintf(stderr, "test_wait_policy_phases failed\n");
+        return 1;
+    }
+    if (test_owned_flow() != 0) {
+        fprintf(stderr, "test_owned_flow failed\n");
+        return 1;
+    }
+    if (test_byte_budget() != 0) {
+        fprintf(stderr, "test_byte_budget failed\n");
+        return 1;
+    }
+    if (test_spill_keeps_order() != 0) {
+        fprintf(stderr, "test_spill_keeps_order failed\n");
+        return 1;
+    }
+    if (test_spill_read_error_keeps_end() != 0) {
+        fprintf(stderr, "test_spill_read_error_keeps_end failed\n");
+        return 1;
+    }
+    if (test_slab_cross_thread_frees() != 0) {
+        fprintf(stderr, "test_slab_cross_thread_frees failed\n");
+        return 1;
+    }
+    if (test_bytes_views_in_place() != 0) {
+        fprintf(stderr, "test_bytes_views_in_place failed\n");
+        return 1;
+    }
+    if (test_records_keep_embedded_nuls() != 0) {
+        fprintf(stderr, "test_records_keep_embedded_nuls failed\n");
+        return 1;
+    }
+    if (test_bytes_owned_get_and_destroy() != 0) {
+        fprintf(stderr, "test_bytes_owned_get_and_destroy failed\n");
+        return 1;
+    }
+    if (test_seq_numbers_and_close_wakes_all() != 0) {
+        fprintf(stderr, "test_seq_numbers_and_close_wakes_all failed\n");
+        return 1;
+    }
     printf("consumer_producer_test OK\n");
     return 0;
 }
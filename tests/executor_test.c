@@ -0,0 +1,144 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sync/consumer_producer.h"
+#include "sync/executor.h"
+
+#define STAGES 4
+#define ITEMS 5000
+
+/* A chain of tasks, each moving records from its queue to the next. */
+typedef struct {
+    consumer_producer_t queues[STAGES];
+    executor_task_t tasks[STAGES];
+    int index[STAGES];
+    long next_expected;               /* checked by the last stage */
+    int in_order;
+} chain_t;
+
+static chain_t g_chain;
+
+static executor_status_t stage_step(void* arg) {
+    int i = *(int*)arg;
+    consumer_producer_t* q = &g_chain.queues[i];
+    record_t batch[8];
+    int n = consumer_producer_try_get_records(q, batch, 8);
+    if (n == 0) {
+        return EXECUTOR_IDLE;
+    }
+    int ended = record_is_end(&batch[n - 1]);
+    if (i + 1 < STAGES) {
+        /* tiny next queue: blocks and has the worker help downstream */
+        const char* err = consumer_producer_put_records_owned(&g_chain.queues[i + 1], batch, n);
+        if (err) {
+            g_chain.in_order = 0;
+        }
+    } else {
+        for (int k = 0; k < n; ++k) {
+            if (record_is_end(&batch[k])) {
+                continue;
+            }
+            if (strtol(batch[k].data, NULL, 10) != g_chain.next_expected++) {
+                g_chain.in_order = 0;
+            }
+            free(batch[k].data);
+        }
+    }
+    if (ended) {
+        consumer_producer_signal_finished(q);
+        return EXECUTOR_DONE;
+    }
+    return n == 8 ? EXECUTOR_MORE : EXECUTOR_IDLE;
+}
+
+static int run_chain(int workers) {
+    executor_t ex;
+    if (executor_init(&ex, workers) != 0) {
+        return 1;
+    }
+    memset(&g_chain, 0, sizeof(g_chain));
+    g_chain.in_order = 1;
+    for (int i = 0; i < STAGES; ++i) {
+        if (consumer_producer_init(&g_chain.queues[i], 2) != NULL) {
+            return 1;
+        }
+        g_chain.index[i] = i;
+        if (executor_register(&ex, &g_chain.tasks[i], executor_next_order(&ex), stage_step,
+                              &g_chain.index[i]) != 0) {
+            return 1;
+        }
+        consumer_producer_set_executor(&g_chain.queues[i], &ex, &g_chain.tasks[i]);
+    }
+
+    char buf[32];
+    for (long v = 0; v < ITEMS; ++v) {
+        snprintf(buf, sizeof(buf), "%ld", v);
+        consumer_producer_put(&g_chain.queues[0], buf);
+    }
+    consumer_producer_put(&g_chain.queues[0], "<END>");
+    for (int i = 0; i < STAGES; ++i) {
+        (void)consumer_producer_wait_finished(&g_chain.queues[i]);
+    }
+    executor_destroy(&ex);
+    for (int i = 0; i < STAGES; ++i) {
+        consumer_producer_destroy(&g_chain.queues[i]);
+    }
+    return g_chain.in_order && g_chain.next_expected == ITEMS ? 0 : 1;
+}
+
+/* One worker must get through a chain of full two-slot queues. */
+static int test_single_worker_chain(void) {
+    return run_chain(1);
+}
+
+static int test_many_workers_keep_order(void) {
+    return run_chain(4);
+}
+
+static atomic_int count_steps;
+
+static executor_status_t count_step(void* arg) {
+    (void)arg;
+    count_steps++;
+    return EXECUTOR_IDLE;
+}
+
+/* Notifying an idle task runs it. */
+static int test_notify_runs_task(void) {
+    executor_t ex;
+    if (executor_init(&ex, 2) != 0) {
+        return 1;
+    }
+    executor_task_t task;
+    if (executor_register(&ex, &task, executor_next_order(&ex), count_step, NULL) != 0) {
+        return 1;
+    }
+    executor_notify(&task);
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 20 * 1000 * 1000 };
+    nanosleep(&ts, NULL);
+    int ran = atomic_load(&count_steps);
+    executor_destroy(&ex);
+    return ran >= 1 ? 0 : 1;
+}
+
+int main(void) {
+    if (test_notify_runs_task() != 0) {
+        fprintf(stderr, "test_notify_runs_task failed\n");
+        return 1;
+    }
+    if (test_single_worker_chain() != 0) {
+        fprintf(stderr, "test_single_worker_chain failed\n");
+        return 1;
+    }
+    if (test_many_workers_keep_order() != 0) {
+        fprintf(stderr, "test_many_workers_keep_order failed\n");
+        return 1;
+    }
+    printf("executor_test OK\n");
+    return 0;
+}
@@ -0,0 +1,584 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "io/async_writer.h"
+#include "io/line_batch.h"
+#include "io/mmap_log.h"
+#include "io/uring_writer.h"
+
+#define THREADS 4
+#define LINES 5000
+
+/* An unlinked temp file to write into and read back. */
+static int temp_fd(void) {
+    char path[] = "/tmp/os_pipeline_io_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        unlink(path);
+    }
+    return fd;
+}
+
+/* Whole file contents, NUL-terminated; *len gets the size. */
+static char *read_back(int fd, size_t *len) {
+    off_t end = lseek(fd, 0, SEEK_END);
+    char *buf = malloc((size_t)end + 1);
+    if (!buf || pread(fd, buf, (size_t)end, 0) != end) {
+        free(buf);
+        return NULL;
+    }
+    buf[end] = '\0';
+    *len = (size_t)end;
+    return buf;
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+/* One producer, blocks far smaller than the output: every byte arrives in
+ * order on both targets. */
+static int test_order_small_blocks(void) {
+    int fds[2] = { temp_fd(), temp_fd() };
+    async_target_t targets[2] = { { fds[0], 0 }, { fds[1], 1 } };
+    async_writer_config_t config = { 64, 1000, 5 };
+    async_writer_t w;
+    if (fds[0] < 0 || fds[1] < 0 || async_writer_open(&w, targets, 2, &config) != NULL) {
+        return 1;
+    }
+    for (int i = 0; i < LINES; ++i) {
+        char line[32];
+        int n = snprintf(line, sizeof(line), "line %d\n", i);
+        if (async_writer_append(&w, 0, line, (size_t)n) != NULL ||
+            async_writer_append(&w, 1, line, (size_t)n) != NULL) {
+            return 1;
+        }
+    }
+    if (async_writer_close(&w) != NULL) {
+        return 1;
+    }
+    int rc = 0;
+    for (int t = 0; t < 2 && rc == 0; ++t) {
+        size_t len = 0;
+        char *got = read_back(fds[t], &len);
+        char *p = got;
+        for (int i = 0; p && i < LINES; ++i) {
+            char want[32];
+            int n = snprintf(want, sizeof(want), "line %d\n", i);
+            if (strncmp(p, want, (size_t)n) != 0) {
+                fprintf(stderr, "target %d: line %d out of order\n", t, i);
+                rc = 1;
+                break;
+            }
+            p += n;
+        }
+        if (!got || (rc == 0 && *p != '\0')) {
+            rc = 1;
+        }
+        free(got);
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return rc;
+}
+
+typedef struct {
+    async_writer_t *w;
+    int id;
+} producer_arg;
+
+static void *producer(void *p) {
+    producer_arg *a = (producer_arg *)p;
+    for (int i = 0; i < LINES; ++i) {
+        char num[32];
+        int n = snprintf(num, sizeof(num), "%d %d", a->id, i);
+        struct iovec line[3] = {
+            { (void *)"[t] ", 4 },
+            { num, (size_t)n },
+            { (void *)"\n", 1 },
+        };
+        async_writer_appendv(a->w, 0, line, 3);
+    }
+    return NULL;
+}
+
+/* Several producers: no line is torn and each producer's lines keep their
+ * order. */
+static int test_concurrent_lines_whole(void) {
+    int fd = temp_fd();
+    async_target_t target = { fd, 0 };
+    async_writer_config_t config = { 256, 1000, 0 };
+    async_writer_t w;
+    if (fd < 0 || async_writer_open(&w, &target, 1, &config) != NULL) {
+        return 1;
+    }
+    pthread_t th[THREADS];
+    producer_arg args[THREADS];
+    for (int t = 0; t < THREADS; ++t) {
+        args[t].w = &w;
+        args[t].id = t;
+        pthread_create(&th[t], NULL, producer, &args[t]);
+    }
+    for (int t = 0; t < THREADS; ++t) {
+        pthread_join(th[t], NULL);
+    }
+    if (async_writer_close(&w) != NULL) {
+        return 1;
+    }
+    size_t len = 0;
+    char *got = read_back(fd, &len);
+    close(fd);
+    if (!got) {
+        return 1;
+    }
+    int next[THREADS] = { 0 };
+    int rc = 0;
+    char *save = NULL;
+    for (char *line = strtok_r(got, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        int id = -1;
+        int i = -1;
+        if (sscanf(line, "[t] %d %d", &id, &i) != 2 || id < 0 || id >= THREADS || i != next[id]) {
+            fprintf(stderr, "bad line '%s'\n", line);
+            rc = 1;
+            break;
+        }
+        next[id]++;
+    }
+    for (int t = 0; t < THREADS && rc == 0; ++t) {
+        rc = next[t] == LINES ? 0 : 1;
+    }
+    free(got);
+    return rc;
+}
+
+/* A partial block reaches the fd after flush_ms without a drain. */
+static int test_flush_after_delay(void) {
+    int fd = temp_fd();
+    async_target_t target = { fd, 0 };
+    async_writer_config_t config = { 1 << 20, 20, 0 };
+    async_writer_t w;
+    if (fd < 0 || async_writer_open(&w, &target, 1, &config) != NULL) {
+        return 1;
+    }
+    async_writer_append(&w, 0, "tick\n", 5);
+    int rc = 1;
+    for (int i = 0; i < 200 && rc != 0; ++i) {
+        sleep_ms(10);
+        rc = lseek(fd, 0, SEEK_END) == 5 ? 0 : 1;
+    }
+    async_writer_close(&w);
+    close(fd);
+    return rc;
+}
+
+/* A drain returns only once everything appended is in the fd, and a line
+ * larger than a block still arrives whole. */
+static int test_drain_and_large_line(void) {
+    int fd = temp_fd();
+    async_target_t target = { fd, 0 };
+    async_writer_config_t config = { 8, 60000, 0 };
+    async_writer_t w;
+    if (fd < 0 || async_writer_open(&w, &target, 1, &config) != NULL) {
+        return 1;
+    }
+    char big[100];
+    memset(big, 'x', sizeof(big));
+    async_writer_append(&w, 0, "ab", 2);
+    async_writer_append(&w, 0, big, sizeof(big));
+    int rc = async_writer_drain(&w) == NULL && lseek(fd, 0, SEEK_END) == 102 ? 0 : 1;
+    async_writer_append(&w, 0, "c", 1);
+    if (async_writer_drain(&w) != NULL || lseek(fd, 0, SEEK_END) != 103) {
+        rc = 1;
+    }
+    async_writer_close(&w);
+    size_t len = 0;
+    char *got = read_back(fd, &len);
+    if (!got || memcmp(got, "ab", 2) != 0 || memcmp(got + 2, big, sizeof(big)) != 0 || got[102] != 'c') {
+        rc = 1;
+    }
+    free(got);
+    close(fd);
+    return rc;
+}
+
+/* A write error is reported, and later appends do not block. */
+static int test_write_error(void) {
+    int pipefd[2];
+    if (pipe(pipefd) != 0) {
+        return 1;
+    }
+    close(pipefd[0]);
+    async_target_t target = { pipefd[1], 0 };
+    async_writer_config_t config = { 16, 1000, 0 };
+    async_writer_t w;
+    if (async_writer_open(&w, &target, 1, &config) != NULL) {
+        return 1;
+    }
+    async_writer_append(&w, 0, "lost\n", 5);
+    int rc = async_writer_drain(&w) != NULL ? 0 : 1;
+    for (int i = 0; i < 100; ++i) {
+        async_writer_append(&w, 0, "more lost lines\n", 16);
+    }
+    if (async_writer_close(&w) == NULL) {
+        rc = 1;
+    }
+    close(pipefd[1]);
+    return rc;
+}
+
+/* Lines crossing many one-page windows, then a piece larger than a
+ * window: the trimmed file holds exactly the bytes appended. */
+static int test_mmap_windows(void) {
+    char path[] = "/tmp/os_pipeline_mmap_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return 1;
+    }
+    close(fd);
+    mmap_log_t log;
+    if (mmap_log_open(&log, path, 1) != NULL) {
+        unlink(path);
+        return 1;
+    }
+    int rc = 0;
+    size_t total = 0;
+    for (int i = 0; i < LINES && rc == 0; ++i) {
+        char num[32];
+        int n = snprintf(num, sizeof(num), "line %d", i);
+        struct iovec line[2] = { { num, (size_t)n }, { (void *)"\n", 1 } };
+        rc = mmap_log_appendv(&log, line, 2) == NULL ? 0 : 1;
+        total += (size_t)n + 1;
+    }
+    static char big[3 * 4096 + 100];
+    memset(big, 'x', sizeof(big));
+    struct iovec piece = { big, sizeof(big) };
+    if (mmap_log_appendv(&log, &piece, 1) != NULL || mmap_log_close(&log) != NULL) {
+        rc = 1;
+    }
+    total += sizeof(big);
+    fd = open(path, O_RDONLY);
+    size_t len = 0;
+    char *got = fd >= 0 ? read_back(fd, &len) : NULL;
+    if (!got || len != total || strncmp(got, "line 0\nline 1\n", 14) != 0 ||
+        memcmp(got + len - sizeof(big), big, sizeof(big)) != 0) {
+        rc = 1;
+    }
+    free(got);
+
+    /* a run that never trimmed: the zeros go, the data stays */
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (truncate(path, (off_t)total + 5000) != 0 || mmap_log_open(&log, path, 1) != NULL) {
+        rc = 1;
+    } else {
+        struct iovec tail = { (void *)"end\n", 4 };
+        if (mmap_log_appendv(&log, &tail, 1) != NULL || mmap_log_close(&log) != NULL) {
+            rc = 1;
+        }
+        struct stat st;
+        if (stat(path, &st) != 0 || st.st_size != (off_t)total + 4) {
+            rc = 1;
+        }
+    }
+    unlink(path);
+    return rc;
+}
+
+static const char *backend_name(int threads_only) {
+    return threads_only ? "threads" : "io_uring";
+}
+
+/* LINES numbered lines through a writer on fd, with blocks far smaller
+ * than the output. */
+static int write_lines(int fd, int owns_fd, int threads_only, int depth) {
+    uring_writer_config_t config = { 200, depth, threads_only, owns_fd, 0 };
+    uring_writer_t w;
+    if (uring_writer_open(&w, fd, &config) != NULL) {
+        return 1;
+    }
+    int rc = 0;
+    for (int i = 0; i < LINES && rc == 0; ++i) {
+        char num[32];
+        int n = snprintf(num, sizeof(num), "%d", i);
+        struct iovec line[3] = { { (void *)"line ", 5 }, { num, (size_t)n }, { (void *)"\n", 1 } };
+        rc = uring_writer_appendv(&w, line, 3) == NULL ? 0 : 1;
+    }
+    if (uring_writer_close(&w) != NULL || w.stats.writes == 0 || w.stats.max_depth < 1 ||
+        w.stats.max_depth > depth) {
+        rc = 1;
+    }
+    return rc;
+}
+
+static int lines_in_order(const char *got, size_t len) {
+    size_t pos = 0;
+    for (int i = 0; i < LINES; ++i) {
+        char want[32];
+        int n = snprintf(want, sizeof(want), "line %d\n", i);
+        if (pos + (size_t)n > len || memcmp(got + pos, want, (size_t)n) != 0) {
+            fprintf(stderr, "line %d out of order\n", i);
+            return 0;
+        }
+        pos += (size_t)n;
+    }
+    return pos == len;
+}
+
+/* A regular file the writer owns gets explicit offsets; one it does not
+ * own is written at its position. Both end up in order, and the fd is
+ * left after the data. */
+static int test_uring_file(int threads_only, int owns_fd) {
+    int fd = temp_fd();
+    if (fd < 0 || write(fd, "head\n", 5) != 5) {
+        return 1;
+    }
+    int rc = write_lines(fd, owns_fd, threads_only, 8);
+    size_t len = 0;
+    char *got = read_back(fd, &len);
+    if (rc != 0 || !got || memcmp(got, "head\n", 5) != 0 || !lines_in_order(got + 5, len - 5) ||
+        lseek(fd, 0, SEEK_CUR) != (off_t)len) {
+        rc = 1;
+    }
+    free(got);
+    close(fd);
+    return rc;
+}
+
+typedef struct {
+    int fd;
+    char *buf;
+    size_t len;
+} pipe_reader;
+
+static void *read_pipe(void *p) {
+    pipe_reader *r = (pipe_reader *)p;
+    size_t cap = 1 << 16;
+    r->buf = malloc(cap);
+    ssize_t n;
+    while (r->buf && (n = read(r->fd, r->buf + r->len, cap - r->len)) > 0) {
+        r->len += (size_t)n;
+        if (r->len == cap) {
+            cap *= 2;
+            r->buf = realloc(r->buf, cap);
+        }
+    }
+    return NULL;
+}
+
+/* A pipe, read slowly enough to keep several writes queued. */
+static int test_uring_pipe(int threads_only) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return 1;
+    }
+    pipe_reader r = { fds[0], NULL, 0 };
+    pthread_t th;
+    pthread_create(&th, NULL, read_pipe, &r);
+    int rc = write_lines(fds[1], 0, threads_only, 4);
+    close(fds[1]);
+    pthread_join(th, NULL);
+    close(fds[0]);
+    if (rc != 0 || !r.buf || !lines_in_order(r.buf, r.len)) {
+        rc = 1;
+    }
+    free(r.buf);
+    return rc;
+}
+
+/* A write error is reported and does not hang the writer. */
+static int test_uring_error(int threads_only) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return 1;
+    }
+    close(fds[0]);
+    uring_writer_config_t config = { 64, 2, threads_only, 0, 0 };
+    uring_writer_t w;
+    if (uring_writer_open(&w, fds[1], &config) != NULL) {
+        return 1;
+    }
+    struct iovec line = { (void *)"lost line\n", 10 };
+    for (int i = 0; i < 100; ++i) {
+        uring_writer_appendv(&w, &line, 1);
+    }
+    int rc = uring_writer_close(&w) != NULL ? 0 : 1;
+    close(fds[1]);
+    return rc;
+}
+
+static int test_uring_writer(int threads_only) {
+    if (test_uring_file(threads_only, 1) != 0) {
+        fprintf(stderr, "%s: owned file\n", backend_name(threads_only));
+        return 1;
+    }
+    if (test_uring_file(threads_only, 0) != 0) {
+        fprintf(stderr, "%s: shared file\n", backend_name(threads_only));
+        return 1;
+    }
+    if (test_uring_pipe(threads_only) != 0) {
+        fprintf(stderr, "%s: pipe\n", backend_name(threads_only));
+        return 1;
+    }
+    if (test_uring_error(threads_only) != 0) {
+        fprintf(stderr, "%s: write error\n", backend_name(threads_only));
+        return 1;
+    }
+    return 0;
+}
+
+static struct iovec line_of(const char *s) {
+    struct iovec v = { (void *)s, strlen(s) };
+    return v;
+}
+
+/* Lines wait for the count, then go out together; <END> writes the rest. */
+static int test_batch_count_and_end(void) {
+    int fd = temp_fd();
+    line_batch_config_t config = { 3, 1 << 16, 60000000, 60000000, 0 };
+    line_batch_t b;
+    if (fd < 0 || line_batch_open(&b, fd, &config) != NULL) {
+        return 1;
+    }
+    struct iovec two[2] = { line_of("a"), line_of("b") };
+    struct iovec one[1] = { line_of("c") };
+    int rc = 0;
+    line_batch_add(&b, two, 2, 0);
+    if (lseek(fd, 0, SEEK_END) != 0) {
+        rc = 1;
+    }
+    line_batch_add(&b, one, 1, 0);
+    if (lseek(fd, 0, SEEK_END) != 6) {
+        rc = 1;
+    }
+    line_batch_add(&b, one, 1, 1);
+    if (lseek(fd, 0, SEEK_END) != 8) {
+        rc = 1;
+    }
+    if (line_batch_close(&b) != NULL || b.stats.lines != 4) {
+        rc = 1;
+    }
+    size_t len = 0;
+    char *got = read_back(fd, &len);
+    if (!got || strcmp(got, "a\nb\nc\nc\n") != 0) {
+        rc = 1;
+    }
+    free(got);
+    close(fd);
+    return rc;
+}
+
+/* A steady trickle never looks idle; max_delay_us still lets it out. */
+static int test_batch_max_delay(void) {
+    int fd = temp_fd();
+    line_batch_config_t config = { 1000, 1 << 16, 60000000, 20000, 0 };
+    line_batch_t b;
+    if (fd < 0 || line_batch_open(&b, fd, &config) != NULL) {
+        return 1;
+    }
+    struct iovec one[1] = { line_of("tick") };
+    line_batch_add(&b, one, 1, 0);
+    int rc = 1;
+    for (int i = 0; i < 200 && rc != 0; ++i) {
+        sleep_ms(10);
+        rc = lseek(fd, 0, SEEK_END) == 5 ? 0 : 1;
+    }
+    line_batch_close(&b);
+    close(fd);
+    return rc;
+}
+
+/* Through a pipe, with and without vmsplice, buffers smaller than the
+ * output: the bytes arrive in order even when the reader lags. */
+static int test_batch_pipe(int vmsplice) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return 1;
+    }
+    pipe_reader r = { fds[0], NULL, 0 };
+    pthread_t th;
+    pthread_create(&th, NULL, read_pipe, &r);
+    line_batch_config_t config = { 50, 4096, 100, 1000, vmsplice };
+    line_batch_t b;
+    int rc = line_batch_open(&b, fds[1], &config) == NULL ? 0 : 1;
+    static char nums[LINES][16];
+    struct iovec lines[8];
+    for (int i = 0; rc == 0 && i < LINES; i += 8) {
+        for (int k = 0; k < 8; ++k) {
+            snprintf(nums[i + k], sizeof(nums[0]), "line %d", i + k);
+            lines[k] = line_of(nums[i + k]);
+        }
+        rc = line_batch_add(&b, lines, 8, i + 8 >= LINES) == NULL ? 0 : 1;
+    }
+    if (line_batch_close(&b) != NULL) {
+        rc = 1;
+    }
+    close(fds[1]);
+    pthread_join(th, NULL);
+    close(fds[0]);
+    if (rc != 0 || !r.buf || !lines_in_order(r.buf, r.len)) {
+        rc = 1;
+    }
+    free(r.buf);
+    return rc;
+}
+
+int main(void) {
+    /* the error test writes to a pipe with no reader */
+    signal(SIGPIPE, SIG_IGN);
+    if (test_order_small_blocks() != 0) {
+        fprintf(stderr, "test_order_small_blocks failed\n");
+        return 1;
+    }
+    if (test_concurrent_lines_whole() != 0) {
+        fprintf(stderr, "test_concurrent_lines_whole failed\n");
+        return 1;
+    }
+    if (test_flush_after_delay() != 0) {
+        fprintf(stderr, "test_flush_after_delay failed\n");
+        return 1;
+    }
+    if (test_drain_and_large_line() != 0) {
+        fprintf(stderr, "test_drain_and_large_line failed\n");
+        return 1;
+    }
+    if (test_write_error() != 0) {
+        fprintf(stderr, "test_write_error failed\n");
+        return 1;
+    }
+    if (test_mmap_windows() != 0) {
+        fprintf(stderr, "test_mmap_windows failed\n");
+        return 1;
+    }
+    for (int threads_only = 0; threads_only <= 1; ++threads_only) {
+        if (test_uring_writer(threads_only) != 0) {
+            fprintf(stderr, "test_uring_writer(%s) failed\n", backend_name(threads_only));
+            return 1;
+        }
+    }
+    if (test_batch_count_and_end() != 0) {
+        fprintf(stderr, "test_batch_count_and_end failed\n");
+        return 1;
+    }
+    if (test_batch_max_delay() != 0) {
+        fprintf(stderr, "test_batch_max_delay failed\n");
+        return 1;
+    }
+    for (int vmsplice = 0; vmsplice <= 1; ++vmsplice) {
+        if (test_batch_pipe(vmsplice) != 0) {
+            fprintf(stderr, "test_batch_pipe(vmsplice=%d) failed\n", vmsplice);
+            return 1;
+        }
+    }
+    printf("io_test OK\n");
+    return 0;
+}
@@ -114,6 +114,46 @@ static int test_reset(void) {
     return arg.result == 0 ? 0 : 1;
 }
 
+typedef struct {
+    monitor_t* monitor;
+    volatile int done;
+} flag_waiter_arg_t;
+
+static void* flag_waiter_thread(void* arg) {
+    flag_waiter_arg_t* fa = (flag_waiter_arg_t*)arg;
+    (void)monitor_wait(fa->monitor);
+    fa->done = 1;
+    return NULL;
+}
+
+static int test_signals_coalesce(void) {
+    monitor_t monitor;
+    if (monitor_init(&monitor) != 0) {
+        return 1;
+    }
+
+    /* two signals with nobody waiting are remembered as one */
+    monitor_signal(&monitor);
+    monitor_signal(&monitor);
+    if (monitor_wait(&monitor) != 0) {
+        monitor_destroy(&monitor);
+        return 1;
+    }
+
+    flag_waiter_arg_t arg = { .monitor = &monitor, .done = 0 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, flag_waiter_thread, &arg);
+
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 20 * 1000 * 1000 };
+    nanosleep(&ts, NULL);
+    int blocked = !arg.done;
+
+    monitor_signal(&monitor);
+    pthread_join(thread, NULL);
+    monitor_destroy(&monitor);
+    return blocked && arg.done ? 0 : 1;
+}
+
 int main(void) {
     if (test_signal_before_wait() != 0) {
         fprintf(stderr, "test_signal_before_wait failed\n");
@@ -131,6 +171,10 @@ int main(void) {
         fprintf(stderr, "test_reset failed\n");
         return 1;
     }
+    if (test_signals_coalesce() != 0) {
+        fprintf(stderr, "test_signals_coalesce failed\n");
+        return 1;
+    }
     printf("monitor_test OK\n");
     return 0;
 }
@@ -0,0 +1,293 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "text/expand.h"
+#include "text/reverse.h"
+#include "text/upper.h"
+
+#define MAX_LEN 320
+#define GUARD 64
+
+typedef void (*kernel_fn)(char* data, size_t len);
+
+/* Reference: the per-byte toupper() loop the uppercaser used to run. */
+static void upper_reference(char* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        data[i] = (char)toupper((unsigned char)data[i]);
+    }
+}
+
+/* Run fn and ref on the same bytes; the guards around the line must stay
+ * untouched. */
+static int kernel_matches(kernel_fn fn, kernel_fn ref,
+                          const unsigned char* src, size_t off, size_t len) {
+    static char got[GUARD + MAX_LEN + GUARD];
+    static char want[GUARD + MAX_LEN + GUARD];
+    memset(got, 0x5a, sizeof(got));
+    memcpy(got + GUARD + off, src, len);
+    memcpy(want, got, sizeof(got));
+    fn(got + GUARD + off, len);
+    ref(want + GUARD + off, len);
+    return memcmp(got, want, sizeof(got)) == 0;
+}
+
+/* Every byte value in every lane and tail position, at every length and
+ * alignment up to a few registers. */
+static int test_upper_kernel(text_isa_t isa) {
+    text_upper_fn fn = text_upper_kernel(isa);
+    if (!fn) {
+        return 0;
+    }
+    unsigned char src[MAX_LEN];
+    for (int b = 0; b < 256; ++b) {
+        memset(src, b, sizeof(src));
+        for (size_t len = 0; len <= 2 * 64 + 1; ++len) {
+            if (!kernel_matches(fn, upper_reference, src, 0, len)) {
+                fprintf(stderr, "%s: byte 0x%02x len %zu\n", text_isa_name(isa), (unsigned)b, len);
+                return 1;
+            }
+        }
+    }
+    for (size_t i = 0; i < sizeof(src); ++i) {
+        src[i] = (unsigned char)(i * 7 + 3);
+    }
+    for (size_t off = 0; off < 64; ++off) {
+        for (size_t len = 0; off + len <= MAX_LEN; ++len) {
+            if (!kernel_matches(fn, upper_reference, src, off, len)) {
+                fprintf(stderr, "%s: offset %zu len %zu\n", text_isa_name(isa), off, len);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Reference: the byte-pair swap loop the flipper used to run. */
+static void reverse_reference(char* s, size_t len) {
+    for (size_t i = 0; i < len / 2; ++i) {
+        char tmp = s[i];
+        s[i] = s[len - 1 - i];
+        s[len - 1 - i] = tmp;
+    }
+}
+
+/* Every length and alignment across a few pairs of registers. */
+static int test_reverse_kernel(text_isa_t isa) {
+    text_reverse_fn fn = text_reverse_kernel(isa);
+    if (!fn) {
+        return 0;
+    }
+    unsigned char src[MAX_LEN];
+    for (size_t i = 0; i < sizeof(src); ++i) {
+        src[i] = (unsigned char)(i * 7 + 3);
+    }
+    for (size_t off = 0; off < 64; ++off) {
+        for (size_t len = 0; off + len <= MAX_LEN; ++len) {
+            if (!kernel_matches(fn, reverse_reference, src, off, len)) {
+                fprintf(stderr, "%s: offset %zu len %zu\n", text_isa_name(isa), off, len);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int utf8_reverses_to(const char* in, const char* want) {
+    char buf[64];
+    size_t len = strlen(in);
+    for (int isa = 0; isa < TEXT_ISA_COUNT; ++isa) {
+        text_reverse_fn fn = text_reverse_utf8_kernel((text_isa_t)isa);
+        if (!fn) {
+            continue;
+        }
+        memcpy(buf, in, len + 1);
+        fn(buf, len);
+        if (strcmp(buf, want) != 0) {
+            fprintf(stderr, "%s: utf8 reverse of '%s'\n", text_isa_name((text_isa_t)isa), in);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int test_reverse_utf8_cases(void) {
+    int ok = utf8_reverses_to("", "") &&
+             utf8_reverses_to("abc", "cba") &&
+             utf8_reverses_to("caf\xc3\xa9", "\xc3\xa9" "fac") &&
+             utf8_reverses_to("a\xe2\x82\xac" "b\xf0\x9f\x98\x80", "\xf0\x9f\x98\x80" "b\xe2\x82\xac" "a") &&
+             /* a stray continuation stays a byte of its own */
+             utf8_reverses_to("x\xc3\xa9\x80y", "y\x80\xc3\xa9x") &&
+             /* a truncated sequence is reversed as bytes */
+             utf8_reverses_to("a\xe2\x82" "b", "b\x82\xe2" "a") &&
+             utf8_reverses_to("\xc3", "\xc3");
+    return ok ? 0 : 1;
+}
+
+/* Code points from 1 to 4 bytes, with runs of ASCII wider than a
+ * register in between: every kernel reverses them back to the scalar
+ * result, and reversing twice gives the input back. */
+static int test_reverse_utf8_kernels(void) {
+    static const char* const points[] = { "a", "Z", "\xc3\xa9", "\xd7\xa9", "\xe2\x82\xac",
+                                          "\xe4\xb8\xad", "\xf0\x9f\x98\x80", "\xf0\x90\x8d\x88" };
+    char src[MAX_LEN];
+    char want[MAX_LEN];
+    char got[MAX_LEN];
+    unsigned seed = 12345;
+    for (int round = 0; round < 2000; ++round) {
+        size_t len = 0;
+        for (;;) {
+            seed = seed * 1103515245u + 12345u;
+            const char* cp = (seed >> 16) % 4 == 0 ? points[(seed >> 8) % 8] : "the quick brown fox ";
+            size_t n = strlen(cp);
+            if (len + n > (size_t)(round % MAX_LEN)) {
+                break;
+            }
+            memcpy(src + len, cp, n);
+            len += n;
+        }
+        memcpy(want, src, len);
+        text_reverse_utf8_kernel(TEXT_ISA_SCALAR)(want, len);
+        for (int isa = 0; isa < TEXT_ISA_COUNT; ++isa) {
+            text_reverse_fn fn = text_reverse_utf8_kernel((text_isa_t)isa);
+            if (!fn) {
+                continue;
+            }
+            memcpy(got, src, len);
+            fn(got, len);
+            if (memcmp(got, want, len) != 0) {
+                fprintf(stderr, "%s: utf8 round %d len %zu\n", text_isa_name((text_isa_t)isa), round, len);
+                return 1;
+            }
+            fn(got, len);
+            if (memcmp(got, src, len) != 0) {
+                fprintf(stderr, "%s: utf8 twice, round %d\n", text_isa_name((text_isa_t)isa), round);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Arbitrary bytes, malformed sequences included, give the same result on
+ * every kernel. */
+static int test_reverse_utf8_any_bytes(void) {
+    unsigned char src[MAX_LEN];
+    char want[MAX_LEN];
+    char got[MAX_LEN];
+    unsigned seed = 99;
+    for (int round = 0; round < 2000; ++round) {
+        size_t len = (size_t)round % MAX_LEN;
+        for (size_t i = 0; i < len; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            src[i] = (unsigned char)(seed >> 16);
+        }
+        memcpy(want, src, len);
+        text_reverse_utf8_kernel(TEXT_ISA_SCALAR)(want, len);
+        for (int isa = 1; isa < TEXT_ISA_COUNT; ++isa) {
+            text_reverse_fn fn = text_reverse_utf8_kernel((text_isa_t)isa);
+            if (!fn) {
+                continue;
+            }
+            memcpy(got, src, len);
+            fn(got, len);
+            if (memcmp(got, want, len) != 0) {
+                fprintf(stderr, "%s: utf8 bytes round %d\n", text_isa_name((text_isa_t)isa), round);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Reference: the loop the expander used to run, with the separator as a
+ * parameter. */
+static void interleave_reference(char* out, const char* src, size_t len, char sep) {
+    size_t j = 0;
+    for (size_t i = 0; i < len; ++i) {
+        out[j++] = src[i];
+        if (i + 1 < len) {
+            out[j++] = sep;
+        }
+    }
+}
+
+/* Every length and alignment, with guards after the 2 * len - 1 bytes. */
+static int test_interleave_kernel(text_isa_t isa) {
+    text_interleave_fn fn = text_interleave_kernel(isa);
+    if (!fn) {
+        return 0;
+    }
+    static char src[MAX_LEN];
+    static char got[2 * MAX_LEN + GUARD];
+    static char want[2 * MAX_LEN + GUARD];
+    for (size_t i = 0; i < sizeof(src); ++i) {
+        src[i] = (char)(i * 7 + 3);
+    }
+    const char seps[] = { ' ', '\0', (char)0xff };
+    for (size_t k = 0; k < sizeof(seps); ++k) {
+        for (size_t off = 0; off < 64; ++off) {
+            for (size_t len = 1; off + len <= MAX_LEN; ++len) {
+                memset(got, 0x5a, sizeof(got));
+                memset(want, 0x5a, sizeof(want));
+                fn(got, src + off, len, seps[k]);
+                interleave_reference(want, src + off, len, seps[k]);
+                if (memcmp(got, want, sizeof(got)) != 0) {
+                    fprintf(stderr, "%s: sep 0x%02x offset %zu len %zu\n", text_isa_name(isa),
+                            (unsigned)(unsigned char)seps[k], off, len);
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int test_upper_select(void) {
+    for (int isa = 0; isa < TEXT_ISA_COUNT; ++isa) {
+        text_upper_fn fn = text_upper_select((text_isa_t)isa);
+        if (!fn || (text_upper_kernel((text_isa_t)isa) && fn != text_upper_kernel((text_isa_t)isa))) {
+            return 1;
+        }
+    }
+    return text_upper_kernel(TEXT_ISA_SCALAR) ? 0 : 1;
+}
+
+int main(void) {
+    for (int isa = 0; isa < TEXT_ISA_COUNT; ++isa) {
+        if (test_upper_kernel((text_isa_t)isa) != 0) {
+            fprintf(stderr, "test_upper_kernel(%s) failed\n", text_isa_name((text_isa_t)isa));
+            return 1;
+        }
+    }
+    if (test_upper_select() != 0) {
+        fprintf(stderr, "test_upper_select failed\n");
+        return 1;
+    }
+    for (int isa = 0; isa < TEXT_ISA_COUNT; ++isa) {
+        if (test_reverse_kernel((text_isa_t)isa) != 0) {
+            fprintf(stderr, "test_reverse_kernel(%s) failed\n", text_isa_name((text_isa_t)isa));
+            return 1;
+        }
+    }
+    if (test_reverse_utf8_cases() != 0) {
+        fprintf(stderr, "test_reverse_utf8_cases failed\n");
+        return 1;
+    }
+    if (test_reverse_utf8_kernels() != 0) {
+        fprintf(stderr, "test_reverse_utf8_kernels failed\n");
+        return 1;
+    }
+    if (test_reverse_utf8_any_bytes() != 0) {
+        fprintf(stderr, "test_reverse_utf8_any_bytes failed\n");
+        return 1;
+    }
+    for (int isa = 0; isa < TEXT_ISA_COUNT; ++isa) {
+        if (test_interleave_kernel((text_isa_t)isa) != 0) {
+            fprintf(stderr, "test_interleave_kernel(%s) failed\n", text_isa_name((text_isa_t)isa));
+            return 1;
+        }
+    }
+    printf("text_test OK\n");
+    return 0;
+}